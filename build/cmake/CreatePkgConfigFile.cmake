@@ -9,12 +9,17 @@ SET(includedir \${prefix}/include)
 # Now, this is not particularly pretty, nor is it terribly accurate...
 # Loop over all our additional libs
 FOREACH(mylib ${ADDITIONAL_LIBS})
-	# Extract the filename from the absolute path
-	GET_FILENAME_COMPONENT(mylib_name ${mylib} NAME_WE)
-	# Strip the lib prefix
-	STRING(REGEX REPLACE "^lib" "" mylib_name ${mylib_name})
-	# Append it to our LIBS string
-	SET(LIBS "${LIBS} -l${mylib_name}")
+	IF(mylib MATCHES "^-")
+		# Linker flags such as -pthread are passed through as they are
+		SET(LIBS "${LIBS} ${mylib}")
+	ELSE()
+		# Extract the filename from the absolute path
+		GET_FILENAME_COMPONENT(mylib_name ${mylib} NAME_WE)
+		# Strip the lib prefix
+		STRING(REGEX REPLACE "^lib" "" mylib_name ${mylib_name})
+		# Append it to our LIBS string
+		SET(LIBS "${LIBS} -l${mylib_name}")
+	ENDIF()
 ENDFOREACH()
 # libxml2 is easier, since it's already using pkg-config
 FOREACH(mylib ${PC_LIBXML_STATIC_LDFLAGS})
@@ -39,6 +39,7 @@ libarchive_src_files := libarchive/archive_acl.c \
 						libarchive/archive_entry_xattr.c \
 						libarchive/archive_getdate.c \
 						libarchive/archive_hmac.c \
+						libarchive/archive_hmap.c \
 						libarchive/archive_match.c \
 						libarchive/archive_options.c \
 						libarchive/archive_pack_dev.c \
@@ -93,6 +94,7 @@ libarchive_src_files := libarchive/archive_acl.c \
 						libarchive/archive_read_support_format_zip.c \
 						libarchive/archive_string.c \
 						libarchive/archive_string_sprintf.c \
+						libarchive/archive_time.c \
 						libarchive/archive_util.c \
 						libarchive/archive_version_details.c \
 						libarchive/archive_virtual.c \
@@ -137,6 +139,7 @@ libarchive_src_files := libarchive/archive_acl.c \
 						libarchive/archive_write_set_format_zip.c \
 						libarchive/archive_write_set_options.c \
 						libarchive/archive_write_set_passphrase.c \
+						libarchive/archive_zstd_dict.c \
 						libarchive/filter_fork_posix.c \
 						libarchive/xxhash.c
 
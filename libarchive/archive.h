@@ -183,6 +183,13 @@ __LA_DECL const char *  archive_libzstd_version(void);
 struct archive;
 struct archive_entry;
 
+/* A block of memory.  The layout matches struct iovec on POSIX systems,
+ * so an array of these can be passed to writev(). */
+struct archive_iovec {
+	void	*iov_base;
+	size_t	 iov_len;
+};
+
 /*
  * Error codes: Use archive_errno() and archive_error_string()
  * to retrieve details.  Unless specified otherwise, all functions
@@ -441,6 +448,9 @@ __LA_DECL int archive_read_support_filter_rpm(struct archive *);
 __LA_DECL int archive_read_support_filter_uu(struct archive *);
 __LA_DECL int archive_read_support_filter_xz(struct archive *);
 __LA_DECL int archive_read_support_filter_zstd(struct archive *);
+/* Frames select one of the added dictionaries by its dictionary ID. */
+__LA_DECL int archive_read_add_zstd_dictionary(struct archive *,
+		     const void *, size_t);
 
 __LA_DECL int archive_read_support_format_7zip(struct archive *);
 __LA_DECL int archive_read_support_format_all(struct archive *);
@@ -542,6 +552,9 @@ __LA_DECL int archive_read_open_memory(struct archive *,
 /* A more involved version that is only used for internal testing. */
 __LA_DECL int archive_read_open_memory2(struct archive *a, const void *buff,
 		     size_t size, size_t read_size);
+/* Read an archive stored in several blocks of memory, in order. */
+__LA_DECL int archive_read_open_iovec(struct archive *,
+		     const struct archive_iovec *_blocks, size_t _count);
 /* Read an archive that's already open, using the file descriptor. */
 __LA_DECL int archive_read_open_fd(struct archive *, int _fd,
 		     size_t _block_size);
@@ -699,6 +712,11 @@ __LA_DECL int archive_read_set_passphrase_callback(struct archive *,
 #define	ARCHIVE_EXTRACT_CLEAR_NOCHANGE_FFLAGS	(0x20000)
 /* Default: Do not extract atomically (using rename) */
 #define	ARCHIVE_EXTRACT_SAFE_WRITES		(0x40000)
+/* Default: Do not preallocate space for large files */
+#define	ARCHIVE_EXTRACT_PREALLOCATE		(0x80000)
+/* Default: Leave flushing extracted files to the system */
+#define	ARCHIVE_EXTRACT_SYNC_PER_FILE		(0x100000)
+#define	ARCHIVE_EXTRACT_SYNC_BATCH		(0x200000)
 
 __LA_DECL int archive_read_extract(struct archive *, struct archive_entry *,
 		     int flags);
@@ -790,6 +808,9 @@ __LA_DECL int archive_write_add_filter_program(struct archive *,
 __LA_DECL int archive_write_add_filter_uuencode(struct archive *);
 __LA_DECL int archive_write_add_filter_xz(struct archive *);
 __LA_DECL int archive_write_add_filter_zstd(struct archive *);
+/* Compress with this dictionary; call after adding the zstd filter. */
+__LA_DECL int archive_write_set_zstd_dictionary(struct archive *,
+		     const void *, size_t);
 
 
 /* A convenience function to set the format based on the code or name. */
@@ -824,6 +845,11 @@ __LA_DECL int archive_write_set_format_filter_by_ext(struct archive *a, const ch
 __LA_DECL int archive_write_set_format_filter_by_ext_def(struct archive *a, const char *filename, const char * def_ext);
 __LA_DECL int archive_write_zip_set_compression_deflate(struct archive *);
 __LA_DECL int archive_write_zip_set_compression_store(struct archive *);
+/* How many regular files the "compression=auto" option of the zip and
+ * 7zip writers has compressed and stored so far.  Comparing the counts
+ * before and after an entry tells what was done with that entry. */
+__LA_DECL int archive_write_get_auto_compression_stats(struct archive *,
+		     la_int64_t *_compressed, la_int64_t *_stored);
 /* Deprecated; use archive_write_open2 instead */
 __LA_DECL int archive_write_open(struct archive *, void *,
 		     archive_open_callback *, archive_write_callback *,
@@ -843,6 +869,20 @@ __LA_DECL int archive_write_open_FILE(struct archive *, FILE *);
  * will be updated after each write into the buffer. */
 __LA_DECL int archive_write_open_memory(struct archive *,
 			void *_buffer, size_t _buffSize, size_t *_used);
+/* Write into a list of chunks of _chunkSize bytes (0 picks a default)
+ * that grows as needed.  The chunks can be inspected with
+ * archive_write_get_memory_chunks() until the next write, or handed
+ * over to the caller with archive_write_take_memory_chunks(); the
+ * caller must then release them with
+ * archive_write_free_memory_chunks(), not free(). */
+__LA_DECL int archive_write_open_memory_chunks(struct archive *,
+			size_t _chunkSize);
+__LA_DECL int archive_write_get_memory_chunks(struct archive *,
+			const struct archive_iovec **_chunks, size_t *_count);
+__LA_DECL int archive_write_take_memory_chunks(struct archive *,
+			struct archive_iovec **_chunks, size_t *_count);
+__LA_DECL void archive_write_free_memory_chunks(struct archive_iovec *_chunks,
+			size_t _count);
 
 /*
  * Note that the library will truncate writes beyond the size provided
@@ -0,0 +1,195 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "archive_hmap.h"
+#include "archive_xxhash.h"
+
+/*
+ * Linear probing with a load factor of at most 3/4.  Each slot keeps
+ * 32 bits of the hash so most mismatches are rejected without looking
+ * at the node, and removal shifts later entries back instead of
+ * leaving tombstones.
+ */
+#define	HMAP_MIN_SLOTS	16
+
+void
+__archive_hmap_init(struct archive_hmap *m, const struct archive_hmap_ops *ops)
+{
+	m->slots = NULL;
+	m->mask = 0;
+	m->count = 0;
+	m->ops = ops;
+}
+
+void
+__archive_hmap_free(struct archive_hmap *m)
+{
+	free(m->slots);
+	m->slots = NULL;
+	m->mask = 0;
+	m->count = 0;
+}
+
+static int
+hmap_grow(struct archive_hmap *m)
+{
+	struct archive_hmap_slot *old = m->slots, *slots;
+	size_t old_n = old ? m->mask + 1 : 0, n, i, j;
+
+	n = old_n ? old_n * 2 : HMAP_MIN_SLOTS;
+	if (n < old_n || n > SIZE_MAX / sizeof(*slots))
+		return (-1);
+	slots = calloc(n, sizeof(*slots));
+	if (slots == NULL)
+		return (-1);
+	for (i = 0; i < old_n; i++) {
+		if (old[i].node == NULL)
+			continue;
+		for (j = old[i].hash & (n - 1); slots[j].node != NULL;
+		    j = (j + 1) & (n - 1))
+			;
+		slots[j] = old[i];
+	}
+	free(old);
+	m->slots = slots;
+	m->mask = n - 1;
+	return (0);
+}
+
+int
+__archive_hmap_insert(struct archive_hmap *m, void *node)
+{
+	uint32_t h;
+	size_t i;
+
+	if (m->slots == NULL || (m->count + 1) * 4 > (m->mask + 1) * 3) {
+		if (hmap_grow(m) < 0)
+			return (-1);
+	}
+	h = (uint32_t)m->ops->hmap_hash_node(node);
+	for (i = h & m->mask; m->slots[i].node != NULL;
+	    i = (i + 1) & m->mask) {
+		if (m->slots[i].hash == h &&
+		    m->ops->hmap_cmp_nodes(m->slots[i].node, node) == 0)
+			return (0);
+	}
+	m->slots[i].node = node;
+	m->slots[i].hash = h;
+	m->count++;
+	return (1);
+}
+
+static size_t
+hmap_lookup(const struct archive_hmap *m, const void *key)
+{
+	uint32_t h;
+	size_t i;
+
+	if (m->slots == NULL)
+		return ((size_t)-1);
+	h = (uint32_t)m->ops->hmap_hash_key(key);
+	for (i = h & m->mask; m->slots[i].node != NULL;
+	    i = (i + 1) & m->mask) {
+		if (m->slots[i].hash == h &&
+		    m->ops->hmap_cmp_key(m->slots[i].node, key) == 0)
+			return (i);
+	}
+	return ((size_t)-1);
+}
+
+void *
+__archive_hmap_find(const struct archive_hmap *m, const void *key)
+{
+	size_t i = hmap_lookup(m, key);
+
+	return (i == (size_t)-1 ? NULL : m->slots[i].node);
+}
+
+void *
+__archive_hmap_remove(struct archive_hmap *m, const void *key)
+{
+	size_t i, j, home;
+	void *node;
+
+	i = hmap_lookup(m, key);
+	if (i == (size_t)-1)
+		return (NULL);
+	node = m->slots[i].node;
+	/* Move back any later entry whose probe sequence passed 'i'. */
+	for (j = (i + 1) & m->mask; m->slots[j].node != NULL;
+	    j = (j + 1) & m->mask) {
+		home = m->slots[j].hash & m->mask;
+		if (((j - home) & m->mask) >= ((j - i) & m->mask)) {
+			m->slots[i] = m->slots[j];
+			i = j;
+		}
+	}
+	m->slots[i].node = NULL;
+	m->count--;
+	return (node);
+}
+
+void **
+__archive_hmap_sorted(const struct archive_hmap *m, size_t *count,
+    int (*cmp)(const void *, const void *))
+{
+	void **nodes;
+	size_t i, n = 0;
+
+	*count = 0;
+	if (m->count == 0)
+		return (NULL);
+	nodes = malloc(m->count * sizeof(*nodes));
+	if (nodes == NULL)
+		return (NULL);
+	for (i = 0; i <= m->mask; i++) {
+		if (m->slots[i].node != NULL)
+			nodes[n++] = m->slots[i].node;
+	}
+	qsort(nodes, n, sizeof(*nodes), cmp);
+	*count = n;
+	return (nodes);
+}
+
+uint64_t
+__archive_hmap_hash_bytes(const void *p, size_t len)
+{
+	return (__archive_xxhash.XXH64(p, len, 0));
+}
+
+uint64_t
+__archive_hmap_hash_string(const char *s)
+{
+	return (__archive_xxhash.XXH64(s, strlen(s), 0));
+}
@@ -0,0 +1,84 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_HMAP_H_INCLUDED
+#define	ARCHIVE_HMAP_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#ifndef __LIBARCHIVE_TEST
+#error This header is only to be used internally to libarchive.
+#endif
+#endif
+
+/*
+ * An open-addressing hash table of pointers to caller-owned nodes.
+ * Unlike archive_rb, nodes need no embedded links, and a lookup
+ * usually touches one cache line of the table plus the node itself.
+ * There is no ordering; __archive_hmap_sorted() builds a sorted array
+ * when one is needed.
+ */
+
+struct archive_hmap_ops {
+	/* Hash of a key, and of the key stored in a node. */
+	uint64_t (*hmap_hash_key)(const void *key);
+	uint64_t (*hmap_hash_node)(const void *node);
+	/* Return 0 if the node's key equals 'key'. */
+	int	 (*hmap_cmp_key)(const void *node, const void *key);
+	/* Return 0 if the two nodes have the same key. */
+	int	 (*hmap_cmp_nodes)(const void *, const void *);
+};
+
+struct archive_hmap_slot {
+	void		*node;
+	uint32_t	 hash;
+};
+
+struct archive_hmap {
+	struct archive_hmap_slot	*slots;
+	size_t				 mask;	/* Slot count - 1. */
+	size_t				 count;
+	const struct archive_hmap_ops	*ops;
+};
+
+void	__archive_hmap_init(struct archive_hmap *,
+	    const struct archive_hmap_ops *);
+void	__archive_hmap_free(struct archive_hmap *);
+/* Returns 1 if inserted, 0 if a node with the same key is already
+ * there (the map is unchanged), or -1 if out of memory. */
+int	__archive_hmap_insert(struct archive_hmap *, void *);
+void	*__archive_hmap_find(const struct archive_hmap *, const void *key);
+/* Removes and returns the node with this key, if any. */
+void	*__archive_hmap_remove(struct archive_hmap *, const void *key);
+/* Returns a malloc()ed array of all nodes, sorted with qsort() and
+ * 'cmp', which is given pointers to array elements.  *count is set to
+ * the number of nodes.  Returns NULL if the map is empty or out of
+ * memory. */
+void	**__archive_hmap_sorted(const struct archive_hmap *, size_t *count,
+	    int (*cmp)(const void *, const void *));
+/* Hashes for keys that are byte strings. */
+uint64_t __archive_hmap_hash_bytes(const void *, size_t);
+uint64_t __archive_hmap_hash_string(const char *);
+
+#endif	/* ARCHIVE_HMAP_H_INCLUDED */
@@ -42,13 +42,16 @@ __FBSDID("$FreeBSD$");
 #include "archive_entry.h"
 #include "archive_getdate.h"
 #include "archive_pathmatch.h"
-#include "archive_rb.h"
+#include "archive_hmap.h"
 #include "archive_string.h"
 
 struct match {
 	struct match		*next;
 	int			 matches;
 	struct archive_mstring	 pattern;
+	/* The multibyte pattern compiled for 'compiled_flags'. */
+	struct archive_pathmatch_compiled *compiled;
+	int			 compiled_flags;
 };
 
 struct match_list {
@@ -61,7 +64,6 @@ struct match_list {
 };
 
 struct match_file {
-	struct archive_rb_node	 node;
 	struct match_file	*next;
 	struct archive_mstring	 pathname;
 	int			 flag;
@@ -121,7 +123,7 @@ struct archive_match {
 	/*
 	 * Matching time stamps with its filename.
 	 */
-	struct archive_rb_tree	 exclusion_tree;
+	struct archive_hmap	 exclusion_map;
 	struct entry_list 	 exclusion_entry_list;
 
 	/*
@@ -145,12 +147,14 @@ static int	add_pattern_mbs(struct archive_match *, struct match_list *,
 		    const char *);
 static int	add_pattern_wcs(struct archive_match *, struct match_list *,
 		    const wchar_t *);
-static int	cmp_key_mbs(const struct archive_rb_node *, const void *);
-static int	cmp_key_wcs(const struct archive_rb_node *, const void *);
-static int	cmp_node_mbs(const struct archive_rb_node *,
-		    const struct archive_rb_node *);
-static int	cmp_node_wcs(const struct archive_rb_node *,
-		    const struct archive_rb_node *);
+static int	cmp_key_mbs(const void *, const void *);
+static int	cmp_key_wcs(const void *, const void *);
+static int	cmp_node_mbs(const void *, const void *);
+static int	cmp_node_wcs(const void *, const void *);
+static uint64_t	hash_key_mbs(const void *);
+static uint64_t	hash_key_wcs(const void *);
+static uint64_t	hash_node_mbs(const void *);
+static uint64_t	hash_node_wcs(const void *);
 static void	entry_list_add(struct entry_list *, struct match_file *);
 static void	entry_list_free(struct entry_list *);
 static void	entry_list_init(struct entry_list *);
@@ -172,6 +176,8 @@ static int	match_path_exclusion(struct archive_match *,
 		    struct match *, int, const void *);
 static int	match_path_inclusion(struct archive_match *,
 		    struct match *, int, const void *);
+static int	match_path_mbs(struct match *, const char *, const char *,
+		    int);
 static int	owner_excluded(struct archive_match *,
 		    struct archive_entry *);
 static int	path_excluded(struct archive_match *, int, const void *);
@@ -190,12 +196,12 @@ static int	validate_time_flag(struct archive *, int, const char *);
 
 #define get_date __archive_get_date
 
-static const struct archive_rb_tree_ops rb_ops_mbs = {
-	cmp_node_mbs, cmp_key_mbs
+static const struct archive_hmap_ops hmap_ops_mbs = {
+	hash_key_mbs, hash_node_mbs, cmp_key_mbs, cmp_node_mbs
 };
 
-static const struct archive_rb_tree_ops rb_ops_wcs = {
-	cmp_node_wcs, cmp_key_wcs
+static const struct archive_hmap_ops hmap_ops_wcs = {
+	hash_key_wcs, hash_node_wcs, cmp_key_wcs, cmp_node_wcs
 };
 
 /*
@@ -229,7 +235,12 @@ archive_match_new(void)
 	a->recursive_include = 1;
 	match_list_init(&(a->inclusions));
 	match_list_init(&(a->exclusions));
-	__archive_rb_tree_init(&(a->exclusion_tree), &rb_ops_mbs);
+#if defined(_WIN32) && !defined(__CYGWIN__)
+	__archive_hmap_init(&(a->exclusion_map), &hmap_ops_wcs);
+#else
+	(void)hmap_ops_wcs;
+	__archive_hmap_init(&(a->exclusion_map), &hmap_ops_mbs);
+#endif
 	entry_list_init(&(a->exclusion_entry_list));
 	match_list_init(&(a->inclusion_unames));
 	match_list_init(&(a->inclusion_gnames));
@@ -252,6 +263,7 @@ archive_match_free(struct archive *_a)
 	a = (struct archive_match *)_a;
 	match_list_free(&(a->inclusions));
 	match_list_free(&(a->exclusions));
+	__archive_hmap_free(&(a->exclusion_map));
 	entry_list_free(&(a->exclusion_entry_list));
 	free(a->inclusion_uids.ids);
 	free(a->inclusion_gids.ids);
@@ -770,6 +782,24 @@ path_excluded(struct archive_match *a, int mbs, const void *pathname)
 	return (0);
 }
 
+/*
+ * Match with the compiled form of the pattern, compiling it the first
+ * time it's used with these flags.  Inclusion flags can change after
+ * patterns were added, so the flags are part of the cache key.
+ */
+static int
+match_path_mbs(struct match *m, const char *p, const char *pn, int flag)
+{
+	if (m->compiled == NULL || m->compiled_flags != flag) {
+		__archive_pathmatch_compiled_free(m->compiled);
+		m->compiled = __archive_pathmatch_compile(p, flag);
+		m->compiled_flags = flag;
+		if (m->compiled == NULL)
+			return (archive_pathmatch(p, pn, flag));
+	}
+	return (__archive_pathmatch_exec(m->compiled, pn));
+}
+
 /*
  * This is a little odd, but it matches the default behavior of
  * gtar.  In particular, 'a*b' will match 'foo/a1111/222b/bar'
@@ -786,7 +816,7 @@ match_path_exclusion(struct archive_match *a, struct match *m,
 		const char *p;
 		r = archive_mstring_get_mbs(&(a->archive), &(m->pattern), &p);
 		if (r == 0)
-			return (archive_pathmatch(p, (const char *)pn, flag));
+			return (match_path_mbs(m, p, (const char *)pn, flag));
 	} else {
 		const wchar_t *p;
 		r = archive_mstring_get_wcs(&(a->archive), &(m->pattern), &p);
@@ -817,7 +847,7 @@ match_path_inclusion(struct archive_match *a, struct match *m,
 		const char *p;
 		r = archive_mstring_get_mbs(&(a->archive), &(m->pattern), &p);
 		if (r == 0)
-			return (archive_pathmatch(p, (const char *)pn, flag));
+			return (match_path_mbs(m, p, (const char *)pn, flag));
 	} else {
 		const wchar_t *p;
 		r = archive_mstring_get_wcs(&(a->archive), &(m->pattern), &p);
@@ -847,6 +877,7 @@ match_list_free(struct match_list *list)
 		q = p;
 		p = p->next;
 		archive_mstring_clean(&(q->pattern));
+		__archive_pathmatch_compiled_free(q->compiled);
 		free(q);
 	}
 }
@@ -1299,11 +1330,28 @@ set_timefilter_pathname_wcs(struct archive_match *a, int timetype,
 #endif /* _WIN32 && !__CYGWIN__ */
 
 /*
- * Call back functions for archive_rb.
+ * Call back functions for archive_hmap.
  */
+static uint64_t
+hash_key_mbs(const void *key)
+{
+	return (__archive_hmap_hash_string((const char *)key));
+}
+
+static uint64_t
+hash_node_mbs(const void *n)
+{
+	struct match_file *f = (struct match_file *)(uintptr_t)n;
+	const char *p;
+
+	archive_mstring_get_mbs(NULL, &(f->pathname), &p);
+	if (p == NULL)
+		return (0);
+	return (hash_key_mbs(p));
+}
+
 static int
-cmp_node_mbs(const struct archive_rb_node *n1,
-    const struct archive_rb_node *n2)
+cmp_node_mbs(const void *n1, const void *n2)
 {
 	struct match_file *f1 = (struct match_file *)(uintptr_t)n1;
 	struct match_file *f2 = (struct match_file *)(uintptr_t)n2;
@@ -1317,9 +1365,9 @@ cmp_node_mbs(const struct archive_rb_node *n1,
 		return (-1);
 	return (strcmp(p1, p2));
 }
-        
+
 static int
-cmp_key_mbs(const struct archive_rb_node *n, const void *key)
+cmp_key_mbs(const void *n, const void *key)
 {
 	struct match_file *f = (struct match_file *)(uintptr_t)n;
 	const char *p;
@@ -1330,9 +1378,28 @@ cmp_key_mbs(const struct archive_rb_node *n, const void *key)
 	return (strcmp(p, (const char *)key));
 }
 
+static uint64_t
+hash_key_wcs(const void *key)
+{
+	const wchar_t *p = (const wchar_t *)key;
+
+	return (__archive_hmap_hash_bytes(p, wcslen(p) * sizeof(*p)));
+}
+
+static uint64_t
+hash_node_wcs(const void *n)
+{
+	struct match_file *f = (struct match_file *)(uintptr_t)n;
+	const wchar_t *p;
+
+	archive_mstring_get_wcs(NULL, &(f->pathname), &p);
+	if (p == NULL)
+		return (0);
+	return (hash_key_wcs(p));
+}
+
 static int
-cmp_node_wcs(const struct archive_rb_node *n1,
-    const struct archive_rb_node *n2)
+cmp_node_wcs(const void *n1, const void *n2)
 {
 	struct match_file *f1 = (struct match_file *)(uintptr_t)n1;
 	struct match_file *f2 = (struct match_file *)(uintptr_t)n2;
@@ -1346,9 +1413,9 @@ cmp_node_wcs(const struct archive_rb_node *n1,
 		return (-1);
 	return (wcscmp(p1, p2));
 }
-        
+
 static int
-cmp_key_wcs(const struct archive_rb_node *n, const void *key)
+cmp_key_wcs(const void *n, const void *key)
 {
 	struct match_file *f = (struct match_file *)(uintptr_t)n;
 	const wchar_t *p;
@@ -1408,9 +1475,7 @@ add_entry(struct archive_match *a, int flag,
 		return (ARCHIVE_FAILED);
 	}
 	archive_mstring_copy_wcs(&(f->pathname), pathname);
-	a->exclusion_tree.rbt_ops = &rb_ops_wcs;
 #else
-	(void)rb_ops_wcs;
 	pathname = archive_entry_pathname(entry);
 	if (pathname == NULL) {
 		free(f);
@@ -1418,20 +1483,24 @@ add_entry(struct archive_match *a, int flag,
 		return (ARCHIVE_FAILED);
 	}
 	archive_mstring_copy_mbs(&(f->pathname), pathname);
-	a->exclusion_tree.rbt_ops = &rb_ops_mbs;
 #endif
 	f->flag = flag;
 	f->mtime_sec = archive_entry_mtime(entry);
 	f->mtime_nsec = archive_entry_mtime_nsec(entry);
 	f->ctime_sec = archive_entry_ctime(entry);
 	f->ctime_nsec = archive_entry_ctime_nsec(entry);
-	r = __archive_rb_tree_insert_node(&(a->exclusion_tree), &(f->node));
-	if (!r) {
+	r = __archive_hmap_insert(&(a->exclusion_map), f);
+	if (r < 0) {
+		archive_mstring_clean(&(f->pathname));
+		free(f);
+		return (error_nomem(a));
+	}
+	if (r == 0) {
 		struct match_file *f2;
 
 		/* Get the duplicated file. */
-		f2 = (struct match_file *)__archive_rb_tree_find_node(
-			&(a->exclusion_tree), pathname);
+		f2 = (struct match_file *)__archive_hmap_find(
+			&(a->exclusion_map), pathname);
 
 		/*
 		 * We always overwrite comparison condition.
@@ -1548,17 +1617,14 @@ time_excluded(struct archive_match *a, struct archive_entry *entry)
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
 	pathname = archive_entry_pathname_w(entry);
-	a->exclusion_tree.rbt_ops = &rb_ops_wcs;
 #else
-	(void)rb_ops_wcs;
 	pathname = archive_entry_pathname(entry);
-	a->exclusion_tree.rbt_ops = &rb_ops_mbs;
 #endif
 	if (pathname == NULL)
 		return (0);
 
-	f = (struct match_file *)__archive_rb_tree_find_node(
-		&(a->exclusion_tree), pathname);
+	f = (struct match_file *)__archive_hmap_find(
+		&(a->exclusion_map), pathname);
 	/* If the file wasn't rejected, include it. */
 	if (f == NULL)
 		return (0);
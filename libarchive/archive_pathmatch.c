@@ -27,6 +27,9 @@
 #include "archive_platform.h"
 __FBSDID("$FreeBSD$");
 
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
@@ -220,8 +223,10 @@ pm(const char *p, const char *s, int flags)
 				++end;
 			}
 			if (*end == ']') {
-				/* We found [...], try to match it. */
-				if (!pm_list(p + 1, end, *s, flags))
+				/* We found [...], try to match it.  Even a
+				 * negated class can't match the end of 's'. */
+				if (*s == '\0' ||
+				    !pm_list(p + 1, end, *s, flags))
 					return (0);
 				p = end; /* Jump to trailing ']' char. */
 				break;
@@ -325,8 +330,10 @@ pm_w(const wchar_t *p, const wchar_t *s, int flags)
 				++end;
 			}
 			if (*end == L']') {
-				/* We found [...], try to match it. */
-				if (!pm_list_w(p + 1, end, *s, flags))
+				/* We found [...], try to match it.  Even a
+				 * negated class can't match the end of 's'. */
+				if (*s == L'\0' ||
+				    !pm_list_w(p + 1, end, *s, flags))
 					return (0);
 				p = end; /* Jump to trailing ']' char. */
 				break;
@@ -461,3 +468,379 @@ __archive_pathmatch_w(const wchar_t *p, const wchar_t *s, int flags)
 	/* Default: Match from beginning. */
 	return (pm_w(p, s, flags));
 }
+
+/*
+ * Compiled patterns.
+ *
+ * archive_match tests every pattern against every entry, so it pays
+ * to do the parsing above once.  A pattern is compiled into a list of
+ * operations; runs of ordinary characters become one literal that is
+ * compared with strncmp(), and [...] classes become a 256-bit map
+ * built by pm_list() itself.  The interpreter restarts at the top
+ * (__archive_pathmatch()) for the rest of the pattern after each '*',
+ * so every '*' gets its own entry with the same start-of-pattern
+ * handling.  The result must be exactly that of __archive_pathmatch().
+ */
+
+enum pm_op_type {
+	PM_OP_LITERAL,	/* Characters that must match exactly. */
+	PM_OP_ANY,	/* '?' */
+	PM_OP_CLASS,	/* [...] */
+	PM_OP_SLASH,	/* '/', together with any "./" or "//" after it. */
+	PM_OP_END,	/* End of pattern. */
+	PM_OP_DOLLAR,	/* Trailing '$' with PATHMATCH_NO_ANCHOR_END. */
+	PM_OP_STAR	/* '*'; always the last op of an entry. */
+};
+
+struct pm_op {
+	enum pm_op_type	 type;
+	/* PM_OP_SLASH: nonzero if the pattern matches after it.
+	 * PM_OP_STAR: the entry for the rest of the pattern, or -1. */
+	int		 arg;
+	size_t		 off;	/* Literal offset or class index. */
+	size_t		 len;	/* Literal length. */
+};
+
+struct pm_entry {
+	int		 empty;		/* Pattern is "". */
+	int		 need_slash;	/* Pattern starts with '/'. */
+	int		 implicit;	/* Skip leading '/' in the path. */
+	int		 scan;		/* Try each path element. */
+	size_t		 first_op;
+	/* If not empty, a path position can only match when its first
+	 * character is one of these; "." covers a skipped "./". */
+	char		 accept[3];
+};
+
+struct archive_pathmatch_compiled {
+	int		 flags;
+	struct pm_entry	*entries;
+	size_t		 nentries;
+	struct pm_op	*ops;
+	size_t		 nops;
+	unsigned char	(*classes)[32];
+	size_t		 nclasses;
+	char		*literals;
+	size_t		 nliterals;
+};
+
+static void	pmc_compile_body(struct archive_pathmatch_compiled *,
+		    const char *, int);
+static int	pmc_body(const struct archive_pathmatch_compiled *, size_t,
+		    const char *);
+static int	pmc_entry(const struct archive_pathmatch_compiled *,
+		    const struct pm_entry *, const char *);
+
+static void
+pmc_literal(struct archive_pathmatch_compiled *c, char ch)
+{
+	struct pm_op *op;
+
+	op = c->nops ? &c->ops[c->nops - 1] : NULL;
+	if (op == NULL || op->type != PM_OP_LITERAL) {
+		op = &c->ops[c->nops++];
+		op->type = PM_OP_LITERAL;
+		op->arg = 0;
+		op->off = c->nliterals;
+		op->len = 0;
+	}
+	c->literals[c->nliterals++] = ch;
+	op->len++;
+}
+
+static struct pm_op *
+pmc_op(struct archive_pathmatch_compiled *c, enum pm_op_type type, int arg)
+{
+	struct pm_op *op = &c->ops[c->nops++];
+
+	op->type = type;
+	op->arg = arg;
+	op->off = op->len = 0;
+	return (op);
+}
+
+/* Mirrors the start of __archive_pathmatch(). */
+static size_t
+pmc_compile_entry(struct archive_pathmatch_compiled *c, const char *p,
+    int flags)
+{
+	size_t idx = c->nentries++;
+	struct pm_entry *e = &c->entries[idx];
+	const struct pm_op *op;
+
+	memset(e, 0, sizeof(*e));
+	if (*p == '\0') {
+		e->empty = 1;
+		return (idx);
+	}
+	if (*p == '^') {
+		++p;
+		flags &= ~PATHMATCH_NO_ANCHOR_START;
+	}
+	if (*p == '/')
+		e->need_slash = 1;
+	if (*p == '*' || *p == '/') {
+		e->implicit = 1;
+		while (*p == '/')
+			++p;
+	} else if (flags & PATHMATCH_NO_ANCHOR_START)
+		e->scan = 1;
+	e->first_op = c->nops;
+	pmc_compile_body(c, p, flags);
+
+	op = &c->ops[e->first_op];
+	if (op->type == PM_OP_LITERAL) {
+		e->accept[0] = c->literals[op->off];
+		e->accept[1] = '.';
+	}
+	return (idx);
+}
+
+/* Mirrors pm(). */
+static void
+pmc_compile_body(struct archive_pathmatch_compiled *c, const char *p,
+    int flags)
+{
+	const char *end;
+	struct pm_op *op;
+	int i;
+
+	if (p[0] == '.' && p[1] == '/')
+		p = pm_slashskip(p + 1);
+
+	for (;;) {
+		switch (*p) {
+		case '\0':
+			pmc_op(c, PM_OP_END, 0);
+			return;
+		case '?':
+			pmc_op(c, PM_OP_ANY, 0);
+			break;
+		case '*':
+			while (*p == '*')
+				++p;
+			if (*p == '\0') {
+				pmc_op(c, PM_OP_STAR, -1);
+				return;
+			}
+			op = pmc_op(c, PM_OP_STAR, 0);
+			op->arg = (int)pmc_compile_entry(c, p, flags);
+			return;
+		case '[':
+			end = p + 1;
+			while (*end != '\0' && *end != ']') {
+				if (*end == '\\' && end[1] != '\0')
+					++end;
+				++end;
+			}
+			if (*end == ']') {
+				op = pmc_op(c, PM_OP_CLASS, 0);
+				op->off = c->nclasses++;
+				memset(c->classes[op->off], 0, 32);
+				for (i = 1; i < 256; i++) {
+					if (pm_list(p + 1, end, (char)i, flags))
+						c->classes[op->off][i >> 3] |=
+						    1 << (i & 7);
+				}
+				p = end;
+			} else
+				pmc_literal(c, '[');
+			break;
+		case '\\':
+			if (p[1] != '\0')
+				++p;
+			pmc_literal(c, *p);
+			break;
+		case '/':
+			p = pm_slashskip(p);
+			if (*p == '\0' && (flags & PATHMATCH_NO_ANCHOR_END)) {
+				pmc_op(c, PM_OP_SLASH, 1);
+				return;
+			}
+			pmc_op(c, PM_OP_SLASH, 0);
+			--p;
+			break;
+		case '$':
+			if (p[1] == '\0' && (flags & PATHMATCH_NO_ANCHOR_END)) {
+				pmc_op(c, PM_OP_DOLLAR, 0);
+				return;
+			}
+			/* FALL THROUGH */
+		default:
+			pmc_literal(c, *p);
+			break;
+		}
+		++p;
+	}
+}
+
+struct archive_pathmatch_compiled *
+__archive_pathmatch_compile(const char *p, int flags)
+{
+	struct archive_pathmatch_compiled *c;
+	size_t n;
+
+	if (p == NULL)
+		p = "";
+	/* Each pattern character adds at most one op, entry or class;
+	 * each entry adds at most one more op for the end. */
+	n = strlen(p) + 2;
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+		return (NULL);
+	c->flags = flags;
+	c->entries = calloc(n, sizeof(*c->entries));
+	c->ops = calloc(2 * n, sizeof(*c->ops));
+	c->classes = calloc(n, sizeof(*c->classes));
+	c->literals = malloc(n);
+	if (c->entries == NULL || c->ops == NULL || c->classes == NULL ||
+	    c->literals == NULL) {
+		__archive_pathmatch_compiled_free(c);
+		return (NULL);
+	}
+	pmc_compile_entry(c, p, flags);
+	return (c);
+}
+
+void
+__archive_pathmatch_compiled_free(struct archive_pathmatch_compiled *c)
+{
+	if (c == NULL)
+		return;
+	free(c->entries);
+	free(c->ops);
+	free(c->classes);
+	free(c->literals);
+	free(c);
+}
+
+/* Mirrors pm() for the ops starting at 'first'. */
+static int
+pmc_body(const struct archive_pathmatch_compiled *c, size_t first,
+    const char *s)
+{
+	const struct pm_op *op;
+	const struct pm_entry *e;
+	unsigned char ch;
+
+	if (s[0] == '.' && s[1] == '/')
+		s = pm_slashskip(s + 1);
+
+	for (op = &c->ops[first];; op++) {
+		switch (op->type) {
+		case PM_OP_LITERAL:
+			if (strncmp(s, c->literals + op->off, op->len) != 0)
+				return (0);
+			s += op->len;
+			break;
+		case PM_OP_ANY:
+			if (*s == '\0')
+				return (0);
+			++s;
+			break;
+		case PM_OP_CLASS:
+			ch = (unsigned char)*s;
+			if (ch == '\0' ||
+			    !(c->classes[op->off][ch >> 3] & (1 << (ch & 7))))
+				return (0);
+			++s;
+			break;
+		case PM_OP_SLASH:
+			if (*s != '/' && *s != '\0')
+				return (0);
+			s = pm_slashskip(s);
+			if (op->arg)
+				return (1);
+			break;
+		case PM_OP_END:
+			if (s[0] == '/') {
+				if (c->flags & PATHMATCH_NO_ANCHOR_END)
+					return (1);
+				s = pm_slashskip(s);
+			}
+			return (*s == '\0');
+		case PM_OP_DOLLAR:
+			return (*pm_slashskip(s) == '\0');
+		case PM_OP_STAR:
+			/* Trailing '*' always succeeds. */
+			if (op->arg < 0)
+				return (1);
+			e = &c->entries[op->arg];
+			if (*s == '\0')
+				return (0);
+			if (e->scan) {
+				/*
+				 * Trying every element start from every
+				 * position adds up to trying each position
+				 * once, except a '/' that doesn't follow
+				 * another '/', plus the end of the path if
+				 * it ends with '/'.
+				 */
+				const char *t = s;
+
+				while (*t != '\0') {
+					if (e->accept[0] != '\0') {
+						t = strpbrk(t, e->accept);
+						if (t == NULL)
+							break;
+					}
+					if ((*t != '/' ||
+					    (t > s && t[-1] == '/')) &&
+					    pmc_body(c, e->first_op, t))
+						return (1);
+					++t;
+				}
+				t = s + strlen(s);
+				return (t[-1] == '/' &&
+				    pmc_body(c, e->first_op, t));
+			}
+			while (*s != '\0') {
+				if (e->need_slash)
+					s = strchr(s, '/');
+				else if (e->accept[0] != '\0')
+					s = strpbrk(s, e->accept);
+				if (s == NULL)
+					return (0);
+				if (pmc_entry(c, e, s))
+					return (1);
+				++s;
+			}
+			return (0);
+		}
+	}
+}
+
+/* Mirrors __archive_pathmatch() once the pattern has been compiled. */
+static int
+pmc_entry(const struct archive_pathmatch_compiled *c,
+    const struct pm_entry *e, const char *s)
+{
+	if (e->empty)
+		return (*s == '\0');
+	if (e->need_slash && *s != '/')
+		return (0);
+	if (e->implicit) {
+		while (*s == '/')
+			++s;
+		return (pmc_body(c, e->first_op, s));
+	}
+	if (e->scan) {
+		for ( ; s != NULL; s = strchr(s, '/')) {
+			if (*s == '/')
+				s++;
+			if (pmc_body(c, e->first_op, s))
+				return (1);
+		}
+		return (0);
+	}
+	return (pmc_body(c, e->first_op, s));
+}
+
+int
+__archive_pathmatch_exec(const struct archive_pathmatch_compiled *c,
+    const char *s)
+{
+	if (s == NULL)
+		return (c->entries[0].empty);
+	return (pmc_entry(c, &c->entries[0], s));
+}
@@ -49,4 +49,16 @@ int __archive_pathmatch_w(const wchar_t *p, const wchar_t *s, int flags);
 #define archive_pathmatch(p, s, f)	__archive_pathmatch(p, s, f)
 #define archive_pathmatch_w(p, s, f)	__archive_pathmatch_w(p, s, f)
 
+/* A pattern parsed once for matching against many paths.  Matching
+ * gives the same result as __archive_pathmatch() with the flags given
+ * to __archive_pathmatch_compile(), which returns NULL if out of
+ * memory. */
+struct archive_pathmatch_compiled;
+
+struct archive_pathmatch_compiled *__archive_pathmatch_compile(const char *p,
+	    int flags);
+int __archive_pathmatch_exec(const struct archive_pathmatch_compiled *,
+	    const char *s);
+void __archive_pathmatch_compiled_free(struct archive_pathmatch_compiled *);
+
 #endif
@@ -143,6 +143,14 @@ struct archive {
 	 */
 	char		  read_data_is_posix_read;
 	size_t		  read_data_requested;
+
+	/*
+	 * The client buffer archive_read_data() is about to fill.  A
+	 * format may store entry data here directly and return this
+	 * pointer as the block, which saves archive_read_data() a copy.
+	 * Only valid during the read_data call.
+	 */
+	char		 *read_data_dest;
 };
 
 /* Check magic value and state; return(ARCHIVE_FATAL) if it isn't valid. */
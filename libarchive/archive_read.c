@@ -37,6 +37,9 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_read.c 201157 2009-12-29 05:30:2
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
 #include <stdio.h>
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
@@ -54,6 +57,8 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_read.c 201157 2009-12-29 05:30:2
 #include "archive_read_private.h"
 
 #define minimum(a, b) (a < b ? a : b)
+/* Smallest request worth decoding straight into the caller's buffer. */
+#define READ_INTO_MIN	8192
 
 static int	choose_filters(struct archive_read *);
 static int	choose_format(struct archive_read *);
@@ -849,8 +854,10 @@ archive_read_data(struct archive *_a, void *buff, size_t s)
 			read_buf = a->read_data_block;
 			a->read_data_is_posix_read = 1;
 			a->read_data_requested = s;
+			a->read_data_dest = dest;
 			r = archive_read_data_block(a, &read_buf,
 			    &a->read_data_remaining, &a->read_data_offset);
+			a->read_data_dest = NULL;
 			a->read_data_block = read_buf;
 			if (r == ARCHIVE_EOF)
 				return (bytes_read);
@@ -893,7 +900,9 @@ archive_read_data(struct archive *_a, void *buff, size_t s)
 			if (len > s)
 				len = s;
 			if (len) {
-				memcpy(dest, a->read_data_block, len);
+				/* The format may have filled dest already. */
+				if (a->read_data_block != dest)
+					memcpy(dest, a->read_data_block, len);
 				s -= len;
 				a->read_data_block += len;
 				a->read_data_remaining -= len;
@@ -906,6 +915,7 @@ archive_read_data(struct archive *_a, void *buff, size_t s)
 	}
 	a->read_data_is_posix_read = 0;
 	a->read_data_requested = 0;
+	a->read_data_dest = NULL;
 	return (bytes_read);
 }
 
@@ -1522,6 +1532,57 @@ __archive_read_filter_consume(struct archive_read_filter * filter,
 	return (ARCHIVE_FATAL);
 }
 
+/*
+ * Read and consume up to size bytes into buff.  Once nothing is
+ * buffered ahead, a filter that supports it decodes straight into
+ * buff, avoiding the copy through its own output block.  Returns the
+ * number of bytes read, 0 at end of input, or ARCHIVE_FATAL.
+ */
+ssize_t
+__archive_read_read_into(struct archive_read *a, void *buff, size_t size)
+{
+	return (__archive_read_filter_read_into(a->filter, buff, size));
+}
+
+ssize_t
+__archive_read_filter_read_into(struct archive_read_filter *filter,
+    void *buff, size_t size)
+{
+	const void *p;
+	ssize_t bytes;
+
+	if (filter->fatal)
+		return (ARCHIVE_FATAL);
+	if (size == 0)
+		return (0);
+	/* Small requests are cheaper from the filter's own block. */
+	if (filter->read_into != NULL && filter->avail == 0 &&
+	    filter->client_avail == 0 && !filter->end_of_file &&
+	    size >= READ_INTO_MIN) {
+		if (size > SSIZE_MAX)
+			size = SSIZE_MAX;
+		bytes = (filter->read_into)(filter, buff, size);
+		if (bytes < 0) {
+			filter->fatal = 1;
+			return (ARCHIVE_FATAL);
+		}
+		if (bytes == 0)
+			filter->end_of_file = 1;
+		filter->position += bytes;
+		return (bytes);
+	}
+
+	p = __archive_read_filter_ahead(filter, 1, &bytes);
+	if (p == NULL)
+		return (bytes < 0 ? ARCHIVE_FATAL : 0);
+	if ((size_t)bytes > size)
+		bytes = (ssize_t)size;
+	memcpy(buff, p, bytes);
+	if (__archive_read_filter_consume(filter, bytes) < 0)
+		return (ARCHIVE_FATAL);
+	return (bytes);
+}
+
 /*
  * Advance the file pointer by the amount requested.
  * Returns the amount actually advanced, which may be less than the
@@ -1634,6 +1695,25 @@ __archive_read_filter_seek(struct archive_read_filter *filter, int64_t offset,
 	if (filter->seek == NULL)
 		return (ARCHIVE_FAILED);
 
+	if (filter->upstream != NULL) {
+		/*
+		 * A decompression filter that can reposition its own
+		 * output, usually by way of a seekable upstream.
+		 */
+		if (whence == SEEK_CUR) {
+			offset += filter->position;
+			whence = SEEK_SET;
+		}
+		r = (filter->seek)(filter, offset, whence);
+		if (r >= 0) {
+			filter->avail = filter->client_avail = 0;
+			filter->next = filter->buffer;
+			filter->position = r;
+			filter->end_of_file = 0;
+		}
+		return r;
+	}
+
 	client = &(filter->archive->client);
 	switch (whence) {
 	case SEEK_CUR:
@@ -184,3 +184,174 @@ memory_read_close(struct archive *a, void *client_data)
 	free(mine);
 	return (ARCHIVE_OK);
 }
+
+/*
+ * Glue to read an archive stored in several separate blocks of
+ * memory.  Each read returns the rest of the current block; the
+ * read-ahead layer copies only the bytes it needs to join a header
+ * that straddles two blocks.
+ */
+
+struct read_iovec_data {
+	struct archive_iovec	*iov;
+	int64_t			*offsets;	/* Start of each block. */
+	size_t			 count;
+	size_t			 cur;		/* Current block. */
+	size_t			 pos;		/* Offset within it. */
+	int64_t			 total;
+};
+
+static int	iovec_read_close(struct archive *, void *);
+static int64_t	iovec_read_seek(struct archive *, void *, int64_t, int);
+static int64_t	iovec_read_skip(struct archive *, void *, int64_t);
+static ssize_t	iovec_read(struct archive *, void *, const void **);
+
+/*
+ * The blocks themselves are not copied and must remain valid until
+ * the archive is closed.
+ */
+int
+archive_read_open_iovec(struct archive *a, const struct archive_iovec *iov,
+    size_t count)
+{
+	struct read_iovec_data *mine;
+	size_t i;
+
+	mine = (struct read_iovec_data *)calloc(1, sizeof(*mine));
+	if (mine == NULL)
+		goto nomem;
+	mine->iov = malloc((count + 1) * sizeof(*mine->iov));
+	mine->offsets = malloc((count + 1) * sizeof(*mine->offsets));
+	if (mine->iov == NULL || mine->offsets == NULL) {
+		free(mine->iov);
+		free(mine->offsets);
+		free(mine);
+		goto nomem;
+	}
+	/* Drop empty blocks; a zero-length read would mean EOF. */
+	for (i = 0; i < count; i++) {
+		if (iov[i].iov_len == 0)
+			continue;
+		mine->iov[mine->count] = iov[i];
+		mine->offsets[mine->count] = mine->total;
+		mine->total += iov[i].iov_len;
+		mine->count++;
+	}
+	mine->offsets[mine->count] = mine->total;
+	archive_read_set_open_callback(a, memory_read_open);
+	archive_read_set_read_callback(a, iovec_read);
+	archive_read_set_seek_callback(a, iovec_read_seek);
+	archive_read_set_skip_callback(a, iovec_read_skip);
+	archive_read_set_close_callback(a, iovec_read_close);
+	archive_read_set_callback_data(a, mine);
+	return (archive_read_open1(a));
+nomem:
+	archive_set_error(a, ENOMEM, "No memory");
+	return (ARCHIVE_FATAL);
+}
+
+static ssize_t
+iovec_read(struct archive *a, void *client_data, const void **buff)
+{
+	struct read_iovec_data *mine = (struct read_iovec_data *)client_data;
+	size_t size;
+
+	(void)a; /* UNUSED */
+	if (mine->cur >= mine->count) {
+		*buff = NULL;
+		return (0);
+	}
+	*buff = (const unsigned char *)mine->iov[mine->cur].iov_base +
+	    mine->pos;
+	size = mine->iov[mine->cur].iov_len - mine->pos;
+	mine->cur++;
+	mine->pos = 0;
+	return ((ssize_t)size);
+}
+
+/* Move to absolute offset 'offset', which must be within the data. */
+static void
+iovec_set_position(struct read_iovec_data *mine, int64_t offset)
+{
+	size_t lo = 0, hi = mine->count, mid;
+
+	/* Find the last block that starts at or before 'offset'. */
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (mine->offsets[mid] <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	if (offset >= mine->total) {
+		mine->cur = mine->count;
+		mine->pos = 0;
+	} else {
+		mine->cur = lo;
+		mine->pos = (size_t)(offset - mine->offsets[lo]);
+	}
+}
+
+static int64_t
+iovec_position(struct read_iovec_data *mine)
+{
+	return (mine->offsets[mine->cur] + mine->pos);
+}
+
+static int64_t
+iovec_read_skip(struct archive *a, void *client_data, int64_t skip)
+{
+	struct read_iovec_data *mine = (struct read_iovec_data *)client_data;
+	int64_t pos;
+
+	(void)a; /* UNUSED */
+	pos = iovec_position(mine);
+	if (skip > mine->total - pos)
+		skip = mine->total - pos;
+	iovec_set_position(mine, pos + skip);
+	return (skip);
+}
+
+static int64_t
+iovec_read_seek(struct archive *a, void *client_data, int64_t offset,
+    int whence)
+{
+	struct read_iovec_data *mine = (struct read_iovec_data *)client_data;
+	int64_t pos;
+
+	(void)a; /* UNUSED */
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = iovec_position(mine) + offset;
+		break;
+	case SEEK_END:
+		pos = mine->total + offset;
+		break;
+	default:
+		return ARCHIVE_FATAL;
+	}
+	if (pos < 0) {
+		iovec_set_position(mine, 0);
+		return ARCHIVE_FAILED;
+	}
+	if (pos > mine->total) {
+		iovec_set_position(mine, mine->total);
+		return ARCHIVE_FAILED;
+	}
+	iovec_set_position(mine, pos);
+	return (pos);
+}
+
+static int
+iovec_read_close(struct archive *a, void *client_data)
+{
+	struct read_iovec_data *mine = (struct read_iovec_data *)client_data;
+	(void)a; /* UNUSED */
+	free(mine->iov);
+	free(mine->offsets);
+	free(mine);
+	return (ARCHIVE_OK);
+}
@@ -90,6 +90,9 @@ struct archive_read_filter {
 	int (*open)(struct archive_read_filter *self);
 	/* Return next block. */
 	ssize_t (*read)(struct archive_read_filter *, const void **);
+	/* Optional: decode up to size bytes straight into buff. */
+	ssize_t (*read_into)(struct archive_read_filter *, void *buff,
+	    size_t size);
 	/* Skip forward this many bytes. */
 	int64_t (*skip)(struct archive_read_filter *self, int64_t request);
 	/* Seek to an absolute location. */
@@ -252,6 +255,9 @@ int64_t	__archive_read_seek(struct archive_read*, int64_t, int);
 int64_t	__archive_read_filter_seek(struct archive_read_filter *, int64_t, int);
 int64_t	__archive_read_consume(struct archive_read *, int64_t);
 int64_t	__archive_read_filter_consume(struct archive_read_filter *, int64_t);
+ssize_t	__archive_read_read_into(struct archive_read *, void *, size_t);
+ssize_t	__archive_read_filter_read_into(struct archive_read_filter *,
+	    void *, size_t);
 int __archive_read_header(struct archive_read *, struct archive_entry *);
 int __archive_read_program(struct archive_read_filter *, const char *);
 void __archive_read_free_filters(struct archive_read *);
@@ -0,0 +1,99 @@
+/*-
+ * Copyright (c) 2009 Michihiro NAKAJIMA
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_READ_RPM_PRIVATE_H_INCLUDED
+#define ARCHIVE_READ_RPM_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+#include "archive_digest_private.h"
+
+struct archive_read;
+
+/*
+ * One file as described by the main RPM header.  The strings point
+ * into storage owned by the rpm filter and stay valid until the
+ * archive is closed.
+ */
+struct archive_rpm_file {
+	const char	*pathname;	/* Without leading "/" or "./". */
+	const char	*digest;	/* Hex digest; NULL or "" if none. */
+	const char	*uname;
+	const char	*gname;
+	const char	*linkname;
+	int64_t		 size;
+	int64_t		 mtime;
+	int		 mode;
+};
+
+struct archive_rpm_index {
+	struct archive_rpm_file	 *files;
+	struct archive_rpm_file	**sorted;	/* By pathname. */
+	size_t			  nfiles;
+	size_t			  next;		/* Lookup hint. */
+	int			  digest_algo;	/* RPM hash algorithm id. */
+};
+
+/* Per-file digest check driven by the header's digest algorithm. */
+struct archive_rpm_digest {
+	int			 algo;
+	const char		*expected;
+	union {
+#ifdef ARCHIVE_HAS_MD5
+		archive_md5_ctx		md5;
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+		archive_sha1_ctx	sha1;
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+		archive_sha256_ctx	sha256;
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+		archive_sha384_ctx	sha384;
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+		archive_sha512_ctx	sha512;
+#endif
+		char			unused;
+	}			 ctx;
+};
+
+/* Returns the index built by the rpm filter, or NULL if there is
+ * no rpm filter in the chain or its header had no file list. */
+struct archive_rpm_index *__archive_read_rpm_index(struct archive_read *);
+const struct archive_rpm_file *__archive_read_rpm_lookup(
+	struct archive_rpm_index *, const char *);
+
+/* Returns 0 if the digest can't be checked. */
+int	__archive_rpm_digest_init(struct archive_rpm_digest *,
+	    const struct archive_rpm_index *, const struct archive_rpm_file *);
+void	__archive_rpm_digest_update(struct archive_rpm_digest *,
+	    const void *, size_t);
+/* Returns ARCHIVE_OK if the data matched, ARCHIVE_WARN otherwise. */
+int	__archive_rpm_digest_final(struct archive_rpm_digest *);
+
+#endif
@@ -113,19 +113,22 @@ archive_set_filter_option(struct archive *_a, const char *m, const char *o,
     const char *v)
 {
 	struct archive_read *a = (struct archive_read *)_a;
-	struct archive_read_filter *filter;
 	struct archive_read_filter_bidder *bidder;
+	size_t i;
 	int r, rv = ARCHIVE_WARN, matched_modules = 0;
 
-	for (filter = a->filter; filter != NULL; filter = filter->upstream) {
-		bidder = filter->bidder;
-		if (bidder == NULL)
-			continue;
-		if (bidder->options == NULL)
+	/*
+	 * Options are given to the bidders rather than to the filters
+	 * in the current chain, so that they can be set before the
+	 * archive is opened and apply to every filter a bidder creates.
+	 */
+	for (i = 0; i < sizeof(a->bidders)/sizeof(a->bidders[0]); i++) {
+		bidder = &a->bidders[i];
+		if (bidder->options == NULL || bidder->name == NULL)
 			/* This bidder does not support option */
 			continue;
 		if (m != NULL) {
-			if (strcmp(filter->name, m) != 0)
+			if (strcmp(bidder->name, m) != 0)
 				continue;
 			++matched_modules;
 		}
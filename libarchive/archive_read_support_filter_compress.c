@@ -96,7 +96,7 @@ struct private_data {
 	const unsigned char	*next_in;
 	size_t			 avail_in;
 	size_t			 consume_unnotified;
-	int			 bit_buffer;
+	uint64_t		 bit_buffer;
 	int			 bits_avail;
 	size_t			 bytes_in_section;
 
@@ -118,16 +118,22 @@ struct private_data {
 	int			 free_ent;       /* Next dictionary entry. */
 	unsigned char		 suffix[65536];
 	uint16_t		 prefix[65536];
+	uint16_t		 length[65536];	/* Expanded length of each code. */
 
 	/*
-	 * Scratch area for expanding dictionary entries.  Note:
-	 * "worst" case here comes from compressing /dev/zero: the
-	 * last code in the dictionary will code a sequence of
-	 * 65536-256 zero bytes.  Thus, we need stack space to expand
-	 * a 65280-byte dictionary entry.  (Of course, 32640:1
-	 * compression could also be considered the "best" case. ;-)
+	 * Knowing the length of every dictionary entry lets us
+	 * expand a code forward, straight into the output block.
+	 * Entries that don't fit in what is left of the output
+	 * block are expanded here instead and copied out on the
+	 * next read.  Note: "worst" case here comes from
+	 * compressing /dev/zero: the last code in the dictionary
+	 * will code a sequence of 65536-256 zero bytes.  Thus, we
+	 * need space to expand a 65280-byte dictionary entry.  (Of
+	 * course, 32640:1 compression could also be considered the
+	 * "best" case. ;-)
 	 */
 	unsigned char		*stackp;
+	size_t			 stack_avail;
 	unsigned char		 stack[65300];
 };
 
@@ -138,8 +144,11 @@ static int	compress_bidder_free(struct archive_read_filter_bidder *);
 static ssize_t	compress_filter_read(struct archive_read_filter *, const void **);
 static int	compress_filter_close(struct archive_read_filter *);
 
+static void	start_section(struct private_data *);
+static size_t	section_bytes(struct private_data *);
 static int	getbits(struct archive_read_filter *, int n);
-static int	next_code(struct archive_read_filter *);
+static int	next_code(struct archive_read_filter *, unsigned char **,
+		    const unsigned char *);
 
 #if ARCHIVE_VERSION_NUMBER < 4000000
 /* Deprecated; remove in libarchive 4.0 */
@@ -256,6 +265,7 @@ compress_bidder_init(struct archive_read_filter *self)
 	/* Initialize decompressor. */
 	state->free_ent = 256;
 	state->stackp = state->stack;
+	state->stack_avail = 0;
 	if (state->use_reset_code)
 		state->free_ent++;
 	state->bits = 9;
@@ -264,8 +274,9 @@ compress_bidder_init(struct archive_read_filter *self)
 	for (code = 255; code >= 0; code--) {
 		state->prefix[code] = 0;
 		state->suffix[code] = code;
+		state->length[code] = 1;
 	}
-	next_code(self);
+	next_code(self, NULL, NULL);
 
 	return (ARCHIVE_OK);
 }
@@ -279,6 +290,7 @@ compress_filter_read(struct archive_read_filter *self, const void **pblock)
 {
 	struct private_data *state;
 	unsigned char *p, *start, *end;
+	size_t n;
 	int ret;
 
 	state = (struct private_data *)self->data;
@@ -290,10 +302,17 @@ compress_filter_read(struct archive_read_filter *self, const void **pblock)
 	end = start + state->out_block_size;
 
 	while (p < end && !state->end_of_stream) {
-		if (state->stackp > state->stack) {
-			*p++ = *--state->stackp;
+		if (state->stack_avail > 0) {
+			/* Copy out an entry that didn't fit last time. */
+			n = end - p;
+			if (n > state->stack_avail)
+				n = state->stack_avail;
+			memcpy(p, state->stackp, n);
+			p += n;
+			state->stackp += n;
+			state->stack_avail -= n;
 		} else {
-			ret = next_code(self);
+			ret = next_code(self, &p, end);
 			if (ret == -1)
 				state->end_of_stream = ret;
 			else if (ret != ARCHIVE_OK)
@@ -329,27 +348,25 @@ compress_filter_close(struct archive_read_filter *self)
 }
 
 /*
- * Process the next code and fill the stack with the expansion
- * of the code.  Returns ARCHIVE_FATAL if there is a fatal I/O or
- * format error, ARCHIVE_EOF if we hit end of data, ARCHIVE_OK otherwise.
+ * Process the next code and expand it.  If the expansion fits between
+ * *out and end, it is written there and *out is advanced past it;
+ * otherwise it goes to the stack to be copied out later.  Returns
+ * ARCHIVE_FATAL if there is a fatal I/O or format error, ARCHIVE_EOF
+ * if we hit end of data, ARCHIVE_OK otherwise.
  */
 static int
-next_code(struct archive_read_filter *self)
+next_code(struct archive_read_filter *self, unsigned char **out,
+    const unsigned char *end)
 {
 	struct private_data *state = (struct private_data *)self->data;
+	unsigned char *dst, *q;
+	size_t len;
 	int code, newcode;
 
-	static int debug_buff[1024];
-	static unsigned debug_index;
-
 	code = newcode = getbits(self, state->bits);
 	if (code < 0)
 		return (code);
 
-	debug_buff[debug_index++] = code;
-	if (debug_index >= sizeof(debug_buff)/sizeof(debug_buff[0]))
-		debug_index = 0;
-
 	/* If it's a reset code, reset the dictionary. */
 	if ((code == 256) && state->use_reset_code) {
 		/*
@@ -360,21 +377,23 @@ next_code(struct archive_read_filter *self)
 		 * a function of the current *bit* length.)
 		 */
 		int skip_bytes =  state->bits -
-		    (state->bytes_in_section % state->bits);
+		    (section_bytes(state) % state->bits);
 		skip_bytes %= state->bits;
-		state->bits_avail = 0; /* Discard rest of this byte. */
+		/* Discard rest of this byte. */
+		state->bit_buffer >>= state->bits_avail & 7;
+		state->bits_avail &= ~7;
 		while (skip_bytes-- > 0) {
 			code = getbits(self, 8);
 			if (code < 0)
 				return (code);
 		}
 		/* Now, actually do the reset. */
-		state->bytes_in_section = 0;
+		start_section(state);
 		state->bits = 9;
 		state->section_end_code = (1 << state->bits) - 1;
 		state->free_ent = 257;
 		state->oldcode = -1;
-		return (next_code(self));
+		return (next_code(self, out, end));
 	}
 
 	if (code > state->free_ent
@@ -385,29 +404,42 @@ next_code(struct archive_read_filter *self)
 		return (ARCHIVE_FATAL);
 	}
 
+	if (code >= state->free_ent)
+		len = state->length[state->oldcode] + 1;
+	else
+		len = state->length[code];
+	if (out != NULL && len <= (size_t)(end - *out)) {
+		dst = *out;
+		*out += len;
+	} else {
+		dst = state->stackp = state->stack;
+		state->stack_avail = len;
+	}
+
+	/* Generate output characters from the end of the entry. */
+	q = dst + len;
 	/* Special case for KwKwK string. */
 	if (code >= state->free_ent) {
-		*state->stackp++ = state->finbyte;
+		*--q = state->finbyte;
 		code = state->oldcode;
 	}
-
-	/* Generate output characters in reverse order. */
 	while (code >= 256) {
-		*state->stackp++ = state->suffix[code];
+		*--q = state->suffix[code];
 		code = state->prefix[code];
 	}
-	*state->stackp++ = state->finbyte = code;
+	*--q = state->finbyte = code;
 
 	/* Generate the new entry. */
 	code = state->free_ent;
 	if (code < state->maxcode && state->oldcode >= 0) {
 		state->prefix[code] = state->oldcode;
 		state->suffix[code] = state->finbyte;
+		state->length[code] = state->length[state->oldcode] + 1;
 		++state->free_ent;
 	}
 	if (state->free_ent > state->section_end_code) {
 		state->bits++;
-		state->bytes_in_section = 0;
+		start_section(state);
 		if (state->bits == state->maxcode_bits)
 			state->section_end_code = state->maxcode;
 		else
@@ -420,7 +452,27 @@ next_code(struct archive_read_filter *self)
 }
 
 /*
- * Return next 'n' bits from stream.
+ * The junk skipped after a reset code depends on how many bytes were
+ * read since the code length last changed.  Whole bytes sitting in the
+ * bit buffer have been fetched but not yet read, so they belong to the
+ * section that follows.
+ */
+static void
+start_section(struct private_data *state)
+{
+	state->bytes_in_section = state->bits_avail / 8;
+}
+
+static size_t
+section_bytes(struct private_data *state)
+{
+	return (state->bytes_in_section - state->bits_avail / 8);
+}
+
+/*
+ * Return next 'n' bits from stream.  The bit buffer is refilled with
+ * as many whole bytes as will fit, so most calls don't touch the
+ * input at all.
  *
  * -1 indicates end of available data.
  */
@@ -451,13 +503,16 @@ getbits(struct archive_read_filter *self, int n)
 				return (ARCHIVE_FATAL);
 			state->consume_unnotified = state->avail_in = ret;
 		}
-		state->bit_buffer |= *state->next_in++ << state->bits_avail;
-		state->avail_in--;
-		state->bits_avail += 8;
-		state->bytes_in_section++;
+		do {
+			state->bit_buffer |=
+			    (uint64_t)*state->next_in++ << state->bits_avail;
+			state->avail_in--;
+			state->bits_avail += 8;
+			state->bytes_in_section++;
+		} while (state->bits_avail <= 56 && state->avail_in > 0);
 	}
 
-	code = state->bit_buffer;
+	code = (int)state->bit_buffer;
 	state->bit_buffer >>= n;
 	state->bits_avail -= n;
 
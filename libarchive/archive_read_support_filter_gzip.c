@@ -46,6 +46,10 @@ __FBSDID("$FreeBSD$");
 #ifdef HAVE_ZLIB_H
 #include <zlib.h>
 #endif
+#if defined(HAVE_ZLIB_H) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define	GZIP_THREADS	1
+#endif
 
 #include "archive.h"
 #include "archive_entry.h"
@@ -54,20 +58,72 @@ __FBSDID("$FreeBSD$");
 #include "archive_read_private.h"
 
 #ifdef HAVE_ZLIB_H
+/* Options set on the bidder, used by every gzip filter it creates. */
+struct gzip_options {
+	int		 threads;
+};
+
+#ifdef GZIP_THREADS
+/*
+ * BGZF members never decompress to more than 64KiB, so each one is
+ * a job that a worker can finish on its own: the compressed member
+ * is copied in, and the output stays in the job until the reader is
+ * done with it.
+ */
+#define	GZIP_JOB_OUT_SIZE	(64 * 1024)
+
+struct gzip_job {
+	unsigned char	*in;
+	size_t		 in_size;
+	size_t		 in_alloc;
+	size_t		 header_size;
+	uint32_t	 out_size;
+	const char	*error;	/* NULL if the member was fine. */
+	char		 done;
+	unsigned char	 out[GZIP_JOB_OUT_SIZE];
+};
+
+struct gzip_pool {
+	pthread_mutex_t	 lock;
+	pthread_cond_t	 wake;	/* Workers: job queued or shutdown. */
+	pthread_cond_t	 done;	/* Reader: a job finished. */
+	pthread_t	*threads;
+	int		 nthreads;
+	char		 shutdown;
+	char		 stalled; /* Next member must be streamed. */
+	char		 held;	/* Reader returned the head job's output. */
+	struct gzip_job	*jobs;
+	unsigned	 njobs;
+	/* Job counters; job n is in slot n % njobs. */
+	uint64_t	 head;	/* Oldest job not yet released. */
+	uint64_t	 next;	/* Next job for a worker. */
+	uint64_t	 tail;	/* Next job to queue. */
+};
+#endif
+
 struct private_data {
 	z_stream	 stream;
 	char		 in_stream;
+	char		 stream_valid; /* True = inflateInit2() was done. */
 	unsigned char	*out_block;
 	size_t		 out_block_size;
 	int64_t		 total_out;
 	unsigned long	 crc;
+	uint32_t	 member_out;	/* Bytes from this member, mod 2^32. */
 	uint32_t	 mtime;
+	uint32_t	 bsize;	/* BGZF member size less 1, or 0. */
 	char		*name;
 	char		 eof; /* True = found end of compressed data. */
+#ifdef GZIP_THREADS
+	struct gzip_pool *pool;
+	char		 pool_failed;
+#endif
 };
 
 /* Gzip Filter. */
 static ssize_t	gzip_filter_read(struct archive_read_filter *, const void **);
+static ssize_t	gzip_filter_read_into(struct archive_read_filter *, void *,
+		    size_t);
 static int	gzip_filter_close(struct archive_read_filter *);
 #endif
 
@@ -84,6 +140,11 @@ static int	gzip_filter_close(struct archive_read_filter *);
 static int	gzip_bidder_bid(struct archive_read_filter_bidder *,
 		    struct archive_read_filter *);
 static int	gzip_bidder_init(struct archive_read_filter *);
+#ifdef HAVE_ZLIB_H
+static int	gzip_bidder_options(struct archive_read_filter_bidder *,
+		    const char *, const char *);
+static int	gzip_bidder_free(struct archive_read_filter_bidder *);
+#endif
 
 #if ARCHIVE_VERSION_NUMBER < 4000000
 /* Deprecated; remove in libarchive 4.0 */
@@ -99,23 +160,42 @@ archive_read_support_filter_gzip(struct archive *_a)
 {
 	struct archive_read *a = (struct archive_read *)_a;
 	struct archive_read_filter_bidder *bidder;
+#ifdef HAVE_ZLIB_H
+	struct gzip_options *options;
+#endif
 
 	archive_check_magic(_a, ARCHIVE_READ_MAGIC,
 	    ARCHIVE_STATE_NEW, "archive_read_support_filter_gzip");
 
-	if (__archive_read_get_bidder(a, &bidder) != ARCHIVE_OK)
+#ifdef HAVE_ZLIB_H
+	options = (struct gzip_options *)calloc(1, sizeof(*options));
+	if (options == NULL) {
+		archive_set_error(_a, ENOMEM, "Can't allocate gzip options");
 		return (ARCHIVE_FATAL);
+	}
+	options->threads = 1;
+#endif
+
+	if (__archive_read_get_bidder(a, &bidder) != ARCHIVE_OK) {
+#ifdef HAVE_ZLIB_H
+		free(options);
+#endif
+		return (ARCHIVE_FATAL);
+	}
 
-	bidder->data = NULL;
 	bidder->name = "gzip";
 	bidder->bid = gzip_bidder_bid;
 	bidder->init = gzip_bidder_init;
-	bidder->options = NULL;
-	bidder->free = NULL; /* No data, so no cleanup necessary. */
 	/* Signal the extent of gzip support with the return value here. */
 #if HAVE_ZLIB_H
+	bidder->data = options;
+	bidder->options = gzip_bidder_options;
+	bidder->free = gzip_bidder_free;
 	return (ARCHIVE_OK);
 #else
+	bidder->data = NULL;
+	bidder->options = NULL;
+	bidder->free = NULL; /* No data, so no cleanup necessary. */
 	archive_set_error(_a, ARCHIVE_ERRNO_MISC,
 	    "Using external gzip program");
 	return (ARCHIVE_WARN);
@@ -170,13 +250,46 @@ peek_at_header(struct archive_read_filter *filter, int *pbits,
 	   in initializing the decompressor. */
 	/* Byte 9 is OS. */
 
+#ifdef HAVE_ZLIB_H
+	if (state)
+		state->bsize = 0;
+#endif
 	/* Optional extra data:  2 byte length plus variable body. */
 	if (header_flags & 4) {
+		ssize_t xlen;
+
 		p = __archive_read_filter_ahead(filter, len + 2, &avail);
 		if (p == NULL)
 			return (0);
-		len += ((int)p[len + 1] << 8) | (int)p[len];
+		xlen = ((int)p[len + 1] << 8) | (int)p[len];
 		len += 2;
+#ifdef HAVE_ZLIB_H
+		/*
+		 * BGZF (and other blocked gzip writers) store the size
+		 * of each member in a "BC" subfield, which lets the
+		 * whole member be inflated in a single call.
+		 */
+		if (state) {
+			const unsigned char *x, *end;
+
+			p = __archive_read_filter_ahead(filter, len + xlen,
+			    &avail);
+			if (p == NULL)
+				return (0);
+			x = p + len;
+			end = x + xlen;
+			while (end - x >= 4) {
+				size_t slen = archive_le16dec(x + 2);
+
+				if ((size_t)(end - x - 4) < slen)
+					break;
+				if (x[0] == 'B' && x[1] == 'C' && slen == 2)
+					state->bsize = archive_le16dec(x + 4);
+				x += 4 + slen;
+			}
+		}
+#endif
+		len += xlen;
 	}
 
 	/* Null-terminated optional filename. */
@@ -273,6 +386,52 @@ gzip_bidder_init(struct archive_read_filter *self)
 
 #else
 
+static int
+gzip_bidder_options(struct archive_read_filter_bidder *self,
+    const char *key, const char *value)
+{
+	struct gzip_options *options = (struct gzip_options *)self->data;
+
+	if (strcmp(key, "threads") == 0) {
+		char *endptr;
+		long threads;
+
+		if (value == NULL)
+			return (ARCHIVE_WARN);
+		errno = 0;
+		threads = strtol(value, &endptr, 10);
+		if (errno != 0 || *endptr != '\0' || threads < 0 ||
+		    threads > 256) {
+			options->threads = 1;
+			return (ARCHIVE_WARN);
+		}
+		if (threads == 0) {
+#if defined(GZIP_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+			threads = sysconf(_SC_NPROCESSORS_ONLN);
+			if (threads < 1)
+				threads = 1;
+#else
+			threads = 1;
+#endif
+		}
+		options->threads = (int)threads;
+		return (ARCHIVE_OK);
+	}
+
+	/* Note: The "warn" return is just to inform the options
+	 * supervisor that we didn't handle it.  It will generate
+	 * a suitable error if no one used this option. */
+	return (ARCHIVE_WARN);
+}
+
+static int
+gzip_bidder_free(struct archive_read_filter_bidder *self)
+{
+	free(self->data);
+	self->data = NULL;
+	return (ARCHIVE_OK);
+}
+
 static int
 gzip_read_header(struct archive_read_filter *self, struct archive_entry *entry)
 {
@@ -318,6 +477,7 @@ gzip_bidder_init(struct archive_read_filter *self)
 	state->out_block_size = out_block_size;
 	state->out_block = out_block;
 	self->read = gzip_filter_read;
+	self->read_into = gzip_filter_read_into;
 	self->skip = NULL; /* not supported */
 	self->close = gzip_filter_close;
 #ifdef HAVE_ZLIB_H
@@ -329,36 +489,33 @@ gzip_bidder_init(struct archive_read_filter *self)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Prepare the decompressor for a new member.  The z_stream is set up
+ * once and reset for each later member, which matters for blocked
+ * gzip files (BGZF, pigz -i) that have a member every 64KiB.
+ */
 static int
-consume_header(struct archive_read_filter *self)
+reset_stream(struct archive_read_filter *self)
 {
 	struct private_data *state;
-	ssize_t avail;
-	size_t len;
 	int ret;
 
 	state = (struct private_data *)self->data;
 
-	/* If this is a real header, consume it. */
-	len = peek_at_header(self->upstream, NULL, state);
-	if (len == 0)
-		return (ARCHIVE_EOF);
-	__archive_read_filter_consume(self->upstream, len);
-
 	/* Initialize CRC accumulator. */
 	state->crc = crc32(0L, NULL, 0);
+	state->member_out = 0;
 
-	/* Initialize compression library. */
-	state->stream.next_in = (unsigned char *)(uintptr_t)
-	    __archive_read_filter_ahead(self->upstream, 1, &avail);
-	state->stream.avail_in = (uInt)avail;
-	ret = inflateInit2(&(state->stream),
-	    -15 /* Don't check for zlib header */);
+	if (state->stream_valid)
+		ret = inflateReset(&(state->stream));
+	else
+		ret = inflateInit2(&(state->stream),
+		    -15 /* Don't check for zlib header */);
 
 	/* Decipher the error code. */
 	switch (ret) {
 	case Z_OK:
-		state->in_stream = 1;
+		state->stream_valid = 1;
 		return (ARCHIVE_OK);
 	case Z_STREAM_ERROR:
 		archive_set_error(&self->archive->archive,
@@ -387,32 +544,76 @@ consume_header(struct archive_read_filter *self)
 	return (ARCHIVE_FATAL);
 }
 
+/*
+ * Check the CRC and length stored in a member trailer against what
+ * was decompressed.
+ */
+static int
+check_trailer(struct archive_read_filter *self, const unsigned char *p)
+{
+	struct private_data *state;
+
+	state = (struct private_data *)self->data;
+
+	if (archive_le32dec(p) != (uint32_t)state->crc) {
+		archive_set_error(&self->archive->archive,
+		    ARCHIVE_ERRNO_MISC, "gzip data CRC mismatch");
+		return (ARCHIVE_FATAL);
+	}
+	if (archive_le32dec(p + 4) != state->member_out) {
+		archive_set_error(&self->archive->archive,
+		    ARCHIVE_ERRNO_MISC, "gzip data length mismatch");
+		return (ARCHIVE_FATAL);
+	}
+	return (ARCHIVE_OK);
+}
+
+static int
+consume_header(struct archive_read_filter *self)
+{
+	struct private_data *state;
+	ssize_t avail;
+	size_t len;
+	int ret;
+
+	state = (struct private_data *)self->data;
+
+	/* If this is a real header, consume it. */
+	len = peek_at_header(self->upstream, NULL, state);
+	if (len == 0)
+		return (ARCHIVE_EOF);
+	__archive_read_filter_consume(self->upstream, len);
+
+	/* Initialize compression library. */
+	ret = reset_stream(self);
+	if (ret != ARCHIVE_OK)
+		return (ret);
+	state->stream.next_in = (unsigned char *)(uintptr_t)
+	    __archive_read_filter_ahead(self->upstream, 1, &avail);
+	state->stream.avail_in = (uInt)avail;
+	state->in_stream = 1;
+	return (ARCHIVE_OK);
+}
+
 static int
 consume_trailer(struct archive_read_filter *self)
 {
 	struct private_data *state;
 	const unsigned char *p;
 	ssize_t avail;
+	int ret;
 
 	state = (struct private_data *)self->data;
 
 	state->in_stream = 0;
-	switch (inflateEnd(&(state->stream))) {
-	case Z_OK:
-		break;
-	default:
-		archive_set_error(&self->archive->archive,
-		    ARCHIVE_ERRNO_MISC,
-		    "Failed to clean up gzip decompressor");
-		return (ARCHIVE_FATAL);
-	}
 
 	/* GZip trailer is a fixed 8 byte structure. */
 	p = __archive_read_filter_ahead(self->upstream, 8, &avail);
 	if (p == NULL || avail == 0)
 		return (ARCHIVE_FATAL);
-
-	/* XXX TODO: Verify the length and CRC. */
+	ret = check_trailer(self, p);
+	if (ret != ARCHIVE_OK)
+		return (ret);
 
 	/* We've verified the trailer, so consume it now. */
 	__archive_read_filter_consume(self->upstream, 8);
@@ -420,25 +621,273 @@ consume_trailer(struct archive_read_filter *self)
 	return (ARCHIVE_OK);
 }
 
+#ifdef GZIP_THREADS
+/*
+ * Decompress one BGZF member and check it against its trailer.
+ */
+static void
+gzip_job_inflate(z_stream *stream, struct gzip_job *job)
+{
+	const unsigned char *trailer = job->in + job->in_size - 8;
+	int ret;
+
+	if (inflateReset(stream) != Z_OK) {
+		job->error = "gzip decompression failed";
+		return;
+	}
+	stream->next_in = job->in + job->header_size;
+	stream->avail_in = (uInt)(job->in_size - job->header_size - 8);
+	stream->next_out = job->out;
+	stream->avail_out = job->out_size;
+	ret = inflate(stream, Z_FINISH);
+	if (ret != Z_STREAM_END || stream->avail_in != 0)
+		job->error = "gzip decompression failed";
+	else if (stream->avail_out != 0)
+		job->error = "gzip data length mismatch";
+	else if (archive_le32dec(trailer) !=
+	    (uint32_t)crc32(crc32(0L, NULL, 0), job->out, job->out_size))
+		job->error = "gzip data CRC mismatch";
+}
+
+static void *
+gzip_worker(void *arg)
+{
+	struct gzip_pool *pool = (struct gzip_pool *)arg;
+	struct gzip_job *job;
+	z_stream stream;
+	int ready;
+
+	memset(&stream, 0, sizeof(stream));
+	ready = inflateInit2(&stream, -15) == Z_OK;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->shutdown && pool->next == pool->tail)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (pool->shutdown)
+			break;
+		job = &pool->jobs[pool->next++ % pool->njobs];
+		pthread_mutex_unlock(&pool->lock);
+
+		if (ready)
+			gzip_job_inflate(&stream, job);
+		else
+			job->error = "Can't initialize gzip decompression";
+
+		pthread_mutex_lock(&pool->lock);
+		job->done = 1;
+		pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (ready)
+		inflateEnd(&stream);
+	return (NULL);
+}
+
+static void
+gzip_pool_free(struct gzip_pool *pool)
+{
+	unsigned i;
+	int t;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for (t = 0; t < pool->nthreads; t++)
+		pthread_join(pool->threads[t], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	for (i = 0; i < pool->njobs; i++)
+		free(pool->jobs[i].in);
+	free(pool->jobs);
+	free(pool->threads);
+	free(pool);
+}
+
+static struct gzip_pool *
+gzip_pool_new(int nthreads)
+{
+	struct gzip_pool *pool;
+
+	pool = (struct gzip_pool *)calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return (NULL);
+	/* Enough jobs to keep every worker busy while the reader
+	 * drains finished ones in order. */
+	pool->njobs = nthreads * 4;
+	pool->jobs = (struct gzip_job *)calloc(pool->njobs,
+	    sizeof(*pool->jobs));
+	pool->threads = (pthread_t *)calloc(nthreads,
+	    sizeof(*pool->threads));
+	if (pool->jobs == NULL || pool->threads == NULL) {
+		free(pool->jobs);
+		free(pool->threads);
+		free(pool);
+		return (NULL);
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	for (pool->nthreads = 0; pool->nthreads < nthreads;
+	    pool->nthreads++) {
+		if (pthread_create(&pool->threads[pool->nthreads], NULL,
+		    gzip_worker, pool) != 0)
+			break;
+	}
+	if (pool->nthreads == 0) {
+		gzip_pool_free(pool);
+		return (NULL);
+	}
+	return (pool);
+}
+
+/*
+ * Copy the next member to a free job if it is a BGZF member that is
+ * small enough for a job.  Returns ARCHIVE_OK if it was queued and
+ * ARCHIVE_WARN if the member has to be streamed instead.
+ */
+static int
+gzip_pool_queue(struct archive_read_filter *self)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	struct gzip_pool *pool = state->pool;
+	struct gzip_job *job;
+	const unsigned char *p;
+	ssize_t avail, len, member_size;
+	uint32_t isize;
+
+	len = peek_at_header(self->upstream, NULL, state);
+	if (len == 0 || state->bsize == 0)
+		return (ARCHIVE_WARN);
+	member_size = (ssize_t)state->bsize + 1;
+	if (member_size < len + 8)
+		return (ARCHIVE_WARN);
+	p = __archive_read_filter_ahead(self->upstream, member_size, &avail);
+	if (p == NULL)
+		return (ARCHIVE_WARN); /* Let the stream report truncation. */
+	isize = archive_le32dec(p + member_size - 4);
+	if (isize > GZIP_JOB_OUT_SIZE)
+		return (ARCHIVE_WARN);
+
+	job = &pool->jobs[pool->tail % pool->njobs];
+	if (job->in_alloc < (size_t)member_size) {
+		unsigned char *in = (unsigned char *)realloc(job->in,
+		    member_size);
+		if (in == NULL)
+			return (ARCHIVE_WARN);
+		job->in = in;
+		job->in_alloc = member_size;
+	}
+	memcpy(job->in, p, member_size);
+	__archive_read_filter_consume(self->upstream, member_size);
+	job->in_size = member_size;
+	job->header_size = len;
+	job->out_size = isize;
+	job->error = NULL;
+	job->done = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->tail++;
+	pthread_cond_signal(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Return the output of the next BGZF member, decompressed on the
+ * worker pool.  Returns 0 if the next member is not a BGZF member, in
+ * which case the caller streams it.
+ */
+static ssize_t
+gzip_pool_read(struct archive_read_filter *self, const void **p)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	struct gzip_pool *pool = state->pool;
+	struct gzip_job *job;
+
+	if (pool == NULL) {
+		pool = gzip_pool_new(
+		    ((struct gzip_options *)self->bidder->data)->threads);
+		if (pool == NULL) {
+			state->pool_failed = 1;
+			return (0);
+		}
+		state->pool = pool;
+		/* From now on the output lives in the pool's jobs. */
+		self->read_into = NULL;
+	}
+
+	for (;;) {
+		/* Release the output returned by the last call. */
+		if (pool->held) {
+			pool->head++;
+			pool->held = 0;
+		}
+		while (!pool->stalled && pool->tail - pool->head < pool->njobs)
+			if (gzip_pool_queue(self) != ARCHIVE_OK)
+				pool->stalled = 1;
+		if (pool->head == pool->tail) {
+			/* Every job was returned; stream the next member. */
+			pool->stalled = 0;
+			return (0);
+		}
+
+		job = &pool->jobs[pool->head % pool->njobs];
+		pthread_mutex_lock(&pool->lock);
+		while (!job->done)
+			pthread_cond_wait(&pool->done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+		pool->held = 1;
+		if (job->error != NULL) {
+			archive_set_error(&self->archive->archive,
+			    ARCHIVE_ERRNO_MISC, "%s", job->error);
+			return (ARCHIVE_FATAL);
+		}
+		if (job->out_size > 0) {
+			state->total_out += job->out_size;
+			*p = job->out;
+			return (job->out_size);
+		}
+	}
+}
+#endif
+
+/*
+ * Inflate up to size bytes into out, reading new member headers as
+ * needed.  Returns the number of bytes produced, 0 at end of input.
+ */
 static ssize_t
-gzip_filter_read(struct archive_read_filter *self, const void **p)
+gzip_inflate(struct archive_read_filter *self, unsigned char *out_start,
+    size_t size)
 {
 	struct private_data *state;
+	unsigned char *out;
 	size_t decompressed;
 	ssize_t avail_in, max_in;
 	int ret;
 
 	state = (struct private_data *)self->data;
 
-	/* Empty our output buffer. */
-	state->stream.next_out = state->out_block;
-	state->stream.avail_out = (uInt)state->out_block_size;
+	state->stream.next_out = out_start;
+	if (size > UINT_MAX)
+		size = UINT_MAX;
+	state->stream.avail_out = (uInt)size;
 
 	/* Try to fill the output buffer. */
 	while (state->stream.avail_out > 0 && !state->eof) {
 		/* If we're not in a stream, read a header
 		 * and initialize the decompression library. */
 		if (!state->in_stream) {
+#ifdef GZIP_THREADS
+			/* Give the next member back to the pool. */
+			if (state->pool != NULL &&
+			    state->stream.next_out != out_start)
+				break;
+#endif
 			ret = consume_header(self);
 			if (ret == ARCHIVE_EOF) {
 				state->eof = 1;
@@ -468,20 +917,17 @@ gzip_filter_read(struct archive_read_filter *self, const void **p)
 		state->stream.avail_in = (uInt)avail_in;
 
 		/* Decompress and consume some of that data. */
+		out = state->stream.next_out;
 		ret = inflate(&(state->stream), 0);
 		switch (ret) {
 		case Z_OK: /* Decompressor made some progress. */
-			__archive_read_filter_consume(self->upstream,
-			    avail_in - state->stream.avail_in);
-			break;
 		case Z_STREAM_END: /* Found end of stream. */
 			__archive_read_filter_consume(self->upstream,
 			    avail_in - state->stream.avail_in);
-			/* Consume the stream trailer; release the
-			 * decompression library. */
-			ret = consume_trailer(self);
-			if (ret < ARCHIVE_OK)
-				return (ret);
+			state->crc = crc32(state->crc, out,
+			    (uInt)(state->stream.next_out - out));
+			state->member_out +=
+			    (uint32_t)(state->stream.next_out - out);
 			break;
 		default:
 			/* Return an error. */
@@ -490,18 +936,58 @@ gzip_filter_read(struct archive_read_filter *self, const void **p)
 			    "gzip decompression failed");
 			return (ARCHIVE_FATAL);
 		}
+		if (ret == Z_STREAM_END) {
+			/* Consume and check the stream trailer. */
+			ret = consume_trailer(self);
+			if (ret < ARCHIVE_OK)
+				return (ret);
+		}
 	}
 
 	/* We've read as much as we can. */
-	decompressed = state->stream.next_out - state->out_block;
+	decompressed = state->stream.next_out - out_start;
 	state->total_out += decompressed;
-	if (decompressed == 0)
+	return (decompressed);
+}
+
+static ssize_t
+gzip_filter_read(struct archive_read_filter *self, const void **p)
+{
+	struct private_data *state;
+	ssize_t decompressed;
+
+	state = (struct private_data *)self->data;
+
+#ifdef GZIP_THREADS
+	/* Multithreaded decompression only works on whole members. */
+	if (!state->in_stream && !state->eof && !state->pool_failed &&
+	    ((struct gzip_options *)self->bidder->data)->threads > 1) {
+		ssize_t bytes = gzip_pool_read(self, p);
+		if (bytes != 0)
+			return (bytes);
+	}
+#endif
+
+	decompressed = gzip_inflate(self, state->out_block,
+	    state->out_block_size);
+	if (decompressed <= 0)
 		*p = NULL;
 	else
 		*p = state->out_block;
 	return (decompressed);
 }
 
+/*
+ * Inflate straight into the caller's buffer.  Only used when nothing
+ * is buffered in front of us, so the stream position is the same.
+ */
+static ssize_t
+gzip_filter_read_into(struct archive_read_filter *self, void *buff,
+    size_t size)
+{
+	return (gzip_inflate(self, (unsigned char *)buff, size));
+}
+
 /*
  * Clean up the decompressor.
  */
@@ -514,7 +1000,7 @@ gzip_filter_close(struct archive_read_filter *self)
 	state = (struct private_data *)self->data;
 	ret = ARCHIVE_OK;
 
-	if (state->in_stream) {
+	if (state->stream_valid) {
 		switch (inflateEnd(&(state->stream))) {
 		case Z_OK:
 			break;
@@ -526,6 +1012,10 @@ gzip_filter_close(struct archive_read_filter *self)
 		}
 	}
 
+#ifdef GZIP_THREADS
+	if (state->pool != NULL)
+		gzip_pool_free(state->pool);
+#endif
 	free(state->name);
 	free(state->out_block);
 	free(state);
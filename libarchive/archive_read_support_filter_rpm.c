@@ -31,11 +31,15 @@
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
 
 #include "archive.h"
 #include "archive_endian.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_read_rpm_private.h"
 
 struct rpm {
 	int64_t		 total_in;
@@ -52,9 +56,53 @@ struct rpm {
 		ST_ARCHIVE	/* Reading 'Archive' section. */
 	}		 state;
 	int		 first_header;
+	int		 nheaders;
+
+	/* The main header is kept so that its file list can be
+	 * handed to the format reader. */
+	unsigned char	*hbuf;
+	struct archive_rpm_index index;
+	char		*paths;
 };
 #define RPM_LEAD_SIZE	96	/* Size of 'Lead' section. */
 
+/* Limits rpm itself puts on a header. */
+#define RPM_HEADER_MAX_TAGS	0xffff
+#define RPM_HEADER_MAX_DATA	0x10000000
+
+/* Header tags and types used to build the file index. */
+#define RPMTAG_OLDFILENAMES	1027
+#define RPMTAG_FILESIZES	1028
+#define RPMTAG_FILEMODES	1030
+#define RPMTAG_FILEMTIMES	1034
+#define RPMTAG_FILEDIGESTS	1035
+#define RPMTAG_FILELINKTOS	1036
+#define RPMTAG_FILEUSERNAME	1039
+#define RPMTAG_FILEGROUPNAME	1040
+#define RPMTAG_DIRINDEXES	1116
+#define RPMTAG_BASENAMES	1117
+#define RPMTAG_DIRNAMES		1118
+#define RPMTAG_LONGFILESIZES	5008
+#define RPMTAG_FILEDIGESTALGO	5011
+
+#define RPM_INT16_TYPE		3
+#define RPM_INT32_TYPE		4
+#define RPM_INT64_TYPE		5
+#define RPM_STRING_ARRAY_TYPE	8
+
+#define PGPHASHALGO_MD5		1
+#define PGPHASHALGO_SHA1	2
+#define PGPHASHALGO_SHA256	8
+#define PGPHASHALGO_SHA384	9
+#define PGPHASHALGO_SHA512	10
+
+struct rpm_tag {
+	const unsigned char	*data;
+	uint32_t		 type;
+	uint32_t		 count;
+	size_t			 size;	/* Bytes available from data. */
+};
+
 static int	rpm_bidder_bid(struct archive_read_filter_bidder *,
 		    struct archive_read_filter *);
 static int	rpm_bidder_init(struct archive_read_filter *);
@@ -62,6 +110,8 @@ static int	rpm_bidder_init(struct archive_read_filter *);
 static ssize_t	rpm_filter_read(struct archive_read_filter *,
 		    const void **);
 static int	rpm_filter_close(struct archive_read_filter *);
+static void	rpm_build_index(struct rpm *);
+static void	rpm_free_index(struct rpm *);
 
 #if ARCHIVE_VERSION_NUMBER < 4000000
 /* Deprecated; remove in libarchive 4.0 */
@@ -230,17 +280,29 @@ rpm_filter_read(struct archive_read_filter *self, const void **buff)
 				rpm->hlen = 16 + section * 16 + bytes;
 				rpm->state = ST_HEADER_DATA;
 				rpm->first_header = 0;
+				/* The second header is the main one; keep
+				 * it if it is within rpm's own limits. */
+				if (++rpm->nheaders == 2 &&
+				    section <= RPM_HEADER_MAX_TAGS &&
+				    bytes <= RPM_HEADER_MAX_DATA &&
+				    (rpm->hbuf = malloc(rpm->hlen)) != NULL)
+					memcpy(rpm->hbuf, rpm->header, 16);
 			}
 			break;
 		case ST_HEADER_DATA:
 			n = rpm->hlen - rpm->hpos;
 			if (n > avail_in - used)
 				n = avail_in - used;
+			if (rpm->nheaders == 2 && rpm->hbuf != NULL)
+				memcpy(rpm->hbuf + rpm->hpos, b, n);
 			b += n;
 			used += n;
 			rpm->hpos += n;
-			if (rpm->hpos == rpm->hlen)
+			if (rpm->hpos == rpm->hlen) {
 				rpm->state = ST_PADDING;
+				if (rpm->nheaders == 2 && rpm->hbuf != NULL)
+					rpm_build_index(rpm);
+			}
 			break;
 		case ST_PADDING:
 			while (used < (size_t)avail_in) {
@@ -282,8 +344,447 @@ rpm_filter_close(struct archive_read_filter *self)
 	struct rpm *rpm;
 
 	rpm = (struct rpm *)self->data;
+	rpm_free_index(rpm);
+	free(rpm->hbuf);
 	free(rpm);
 
 	return (ARCHIVE_OK);
 }
 
+
+
+/*
+ * Building the file index from the main header.
+ *
+ * The header is a count of index entries, the size of the data
+ * store, the index entries themselves (tag, type, offset, count;
+ * all big-endian) and then the data store.  Anything that doesn't
+ * make sense just leaves the archive without an index; the payload
+ * can still be read as before.
+ */
+
+static int
+rpm_find_tag(const unsigned char *h, uint32_t tag, uint32_t type,
+    struct rpm_tag *t)
+{
+	const unsigned char *e, *store;
+	uint32_t ntags, dsize, off, i;
+	size_t width;
+
+	ntags = archive_be32dec(h + 8);
+	dsize = archive_be32dec(h + 12);
+	store = h + 16 + (size_t)ntags * 16;
+	for (i = 0, e = h + 16; i < ntags; i++, e += 16) {
+		if (archive_be32dec(e) != tag)
+			continue;
+		if (archive_be32dec(e + 4) != type)
+			return (0);
+		off = archive_be32dec(e + 8);
+		if (off >= dsize)
+			return (0);
+		t->data = store + off;
+		t->type = type;
+		t->count = archive_be32dec(e + 12);
+		t->size = dsize - off;
+		switch (type) {
+		case RPM_INT16_TYPE: width = 2; break;
+		case RPM_INT32_TYPE: width = 4; break;
+		case RPM_INT64_TYPE: width = 8; break;
+		default: width = 0; break;
+		}
+		if (width != 0 && t->count > t->size / width)
+			return (0);
+		return (1);
+	}
+	return (0);
+}
+
+/*
+ * Split a string array tag into 'n' strings.  Fails unless the tag
+ * holds exactly 'n' NUL-terminated strings.
+ */
+static int
+rpm_tag_strings(const struct rpm_tag *t, const char **v, size_t n)
+{
+	const unsigned char *p, *end, *nul;
+	size_t i;
+
+	if (t->count != n)
+		return (0);
+	p = t->data;
+	end = t->data + t->size;
+	for (i = 0; i < n; i++) {
+		nul = memchr(p, '\0', end - p);
+		if (nul == NULL)
+			return (0);
+		v[i] = (const char *)p;
+		p = nul + 1;
+	}
+	return (1);
+}
+
+static const char *
+rpm_strip_path(const char *p)
+{
+	if (p[0] == '.' && p[1] == '/')
+		p += 2;
+	while (*p == '/')
+		p++;
+	return (p);
+}
+
+static int
+rpm_cmp_file(const void *a, const void *b)
+{
+	const struct archive_rpm_file *fa =
+	    *(const struct archive_rpm_file * const *)a;
+	const struct archive_rpm_file *fb =
+	    *(const struct archive_rpm_file * const *)b;
+
+	return (strcmp(fa->pathname, fb->pathname));
+}
+
+static void
+rpm_build_index(struct rpm *rpm)
+{
+	struct archive_rpm_index *index = &rpm->index;
+	struct archive_rpm_file *f;
+	struct rpm_tag t, dirs, dirindexes;
+	const char **names = NULL, **strs = NULL, *dir;
+	const unsigned char *h = rpm->hbuf;
+	size_t i, n, ndirs, len, total;
+	uint32_t di;
+	char *p;
+
+	if (rpm_find_tag(h, RPMTAG_BASENAMES, RPM_STRING_ARRAY_TYPE, &t)) {
+		if (!rpm_find_tag(h, RPMTAG_DIRNAMES, RPM_STRING_ARRAY_TYPE,
+		    &dirs) ||
+		    !rpm_find_tag(h, RPMTAG_DIRINDEXES, RPM_INT32_TYPE,
+		    &dirindexes) || dirindexes.count != t.count)
+			return;
+	} else if (rpm_find_tag(h, RPMTAG_OLDFILENAMES,
+	    RPM_STRING_ARRAY_TYPE, &t))
+		dirs.count = 0;
+	else
+		return;
+	n = t.count;
+	ndirs = dirs.count;
+	/* Every string takes at least one byte. */
+	if (n == 0 || n > t.size || (ndirs > 0 && ndirs > dirs.size))
+		return;
+
+	names = calloc(n + ndirs, sizeof(*names));
+	strs = calloc(n, sizeof(*strs));
+	index->files = calloc(n, sizeof(*index->files));
+	index->sorted = calloc(n, sizeof(*index->sorted));
+	if (names == NULL || strs == NULL || index->files == NULL ||
+	    index->sorted == NULL)
+		goto fail;
+	index->nfiles = n;
+
+	/* Assemble the pathnames in one buffer. */
+	if (!rpm_tag_strings(&t, names, n) ||
+	    (ndirs > 0 && !rpm_tag_strings(&dirs, names + n, ndirs)))
+		goto fail;
+	total = 0;
+	for (i = 0; i < n; i++) {
+		len = strlen(names[i]) + 1;
+		if (ndirs > 0) {
+			di = archive_be32dec(dirindexes.data + i * 4);
+			if (di >= ndirs)
+				goto fail;
+			len += strlen(rpm_strip_path(names[n + di]));
+		}
+		total += len;
+	}
+	rpm->paths = malloc(total);
+	if (rpm->paths == NULL)
+		goto fail;
+	p = rpm->paths;
+	for (i = 0; i < n; i++) {
+		f = &index->files[i];
+		f->pathname = p;
+		if (ndirs > 0) {
+			di = archive_be32dec(dirindexes.data + i * 4);
+			dir = rpm_strip_path(names[n + di]);
+			len = strlen(dir);
+			memcpy(p, dir, len);
+			p += len;
+			len = strlen(names[i]) + 1;
+			memcpy(p, names[i], len);
+		} else {
+			dir = rpm_strip_path(names[i]);
+			len = strlen(dir) + 1;
+			memcpy(p, dir, len);
+		}
+		p += len;
+		index->sorted[i] = f;
+	}
+
+	/* Everything else is optional. */
+	if (rpm_find_tag(h, RPMTAG_LONGFILESIZES, RPM_INT64_TYPE, &t) &&
+	    t.count == n) {
+		for (i = 0; i < n; i++)
+			index->files[i].size =
+			    (int64_t)archive_be64dec(t.data + i * 8);
+	} else if (rpm_find_tag(h, RPMTAG_FILESIZES, RPM_INT32_TYPE, &t) &&
+	    t.count == n) {
+		for (i = 0; i < n; i++)
+			index->files[i].size = archive_be32dec(t.data + i * 4);
+	}
+	if (rpm_find_tag(h, RPMTAG_FILEMODES, RPM_INT16_TYPE, &t) &&
+	    t.count == n) {
+		for (i = 0; i < n; i++)
+			index->files[i].mode = archive_be16dec(t.data + i * 2);
+	}
+	if (rpm_find_tag(h, RPMTAG_FILEMTIMES, RPM_INT32_TYPE, &t) &&
+	    t.count == n) {
+		for (i = 0; i < n; i++)
+			index->files[i].mtime = archive_be32dec(t.data + i * 4);
+	}
+	if (rpm_find_tag(h, RPMTAG_FILEDIGESTS, RPM_STRING_ARRAY_TYPE, &t) &&
+	    rpm_tag_strings(&t, strs, n)) {
+		for (i = 0; i < n; i++)
+			index->files[i].digest = strs[i];
+	}
+	if (rpm_find_tag(h, RPMTAG_FILELINKTOS, RPM_STRING_ARRAY_TYPE, &t) &&
+	    rpm_tag_strings(&t, strs, n)) {
+		for (i = 0; i < n; i++)
+			index->files[i].linkname = strs[i];
+	}
+	if (rpm_find_tag(h, RPMTAG_FILEUSERNAME, RPM_STRING_ARRAY_TYPE, &t) &&
+	    rpm_tag_strings(&t, strs, n)) {
+		for (i = 0; i < n; i++)
+			index->files[i].uname = strs[i];
+	}
+	if (rpm_find_tag(h, RPMTAG_FILEGROUPNAME, RPM_STRING_ARRAY_TYPE,
+	    &t) && rpm_tag_strings(&t, strs, n)) {
+		for (i = 0; i < n; i++)
+			index->files[i].gname = strs[i];
+	}
+	if (rpm_find_tag(h, RPMTAG_FILEDIGESTALGO, RPM_INT32_TYPE, &t) &&
+	    t.count >= 1)
+		index->digest_algo = archive_be32dec(t.data);
+	else
+		index->digest_algo = PGPHASHALGO_MD5;
+
+	qsort(index->sorted, n, sizeof(*index->sorted), rpm_cmp_file);
+	free(names);
+	free(strs);
+	return;
+fail:
+	free(names);
+	free(strs);
+	rpm_free_index(rpm);
+}
+
+static void
+rpm_free_index(struct rpm *rpm)
+{
+	free(rpm->index.files);
+	free(rpm->index.sorted);
+	free(rpm->paths);
+	memset(&rpm->index, 0, sizeof(rpm->index));
+	rpm->paths = NULL;
+}
+
+struct archive_rpm_index *
+__archive_read_rpm_index(struct archive_read *a)
+{
+	struct archive_read_filter *f;
+	struct rpm *rpm;
+
+	for (f = a->filter; f != NULL; f = f->upstream) {
+		if (f->code != ARCHIVE_FILTER_RPM)
+			continue;
+		rpm = (struct rpm *)f->data;
+		if (rpm->index.files == NULL)
+			return (NULL);
+		return (&rpm->index);
+	}
+	return (NULL);
+}
+
+const struct archive_rpm_file *
+__archive_read_rpm_lookup(struct archive_rpm_index *index,
+    const char *pathname)
+{
+	struct archive_rpm_file *f;
+	size_t lo, hi, mid;
+	int cmp;
+
+	pathname = rpm_strip_path(pathname);
+
+	/* rpm writes the payload in header order. */
+	if (index->next < index->nfiles) {
+		f = &index->files[index->next];
+		if (strcmp(f->pathname, pathname) == 0) {
+			index->next++;
+			return (f);
+		}
+	}
+
+	lo = 0;
+	hi = index->nfiles;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		f = index->sorted[mid];
+		cmp = strcmp(f->pathname, pathname);
+		if (cmp == 0) {
+			index->next = f - index->files + 1;
+			return (f);
+		}
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (NULL);
+}
+
+/*
+ * Per-file digest checking.
+ */
+
+int
+__archive_rpm_digest_init(struct archive_rpm_digest *d,
+    const struct archive_rpm_index *index,
+    const struct archive_rpm_file *file)
+{
+	int r;
+
+	d->algo = 0;
+	if (file->digest == NULL || file->digest[0] == '\0')
+		return (0);
+	switch (index->digest_algo) {
+#ifdef ARCHIVE_HAS_MD5
+	case PGPHASHALGO_MD5:
+		r = archive_md5_init(&d->ctx.md5);
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+	case PGPHASHALGO_SHA1:
+		r = archive_sha1_init(&d->ctx.sha1);
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+	case PGPHASHALGO_SHA256:
+		r = archive_sha256_init(&d->ctx.sha256);
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+	case PGPHASHALGO_SHA384:
+		r = archive_sha384_init(&d->ctx.sha384);
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+	case PGPHASHALGO_SHA512:
+		r = archive_sha512_init(&d->ctx.sha512);
+		break;
+#endif
+	default:
+		return (0);
+	}
+	if (r != ARCHIVE_OK)
+		return (0);
+	d->algo = index->digest_algo;
+	d->expected = file->digest;
+	return (1);
+}
+
+void
+__archive_rpm_digest_update(struct archive_rpm_digest *d,
+    const void *buff, size_t size)
+{
+	(void)buff; /* UNUSED without a digest back end */
+	(void)size; /* UNUSED without a digest back end */
+
+	switch (d->algo) {
+#ifdef ARCHIVE_HAS_MD5
+	case PGPHASHALGO_MD5:
+		archive_md5_update(&d->ctx.md5, buff, size);
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+	case PGPHASHALGO_SHA1:
+		archive_sha1_update(&d->ctx.sha1, buff, size);
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+	case PGPHASHALGO_SHA256:
+		archive_sha256_update(&d->ctx.sha256, buff, size);
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+	case PGPHASHALGO_SHA384:
+		archive_sha384_update(&d->ctx.sha384, buff, size);
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+	case PGPHASHALGO_SHA512:
+		archive_sha512_update(&d->ctx.sha512, buff, size);
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+/*
+ * Must be called once for every successful init, even if the
+ * result is not wanted, since some digest back ends allocate.
+ */
+int
+__archive_rpm_digest_final(struct archive_rpm_digest *d)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned char md[64];
+	size_t len, i;
+	const char *e;
+
+	switch (d->algo) {
+#ifdef ARCHIVE_HAS_MD5
+	case PGPHASHALGO_MD5:
+		archive_md5_final(&d->ctx.md5, md);
+		len = 16;
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+	case PGPHASHALGO_SHA1:
+		archive_sha1_final(&d->ctx.sha1, md);
+		len = 20;
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+	case PGPHASHALGO_SHA256:
+		archive_sha256_final(&d->ctx.sha256, md);
+		len = 32;
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+	case PGPHASHALGO_SHA384:
+		archive_sha384_final(&d->ctx.sha384, md);
+		len = 48;
+		break;
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+	case PGPHASHALGO_SHA512:
+		archive_sha512_final(&d->ctx.sha512, md);
+		len = 64;
+		break;
+#endif
+	default:
+		return (ARCHIVE_OK);
+	}
+	d->algo = 0;
+
+	e = d->expected;
+	if (strlen(e) != len * 2)
+		return (ARCHIVE_WARN);
+	for (i = 0; i < len; i++, e += 2) {
+		if ((e[0] | 0x20) != hex[md[i] >> 4] ||
+		    (e[1] | 0x20) != hex[md[i] & 0x0f])
+			return (ARCHIVE_WARN);
+	}
+	return (ARCHIVE_OK);
+}
@@ -98,7 +98,7 @@ archive_read_support_filter_uu(struct archive *_a)
 }
 
 static const unsigned char ascii[256] = {
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\n', 0, 0, '\r', 0, 0, /* 00 - 0F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, '\n', 0, 0, '\r', 0, 0, /* 00 - 0F */
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 10 - 1F */
 	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 20 - 2F */
 	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 30 - 3F */
@@ -135,10 +135,11 @@ static const unsigned char uuchar[256] = {
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* F0 - FF */
 };
 
+/* Characters which may appear in base64 lines, including white space. */
 static const unsigned char base64[256] = {
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 00 - 0F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, /* 00 - 0F */
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 10 - 1F */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, /* 20 - 2F */
+	1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, /* 20 - 2F */
 	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, /* 30 - 3F */
 	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 40 - 4F */
 	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, /* 50 - 5F */
@@ -154,23 +155,88 @@ static const unsigned char base64[256] = {
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* F0 - FF */
 };
 
-static const int base64num[128] = {
-	 0,  0,  0,  0,  0,  0,  0,  0,
-	 0,  0,  0,  0,  0,  0,  0,  0, /* 00 - 0F */
-	 0,  0,  0,  0,  0,  0,  0,  0,
-	 0,  0,  0,  0,  0,  0,  0,  0, /* 10 - 1F */
-	 0,  0,  0,  0,  0,  0,  0,  0,
-	 0,  0,  0, 62,  0,  0,  0, 63, /* 20 - 2F */
-	52, 53, 54, 55, 56, 57, 58, 59,
-	60, 61,  0,  0,  0,  0,  0,  0, /* 30 - 3F */
-	 0,  0,  1,  2,  3,  4,  5,  6,
-	 7,  8,  9, 10, 11, 12, 13, 14, /* 40 - 4F */
-	15, 16, 17, 18, 19, 20, 21, 22,
-	23, 24, 25,  0,  0,  0,  0,  0, /* 50 - 5F */
-	 0, 26, 27, 28, 29, 30, 31, 32,
-	33, 34, 35, 36, 37, 38, 39, 40, /* 60 - 6F */
-	41, 42, 43, 44, 45, 46, 47, 48,
-	49, 50, 51,  0,  0,  0,  0,  0, /* 70 - 7F */
+/*
+ * Decoded values of uuencoded characters. Characters which cannot
+ * appear in uuencoded data are marked with UU_INVALID so that a group
+ * of four characters can be checked with a single test.
+ */
+#define UU_INVALID	0x40
+static const unsigned char uuvalue[256] = {
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* 00 - 0F */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* 10 - 1F */
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, /* 20 - 2F */
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, /* 30 - 3F */
+	0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+	0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, /* 40 - 4F */
+	0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+	0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, /* 50 - 5F */
+	0x00, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* 60 - 6F */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* 70 - 7F */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* 80 - 8F */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* 90 - 9F */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* A0 - AF */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* B0 - BF */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* C0 - CF */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* D0 - DF */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* E0 - EF */
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, /* F0 - FF */
+};
+
+/*
+ * Decoded values of base64 characters. The padding character '=' and
+ * the white space that mail gateways and log collectors sometimes add
+ * to lines are marked separately from invalid characters.
+ */
+#define B64_PAD		0x40
+#define B64_SPACE	0x80
+#define B64_INVALID	0xff
+static const unsigned char base64value[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x80, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* 00 - 0F */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* 10 - 1F */
+	0x80, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f, /* 20 - 2F */
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+	0x3c, 0x3d, 0xff, 0xff, 0xff, 0x40, 0xff, 0xff, /* 30 - 3F */
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, /* 40 - 4F */
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff, /* 50 - 5F */
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+	0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, /* 60 - 6F */
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+	0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff, /* 70 - 7F */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* 80 - 8F */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* 90 - 9F */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* A0 - AF */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* B0 - BF */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* C0 - CF */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* D0 - DF */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* E0 - EF */
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, /* F0 - FF */
 };
 
 static ssize_t
@@ -178,15 +244,14 @@ get_line(const unsigned char *b, ssize_t avail, ssize_t *nlsize)
 {
 	ssize_t len;
 
+	/* Skip over printable characters, then look at what stopped us. */
 	len = 0;
-	while (len < avail) {
-		switch (ascii[*b]) {
-		case 0:	/* Non-ascii character or control character. */
-			if (nlsize != NULL)
-				*nlsize = 0;
-			return (-1);
+	while (len < avail && ascii[b[len]] == 1)
+		len++;
+	if (len < avail) {
+		switch (ascii[b[len]]) {
 		case '\r':
-			if (avail-len > 1 && b[1] == '\n') {
+			if (avail-len > 1 && b[len+1] == '\n') {
 				if (nlsize != NULL)
 					*nlsize = 2;
 				return (len+2);
@@ -196,10 +261,10 @@ get_line(const unsigned char *b, ssize_t avail, ssize_t *nlsize)
 			if (nlsize != NULL)
 				*nlsize = 1;
 			return (len+1);
-		case 1:
-			b++;
-			len++;
-			break;
+		default: /* Non-ascii character or control character. */
+			if (nlsize != NULL)
+				*nlsize = 0;
+			return (-1);
 		}
 	}
 	if (nlsize != NULL)
@@ -432,6 +497,66 @@ ensure_in_buff_size(struct archive_read_filter *self,
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Decode one line of base64 data into `out`, which must have room for
+ * at least 3/4 of `l` bytes. Spaces and tabs are skipped and decoding
+ * stops at the first '='. Returns the number of decoded bytes, or -1
+ * if the line contains an invalid character.
+ */
+static ssize_t
+base64_decode_line(unsigned char *out, const unsigned char *b, ssize_t l)
+{
+	unsigned char *o = out;
+	int c, n, sextets;
+
+	/* Decode plain groups of four characters at a time. */
+	while (l >= 4) {
+		int c0 = base64value[b[0]], c1 = base64value[b[1]];
+		int c2 = base64value[b[2]], c3 = base64value[b[3]];
+
+		if ((c0 | c1 | c2 | c3) & (B64_PAD | B64_SPACE))
+			break;
+		n = (c0 << 18) | (c1 << 12) | (c2 << 6) | c3;
+		o[0] = n >> 16;
+		o[1] = (n >> 8) & 0xFF;
+		o[2] = n & 0xFF;
+		o += 3;
+		b += 4;
+		l -= 4;
+	}
+
+	/* Handle the rest of the line one character at a time. */
+	n = 0;
+	sextets = 0;
+	for (; l > 0; b++, l--) {
+		c = base64value[*b];
+		if (c == B64_SPACE)
+			continue;
+		if (c == B64_PAD)
+			break;
+		if (c == B64_INVALID)
+			return (-1);
+		n = (n << 6) | c;
+		switch (++sextets) {
+		case 2:
+			*o++ = (n >> 4) & 0xFF;
+			break;
+		case 3:
+			*o++ = (n >> 2) & 0xFF;
+			break;
+		case 4:
+			*o++ = n & 0xFF;
+			n = 0;
+			sextets = 0;
+			break;
+		}
+	}
+	/* A single character cannot encode a byte. */
+	if (sextets == 1)
+		return (-1);
+	return (o - out);
+}
+
 static ssize_t
 uudecode_filter_read(struct archive_read_filter *self, const void **buff)
 {
@@ -571,6 +696,22 @@ read_more:
 				uudecode->state = ST_UUEND;
 				break;
 			}
+			/* Decode whole groups of four characters first. */
+			while (l >= 3 && body >= 4) {
+				int c0 = uuvalue[b[0]], c1 = uuvalue[b[1]];
+				int c2 = uuvalue[b[2]], c3 = uuvalue[b[3]];
+				int n;
+
+				if ((c0 | c1 | c2 | c3) & UU_INVALID)
+					break;
+				n = (c0 << 18) | (c1 << 12) | (c2 << 6) | c3;
+				out[0] = n >> 16;
+				out[1] = (n >> 8) & 0xFF;
+				out[2] = n & 0xFF;
+				out += 3; total += 3;
+				b += 4; l -= 3;
+				body -= 4;
+			}
 			while (l > 0) {
 				int n = 0;
 
@@ -622,41 +763,15 @@ read_more:
 				uudecode->state = ST_FIND_HEAD;
 				break;
 			}
-			while (l > 0) {
-				int n = 0;
-
-				if (!base64[b[0]] || !base64[b[1]])
-					break;
-				n = base64num[*b++] << 18;
-				n |= base64num[*b++] << 12;
-				*out++ = n >> 16; total++;
-				l -= 2;
-
-				if (l > 0) {
-					if (*b == '=')
-						break;
-					if (!base64[*b])
-						break;
-					n |= base64num[*b++] << 6;
-					*out++ = (n >> 8) & 0xFF; total++;
-					--l;
-				}
-				if (l > 0) {
-					if (*b == '=')
-						break;
-					if (!base64[*b])
-						break;
-					n |= base64num[*b++];
-					*out++ = n & 0xFF; total++;
-					--l;
-				}
-			}
-			if (l && *b != '=') {
+			l = base64_decode_line(out, b, l);
+			if (l < 0) {
 				archive_set_error(&self->archive->archive,
 				    ARCHIVE_ERRNO_MISC,
 				    "Insufficient compressed data");
 				return (ARCHIVE_FATAL);
 			}
+			out += l;
+			total += l;
 			break;
 		}
 	}
@@ -52,6 +52,12 @@ __FBSDID("$FreeBSD$");
 
 #if HAVE_LZMA_H && HAVE_LIBLZMA
 
+#if LZMA_VERSION_MAJOR >= 5
+/* Random access to .xz data through the Index at the end of each
+ * Stream. */
+#define XZ_SEEK 1
+#endif
+
 struct private_data {
 	lzma_stream	 stream;
 	unsigned char	*out_block;
@@ -65,6 +71,22 @@ struct private_data {
 	uint32_t	 crc32;
 	int64_t		 member_in;
 	int64_t		 member_out;
+
+#ifdef XZ_SEEK
+	/*
+	 * Following variables are used for seekable xz only.  The
+	 * Index lists every Block of every Stream in the file; after
+	 * the first seek we decode one Block at a time, starting from
+	 * the Block that holds the requested offset.
+	 */
+	lzma_index	*index;
+	lzma_index_iter	 iter;
+	int64_t		 in_start;	/* Upstream offset of the file. */
+	char		 index_checked;
+	char		 block_mode;
+	lzma_block	 block;
+	lzma_filter	 filters[LZMA_FILTERS_MAX + 1];
+#endif
 };
 
 #if LZMA_VERSION_MAJOR >= 5
@@ -77,8 +99,16 @@ struct private_data {
 
 /* Combined lzip/lzma/xz filter */
 static ssize_t	xz_filter_read(struct archive_read_filter *, const void **);
+static ssize_t	xz_filter_read_into(struct archive_read_filter *, void *,
+		    size_t);
 static int	xz_filter_close(struct archive_read_filter *);
 static int	xz_lzma_bidder_init(struct archive_read_filter *);
+#ifdef XZ_SEEK
+static int	xz_read_index(struct archive_read_filter *);
+static int	xz_block_init(struct archive_read_filter *);
+static int64_t	xz_filter_seek(struct archive_read_filter *, int64_t, int);
+static int64_t	xz_filter_skip(struct archive_read_filter *, int64_t);
+#endif
 
 #endif
 
@@ -495,6 +525,7 @@ xz_lzma_bidder_init(struct archive_read_filter *self)
 	state->out_block_size = out_block_size;
 	state->out_block = out_block;
 	self->read = xz_filter_read;
+	self->read_into = xz_filter_read_into;
 	self->skip = NULL; /* not supported */
 	self->close = xz_filter_close;
 
@@ -653,8 +684,12 @@ lzip_tail(struct archive_read_filter *self)
 /*
  * Return the next block of decompressed data.
  */
+/*
+ * Decompress up to size bytes into out.  Returns the number of bytes
+ * produced, 0 at end of input.
+ */
 static ssize_t
-xz_filter_read(struct archive_read_filter *self, const void **p)
+xz_decode(struct archive_read_filter *self, unsigned char *out, size_t size)
 {
 	struct private_data *state;
 	size_t decompressed;
@@ -663,9 +698,21 @@ xz_filter_read(struct archive_read_filter *self, const void **p)
 
 	state = (struct private_data *)self->data;
 
-	/* Empty our output buffer. */
-	state->stream.next_out = state->out_block;
-	state->stream.avail_out = state->out_block_size;
+#ifdef XZ_SEEK
+	/* Not done at init time: the upstream may not be open yet. */
+	if (!state->index_checked && self->code == ARCHIVE_FILTER_XZ) {
+		state->index_checked = 1;
+		if (xz_read_index(self) != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
+		if (state->index != NULL) {
+			self->seek = xz_filter_seek;
+			self->skip = xz_filter_skip;
+		}
+	}
+#endif
+
+	state->stream.next_out = out;
+	state->stream.avail_out = size;
 
 	/* Try to fill the output buffer. */
 	while (state->stream.avail_out > 0 && !state->eof) {
@@ -705,28 +752,67 @@ xz_filter_read(struct archive_read_filter *self, const void **p)
 			set_error(self, ret);
 			return (ARCHIVE_FATAL);
 		}
+#ifdef XZ_SEEK
+		if (state->eof && state->block_mode) {
+			/* End of a Block; go on with the next one. */
+			int64_t end = state->iter.block.compressed_file_offset
+			    + state->iter.block.total_size;
+
+			if (lzma_index_iter_next(&state->iter,
+			    LZMA_INDEX_ITER_NONEMPTY_BLOCK))
+				continue;
+			/* Step over any Index, Stream Footer, Stream
+			 * Padding and Stream Header in between. */
+			if (__archive_read_filter_consume(self->upstream,
+			    state->iter.block.compressed_file_offset - end) < 0)
+				return (ARCHIVE_FATAL);
+			if (xz_block_init(self) != ARCHIVE_OK)
+				return (ARCHIVE_FATAL);
+		}
+#endif
 	}
 
-	decompressed = state->stream.next_out - state->out_block;
+	decompressed = state->stream.next_out - out;
 	state->total_out += decompressed;
 	state->member_out += decompressed;
-	if (decompressed == 0)
-		*p = NULL;
-	else {
-		*p = state->out_block;
-		if (self->code == ARCHIVE_FILTER_LZIP) {
-			state->crc32 = lzma_crc32(state->out_block,
-			    decompressed, state->crc32);
-			if (state->eof) {
-				ret = lzip_tail(self);
-				if (ret != ARCHIVE_OK)
-					return (ret);
-			}
+	if (decompressed != 0 && self->code == ARCHIVE_FILTER_LZIP) {
+		state->crc32 = lzma_crc32(out, decompressed, state->crc32);
+		if (state->eof) {
+			ret = lzip_tail(self);
+			if (ret != ARCHIVE_OK)
+				return (ret);
 		}
 	}
 	return (decompressed);
 }
 
+static ssize_t
+xz_filter_read(struct archive_read_filter *self, const void **p)
+{
+	struct private_data *state;
+	ssize_t decompressed;
+
+	state = (struct private_data *)self->data;
+
+	decompressed = xz_decode(self, state->out_block,
+	    state->out_block_size);
+	if (decompressed <= 0)
+		*p = NULL;
+	else
+		*p = state->out_block;
+	return (decompressed);
+}
+
+/*
+ * Let liblzma write into the caller's buffer instead of out_block.
+ */
+static ssize_t
+xz_filter_read_into(struct archive_read_filter *self, void *buff,
+    size_t size)
+{
+	return (xz_decode(self, (unsigned char *)buff, size));
+}
+
 /*
  * Clean up the decompressor.
  */
@@ -737,11 +823,254 @@ xz_filter_close(struct archive_read_filter *self)
 
 	state = (struct private_data *)self->data;
 	lzma_end(&(state->stream));
+#ifdef XZ_SEEK
+	lzma_index_end(state->index, NULL);
+#endif
 	free(state->out_block);
 	free(state);
 	return (ARCHIVE_OK);
 }
 
+#ifdef XZ_SEEK
+
+/* An Index this large is not worth holding in memory. */
+#define XZ_INDEX_MAX	(64 * 1024 * 1024)
+
+static const unsigned char *
+xz_read_at(struct archive_read_filter *upstream, int64_t offset, size_t size)
+{
+	if (__archive_read_filter_seek(upstream, offset, SEEK_SET) != offset)
+		return (NULL);
+	return (__archive_read_filter_ahead(upstream, size, NULL));
+}
+
+/*
+ * Read the Index of every Stream, walking back from the end of the
+ * file.  Anything we don't understand just leaves the file without
+ * an index; it is then read sequentially as before.
+ */
+static int
+xz_read_index(struct archive_read_filter *self)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	struct archive_read_filter *upstream = self->upstream;
+	lzma_index *index = NULL, *this_index;
+	lzma_stream_flags header_flags, footer_flags;
+	const unsigned char *p;
+	int64_t start, pos;
+	lzma_vli padding = 0, stream_size;
+	uint64_t memlimit;
+	size_t in_pos;
+
+	if (upstream->seek == NULL)
+		return (ARCHIVE_OK);
+	start = upstream->position;
+	pos = __archive_read_filter_seek(upstream, 0, SEEK_END);
+	if (pos < 0) {
+		/* A pipe or the like; read it sequentially. */
+		archive_clear_error(&self->archive->archive);
+		return (ARCHIVE_OK);
+	}
+
+	while (pos > start) {
+		if (pos - start < 2 * LZMA_STREAM_HEADER_SIZE)
+			goto no_index;
+		p = xz_read_at(upstream, pos - LZMA_STREAM_HEADER_SIZE,
+		    LZMA_STREAM_HEADER_SIZE);
+		if (p == NULL)
+			goto no_index;
+		/* Stream Padding is a multiple of four null bytes. */
+		if (archive_le32dec(p + 8) == 0) {
+			pos -= 4;
+			padding += 4;
+			continue;
+		}
+		if (lzma_stream_footer_decode(&footer_flags, p) != LZMA_OK ||
+		    footer_flags.backward_size > XZ_INDEX_MAX ||
+		    (int64_t)footer_flags.backward_size >
+		    pos - start - 2 * LZMA_STREAM_HEADER_SIZE)
+			goto no_index;
+		p = xz_read_at(upstream, pos - LZMA_STREAM_HEADER_SIZE
+		    - footer_flags.backward_size,
+		    (size_t)footer_flags.backward_size);
+		if (p == NULL)
+			goto no_index;
+		this_index = NULL;
+		memlimit = UINT64_MAX;
+		in_pos = 0;
+		if (lzma_index_buffer_decode(&this_index, &memlimit, NULL,
+		    p, &in_pos, (size_t)footer_flags.backward_size)
+		    != LZMA_OK)
+			goto no_index;
+
+		stream_size = lzma_index_stream_size(this_index);
+		if (stream_size > (lzma_vli)(pos - start))
+			goto bad_stream;
+		pos -= stream_size;
+		p = xz_read_at(upstream, pos, LZMA_STREAM_HEADER_SIZE);
+		if (p == NULL ||
+		    lzma_stream_header_decode(&header_flags, p) != LZMA_OK ||
+		    lzma_stream_flags_compare(&header_flags, &footer_flags)
+		    != LZMA_OK ||
+		    lzma_index_stream_flags(this_index, &footer_flags)
+		    != LZMA_OK ||
+		    lzma_index_stream_padding(this_index, padding) != LZMA_OK)
+			goto bad_stream;
+		padding = 0;
+		/* Streams are found last first; append what we have so
+		 * far to this one. */
+		if (index != NULL &&
+		    lzma_index_cat(this_index, index, NULL) != LZMA_OK)
+			goto bad_stream;
+		index = this_index;
+		continue;
+bad_stream:
+		lzma_index_end(this_index, NULL);
+		goto no_index;
+	}
+	if (index != NULL && pos == start) {
+		state->index = index;
+		state->in_start = start;
+		index = NULL;
+	}
+no_index:
+	lzma_index_end(index, NULL);
+	if (__archive_read_filter_seek(upstream, start, SEEK_SET) != start) {
+		archive_set_error(&self->archive->archive,
+		    ARCHIVE_ERRNO_MISC, "Can't seek back to the xz data");
+		return (ARCHIVE_FATAL);
+	}
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Set up a Block decoder for the Block at state->iter, reading its
+ * header from the current upstream position.
+ */
+static int
+xz_block_init(struct archive_read_filter *self)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	const unsigned char *p;
+	lzma_ret ret;
+	int i;
+
+	if ((p = __archive_read_filter_ahead(self->upstream, 1, NULL)) == NULL)
+		goto truncated;
+	memset(&state->block, 0, sizeof(state->block));
+	state->block.version = 0;
+	state->block.check = state->iter.stream.flags->check;
+	state->block.filters = state->filters;
+	state->block.header_size = lzma_block_header_size_decode(p[0]);
+	p = __archive_read_filter_ahead(self->upstream,
+	    state->block.header_size, NULL);
+	if (p == NULL)
+		goto truncated;
+	ret = lzma_block_header_decode(&state->block, NULL, p);
+	if (ret != LZMA_OK) {
+		set_error(self, ret);
+		return (ARCHIVE_FATAL);
+	}
+	ret = lzma_block_compressed_size(&state->block,
+	    state->iter.block.unpadded_size);
+	if (ret == LZMA_OK) {
+		state->block.uncompressed_size =
+		    state->iter.block.uncompressed_size;
+		ret = lzma_block_decoder(&state->stream, &state->block);
+	}
+	/* The decoder has its own copy of the filter options. */
+	for (i = 0; state->filters[i].id != LZMA_VLI_UNKNOWN; i++) {
+		free(state->filters[i].options);
+		state->filters[i].options = NULL;
+	}
+	if (ret != LZMA_OK) {
+		set_error(self, ret);
+		return (ARCHIVE_FATAL);
+	}
+	__archive_read_filter_consume(self->upstream,
+	    state->block.header_size);
+	state->block_mode = 1;
+	state->eof = 0;
+	return (ARCHIVE_OK);
+truncated:
+	archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_MISC,
+	    "truncated input");
+	return (ARCHIVE_FATAL);
+}
+
+static int64_t
+xz_filter_seek(struct archive_read_filter *self, int64_t offset, int whence)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	int64_t size, n;
+	ssize_t bytes;
+
+	size = (int64_t)lzma_index_uncompressed_size(state->index);
+	if (whence == SEEK_END)
+		offset += size;
+	if (offset < 0) {
+		archive_set_error(&self->archive->archive, EINVAL,
+		    "Seek before the start of the xz data");
+		return (ARCHIVE_FATAL);
+	}
+	if (offset >= size) {
+		/* Leave the decoder at the end of the data. */
+		state->block_mode = 1;
+		state->eof = 1;
+		state->total_out = size;
+		return (size);
+	}
+
+	lzma_index_iter_init(&state->iter, state->index);
+	if (lzma_index_iter_locate(&state->iter, offset))
+		return (ARCHIVE_FATAL);
+	if (__archive_read_filter_seek(self->upstream, state->in_start +
+	    (int64_t)state->iter.block.compressed_file_offset, SEEK_SET) < 0)
+		return (ARCHIVE_FATAL);
+	if (xz_block_init(self) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+	state->total_out = state->iter.block.uncompressed_file_offset;
+
+	/* Decode from the start of the Block up to the offset. */
+	while (state->total_out < offset) {
+		n = offset - state->total_out;
+		if (n > (int64_t)state->out_block_size)
+			n = state->out_block_size;
+		bytes = xz_decode(self, state->out_block, (size_t)n);
+		if (bytes < 0)
+			return (ARCHIVE_FATAL);
+		if (bytes == 0) {
+			archive_set_error(&self->archive->archive,
+			    ARCHIVE_ERRNO_MISC, "truncated input");
+			return (ARCHIVE_FATAL);
+		}
+	}
+	return (offset);
+}
+
+/*
+ * Skip forward by seeking when the target is in a later Block;
+ * within the current Block it is cheaper to keep decoding.
+ */
+static int64_t
+xz_filter_skip(struct archive_read_filter *self, int64_t request)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	lzma_index_iter iter;
+	int64_t target;
+
+	target = state->total_out + request;
+	lzma_index_iter_init(&iter, state->index);
+	if (lzma_index_iter_locate(&iter, target) ||
+	    (int64_t)iter.block.uncompressed_file_offset <= state->total_out)
+		return (0);
+	if (xz_filter_seek(self, target, SEEK_SET) < 0)
+		return (ARCHIVE_FATAL);
+	return (request);
+}
+
+#endif /* XZ_SEEK */
+
 #else
 
 /*
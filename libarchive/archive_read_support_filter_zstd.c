@@ -52,6 +52,20 @@ __FBSDID("$FreeBSD$");
 #include "archive_endian.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_string.h"
+#include "archive_zstd_dict_private.h"
+
+/* Options set on the bidder, used by every zstd filter it creates. */
+struct zstd_options {
+	struct archive		 *archive;
+	int			  window_log_max; /* 0 = library default. */
+#ifdef HAVE_ZSTD_DICT
+	struct archive_zstd_dict **dicts;
+	size_t			  ndicts;
+#elif !(HAVE_ZSTD_H && HAVE_LIBZSTD)
+	struct archive_string	  dict_path; /* For "zstd -D". */
+#endif
+};
 
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 
@@ -66,6 +80,8 @@ struct private_data {
 
 /* Zstd Filter. */
 static ssize_t	zstd_filter_read(struct archive_read_filter *, const void**);
+static ssize_t	zstd_filter_read_into(struct archive_read_filter *, void *,
+		    size_t);
 static int	zstd_filter_close(struct archive_read_filter *);
 #endif
 
@@ -78,25 +94,38 @@ static int	zstd_filter_close(struct archive_read_filter *);
 static int	zstd_bidder_bid(struct archive_read_filter_bidder *,
 		    struct archive_read_filter *);
 static int	zstd_bidder_init(struct archive_read_filter *);
+static int	zstd_bidder_options(struct archive_read_filter_bidder *,
+		    const char *, const char *);
+static int	zstd_bidder_free(struct archive_read_filter_bidder *);
 
 int
 archive_read_support_filter_zstd(struct archive *_a)
 {
 	struct archive_read *a = (struct archive_read *)_a;
 	struct archive_read_filter_bidder *bidder;
+	struct zstd_options *options;
 
 	archive_check_magic(_a, ARCHIVE_READ_MAGIC,
 	    ARCHIVE_STATE_NEW, "archive_read_support_filter_zstd");
 
-	if (__archive_read_get_bidder(a, &bidder) != ARCHIVE_OK)
+	options = (struct zstd_options *)calloc(1, sizeof(*options));
+	if (options == NULL) {
+		archive_set_error(_a, ENOMEM, "Can't allocate zstd options");
 		return (ARCHIVE_FATAL);
+	}
+	options->archive = _a;
 
-	bidder->data = NULL;
+	if (__archive_read_get_bidder(a, &bidder) != ARCHIVE_OK) {
+		free(options);
+		return (ARCHIVE_FATAL);
+	}
+
+	bidder->data = options;
 	bidder->name = "zstd";
 	bidder->bid = zstd_bidder_bid;
 	bidder->init = zstd_bidder_init;
-	bidder->options = NULL;
-	bidder->free = NULL;
+	bidder->options = zstd_bidder_options;
+	bidder->free = zstd_bidder_free;
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 	return (ARCHIVE_OK);
 #else
@@ -106,6 +135,153 @@ archive_read_support_filter_zstd(struct archive *_a)
 #endif
 }
 
+static struct zstd_options *
+zstd_find_options(struct archive_read *a)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(a->bidders)/sizeof(a->bidders[0]); i++)
+		if (a->bidders[i].bid == zstd_bidder_bid)
+			return ((struct zstd_options *)a->bidders[i].data);
+	return (NULL);
+}
+
+#ifdef HAVE_ZSTD_DICT
+static int
+zstd_options_add_dict(struct zstd_options *options,
+    struct archive_zstd_dict *dict)
+{
+	struct archive_zstd_dict **dicts;
+
+	if (dict == NULL)
+		return (ARCHIVE_FATAL);
+	dicts = (struct archive_zstd_dict **)realloc(options->dicts,
+	    (options->ndicts + 1) * sizeof(*dicts));
+	if (dicts == NULL) {
+		__archive_zstd_dict_release(dict);
+		archive_set_error(options->archive, ENOMEM,
+		    "Can't allocate zstd dictionary");
+		return (ARCHIVE_FATAL);
+	}
+	dicts[options->ndicts++] = dict;
+	options->dicts = dicts;
+	return (ARCHIVE_OK);
+}
+
+static void
+zstd_options_clear_dicts(struct zstd_options *options)
+{
+	while (options->ndicts > 0)
+		__archive_zstd_dict_release(options->dicts[--options->ndicts]);
+	free(options->dicts);
+	options->dicts = NULL;
+}
+#endif
+
+/*
+ * Make a zstd dictionary available for reading.  Frames name the
+ * dictionary they need by its ID, so any number can be added.
+ */
+int
+archive_read_add_zstd_dictionary(struct archive *_a, const void *dict,
+    size_t size)
+{
+	struct zstd_options *options;
+
+	archive_check_magic(_a, ARCHIVE_READ_MAGIC,
+	    ARCHIVE_STATE_NEW | ARCHIVE_STATE_HEADER | ARCHIVE_STATE_DATA,
+	    "archive_read_add_zstd_dictionary");
+
+	options = zstd_find_options((struct archive_read *)_a);
+	if (options == NULL) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "zstd support is not enabled");
+		return (ARCHIVE_FATAL);
+	}
+#ifdef HAVE_ZSTD_DICT
+	return (zstd_options_add_dict(options,
+	    __archive_zstd_dict_add(_a, dict, size)));
+#else
+	(void)dict; /* UNUSED */
+	(void)size; /* UNUSED */
+	archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+	    "zstd dictionaries are not supported by this build");
+	return (ARCHIVE_FATAL);
+#endif
+}
+
+static int
+zstd_bidder_options(struct archive_read_filter_bidder *self,
+    const char *key, const char *value)
+{
+	struct zstd_options *options = (struct zstd_options *)self->data;
+
+	if (strcmp(key, "dictionary") == 0) {
+#ifdef HAVE_ZSTD_DICT
+		if (value == NULL) {
+			zstd_options_clear_dicts(options);
+			return (ARCHIVE_OK);
+		}
+		return (zstd_options_add_dict(options,
+		    __archive_zstd_dict_load(options->archive, value)));
+#elif HAVE_ZSTD_H && HAVE_LIBZSTD
+		archive_set_error(options->archive, ARCHIVE_ERRNO_MISC,
+		    "zstd dictionaries need libzstd 1.4.0 or later");
+		return (ARCHIVE_FATAL);
+#else
+		/* The zstd program takes a single dictionary. */
+		if (value == NULL)
+			archive_string_empty(&options->dict_path);
+		else
+			archive_strcpy(&options->dict_path, value);
+		return (ARCHIVE_OK);
+#endif
+	}
+	if (strcmp(key, "max-window") == 0) {
+		int log;
+
+		if (value == NULL) {
+			options->window_log_max = 0;
+			return (ARCHIVE_OK);
+		}
+		log = __archive_zstd_window_log(value);
+		if (log < 0) {
+			archive_set_error(options->archive,
+			    ARCHIVE_ERRNO_MISC,
+			    "Invalid zstd window size: %s", value);
+			return (ARCHIVE_FATAL);
+		}
+#if HAVE_ZSTD_H && HAVE_LIBZSTD && !defined(HAVE_ZSTD_DICT)
+		archive_set_error(options->archive, ARCHIVE_ERRNO_MISC,
+		    "Limiting the zstd window needs libzstd 1.4.0 or later");
+		return (ARCHIVE_FATAL);
+#else
+		options->window_log_max = log;
+		return (ARCHIVE_OK);
+#endif
+	}
+
+	/* Note: The "warn" return is just to inform the options
+	 * supervisor that we didn't handle it.  It will generate
+	 * a suitable error if no one used this option. */
+	return (ARCHIVE_WARN);
+}
+
+static int
+zstd_bidder_free(struct archive_read_filter_bidder *self)
+{
+	struct zstd_options *options = (struct zstd_options *)self->data;
+
+#ifdef HAVE_ZSTD_DICT
+	zstd_options_clear_dicts(options);
+#elif !(HAVE_ZSTD_H && HAVE_LIBZSTD)
+	archive_string_free(&options->dict_path);
+#endif
+	free(options);
+	self->data = NULL;
+	return (ARCHIVE_OK);
+}
+
 /*
  * Test whether we can handle this data.
  */
@@ -147,9 +323,21 @@ zstd_bidder_bid(struct archive_read_filter_bidder *self,
 static int
 zstd_bidder_init(struct archive_read_filter *self)
 {
+	struct zstd_options *options =
+	    (struct zstd_options *)self->bidder->data;
+	struct archive_string cmd;
 	int r;
 
-	r = __archive_read_program(self, "zstd -d -qq");
+	archive_string_init(&cmd);
+	archive_strcpy(&cmd, "zstd -d -qq");
+	if (archive_strlen(&options->dict_path) > 0)
+		archive_string_sprintf(&cmd, " -D \"%s\"",
+		    options->dict_path.s);
+	if (options->window_log_max > 0)
+		archive_string_sprintf(&cmd, " --memory=%u",
+		    1U << options->window_log_max);
+	r = __archive_read_program(self, cmd.s);
+	archive_string_free(&cmd);
 	/* Note: We set the format here even if __archive_read_program()
 	 * above fails.  We do, after all, know what the format is
 	 * even if we weren't able to read it. */
@@ -166,6 +354,8 @@ zstd_bidder_init(struct archive_read_filter *self)
 static int
 zstd_bidder_init(struct archive_read_filter *self)
 {
+	struct zstd_options *options =
+	    (struct zstd_options *)self->bidder->data;
 	struct private_data *state;
 	const size_t out_block_size = ZSTD_DStreamOutSize();
 	void *out_block;
@@ -187,12 +377,30 @@ zstd_bidder_init(struct archive_read_filter *self)
 		return (ARCHIVE_FATAL);
 	}
 
+#ifdef HAVE_ZSTD_DICT
+	if (options->window_log_max > 0) {
+		const size_t ret = ZSTD_DCtx_setParameter(dstream,
+		    ZSTD_d_windowLogMax, options->window_log_max);
+		if (ZSTD_isError(ret)) {
+			free(out_block);
+			free(state);
+			ZSTD_freeDStream(dstream);
+			archive_set_error(&self->archive->archive,
+			    ARCHIVE_ERRNO_MISC,
+			    "Can't limit the zstd window: %s",
+			    ZSTD_getErrorName(ret));
+			return (ARCHIVE_FATAL);
+		}
+	}
+#endif
+
 	self->data = state;
 
 	state->out_block_size = out_block_size;
 	state->out_block = out_block;
 	state->dstream = dstream;
 	self->read = zstd_filter_read;
+	self->read_into = zstd_filter_read_into;
 	self->skip = NULL; /* not supported */
 	self->close = zstd_filter_close;
 
@@ -202,8 +410,64 @@ zstd_bidder_init(struct archive_read_filter *self)
 	return (ARCHIVE_OK);
 }
 
+#ifdef HAVE_ZSTD_DICT
+/*
+ * Reference the dictionary that the next frame's header asks for.
+ * ZSTD_initDStream() drops the previous one, so this runs per frame.
+ */
+static int
+zstd_ref_dict(struct archive_read_filter *self)
+{
+	struct private_data *state = (struct private_data *)self->data;
+	struct zstd_options *options =
+	    (struct zstd_options *)self->bidder->data;
+	const ZSTD_DDict *ddict;
+	const void *p;
+	ssize_t avail;
+	size_t i, ret;
+	unsigned id;
+
+	/* The largest frame header is 18 bytes. */
+	p = __archive_read_filter_ahead(self->upstream, 18, &avail);
+	if (p == NULL)
+		p = __archive_read_filter_ahead(self->upstream, 1, &avail);
+	if (p == NULL)
+		return (ARCHIVE_OK); /* Reported by the caller. */
+	id = ZSTD_getDictID_fromFrame(p, avail);
+	if (id == 0)
+		return (ARCHIVE_OK);
+
+	for (i = 0; i < options->ndicts; i++)
+		if (__archive_zstd_dict_id(options->dicts[i]) == id)
+			break;
+	if (i == options->ndicts) {
+		archive_set_error(&self->archive->archive,
+		    ARCHIVE_ERRNO_MISC,
+		    "zstd data needs dictionary %u", id);
+		return (ARCHIVE_FATAL);
+	}
+	ddict = __archive_zstd_dict_ddict(&self->archive->archive,
+	    options->dicts[i]);
+	if (ddict == NULL)
+		return (ARCHIVE_FATAL);
+	ret = ZSTD_DCtx_refDDict(state->dstream, ddict);
+	if (ZSTD_isError(ret)) {
+		archive_set_error(&self->archive->archive,
+		    ARCHIVE_ERRNO_MISC,
+		    "Can't use zstd dictionary %u: %s", id,
+		    ZSTD_getErrorName(ret));
+		return (ARCHIVE_FATAL);
+	}
+	return (ARCHIVE_OK);
+}
+#endif
+
+/*
+ * Decompress up to size bytes into buff.  Returns the number of bytes
+ * produced, 0 at end of input.
+ */
 static ssize_t
-zstd_filter_read(struct archive_read_filter *self, const void **p)
+zstd_decode(struct archive_read_filter *self, void *buff, size_t size)
 {
 	struct private_data *state;
 	size_t decompressed;
@@ -213,7 +477,7 @@ zstd_filter_read(struct archive_read_filter *self, const void **p)
 
 	state = (struct private_data *)self->data;
 
-	out = (ZSTD_outBuffer) { state->out_block, state->out_block_size, 0 };
+	out = (ZSTD_outBuffer) { buff, size, 0 };
 
 	/* Try to fill the output buffer. */
 	while (out.pos < out.size && !state->eof) {
@@ -226,6 +490,10 @@ zstd_filter_read(struct archive_read_filter *self, const void **p)
 				    ZSTD_getErrorName(ret));
 				return (ARCHIVE_FATAL);
 			}
+#ifdef HAVE_ZSTD_DICT
+			if (zstd_ref_dict(self) != ARCHIVE_OK)
+				return (ARCHIVE_FATAL);
+#endif
 		}
 		in.src = __archive_read_filter_ahead(self->upstream, 1,
 		    &avail_in);
@@ -269,13 +537,36 @@ zstd_filter_read(struct archive_read_filter *self, const void **p)
 
 	decompressed = out.pos;
 	state->total_out += decompressed;
-	if (decompressed == 0)
+	return (decompressed);
+}
+
+static ssize_t
+zstd_filter_read(struct archive_read_filter *self, const void **p)
+{
+	struct private_data *state;
+	ssize_t decompressed;
+
+	state = (struct private_data *)self->data;
+
+	decompressed = zstd_decode(self, state->out_block,
+	    state->out_block_size);
+	if (decompressed <= 0)
 		*p = NULL;
 	else
 		*p = state->out_block;
 	return (decompressed);
 }
 
+/*
+ * Same as zstd_filter_read(), but into a buffer the caller owns.
+ */
+static ssize_t
+zstd_filter_read_into(struct archive_read_filter *self, void *buff,
+    size_t size)
+{
+	return (zstd_decode(self, buff, size));
+}
+
 /*
  * Clean up the decompressor.
  */
@@ -180,29 +180,31 @@ struct _7z_header_info {
 	unsigned char		*attrBools;
 };
 
+/*
+ * One of these is kept for every file in the archive for as long as
+ * the archive is open, so keep it small: names stay UTF-16LE in the
+ * shared entry_names blob and are converted when the entry is
+ * returned, and times are kept as raw FILETIME values.
+ */
 struct _7zip_entry {
-	size_t			 name_len;
 	unsigned char		*utf16name;
 #if defined(_WIN32) && !defined(__CYGWIN__) && defined(_DEBUG)
 	const wchar_t		*wname;
 #endif
+	uint64_t		 mtime;
+	uint64_t		 atime;
+	uint64_t		 ctime;
+	uint32_t		 name_len;
 	uint32_t		 folderIndex;
 	uint32_t		 ssIndex;
+	/* Holds the raw attributes until read_Header() is done. */
+	uint32_t		 mode;
 	unsigned		 flg;
 #define MTIME_IS_SET	(1<<0)
 #define ATIME_IS_SET	(1<<1)
 #define CTIME_IS_SET	(1<<2)
 #define CRC32_IS_SET	(1<<3)
 #define HAS_STREAM	(1<<4)
-
-	time_t			 mtime;
-	time_t			 atime;
-	time_t			 ctime;
-	long			 mtime_ns;
-	long			 atime_ns;
-	long			 ctime_ns;
-	uint32_t		 mode;
-	uint32_t		 attr;
 };
 
 struct _7zip {
@@ -615,6 +617,8 @@ archive_read_format_7zip_read_header(struct archive_read *a,
 	int r, ret = ARCHIVE_OK;
 	struct _7z_folder *folder = 0;
 	uint64_t fidx = 0;
+	time_t t;
+	long ns;
 
 	/*
 	 * It should be sufficient to call archive_read_next_header() for
@@ -706,15 +710,18 @@ archive_read_format_7zip_read_header(struct archive_read *a,
 
 	/* Populate some additional entry fields: */
 	archive_entry_set_mode(entry, zip_entry->mode);
-	if (zip_entry->flg & MTIME_IS_SET)
-		archive_entry_set_mtime(entry, zip_entry->mtime,
-			zip_entry->mtime_ns);
-	if (zip_entry->flg & CTIME_IS_SET)
-		archive_entry_set_ctime(entry, zip_entry->ctime,
-		    zip_entry->ctime_ns);
-	if (zip_entry->flg & ATIME_IS_SET)
-		archive_entry_set_atime(entry, zip_entry->atime,
-		    zip_entry->atime_ns);
+	if (zip_entry->flg & MTIME_IS_SET) {
+		fileTimeToUtc(zip_entry->mtime, &t, &ns);
+		archive_entry_set_mtime(entry, t, ns);
+	}
+	if (zip_entry->flg & CTIME_IS_SET) {
+		fileTimeToUtc(zip_entry->ctime, &t, &ns);
+		archive_entry_set_ctime(entry, t, ns);
+	}
+	if (zip_entry->flg & ATIME_IS_SET) {
+		fileTimeToUtc(zip_entry->atime, &t, &ns);
+		archive_entry_set_atime(entry, t, ns);
+	}
 	if (zip_entry->ssIndex != (uint32_t)-1) {
 		zip->entry_bytes_remaining =
 		    zip->si.ss.unpackSizes[zip_entry->ssIndex];
@@ -2528,7 +2535,11 @@ read_Header(struct archive_read *a, struct _7z_header_info *h,
 				}
 				if (nl < 2)
 					return (-1);/* Terminator not found */
-				entries[i].name_len = np - entries[i].utf16name;
+				if ((size_t)(np - entries[i].utf16name)
+				    > UINT32_MAX - 2)
+					return (-1);
+				entries[i].name_len =
+				    (uint32_t)(np - entries[i].utf16name);
 				np += 2;
 				nl -= 2;
 			}
@@ -2558,7 +2569,7 @@ read_Header(struct archive_read *a, struct _7z_header_info *h,
 				if (h->attrBools[i]) {
 					if ((p = header_bytes(a, 4)) == NULL)
 						return (-1);
-					entries[i].attr = archive_le32dec(p);
+					entries[i].mode = archive_le32dec(p);
 				}
 			}
 			break;
@@ -2581,10 +2592,12 @@ read_Header(struct archive_read *a, struct _7z_header_info *h,
 	eindex = sindex = 0;
 	folderIndex = indexInFolder = 0;
 	for (i = 0; i < zip->numFiles; i++) {
+		uint32_t attr = entries[i].mode;
+
 		if (h->emptyStreamBools == NULL || h->emptyStreamBools[i] == 0)
 			entries[i].flg |= HAS_STREAM;
 		/* The high 16 bits of attributes is a posix file mode. */
-		entries[i].mode = entries[i].attr >> 16;
+		entries[i].mode = attr >> 16;
 		if (entries[i].flg & HAS_STREAM) {
 			if ((size_t)sindex >= si->ss.unpack_streams)
 				return (-1);
@@ -2625,7 +2638,7 @@ read_Header(struct archive_read *a, struct _7z_header_info *h,
 			}
 			entries[i].ssIndex = -1;
 		}
-		if (entries[i].attr & 0x01)
+		if (attr & 0x01)
 			entries[i].mode &= ~0222;/* Read only. */
 
 		if ((entries[i].flg & HAS_STREAM) == 0 && indexInFolder == 0) {
@@ -2681,67 +2694,71 @@ read_Times(struct archive_read *a, struct _7z_header_info *h, int type)
 	struct _7zip *zip = (struct _7zip *)a->format->data;
 	const unsigned char *p;
 	struct _7zip_entry *entries = zip->entries;
-	unsigned char *timeBools;
+	unsigned flag, mask = 0, avail = 0;
 	int allAreDefined;
 	unsigned i;
 
-	timeBools = calloc((size_t)zip->numFiles, sizeof(*timeBools));
-	if (timeBools == NULL)
-		return (-1);
+	switch (type) {
+	case kCTime: flag = CTIME_IS_SET; break;
+	case kATime: flag = ATIME_IS_SET; break;
+	default: flag = MTIME_IS_SET; break;
+	}
 
-	/* Read allAreDefined. */
+	/*
+	 * Read allAreDefined.  The defined bits are recorded straight
+	 * into each entry's flags rather than a temporary array.
+	 */
 	if ((p = header_bytes(a, 1)) == NULL)
-		goto failed;
+		return (-1);
 	allAreDefined = *p;
-	if (allAreDefined)
-		memset(timeBools, 1, (size_t)zip->numFiles);
-	else {
-		if (read_Bools(a, timeBools, (size_t)zip->numFiles) < 0)
-			goto failed;
+	for (i = 0; i < zip->numFiles; i++) {
+		if (allAreDefined) {
+			entries[i].flg |= flag;
+			continue;
+		}
+		if (mask == 0) {
+			if ((p = header_bytes(a, 1)) == NULL)
+				return (-1);
+			avail = *p;
+			mask = 0x80;
+		}
+		if (avail & mask)
+			entries[i].flg |= flag;
+		else
+			entries[i].flg &= ~flag;
+		mask >>= 1;
 	}
 
 	/* Read external. */
 	if ((p = header_bytes(a, 1)) == NULL)
-		goto failed;
+		return (-1);
 	if (*p) {
 		if (parse_7zip_uint64(a, &(h->dataIndex)) < 0)
-			goto failed;
+			return (-1);
 		if (UMAX_ENTRY < h->dataIndex)
-			goto failed;
+			return (-1);
 	}
 
+	/* Times are converted when the entry is returned. */
 	for (i = 0; i < zip->numFiles; i++) {
-		if (!timeBools[i])
+		if ((entries[i].flg & flag) == 0)
 			continue;
 		if ((p = header_bytes(a, 8)) == NULL)
-			goto failed;
+			return (-1);
 		switch (type) {
 		case kCTime:
-			fileTimeToUtc(archive_le64dec(p),
-			    &(entries[i].ctime),
-			    &(entries[i].ctime_ns));
-			entries[i].flg |= CTIME_IS_SET;
+			entries[i].ctime = archive_le64dec(p);
 			break;
 		case kATime:
-			fileTimeToUtc(archive_le64dec(p),
-			    &(entries[i].atime),
-			    &(entries[i].atime_ns));
-			entries[i].flg |= ATIME_IS_SET;
+			entries[i].atime = archive_le64dec(p);
 			break;
 		case kMTime:
-			fileTimeToUtc(archive_le64dec(p),
-			    &(entries[i].mtime),
-			    &(entries[i].mtime_ns));
-			entries[i].flg |= MTIME_IS_SET;
+			entries[i].mtime = archive_le64dec(p);
 			break;
 		}
 	}
 
-	free(timeBools);
 	return (0);
-failed:
-	free(timeBools);
-	return (-1);
 }
 
 static int
@@ -61,6 +61,18 @@ struct ar {
 	char	*strtab;
 	size_t	 strtab_size;
 	char	 read_global_header;
+	/*
+	 * Members asked for with the "member" option.  When set,
+	 * only these are returned, and the archive ends as soon as
+	 * the last of them has been returned so that a client after
+	 * one member doesn't walk the rest of the file.
+	 */
+	struct ar_member {
+		char	*name;
+		char	 found;
+	}	*members;
+	size_t	 members_count;
+	size_t	 members_left;
 };
 
 /*
@@ -83,6 +95,8 @@ struct ar {
 
 static int	archive_read_format_ar_bid(struct archive_read *a, int);
 static int	archive_read_format_ar_cleanup(struct archive_read *a);
+static int	archive_read_format_ar_options(struct archive_read *a,
+		    const char *key, const char *val);
 static int	archive_read_format_ar_read_data(struct archive_read *a,
 		    const void **buff, size_t *size, int64_t *offset);
 static int	archive_read_format_ar_skip(struct archive_read *a);
@@ -116,7 +130,7 @@ archive_read_support_format_ar(struct archive *_a)
 	    ar,
 	    "ar",
 	    archive_read_format_ar_bid,
-	    NULL,
+	    archive_read_format_ar_options,
 	    archive_read_format_ar_read_header,
 	    archive_read_format_ar_read_data,
 	    archive_read_format_ar_skip,
@@ -132,6 +146,19 @@ archive_read_support_format_ar(struct archive *_a)
 	return (ARCHIVE_OK);
 }
 
+static void
+ar_free_members(struct ar *ar)
+{
+	size_t i;
+
+	for (i = 0; i < ar->members_count; i++)
+		free(ar->members[i].name);
+	free(ar->members);
+	ar->members = NULL;
+	ar->members_count = 0;
+	ar->members_left = 0;
+}
+
 static int
 archive_read_format_ar_cleanup(struct archive_read *a)
 {
@@ -139,11 +166,79 @@ archive_read_format_ar_cleanup(struct archive_read *a)
 
 	ar = (struct ar *)(a->format->data);
 	free(ar->strtab);
+	ar_free_members(ar);
 	free(ar);
 	(a->format->data) = NULL;
 	return (ARCHIVE_OK);
 }
 
+static int
+archive_read_format_ar_options(struct archive_read *a,
+    const char *key, const char *val)
+{
+	struct ar *ar;
+	struct ar_member *m;
+
+	ar = (struct ar *)(a->format->data);
+	if (strcmp(key, "member") == 0) {
+		if (val == NULL) {
+			/* "!member" forgets the names given so far. */
+			ar_free_members(ar);
+			return (ARCHIVE_OK);
+		}
+		if (val[0] == '\0') {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "ar: member option needs a member name");
+			return (ARCHIVE_FAILED);
+		}
+		m = realloc(ar->members,
+		    (ar->members_count + 1) * sizeof(*m));
+		if (m == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate ar member list");
+			return (ARCHIVE_FATAL);
+		}
+		ar->members = m;
+		m += ar->members_count;
+		if ((m->name = strdup(val)) == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate ar member list");
+			return (ARCHIVE_FATAL);
+		}
+		m->found = 0;
+		ar->members_count++;
+		ar->members_left++;
+		return (ARCHIVE_OK);
+	}
+
+	/* Note: The "warn" return is just to inform the options
+	 * supervisor that we didn't handle it.  It will generate
+	 * a suitable error if no one used this option. */
+	return (ARCHIVE_WARN);
+}
+
+/*
+ * Returns 1 if the entry was asked for with the "member" option and
+ * hasn't been returned yet, marking it as returned.
+ */
+static int
+ar_want_member(struct ar *ar, const char *name)
+{
+	size_t i;
+
+	if (name == NULL)
+		return (0);
+	for (i = 0; i < ar->members_count; i++) {
+		if (!ar->members[i].found &&
+		    strcmp(ar->members[i].name, name) == 0) {
+			ar->members[i].found = 1;
+			ar->members_left--;
+			return (1);
+		}
+	}
+	return (0);
+}
+
 static int
 archive_read_format_ar_bid(struct archive_read *a, int best_bid)
 {
@@ -436,19 +531,38 @@ archive_read_format_ar_read_header(struct archive_read *a,
 		a->archive.archive_format = ARCHIVE_FORMAT_AR;
 	}
 
-	/* Read the header for the next file entry. */
-	if ((header_data = __archive_read_ahead(a, 60, NULL)) == NULL)
-		/* Broken header. */
-		return (ARCHIVE_EOF);
-	
-	unconsumed = 60;
-	
-	ret = _ar_read_header(a, entry, ar, (const char *)header_data, &unconsumed);
+	for (;;) {
+		/* All the requested members have been returned. */
+		if (ar->members_count > 0 && ar->members_left == 0)
+			return (ARCHIVE_EOF);
+
+		/* Read the header for the next file entry. */
+		if ((header_data = __archive_read_ahead(a, 60, NULL)) == NULL)
+			/* Broken header. */
+			return (ARCHIVE_EOF);
+
+		unconsumed = 60;
+
+		ret = _ar_read_header(a, entry, ar, (const char *)header_data,
+		    &unconsumed);
 
-	if (unconsumed)
-		__archive_read_consume(a, unconsumed);
+		if (unconsumed)
+			__archive_read_consume(a, unconsumed);
 
-	return ret;
+		if (ret != ARCHIVE_OK || ar->members_count == 0 ||
+		    ar_want_member(ar, archive_entry_pathname(entry)))
+			return (ret);
+
+		/*
+		 * Not one of the requested members; step over its
+		 * body.  This is a seek when the client provides a
+		 * skip callback, so symbol tables and large members
+		 * cost no more than their headers.
+		 */
+		if (archive_read_format_ar_skip(a) != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
+		archive_entry_clear(entry);
+	}
 }
 
 
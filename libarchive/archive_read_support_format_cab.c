@@ -37,9 +37,16 @@
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #ifdef HAVE_ZLIB_H
 #include <zlib.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#define	CAB_THREADS	1
+#endif
 
 #include "archive.h"
 #include "archive_entry.h"
@@ -47,6 +54,7 @@
 #include "archive_private.h"
 #include "archive_read_private.h"
 #include "archive_endian.h"
+#include "archive_time_private.h"
 
 
 struct lzx_dec {
@@ -223,6 +231,9 @@ struct cffolder {
 	int			 cfdata_index;
 	/* Flags to mark progress of decompression. */
 	char			 decompress_init;
+	/* Job decompressing the whole folder, or NULL if the folder
+	 * is streamed. */
+	struct cab_job		*job;
 };
 
 struct cffile {
@@ -263,6 +274,52 @@ struct cfheader {
 	int			 file_index;
 };
 
+#ifdef CAB_THREADS
+/*
+ * With the "threads" option, folders are decompressed on worker
+ * threads.  Folders are independent streams, so a job gets a copy of
+ * all the CFDATA of one folder and decompresses the whole folder;
+ * entries are then returned straight from the job's output.  A folder
+ * that would decompress to more than CAB_JOB_MAX_OUT is streamed on
+ * the calling thread as usual.
+ */
+#define	CAB_JOB_MAX_OUT		(16 * 1024 * 1024)
+
+struct cab_job {
+	int			 folder;	/* Index in folder_array. */
+	uint16_t		 comptype;
+	uint16_t		 compdata;
+	uint16_t		 cfdata_count;
+	int			 cfdata_hdr;	/* CFDATA header size. */
+	unsigned char		*in;		/* CFDATA as in the file. */
+	size_t			 in_size;
+	size_t			 in_alloc;
+	unsigned char		*out;
+	size_t			 out_size;
+	size_t			 out_alloc;
+	char			 failed;
+	char			 done;
+	char			 error[96];
+};
+
+struct cab_pool {
+	pthread_mutex_t		 lock;
+	pthread_cond_t		 wake;	/* Workers: job queued or shutdown. */
+	pthread_cond_t		 done;	/* Reader: a job finished. */
+	pthread_t		*threads;
+	int			 nthreads;
+	char			 shutdown;
+	char			 broken; /* Stream position is unknown. */
+	struct cab_job		*jobs;
+	unsigned		 njobs;
+	/* Job counters; job n is in slot n % njobs. */
+	uint64_t		 head;	/* Oldest job not yet released. */
+	uint64_t		 next;	/* Next job for a worker. */
+	uint64_t		 tail;	/* Next job to queue. */
+	int			 next_folder; /* Next folder to queue. */
+};
+#endif
+
 struct cab {
 	/* entry_bytes_remaining is the number of bytes we expect.	    */
 	int64_t			 entry_offset;
@@ -301,6 +358,14 @@ struct cab {
 	char			 stream_valid;
 #endif
 	struct lzx_stream	 xstrm;
+
+	/* Local time offsets for MS-DOS timestamps. */
+	struct archive_tz_cache	 tz_cache;
+
+	int			 threads;
+#ifdef CAB_THREADS
+	struct cab_pool		*pool;
+#endif
 };
 
 static int	archive_read_format_cab_bid(struct archive_read *, int);
@@ -314,7 +379,7 @@ static int	archive_read_format_cab_read_data_skip(struct archive_read *);
 static int	archive_read_format_cab_cleanup(struct archive_read *);
 
 static int	cab_skip_sfx(struct archive_read *);
-static time_t	cab_dos_time(const unsigned char *);
+static time_t	cab_dos_time(struct cab *, const unsigned char *);
 static int	cab_read_data(struct archive_read *, const void **,
 		    size_t *, int64_t *);
 static int	cab_read_header(struct archive_read *);
@@ -344,6 +409,14 @@ static int	lzx_huffman_init(struct huffman *, size_t, int);
 static void	lzx_huffman_free(struct huffman *);
 static int	lzx_make_huffman_table(struct huffman *);
 static inline int lzx_decode_huffman(struct huffman *, unsigned);
+#ifdef CAB_THREADS
+static int	cab_pool_start(struct archive_read *);
+static void	cab_pool_release(struct cab *, int);
+static void	cab_pool_fill(struct archive_read *);
+static void	cab_pool_free(struct cab_pool *);
+static int	cab_read_data_job(struct archive_read *, const void **,
+		    size_t *, int64_t *);
+#endif
 
 
 int
@@ -364,6 +437,7 @@ archive_read_support_format_cab(struct archive *_a)
 	}
 	archive_string_init(&cab->ws);
 	archive_wstring_ensure(&cab->ws, 256);
+	cab->threads = 1;
 
 	r = __archive_read_register_format(a,
 	    cab,
@@ -476,6 +550,32 @@ archive_read_format_cab_options(struct archive_read *a,
 		}
 		return (ret);
 	}
+	if (strcmp(key, "threads") == 0) {
+		char *endptr;
+		long threads;
+
+		if (val == NULL)
+			return (ARCHIVE_WARN);
+		errno = 0;
+		threads = strtol(val, &endptr, 10);
+		if (errno != 0 || *endptr != '\0' || threads < 0 ||
+		    threads > 256) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "cab: threads option needs a number from 0 to 256");
+			return (ARCHIVE_FAILED);
+		}
+		if (threads == 0) {
+#if defined(CAB_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+			threads = sysconf(_SC_NPROCESSORS_ONLN);
+			if (threads < 1)
+				threads = 1;
+#else
+			threads = 1;
+#endif
+		}
+		cab->threads = (int)threads;
+		return (ARCHIVE_OK);
+	}
 
 	/* Note: The "warn" return is just to inform the options
 	 * supervisor that we didn't handle it.  It will generate
@@ -795,7 +895,7 @@ cab_read_header(struct archive_read *a)
 		file->uncompressed_size = archive_le32dec(p + CFFILE_cbFile);
 		file->offset = archive_le32dec(p + CFFILE_uoffFolderStart);
 		file->folder = archive_le16dec(p + CFFILE_iFolder);
-		file->mtime = cab_dos_time(p + CFFILE_date_time);
+		file->mtime = cab_dos_time(cab, p + CFFILE_date_time);
 		file->attr = (uint8_t)archive_le16dec(p + CFFILE_attribs);
 		__archive_read_consume(a, 16);
 
@@ -931,8 +1031,19 @@ archive_read_format_cab_read_header(struct archive_read *a,
 	}
 	/* If a cffolder of this file is changed, reset a cfdata to read
 	 * file contents from next cfdata. */
-	if (prev_folder != cab->entry_cffolder)
+	if (prev_folder != cab->entry_cffolder) {
 		cab->entry_cfdata = NULL;
+		/* Bytes skipped in the previous folder don't count here. */
+		cab->bytes_skipped = 0;
+#ifdef CAB_THREADS
+		if (cab->pool != NULL) {
+			/* Free the jobs of the folders we have left. */
+			cab_pool_release(cab,
+			    (int)(cab->entry_cffolder - hd->folder_array));
+			cab_pool_fill(a);
+		}
+#endif
+	}
 
 	/* If a pathname is UTF-8, prepare a string conversion object
 	 * for UTF-8 and use it. */
@@ -1024,6 +1135,22 @@ archive_read_format_cab_read_data(struct archive_read *a,
 	default:
 		break;
 	}
+#ifdef CAB_THREADS
+	if (cab->threads > 1 && cab->entry_cffolder->job == NULL &&
+	    cab->entry_cfdata == NULL && cab->entry_bytes_remaining > 0) {
+		/* Nothing of this folder was read yet; try to hand it
+		 * and the folders after it to the workers. */
+		r = cab_pool_start(a);
+		if (r < ARCHIVE_OK)
+			return (r);
+	}
+	if (cab->entry_cffolder->job != NULL) {
+		/* Any skipped entries were in decompressed folders. */
+		cab->bytes_skipped = 0;
+		cab->read_data_invoked = 1;
+		return (cab_read_data_job(a, buff, size, offset));
+	}
+#endif
 	if (cab->read_data_invoked == 0) {
 		if (cab->bytes_skipped) {
 			if (cab->entry_cfdata == NULL) {
@@ -1062,17 +1189,40 @@ static uint32_t
 cab_checksum_cfdata_4(const void *p, size_t bytes, uint32_t seed)
 {
 	const unsigned char *b;
-	unsigned u32num;
-	uint32_t sum;
+	unsigned char t[8];
+	uint64_t w0, w1, w2, w3, v;
+	size_t n;
 
-	u32num = (unsigned)bytes / 4;
-	sum = seed;
+	/*
+	 * The sum is the XOR of the little-endian 32-bit words.  XOR
+	 * works bytewise, so we can XOR 64-bit words in whatever byte
+	 * order the CPU loads them and fold the result at the end; four
+	 * independent accumulators let the compiler vectorize the loop.
+	 */
 	b = p;
-	for (;u32num > 0; --u32num) {
-		sum ^= archive_le32dec(b);
-		b += 4;
-	}
-	return (sum);
+	w0 = w1 = w2 = w3 = 0;
+	for (n = bytes / 32; n > 0; --n) {
+		memcpy(&v, b, 8);
+		w0 ^= v;
+		memcpy(&v, b + 8, 8);
+		w1 ^= v;
+		memcpy(&v, b + 16, 8);
+		w2 ^= v;
+		memcpy(&v, b + 24, 8);
+		w3 ^= v;
+		b += 32;
+	}
+	w0 ^= w1 ^ w2 ^ w3;
+	for (n = (bytes & 31) / 8; n > 0; --n) {
+		memcpy(&v, b, 8);
+		w0 ^= v;
+		b += 8;
+	}
+	memcpy(t, &w0, 8);
+	seed ^= archive_le32dec(t) ^ archive_le32dec(t + 4);
+	if (bytes & 4)
+		seed ^= archive_le32dec(b);
+	return (seed);
 }
 
 static uint32_t
@@ -1965,6 +2115,14 @@ archive_read_format_cab_read_data_skip(struct archive_read *a)
 	if (cab->end_of_archive)
 		return (ARCHIVE_EOF);
 
+#ifdef CAB_THREADS
+	if (cab->entry_cffolder != NULL && cab->entry_cffolder->job != NULL) {
+		/* The folder is in memory; nothing to consume. */
+		cab->entry_bytes_remaining = 0;
+		cab->end_of_entry_cleanup = cab->end_of_entry = 1;
+		return (ARCHIVE_OK);
+	}
+#endif
 	if (!cab->read_data_invoked) {
 		cab->bytes_skipped += cab->entry_bytes_remaining;
 		cab->entry_bytes_remaining = 0;
@@ -2008,6 +2166,497 @@ archive_read_format_cab_read_data_skip(struct archive_read *a)
 	return (ARCHIVE_OK);
 }
 
+#ifdef CAB_THREADS
+static void
+cab_job_fail(struct cab_job *job, const char *msg)
+{
+	job->failed = 1;
+	snprintf(job->error, sizeof(job->error), "%s", msg);
+}
+
+/*
+ * Verify and decompress every CFDATA of a folder.  This runs on a
+ * worker and must not touch the archive.
+ */
+static void
+cab_job_decode(struct cab_job *job,
+#ifdef HAVE_ZLIB_H
+    z_stream *stream, char *stream_valid,
+#endif
+    struct lzx_stream *xstrm)
+{
+	const unsigned char *p, *d;
+	unsigned char *out;
+	uint32_t sum, calculated;
+	uint16_t csize, usize;
+	int i, r;
+
+	switch (job->comptype) {
+#ifdef HAVE_ZLIB_H
+	case COMPTYPE_MSZIP:
+		if (*stream_valid)
+			r = inflateReset(stream);
+		else
+			r = inflateInit2(stream, -15);
+		if (r != Z_OK) {
+			cab_job_fail(job,
+			    "Can't initialize deflate decompression.");
+			return;
+		}
+		*stream_valid = 1;
+		break;
+#endif
+	case COMPTYPE_LZX:
+		if (lzx_decode_init(xstrm, job->compdata) != ARCHIVE_OK) {
+			cab_job_fail(job,
+			    "Can't initialize LZX decompression.");
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+
+	p = job->in;
+	out = job->out;
+	for (i = 0; i < job->cfdata_count; i++) {
+		sum = archive_le32dec(p + CFDATA_csum);
+		csize = archive_le16dec(p + CFDATA_cbData);
+		usize = archive_le16dec(p + CFDATA_cbUncomp);
+		d = p + job->cfdata_hdr;
+		if (sum != 0) {
+			calculated = cab_checksum_cfdata(d, csize, 0);
+			calculated = cab_checksum_cfdata(p + CFDATA_cbData,
+			    job->cfdata_hdr - CFDATA_cbData, calculated);
+			if (calculated != sum) {
+				job->failed = 1;
+				snprintf(job->error, sizeof(job->error),
+				    "Checksum error CFDATA[%d] %" PRIx32
+				    ":%" PRIx32 " in %d bytes",
+				    i, sum, calculated, csize);
+				return;
+			}
+		}
+
+		switch (job->comptype) {
+		case COMPTYPE_NONE:
+			memcpy(out, d, usize);
+			break;
+#ifdef HAVE_ZLIB_H
+		case COMPTYPE_MSZIP:
+			if (csize < 2 || d[0] != 0x43 || d[1] != 0x4b) {
+				cab_job_fail(job,
+				    "CFDATA incorrect(no MSZIP signature)");
+				return;
+			}
+			if (i > 0) {
+				/* The previous CFDATA is the dictionary. */
+				if (inflateReset(stream) != Z_OK ||
+				    inflateSetDictionary(stream, out - 0x8000,
+				      0x8000) != Z_OK) {
+					cab_job_fail(job,
+					    "Deflate decompression failed");
+					return;
+				}
+			}
+			stream->next_in = (Bytef *)(uintptr_t)(d + 2);
+			stream->avail_in = csize - 2;
+			stream->next_out = out;
+			stream->avail_out = usize;
+			r = inflate(stream, Z_SYNC_FLUSH);
+			if (r != Z_OK && r != Z_STREAM_END) {
+				cab_job_fail(job,
+				    "Deflate decompression failed");
+				return;
+			}
+			if (stream->avail_out != 0) {
+				cab_job_fail(job, "Invalid uncompressed size");
+				return;
+			}
+			break;
+#endif
+		case COMPTYPE_LZX:
+			lzx_cleanup_bitstream(xstrm);
+			xstrm->next_in = d;
+			xstrm->avail_in = csize;
+			xstrm->total_in = 0;
+			xstrm->next_out = out;
+			xstrm->avail_out = usize;
+			xstrm->total_out = 0;
+			while (xstrm->total_out < usize) {
+				int64_t before = xstrm->total_out;
+
+				r = lzx_decode(xstrm, 1);
+				if ((r != ARCHIVE_OK && r != ARCHIVE_EOF) ||
+				    xstrm->total_out == before) {
+					cab_job_fail(job,
+					    "LZX decompression failed");
+					return;
+				}
+			}
+			lzx_translation(xstrm, out, usize, i * 0x8000);
+			break;
+		}
+		p = d + csize;
+		out += usize;
+	}
+}
+
+static void *
+cab_worker(void *arg)
+{
+	struct cab_pool *pool = (struct cab_pool *)arg;
+	struct cab_job *job;
+	struct lzx_stream xstrm;
+#ifdef HAVE_ZLIB_H
+	z_stream stream;
+	char stream_valid = 0;
+
+	memset(&stream, 0, sizeof(stream));
+#endif
+	memset(&xstrm, 0, sizeof(xstrm));
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (!pool->shutdown && pool->next == pool->tail)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (pool->shutdown)
+			break;
+		job = &pool->jobs[pool->next++ % pool->njobs];
+		pthread_mutex_unlock(&pool->lock);
+
+		if (!job->failed)
+			cab_job_decode(job,
+#ifdef HAVE_ZLIB_H
+			    &stream, &stream_valid,
+#endif
+			    &xstrm);
+
+		pthread_mutex_lock(&pool->lock);
+		job->done = 1;
+		pthread_cond_broadcast(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+#ifdef HAVE_ZLIB_H
+	if (stream_valid)
+		inflateEnd(&stream);
+#endif
+	lzx_decode_free(&xstrm);
+	return (NULL);
+}
+
+static void
+cab_pool_free(struct cab_pool *pool)
+{
+	unsigned i;
+	int t;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for (t = 0; t < pool->nthreads; t++)
+		pthread_join(pool->threads[t], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	for (i = 0; i < pool->njobs; i++) {
+		free(pool->jobs[i].in);
+		free(pool->jobs[i].out);
+	}
+	free(pool->jobs);
+	free(pool->threads);
+	free(pool);
+}
+
+static struct cab_pool *
+cab_pool_new(int nthreads)
+{
+	struct cab_pool *pool;
+
+	pool = (struct cab_pool *)calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return (NULL);
+	/* Folders can be large, so only queue one more than the
+	 * workers can run. */
+	pool->njobs = nthreads + 1;
+	pool->jobs = (struct cab_job *)calloc(pool->njobs,
+	    sizeof(*pool->jobs));
+	pool->threads = (pthread_t *)calloc(nthreads,
+	    sizeof(*pool->threads));
+	if (pool->jobs == NULL || pool->threads == NULL) {
+		free(pool->jobs);
+		free(pool->threads);
+		free(pool);
+		return (NULL);
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	for (pool->nthreads = 0; pool->nthreads < nthreads;
+	    pool->nthreads++) {
+		if (pthread_create(&pool->threads[pool->nthreads], NULL,
+		    cab_worker, pool) != 0)
+			break;
+	}
+	if (pool->nthreads == 0) {
+		cab_pool_free(pool);
+		return (NULL);
+	}
+	return (pool);
+}
+
+static int
+cab_job_grow(unsigned char **buff, size_t *alloc, size_t size)
+{
+	unsigned char *p;
+	size_t n;
+
+	if (*alloc >= size)
+		return (0);
+	n = *alloc ? *alloc : 0x10000;
+	while (n < size)
+		n *= 2;
+	p = (unsigned char *)realloc(*buff, n);
+	if (p == NULL)
+		return (-1);
+	*buff = p;
+	*alloc = n;
+	return (0);
+}
+
+/*
+ * Copy all the CFDATA of the next folder into a free job.  Returns
+ * ARCHIVE_OK if it was queued and ARCHIVE_WARN if the folder has to
+ * be streamed instead.  Damaged data is queued as a failed job so the
+ * error is reported when the reader gets to the folder.
+ */
+static int
+cab_pool_queue(struct archive_read *a)
+{
+	struct cab *cab = (struct cab *)(a->format->data);
+	struct cfheader *hd = &cab->cfheader;
+	struct cab_pool *pool = cab->pool;
+	struct cffolder *folder = &hd->folder_array[pool->next_folder];
+	struct cab_job *job;
+	const unsigned char *p;
+	uint16_t csize, usize;
+	int64_t skip;
+	int i, l;
+
+	if (folder->cfdata_count == 0 ||
+	    folder->cfdata_count > CAB_JOB_MAX_OUT / 0x8000)
+		return (ARCHIVE_WARN);
+	switch (folder->comptype) {
+	case COMPTYPE_NONE:
+		break;
+#ifdef HAVE_ZLIB_H
+	case COMPTYPE_MSZIP:
+		break;
+#endif
+	case COMPTYPE_LZX:
+		if (folder->compdata < SLOT_BASE ||
+		    folder->compdata > SLOT_MAX)
+			return (ARCHIVE_WARN);
+		break;
+	default:
+		return (ARCHIVE_WARN);
+	}
+	/* Multivolume folders continue in other files. */
+	if (hd->flags & (PREV_CABINET | NEXT_CABINET))
+		return (ARCHIVE_WARN);
+	skip = (int64_t)folder->cfdata_offset_in_cab - cab->cab_offset;
+	if (skip < 0)
+		return (ARCHIVE_WARN);
+	if (skip > 0) {
+		if (__archive_read_consume(a, skip) < 0)
+			return (ARCHIVE_WARN);
+		cab->cab_offset += skip;
+	}
+
+	job = &pool->jobs[pool->tail % pool->njobs];
+	job->folder = pool->next_folder;
+	job->comptype = folder->comptype;
+	job->compdata = folder->compdata;
+	job->cfdata_count = folder->cfdata_count;
+	job->in_size = 0;
+	job->out_size = 0;
+	job->failed = 0;
+	job->done = 0;
+	l = 8;
+	if (hd->flags & RESERVE_PRESENT)
+		l += hd->cfdata;
+	job->cfdata_hdr = l;
+	for (i = 0; i < folder->cfdata_count; i++) {
+		if ((p = __archive_read_ahead(a, l, NULL)) == NULL) {
+			cab_job_fail(job, "Truncated CAB header");
+			break;
+		}
+		csize = archive_le16dec(p + CFDATA_cbData);
+		usize = archive_le16dec(p + CFDATA_cbUncomp);
+		/* The same checks as cab_next_cfdata(). */
+		if (csize == 0 || csize > (0x8000+6144) ||
+		    usize == 0 || usize > 0x8000 ||
+		    (i + 1 < folder->cfdata_count && usize != 0x8000) ||
+		    (folder->comptype == COMPTYPE_NONE && csize != usize)) {
+			cab_job_fail(job, "Invalid CFDATA");
+			break;
+		}
+		if (cab_job_grow(&job->in, &job->in_alloc,
+		    job->in_size + l + csize) < 0) {
+			cab_job_fail(job, "Can't allocate memory for CAB data");
+			break;
+		}
+		memcpy(job->in + job->in_size, p, l);
+		job->in_size += l;
+		__archive_read_consume(a, l);
+		cab->cab_offset += l;
+		if ((p = __archive_read_ahead(a, csize, NULL)) == NULL) {
+			cab_job_fail(job, "Truncated CAB file data");
+			break;
+		}
+		memcpy(job->in + job->in_size, p, csize);
+		job->in_size += csize;
+		__archive_read_consume(a, csize);
+		cab->cab_offset += csize;
+		job->out_size += usize;
+	}
+	if (!job->failed && cab_job_grow(&job->out, &job->out_alloc,
+	    job->out_size) < 0)
+		cab_job_fail(job, "Can't allocate memory for CAB data");
+	/* After a failure we don't know where the next folder is. */
+	if (job->failed)
+		pool->broken = 1;
+	folder->job = job;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->tail++;
+	pthread_cond_signal(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	return (ARCHIVE_OK);
+}
+
+/* Queue folders in order until the pool is full or a folder has to
+ * be streamed. */
+static void
+cab_pool_fill(struct archive_read *a)
+{
+	struct cab *cab = (struct cab *)(a->format->data);
+	struct cab_pool *pool = cab->pool;
+
+	while (!pool->broken &&
+	    pool->next_folder < cab->cfheader.folder_count &&
+	    pool->tail - pool->head < pool->njobs) {
+		if (cab_pool_queue(a) != ARCHIVE_OK)
+			break;
+		pool->next_folder++;
+	}
+}
+
+/*
+ * Start queuing folders at the folder of the current entry.  Returns
+ * ARCHIVE_OK even if the folder could not be queued; it is then
+ * streamed.
+ */
+static int
+cab_pool_start(struct archive_read *a)
+{
+	struct cab *cab = (struct cab *)(a->format->data);
+	struct cab_pool *pool = cab->pool;
+	int folder;
+
+	switch (cab->entry_cffile->folder) {
+	case iFoldCONTINUED_FROM_PREV:
+	case iFoldCONTINUED_TO_NEXT:
+	case iFoldCONTINUED_PREV_AND_NEXT:
+		return (ARCHIVE_OK);
+	default:
+		break;
+	}
+	if (pool == NULL) {
+		pool = cab_pool_new(cab->threads);
+		if (pool == NULL) {
+			/* Carry on without workers. */
+			cab->threads = 1;
+			return (ARCHIVE_OK);
+		}
+		cab->pool = pool;
+	}
+	folder = (int)(cab->entry_cffolder - cab->cfheader.folder_array);
+	/* Jobs queued earlier are for folders before a streamed one. */
+	if (pool->head != pool->tail)
+		return (ARCHIVE_OK);
+	pool->next_folder = folder;
+	cab_pool_fill(a);
+	return (ARCHIVE_OK);
+}
+
+static void
+cab_job_wait(struct cab_pool *pool, struct cab_job *job)
+{
+	pthread_mutex_lock(&pool->lock);
+	while (!job->done)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* Release the jobs of all folders before the given one. */
+static void
+cab_pool_release(struct cab *cab, int folder)
+{
+	struct cab_pool *pool = cab->pool;
+	struct cab_job *job;
+
+	while (pool->head != pool->tail) {
+		job = &pool->jobs[pool->head % pool->njobs];
+		if (job->folder >= folder)
+			break;
+		/* A worker may still be using it. */
+		cab_job_wait(pool, job);
+		cab->cfheader.folder_array[job->folder].job = NULL;
+		pool->head++;
+	}
+}
+
+/* Return the current entry from its folder's decompressed output. */
+static int
+cab_read_data_job(struct archive_read *a, const void **buff,
+    size_t *size, int64_t *offset)
+{
+	struct cab *cab = (struct cab *)(a->format->data);
+	struct cab_job *job = cab->entry_cffolder->job;
+	struct cffile *file = cab->entry_cffile;
+
+	if (cab->end_of_entry) {
+		*buff = NULL;
+		*size = 0;
+		*offset = cab->entry_offset;
+		return (ARCHIVE_EOF);
+	}
+	cab_job_wait(cab->pool, job);
+	if (job->failed) {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
+		    "%s", job->error);
+		return (ARCHIVE_FATAL);
+	}
+	if ((uint64_t)file->offset + file->uncompressed_size >
+	    job->out_size) {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Invalid CFDATA");
+		return (ARCHIVE_FATAL);
+	}
+	*buff = job->out + file->offset + cab->entry_offset;
+	*size = (size_t)cab->entry_bytes_remaining;
+	*offset = cab->entry_offset;
+	cab->entry_offset += cab->entry_bytes_remaining;
+	cab->entry_bytes_remaining = 0;
+	cab->end_of_entry = 1;
+	return (ARCHIVE_OK);
+}
+#endif /* CAB_THREADS */
+
 static int
 archive_read_format_cab_cleanup(struct archive_read *a)
 {
@@ -2015,6 +2664,10 @@ archive_read_format_cab_cleanup(struct archive_read *a)
 	struct cfheader *hd = &cab->cfheader;
 	int i;
 
+#ifdef CAB_THREADS
+	if (cab->pool != NULL)
+		cab_pool_free(cab->pool);
+#endif
 	if (hd->folder_array != NULL) {
 		for (i = 0; i < hd->folder_count; i++)
 			free(hd->folder_array[i].cfdata.memimage);
@@ -2039,7 +2692,7 @@ archive_read_format_cab_cleanup(struct archive_read *a)
 
 /* Convert an MSDOS-style date/time into Unix-style time. */
 static time_t
-cab_dos_time(const unsigned char *p)
+cab_dos_time(struct cab *cab, const unsigned char *p)
 {
 	int msTime, msDate;
 	struct tm ts;
@@ -2054,8 +2707,7 @@ cab_dos_time(const unsigned char *p)
 	ts.tm_hour = (msTime >> 11) & 0x1f;
 	ts.tm_min = (msTime >> 5) & 0x3f;
 	ts.tm_sec = (msTime << 1) & 0x3e;
-	ts.tm_isdst = -1;
-	return (mktime(&ts));
+	return (__archive_mktime(&cab->tz_cache, &ts));
 }
 
 /*****************************************************************
@@ -43,6 +43,7 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_read_support_format_cpio.c 20116
 #include "archive_entry_locale.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_read_rpm_private.h"
 
 #define	bin_magic_offset 0
 #define	bin_magic_size 2
@@ -187,6 +188,16 @@ struct cpio {
 	int			  init_default_conversion;
 
 	int			  option_pwb;
+
+	/* When the payload comes out of an rpm package, file contents
+	 * are checked against the digests in the rpm header. */
+	struct archive_rpm_digest rpm_digest;
+	/* With the rpm-index option, entries come from the rpm header
+	 * and the payload is never read. */
+	int			  option_rpm_index;
+	int			  rpm_listing;
+	size_t			  rpm_next;
+	struct archive_string	  rpm_path;
 };
 
 static int64_t	atol16(const char *, unsigned);
@@ -216,6 +227,8 @@ static int	header_afiol(struct archive_read *, struct cpio *,
 static int	is_octal(const char *, size_t);
 static int	is_hex(const char *, size_t);
 static int64_t	le4(const unsigned char *);
+static int	read_header_rpm_index(struct archive_read *, struct cpio *,
+		    struct archive_rpm_index *, struct archive_entry *);
 static int	record_hardlink(struct archive_read *a,
 		    struct cpio *cpio, struct archive_entry *entry);
 
@@ -349,6 +362,9 @@ archive_read_format_cpio_options(struct archive_read *a,
 		if (val != NULL && val[0] != 0)
 			cpio->option_pwb = 1;
 		return (ARCHIVE_OK);
+	} else if (strcmp(key, "rpm-index")  == 0) {
+		cpio->option_rpm_index = (val != NULL && val[0] != 0);
+		return (ARCHIVE_OK);
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -364,11 +380,20 @@ archive_read_format_cpio_read_header(struct archive_read *a,
 	struct cpio *cpio;
 	const void *h, *hl;
 	struct archive_string_conv *sconv;
+	struct archive_rpm_index *rpm_index;
+	const struct archive_rpm_file *rpm_file;
 	size_t namelength;
 	size_t name_pad;
 	int r;
 
 	cpio = (struct cpio *)(a->format->data);
+	/* Drop the digest of an entry whose data wasn't all read. */
+	if (cpio->rpm_digest.algo != 0)
+		__archive_rpm_digest_final(&cpio->rpm_digest);
+	rpm_index = __archive_read_rpm_index(a);
+	if (rpm_index != NULL && (cpio->option_rpm_index || cpio->rpm_listing))
+		return (read_header_rpm_index(a, cpio, rpm_index, entry));
+
 	sconv = cpio->opt_sconv;
 	if (sconv == NULL) {
 		if (!cpio->init_default_conversion) {
@@ -452,9 +477,59 @@ archive_read_format_cpio_read_header(struct archive_read *a,
 		return (ARCHIVE_FATAL);
 	}
 
+	/* Hardlinked files carry their data on one of the links only,
+	 * so the size has to match before the digest means anything. */
+	if (rpm_index != NULL && archive_entry_filetype(entry) == AE_IFREG) {
+		rpm_file = __archive_read_rpm_lookup(rpm_index,
+		    archive_entry_pathname(entry));
+		if (rpm_file != NULL &&
+		    rpm_file->size == cpio->entry_bytes_remaining)
+			__archive_rpm_digest_init(&cpio->rpm_digest,
+			    rpm_index, rpm_file);
+	}
+
 	return (r);
 }
 
+/*
+ * Return the next file listed in the rpm header.  Nothing is read
+ * from the payload, so listing a package doesn't decompress it.
+ */
+static int
+read_header_rpm_index(struct archive_read *a, struct cpio *cpio,
+    struct archive_rpm_index *rpm_index, struct archive_entry *entry)
+{
+	const struct archive_rpm_file *f;
+
+	cpio->rpm_listing = 1;
+	a->archive.archive_format = ARCHIVE_FORMAT_CPIO;
+	a->archive.archive_format_name = "cpio (rpm header)";
+	if (cpio->rpm_next >= rpm_index->nfiles)
+		return (ARCHIVE_EOF);
+	f = &rpm_index->files[cpio->rpm_next++];
+
+	/* Name entries the way rpm names them in the payload. */
+	archive_strcpy(&cpio->rpm_path, "./");
+	archive_strcat(&cpio->rpm_path, f->pathname);
+	archive_entry_copy_pathname(entry, cpio->rpm_path.s);
+	archive_entry_set_mode(entry, f->mode);
+	archive_entry_set_mtime(entry, f->mtime, 0);
+	if (f->uname != NULL)
+		archive_entry_copy_uname(entry, f->uname);
+	if (f->gname != NULL)
+		archive_entry_copy_gname(entry, f->gname);
+	if (archive_entry_filetype(entry) == AE_IFREG)
+		archive_entry_set_size(entry, f->size);
+	else if (archive_entry_filetype(entry) == AE_IFLNK &&
+	    f->linkname != NULL)
+		archive_entry_copy_symlink(entry, f->linkname);
+	cpio->entry_bytes_remaining = 0;
+	cpio->entry_bytes_unconsumed = 0;
+	cpio->entry_padding = 0;
+	cpio->entry_offset = 0;
+	return (ARCHIVE_OK);
+}
+
 static int
 archive_read_format_cpio_read_data(struct archive_read *a,
     const void **buff, size_t *size, int64_t *offset)
@@ -464,6 +539,13 @@ archive_read_format_cpio_read_data(struct archive_read *a,
 
 	cpio = (struct cpio *)(a->format->data);
 
+	if (cpio->rpm_listing) {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+		    "File data is not available when listing "
+		    "from the rpm header");
+		return (ARCHIVE_FAILED);
+	}
+
 	if (cpio->entry_bytes_unconsumed) {
 		__archive_read_consume(a, cpio->entry_bytes_unconsumed);
 		cpio->entry_bytes_unconsumed = 0;
@@ -480,6 +562,9 @@ archive_read_format_cpio_read_data(struct archive_read *a,
 		*offset = cpio->entry_offset;
 		cpio->entry_offset += bytes_read;
 		cpio->entry_bytes_remaining -= bytes_read;
+		if (cpio->rpm_digest.algo != 0)
+			__archive_rpm_digest_update(&cpio->rpm_digest,
+			    *buff, bytes_read);
 		return (ARCHIVE_OK);
 	} else {
 		if (cpio->entry_padding !=
@@ -490,6 +575,13 @@ archive_read_format_cpio_read_data(struct archive_read *a,
 		*buff = NULL;
 		*size = 0;
 		*offset = cpio->entry_offset;
+		if (cpio->rpm_digest.algo != 0 &&
+		    __archive_rpm_digest_final(&cpio->rpm_digest)
+		    != ARCHIVE_OK) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "File digest does not match the rpm header");
+			return (ARCHIVE_WARN);
+		}
 		return (ARCHIVE_EOF);
 	}
 }
@@ -501,6 +593,8 @@ archive_read_format_cpio_skip(struct archive_read *a)
 	int64_t to_skip = cpio->entry_bytes_remaining + cpio->entry_padding +
 		cpio->entry_bytes_unconsumed;
 
+	if (cpio->rpm_digest.algo != 0)
+		__archive_rpm_digest_final(&cpio->rpm_digest);
 	if (to_skip != __archive_read_consume(a, to_skip)) {
 		return (ARCHIVE_FATAL);
 	}
@@ -977,6 +1071,9 @@ archive_read_format_cpio_cleanup(struct archive_read *a)
                 free(cpio->links_head);
                 cpio->links_head = lp;
         }
+	if (cpio->rpm_digest.algo != 0)
+		__archive_rpm_digest_final(&cpio->rpm_digest);
+	archive_string_free(&cpio->rpm_path);
 	free(cpio);
 	(a->format->data) = NULL;
 	return (ARCHIVE_OK);
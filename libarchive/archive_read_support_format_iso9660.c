@@ -51,6 +51,7 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_read_support_format_iso9660.c 20
 #include "archive_private.h"
 #include "archive_read_private.h"
 #include "archive_string.h"
+#include "archive_time_private.h"
 
 /*
  * An overview of ISO 9660 format:
@@ -393,7 +394,6 @@ static int	build_pathname_utf16be(unsigned char *, size_t, size_t *,
 #if DEBUG
 static void	dump_isodirrec(FILE *, const unsigned char *isodirrec);
 #endif
-static time_t	time_from_tm(struct tm *);
 static time_t	isodate17(const unsigned char *);
 static time_t	isodate7(const unsigned char *);
 static int	isBootRecord(struct iso9660 *, const unsigned char *);
@@ -3142,7 +3142,7 @@ isodate7(const unsigned char *v)
 		tm.tm_hour -= offset / 4;
 		tm.tm_min -= (offset % 4) * 15;
 	}
-	t = time_from_tm(&tm);
+	t = (time_t)__archive_timegm(&tm);
 	if (t == (time_t)-1)
 		return ((time_t)0);
 	return (t);
@@ -3170,37 +3170,12 @@ isodate17(const unsigned char *v)
 		tm.tm_hour -= offset / 4;
 		tm.tm_min -= (offset % 4) * 15;
 	}
-	t = time_from_tm(&tm);
+	t = (time_t)__archive_timegm(&tm);
 	if (t == (time_t)-1)
 		return ((time_t)0);
 	return (t);
 }
 
-static time_t
-time_from_tm(struct tm *t)
-{
-#if HAVE_TIMEGM
-        /* Use platform timegm() if available. */
-        return (timegm(t));
-#elif HAVE__MKGMTIME64
-        return (_mkgmtime64(t));
-#else
-        /* Else use direct calculation using POSIX assumptions. */
-        /* First, fix up tm_yday based on the year/month/day. */
-        if (mktime(t) == (time_t)-1)
-                return ((time_t)-1);
-        /* Then we can compute timegm() from first principles. */
-        return (t->tm_sec
-            + t->tm_min * 60
-            + t->tm_hour * 3600
-            + t->tm_yday * 86400
-            + (t->tm_year - 70) * 31536000
-            + ((t->tm_year - 69) / 4) * 86400
-            - ((t->tm_year - 1) / 100) * 86400
-            + ((t->tm_year + 299) / 400) * 86400);
-#endif
-}
-
 static const char *
 build_pathname(struct archive_string *as, struct file_info *file, int depth)
 {
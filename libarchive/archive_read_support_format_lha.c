@@ -44,6 +44,7 @@
 #include "archive_private.h"
 #include "archive_read_private.h"
 #include "archive_endian.h"
+#include "archive_time_private.h"
 
 
 #define MAXMATCH		256	/* Maximum match length. */
@@ -200,6 +201,9 @@ struct lha {
 	char			 format_name[64];
 
 	struct lzh_stream	 strm;
+
+	/* Local time offsets for MS-DOS timestamps. */
+	struct archive_tz_cache	 tz_cache;
 };
 
 /*
@@ -230,7 +234,7 @@ static int	lha_read_file_extended_header(struct archive_read *,
 		    struct lha *, uint16_t *, int, size_t, size_t *);
 static size_t	lha_check_header_format(const void *);
 static int	lha_skip_sfx(struct archive_read *);
-static time_t	lha_dos_time(const unsigned char *);
+static time_t	lha_dos_time(struct lha *, const unsigned char *);
 static time_t	lha_win_time(uint64_t, long *);
 static unsigned char	lha_calcsum(unsigned char, const void *,
 		    int, size_t);
@@ -819,7 +823,7 @@ lha_read_file_header_0(struct archive_read *a, struct lha *lha)
 	headersum = p[H0_HEADER_SUM_OFFSET];
 	lha->compsize = archive_le32dec(p + H0_COMP_SIZE_OFFSET);
 	lha->origsize = archive_le32dec(p + H0_ORIG_SIZE_OFFSET);
-	lha->mtime = lha_dos_time(p + H0_DOS_TIME_OFFSET);
+	lha->mtime = lha_dos_time(lha, p + H0_DOS_TIME_OFFSET);
 	namelen = p[H0_NAME_LEN_OFFSET];
 	extdsize = (int)lha->header_size - H0_FIXED_SIZE - namelen;
 	if ((namelen > 221 || extdsize < 0) && extdsize != -2) {
@@ -919,7 +923,7 @@ lha_read_file_header_1(struct archive_read *a, struct lha *lha)
 	/* Note: An extended header size is included in a compsize. */
 	lha->compsize = archive_le32dec(p + H1_COMP_SIZE_OFFSET);
 	lha->origsize = archive_le32dec(p + H1_ORIG_SIZE_OFFSET);
-	lha->mtime = lha_dos_time(p + H1_DOS_TIME_OFFSET);
+	lha->mtime = lha_dos_time(lha, p + H1_DOS_TIME_OFFSET);
 	namelen = p[H1_NAME_LEN_OFFSET];
 	/* Calculate a padding size. The result will be normally 0 only(?) */
 	padding = ((int)lha->header_size) - H1_FIXED_SIZE - namelen;
@@ -1713,7 +1717,7 @@ lha_parse_linkname(struct archive_wstring *linkname,
 
 /* Convert an MSDOS-style date/time into Unix-style time. */
 static time_t
-lha_dos_time(const unsigned char *p)
+lha_dos_time(struct lha *lha, const unsigned char *p)
 {
 	int msTime, msDate;
 	struct tm ts;
@@ -1728,8 +1732,7 @@ lha_dos_time(const unsigned char *p)
 	ts.tm_hour = (msTime >> 11) & 0x1f;
 	ts.tm_min = (msTime >> 5) & 0x3f;
 	ts.tm_sec = (msTime << 1) & 0x3e;
-	ts.tm_isdst = -1;
-	return (mktime(&ts));
+	return (__archive_mktime(&lha->tz_cache, &ts));
 }
 
 /* Convert an MS-Windows-style date/time into Unix-style time. */
@@ -1761,11 +1764,16 @@ lha_calcsum(unsigned char sum, const void *pp, int offset, size_t size)
 	return (sum);
 }
 
-static uint16_t crc16tbl[2][256];
+/*
+ * crc16tbl[n][b] is the CRC of byte b followed by n zero bytes, so
+ * that eight bytes can be folded in with eight independent lookups
+ * ("slicing-by-8").
+ */
+static uint16_t crc16tbl[8][256];
 static void
 lha_crc16_init(void)
 {
-	unsigned int i;
+	unsigned int i, n;
 	static int crc16init = 0;
 
 	if (crc16init)
@@ -1780,9 +1788,11 @@ lha_crc16_init(void)
 		crc16tbl[0][i] = crc;
 	}
 
-	for (i = 0; i < 256; i++) {
-		crc16tbl[1][i] = (crc16tbl[0][i] >> 8)
-			^ crc16tbl[0][crc16tbl[0][i] & 0xff];
+	for (n = 1; n < 8; n++) {
+		for (i = 0; i < 256; i++) {
+			crc16tbl[n][i] = (crc16tbl[n-1][i] >> 8)
+				^ crc16tbl[0][crc16tbl[n-1][i] & 0xff];
+		}
 	}
 }
 
@@ -1790,57 +1800,17 @@ static uint16_t
 lha_crc16(uint16_t crc, const void *pp, size_t len)
 {
 	const unsigned char *p = (const unsigned char *)pp;
-	const uint16_t *buff;
-	const union {
-		uint32_t i;
-		char c[4];
-	} u = { 0x01020304 };
 
-	if (len == 0)
-		return crc;
-
-	/* Process unaligned address. */
-	if (((uintptr_t)p) & (uintptr_t)0x1) {
-		crc = (crc >> 8) ^ crc16tbl[0][(crc ^ *p++) & 0xff];
-		len--;
+	for (;len >= 8; len -= 8, p += 8) {
+		/* The CRC is folded into the first two bytes; each
+		 * byte then only needs the table for its distance
+		 * from the end of the group. */
+		crc ^= archive_le16dec(p);
+		crc = crc16tbl[7][crc & 0xff] ^ crc16tbl[6][crc >> 8]
+		    ^ crc16tbl[5][p[2]] ^ crc16tbl[4][p[3]]
+		    ^ crc16tbl[3][p[4]] ^ crc16tbl[2][p[5]]
+		    ^ crc16tbl[1][p[6]] ^ crc16tbl[0][p[7]];
 	}
-	buff = (const uint16_t *)p;
-	/*
-	 * Modern C compiler such as GCC does not unroll automatically yet
-	 * without unrolling pragma, and Clang is so. So we should
-	 * unroll this loop for its performance.
-	 */
-	for (;len >= 8; len -= 8) {
-		/* This if statement expects compiler optimization will
-		 * remove the statement which will not be executed. */
-#undef bswap16
-#if defined(_MSC_VER) && _MSC_VER >= 1400  /* Visual Studio */
-#  define bswap16(x) _byteswap_ushort(x)
-#elif defined(__GNUC__) && ((__GNUC__ == 4 && __GNUC_MINOR__ >= 8) || __GNUC__ > 4)
-/* GCC 4.8 and later has __builtin_bswap16() */
-#  define bswap16(x) __builtin_bswap16(x)
-#elif defined(__clang__)
-/* All clang versions have __builtin_bswap16() */
-#  define bswap16(x) __builtin_bswap16(x)
-#else
-#  define bswap16(x) ((((x) >> 8) & 0xff) | ((x) << 8))
-#endif
-#define CRC16W	do { 	\
-		if(u.c[0] == 1) { /* Big endian */		\
-			crc ^= bswap16(*buff); buff++;		\
-		} else						\
-			crc ^= *buff++;				\
-		crc = crc16tbl[1][crc & 0xff] ^ crc16tbl[0][crc >> 8];\
-} while (0)
-		CRC16W;
-		CRC16W;
-		CRC16W;
-		CRC16W;
-#undef CRC16W
-#undef bswap16
-	}
-
-	p = (const unsigned char *)buff;
 	for (;len; len--) {
 		crc = (crc >> 8) ^ crc16tbl[0][(crc ^ *p++) & 0xff];
 	}
@@ -2489,19 +2459,32 @@ lzh_decode_blocks(struct lzh_stream *strm, int last)
 					/* No overlap. */
 					memcpy(w_buff + w_pos,
 					    w_buff + copy_pos, l);
+				} else if (copy_pos > w_pos) {
+					/* Source ahead of destination; a
+					 * forward copy is what memmove does. */
+					memmove(w_buff + w_pos,
+					    w_buff + copy_pos, l);
+				} else if (w_pos - copy_pos == 1) {
+					/* A run of the previous byte. */
+					memset(w_buff + w_pos,
+					    w_buff[copy_pos], l);
 				} else {
-					const unsigned char *s;
-					unsigned char *d;
-					int li;
-
-					d = w_buff + w_pos;
-					s = w_buff + copy_pos;
-					for (li = 0; li < l-1;) {
-						d[li] = s[li];li++;
-						d[li] = s[li];li++;
+					/*
+					 * The pattern repeats every `dist'
+					 * bytes; copy it a period at a time
+					 * so that each memcpy reads only
+					 * bytes that are already in place.
+					 */
+					unsigned char *d = w_buff + w_pos;
+					const int dist = w_pos - copy_pos;
+					int li, n;
+
+					for (li = 0; li < l; li += n) {
+						n = l - li;
+						if (n > dist)
+							n = dist;
+						memcpy(d + li, d + li - dist, n);
 					}
-					if (li < l)
-						d[li] = s[li];
 				}
 				w_pos += l;
 				if (w_pos == w_size) {
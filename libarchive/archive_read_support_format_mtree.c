@@ -53,7 +53,7 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_read_support_format_mtree.c 2011
 #include "archive_entry.h"
 #include "archive_entry_private.h"
 #include "archive_private.h"
-#include "archive_rb.h"
+#include "archive_hmap.h"
 #include "archive_read_private.h"
 #include "archive_string.h"
 #include "archive_pack_dev.h"
@@ -88,7 +88,6 @@ struct mtree_option {
 };
 
 struct mtree_entry {
-	struct archive_rb_node rbnode;
 	struct mtree_entry *next_dup;
 	struct mtree_entry *next;
 	struct mtree_option *options;
@@ -107,12 +106,11 @@ struct mtree {
 	const char		*archive_format_name;
 	struct mtree_entry	*entries;
 	struct mtree_entry	*this_entry;
-	struct archive_rb_tree	 entry_rbtree;
 	struct archive_string	 current_dir;
 	struct archive_string	 contents_name;
 
 	struct archive_entry_linkresolver *resolver;
-	struct archive_rb_tree rbtree;
+	struct archive_hmap entries_by_name;
 
 	int64_t			 cur_size;
 	char checkfs;
@@ -243,9 +241,21 @@ free_options(struct mtree_option *head)
 	}
 }
 
+static uint64_t
+mtree_hash_key(const void *key)
+{
+	return (__archive_hmap_hash_string(key));
+}
+
+static uint64_t
+mtree_hash_node(const void *n)
+{
+	return (__archive_hmap_hash_string(
+	    ((const struct mtree_entry *)n)->name));
+}
+
 static int
-mtree_cmp_node(const struct archive_rb_node *n1,
-    const struct archive_rb_node *n2)
+mtree_cmp_node(const void *n1, const void *n2)
 {
 	const struct mtree_entry *e1 = (const struct mtree_entry *)n1;
 	const struct mtree_entry *e2 = (const struct mtree_entry *)n2;
@@ -254,7 +264,7 @@ mtree_cmp_node(const struct archive_rb_node *n1,
 }
 
 static int
-mtree_cmp_key(const struct archive_rb_node *n, const void *key)
+mtree_cmp_key(const void *n, const void *key)
 {
 	const struct mtree_entry *e = (const struct mtree_entry *)n;
 
@@ -264,8 +274,8 @@ mtree_cmp_key(const struct archive_rb_node *n, const void *key)
 int
 archive_read_support_format_mtree(struct archive *_a)
 {
-	static const struct archive_rb_tree_ops rb_ops = {
-		mtree_cmp_node, mtree_cmp_key,
+	static const struct archive_hmap_ops hmap_ops = {
+		mtree_hash_key, mtree_hash_node, mtree_cmp_key, mtree_cmp_node,
 	};
 	struct archive_read *a = (struct archive_read *)_a;
 	struct mtree *mtree;
@@ -283,7 +293,7 @@ archive_read_support_format_mtree(struct archive *_a)
 	mtree->checkfs = 0;
 	mtree->fd = -1;
 
-	__archive_rb_tree_init(&mtree->rbtree, &rb_ops);
+	__archive_hmap_init(&mtree->entries_by_name, &hmap_ops);
 
 	r = __archive_read_register_format(a, mtree, "mtree",
            mtree_bid, archive_read_format_mtree_options, read_header, read_data, skip, NULL, cleanup, NULL, NULL);
@@ -309,6 +319,7 @@ cleanup(struct archive_read *a)
 		free(p);
 		p = q;
 	}
+	__archive_hmap_free(&mtree->entries_by_name);
 	archive_string_free(&mtree->line);
 	archive_string_free(&mtree->current_dir);
 	archive_string_free(&mtree->contents_name);
@@ -993,10 +1004,16 @@ process_add_entry(struct archive_read *a, struct mtree *mtree,
 
 	entry->next_dup = NULL;
 	if (entry->full) {
-		if (!__archive_rb_tree_insert_node(&mtree->rbtree, &entry->rbnode)) {
+		r = __archive_hmap_insert(&mtree->entries_by_name, entry);
+		if (r < 0) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate memory");
+			return (ARCHIVE_FATAL);
+		}
+		if (r == 0) {
 			struct mtree_entry *alt;
-			alt = (struct mtree_entry *)__archive_rb_tree_find_node(
-			    &mtree->rbtree, entry->name);
+			alt = (struct mtree_entry *)__archive_hmap_find(
+			    &mtree->entries_by_name, entry->name);
 			while (alt->next_dup)
 				alt = alt->next_dup;
 			alt->next_dup = entry;
@@ -1205,8 +1222,8 @@ parse_file(struct archive_read *a, struct archive_entry *entry,
 		 * with pathname canonicalization, which is a very
 		 * tricky subject.)
 		 */
-		mp = (struct mtree_entry *)__archive_rb_tree_find_node(
-		    &mtree->rbtree, mentry->name);
+		mp = (struct mtree_entry *)__archive_hmap_find(
+		    &mtree->entries_by_name, mentry->name);
 		for (; mp; mp = mp->next_dup) {
 			if (mp->full && !mp->used) {
 				/* Later lines override earlier ones. */
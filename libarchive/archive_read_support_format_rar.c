@@ -45,6 +45,7 @@
 #include "archive_ppmd7_private.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_time_private.h"
 
 /* RAR signature, also known as the mark header */
 #define RAR_SIGNATURE "\x52\x61\x72\x21\x1A\x07\x00"
@@ -318,6 +319,9 @@ struct rar
    * Custom field to denote that this archive contains encrypted entries
    */
   int has_encrypted_entries;
+
+  /* Local time offsets for MS-DOS timestamps. */
+  struct archive_tz_cache tz_cache;
 };
 
 static int archive_read_support_format_rar_capabilities(struct archive_read *);
@@ -336,7 +340,7 @@ static int archive_read_format_rar_cleanup(struct archive_read *);
 
 /* Support functions */
 static int read_header(struct archive_read *, struct archive_entry *, char);
-static time_t get_time(int);
+static time_t get_time(struct rar *, int);
 static int read_exttime(const char *, struct rar *, const char *);
 static int read_symlink_stored(struct archive_read *, struct archive_entry *,
                                struct archive_string_conv *);
@@ -1350,7 +1354,7 @@ read_header(struct archive_read *a, struct archive_entry *entry,
   rar->compression_method = file_header.method;
 
   ttime = archive_le32dec(file_header.file_time);
-  rar->mtime = get_time(ttime);
+  rar->mtime = get_time(rar, ttime);
 
   rar->file_crc = archive_le32dec(file_header.file_crc);
 
@@ -1707,17 +1711,17 @@ read_header(struct archive_read *a, struct archive_entry *entry,
 }
 
 static time_t
-get_time(int ttime)
+get_time(struct rar *rar, int ttime)
 {
   struct tm tm;
+  memset(&tm, 0, sizeof(tm));
   tm.tm_sec = 2 * (ttime & 0x1f);
   tm.tm_min = (ttime >> 5) & 0x3f;
   tm.tm_hour = (ttime >> 11) & 0x1f;
   tm.tm_mday = (ttime >> 16) & 0x1f;
   tm.tm_mon = ((ttime >> 21) & 0x0f) - 1;
   tm.tm_year = ((ttime >> 25) & 0x7f) + 80;
-  tm.tm_isdst = -1;
-  return mktime(&tm);
+  return __archive_mktime(&rar->tz_cache, &tm);
 }
 
 static int
@@ -1728,13 +1732,7 @@ read_exttime(const char *p, struct rar *rar, const char *endp)
   struct tm *tm;
   time_t t;
   long nsec;
-#if defined(HAVE_LOCALTIME_R) || defined(HAVE__LOCALTIME64_S)
   struct tm tmbuf;
-#endif
-#if defined(HAVE__LOCALTIME64_S)
-  errno_t terr;
-  __time64_t tmptime;
-#endif
 
   if (p + 2 > endp)
     return (-1);
@@ -1754,7 +1752,7 @@ read_exttime(const char *p, struct rar *rar, const char *endp)
         if (p + 4 > endp)
           return (-1);
         ttime = archive_le32dec(p);
-        t = get_time(ttime);
+        t = get_time(rar, ttime);
         p += 4;
       }
       rem = 0;
@@ -1766,23 +1764,14 @@ read_exttime(const char *p, struct rar *rar, const char *endp)
         rem = (((unsigned)(unsigned char)*p) << 16) | (rem >> 8);
         p++;
       }
-#if defined(HAVE_LOCALTIME_R)
-      tm = localtime_r(&t, &tmbuf);
-#elif defined(HAVE__LOCALTIME64_S)
-      tmptime = t;
-      terr = _localtime64_s(&tmbuf, &tmptime);
-      if (terr)
-        tm = NULL;
-      else
-        tm = &tmbuf;
-#else
-      tm = localtime(&t);
-#endif
+      tm = __archive_localtime(&rar->tz_cache, t, &tmbuf, NULL);
+      if (tm == NULL)
+        return (-1);
       nsec = tm->tm_sec + rem / NS_UNIT;
       if (rmode & 4)
       {
-        tm->tm_sec++;
-        t = mktime(tm);
+        /* Round up to the next second. */
+        t++;
       }
       if (i == 3)
       {
@@ -218,6 +218,10 @@ struct comp_state {
 	ssize_t window_size;         /* Size of window_buf. */
 	uint8_t* window_buf;         /* Circular buffer used during
 	                                decompression. */
+	ssize_t window_buf_size;     /* Allocated size of window_buf. */
+	ssize_t window_dirty;        /* Number of bytes at the start of
+	                                window_buf written by previous
+	                                files. */
 	uint8_t* filtered_buf;       /* Buffer used when applying filters. */
 	const uint8_t* block_buf;    /* Buffer used when merging blocks. */
 	size_t window_mask;          /* Convenience field; window_size - 1. */
@@ -852,6 +856,13 @@ static void reset_file_context(struct rar5* rar) {
 	memset(&rar->file, 0, sizeof(rar->file));
 	blake2sp_init(&rar->file.b2state, 32);
 
+	/* Remember how much of the window buffer was touched by the previous
+	 * file, so init_unpack() knows how much of it needs clearing. */
+	if(rar->cstate.write_ptr > rar->cstate.window_dirty) {
+		rar->cstate.window_dirty = (ssize_t) rar5_min(
+		    rar->cstate.write_ptr, rar->cstate.window_buf_size);
+	}
+
 	if(rar->main.solid) {
 		rar->cstate.solid_offset += rar->cstate.write_ptr;
 	} else {
@@ -2304,17 +2315,35 @@ static void init_unpack(struct rar5* rar) {
 	rar->file.calculated_crc32 = 0;
 	init_window_mask(rar);
 
-	free(rar->cstate.window_buf);
+	/* The filter buffer is allocated by run_filter() separately for
+	 * every filter, so don't keep a window-sized one around. */
 	free(rar->cstate.filtered_buf);
+	rar->cstate.filtered_buf = NULL;
 
-	if(rar->cstate.window_size > 0) {
-		rar->cstate.window_buf = calloc(1, rar->cstate.window_size);
-		rar->cstate.filtered_buf = calloc(1, rar->cstate.window_size);
+	if(rar->cstate.window_buf != NULL &&
+	    rar->cstate.window_buf_size == rar->cstate.window_size)
+	{
+		/* Every file in a non-solid archive starts with an empty
+		 * window. Reuse the buffer from the previous file instead of
+		 * allocating a new one, and clear only the part of it that
+		 * was actually written to. */
+		memset(rar->cstate.window_buf, 0, rar->cstate.window_dirty);
 	} else {
-		rar->cstate.window_buf = NULL;
-		rar->cstate.filtered_buf = NULL;
+		free(rar->cstate.window_buf);
+
+		if(rar->cstate.window_size > 0) {
+			rar->cstate.window_buf =
+			    calloc(1, rar->cstate.window_size);
+		} else {
+			rar->cstate.window_buf = NULL;
+		}
+
+		rar->cstate.window_buf_size = rar->cstate.window_buf != NULL ?
+		    rar->cstate.window_size : 0;
 	}
 
+	rar->cstate.window_dirty = 0;
+
 	rar->cstate.write_ptr = 0;
 	rar->cstate.last_write_ptr = 0;
 
@@ -136,6 +136,9 @@ struct tar {
 	int64_t			 entry_offset;
 	int64_t			 entry_padding;
 	int64_t 		 entry_bytes_unconsumed;
+	/* Where the data of a non-sparse entry starts, or -1. */
+	int64_t			 entry_data_start;
+	int64_t			 entry_data_size;
 	int64_t			 realsize;
 	int			 sparse_allowed;
 	struct sparse_block	*sparse_list;
@@ -201,6 +204,8 @@ static int	archive_read_format_tar_cleanup(struct archive_read *);
 static int	archive_read_format_tar_read_data(struct archive_read *a,
 		    const void **buff, size_t *size, int64_t *offset);
 static int	archive_read_format_tar_skip(struct archive_read *a);
+static int64_t	archive_read_format_tar_seek_data(struct archive_read *a,
+		    int64_t offset, int whence);
 static int	archive_read_format_tar_read_header(struct archive_read *,
 		    struct archive_entry *);
 static int	checksum(struct archive_read *, const void *);
@@ -267,7 +272,7 @@ archive_read_support_format_tar(struct archive *_a)
 	    archive_read_format_tar_read_header,
 	    archive_read_format_tar_read_data,
 	    archive_read_format_tar_skip,
-	    NULL,
+	    archive_read_format_tar_seek_data,
 	    archive_read_format_tar_cleanup,
 	    NULL,
 	    NULL);
@@ -553,9 +558,13 @@ archive_read_format_tar_read_header(struct archive_read *a,
 		if (gnu_add_sparse_entry(a, tar, 0, tar->entry_bytes_remaining)
 		    != ARCHIVE_OK)
 			return (ARCHIVE_FATAL);
+		tar->entry_data_start = a->filter->position;
+		tar->entry_data_size = tar->entry_bytes_remaining;
 	} else {
 		struct sparse_block *sb;
 
+		tar->entry_data_start = -1;
+
 		for (sb = tar->sparse_list; sb != NULL; sb = sb->next) {
 			if (!sb->hole)
 				archive_entry_sparse_add_entry(entry,
@@ -620,10 +629,30 @@ archive_read_format_tar_read_data(struct archive_read *a,
 			return (ARCHIVE_EOF);
 		}
 
-		*buff = __archive_read_ahead(a, 1, &bytes_read);
+		/*
+		 * If archive_read_data() is waiting for exactly this
+		 * data, read it straight into the client's buffer.
+		 */
+		if (a->archive.read_data_dest != NULL &&
+		    !tar->sparse_list->hole && tar->sparse_list->offset ==
+		    a->archive.read_data_output_offset) {
+			size_t request = a->archive.read_data_requested;
+
+			if ((int64_t)request > tar->entry_bytes_remaining)
+				request = (size_t)tar->entry_bytes_remaining;
+			if ((int64_t)request > tar->sparse_list->remaining)
+				request = (size_t)tar->sparse_list->remaining;
+			bytes_read = __archive_read_read_into(a,
+			    a->archive.read_data_dest, request);
+			*buff = a->archive.read_data_dest;
+		} else {
+			*buff = __archive_read_ahead(a, 1, &bytes_read);
+			if (*buff == NULL && bytes_read > 0)
+				bytes_read = 0;
+		}
 		if (bytes_read < 0)
 			return (ARCHIVE_FATAL);
-		if (*buff == NULL) {
+		if (bytes_read == 0) {
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 			    "Truncated tar archive");
 			return (ARCHIVE_FATAL);
@@ -639,7 +668,9 @@ archive_read_format_tar_read_data(struct archive_read *a,
 		tar->sparse_list->remaining -= bytes_read;
 		tar->sparse_list->offset += bytes_read;
 		tar->entry_bytes_remaining -= bytes_read;
-		tar->entry_bytes_unconsumed = bytes_read;
+		/* Data read in place has been consumed already. */
+		if (*buff != a->archive.read_data_dest)
+			tar->entry_bytes_unconsumed = bytes_read;
 
 		if (!tar->sparse_list->hole)
 			return (ARCHIVE_OK);
@@ -685,6 +716,67 @@ archive_read_format_tar_skip(struct archive_read *a)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Reposition within the data of a non-sparse entry.  This needs a
+ * seekable input: a seekable file, or a multi-block .xz file whose
+ * index the xz filter has read.
+ */
+static int64_t
+archive_read_format_tar_seek_data(struct archive_read *a, int64_t offset,
+    int whence)
+{
+	struct tar *tar;
+	int64_t target, r;
+
+	tar = (struct tar *)(a->format->data);
+	if (tar->entry_data_start < 0) {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+		    "Can't seek in a sparse tar entry");
+		return (ARCHIVE_FAILED);
+	}
+
+	switch (whence) {
+	case SEEK_CUR:
+		target = tar->entry_data_size - tar->entry_bytes_remaining;
+		break;
+	case SEEK_END:
+		target = tar->entry_data_size;
+		break;
+	case SEEK_SET:
+	default:
+		target = 0;
+	}
+	target += offset;
+	if (target < 0) {
+		archive_set_error(&a->archive, EINVAL,
+		    "Can't seek before the start of the entry");
+		return (ARCHIVE_FAILED);
+	}
+	if (target > tar->entry_data_size)
+		target = tar->entry_data_size;
+
+	r = __archive_read_seek(a, tar->entry_data_start + target, SEEK_SET);
+	if (r == ARCHIVE_FAILED)
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+		    "The input of this tar archive is not seekable");
+	if (r < 0)
+		return (r);
+
+	tar->entry_bytes_unconsumed = 0;
+	tar->entry_bytes_remaining = tar->entry_data_size - target;
+	tar->entry_padding = 0x1ff & (-tar->entry_data_size);
+	gnu_clear_sparse_list(tar);
+	if (gnu_add_sparse_entry(a, tar, target, tar->entry_bytes_remaining)
+	    != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+
+	/* archive_read_data() carries on from the new offset. */
+	__archive_reset_read_data(&a->archive);
+	a->archive.read_data_offset = target;
+	a->archive.read_data_output_offset = target;
+	return (target);
+}
+
 /*
  * This function recursively interprets all of the headers associated
  * with a single entry.
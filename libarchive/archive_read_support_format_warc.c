@@ -71,6 +71,7 @@ __FBSDID("$FreeBSD$");
 #include "archive_entry.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_time_private.h"
 
 typedef enum {
 	WT_NONE,
@@ -527,31 +528,6 @@ strtoi_lim(const char *str, const char **ep, int llim, int ulim)
 	return res;
 }
 
-static time_t
-time_from_tm(struct tm *t)
-{
-#if HAVE_TIMEGM
-        /* Use platform timegm() if available. */
-        return (timegm(t));
-#elif HAVE__MKGMTIME64
-        return (_mkgmtime64(t));
-#else
-        /* Else use direct calculation using POSIX assumptions. */
-        /* First, fix up tm_yday based on the year/month/day. */
-        if (mktime(t) == (time_t)-1)
-                return ((time_t)-1);
-        /* Then we can compute timegm() from first principles. */
-        return (t->tm_sec
-            + t->tm_min * 60
-            + t->tm_hour * 3600
-            + t->tm_yday * 86400
-            + (t->tm_year - 70) * 31536000
-            + ((t->tm_year - 69) / 4) * 86400
-            - ((t->tm_year - 1) / 100) * 86400
-            + ((t->tm_year + 299) / 400) * 86400);
-#endif
-}
-
 static time_t
 xstrpisotime(const char *s, char **endptr)
 {
@@ -597,7 +573,7 @@ xstrpisotime(const char *s, char **endptr)
 	tm.tm_mon--;
 
 	/* now convert our custom tm struct to a unix stamp using UTC */
-	res = time_from_tm(&tm);
+	res = (time_t)__archive_timegm(&tm);
 
 out:
 	if (endptr != NULL) {
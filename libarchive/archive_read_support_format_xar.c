@@ -55,6 +55,7 @@ __FBSDID("$FreeBSD$");
 #include "archive_entry_locale.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_time_private.h"
 
 #if (!defined(HAVE_LIBXML_XMLREADER_H) && \
      !defined(HAVE_BSDXML_H) && !defined(HAVE_EXPAT_H)) ||\
@@ -1132,30 +1133,6 @@ atohex(unsigned char *b, size_t bsize, const char *p, size_t psize)
 	return (fbsize - bsize);
 }
 
-static time_t
-time_from_tm(struct tm *t)
-{
-#if HAVE_TIMEGM
-        /* Use platform timegm() if available. */
-        return (timegm(t));
-#elif HAVE__MKGMTIME64
-        return (_mkgmtime64(t));
-#else
-        /* Else use direct calculation using POSIX assumptions. */
-        /* First, fix up tm_yday based on the year/month/day. */
-        mktime(t);
-        /* Then we can compute timegm() from first principles. */
-        return (t->tm_sec
-            + t->tm_min * 60
-            + t->tm_hour * 3600
-            + t->tm_yday * 86400
-            + (t->tm_year - 70) * 31536000
-            + ((t->tm_year - 69) / 4) * 86400
-            - ((t->tm_year - 1) / 100) * 86400
-            + ((t->tm_year + 299) / 400) * 86400);
-#endif
-}
-
 static time_t
 parse_time(const char *p, size_t n)
 {
@@ -1211,7 +1188,7 @@ parse_time(const char *p, size_t n)
 		return (t);
 #endif
 
-	t = time_from_tm(&tm);
+	t = (time_t)__archive_timegm(&tm);
 
 	return (t);
 }
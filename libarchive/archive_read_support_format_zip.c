@@ -67,16 +67,16 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_read_support_format_zip.c 201102
 #include "archive_entry_locale.h"
 #include "archive_hmac_private.h"
 #include "archive_private.h"
-#include "archive_rb.h"
+#include "archive_hmap.h"
 #include "archive_read_private.h"
 #include "archive_ppmd8_private.h"
+#include "archive_time_private.h"
 
 #ifndef HAVE_ZLIB_H
 #include "archive_crc32.h"
 #endif
 
 struct zip_entry {
-	struct archive_rb_node	node;
 	struct zip_entry	*next;
 	int64_t			local_header_offset;
 	int64_t			compressed_size;
@@ -84,6 +84,8 @@ struct zip_entry {
 	int64_t			gid;
 	int64_t			uid;
 	struct archive_string	rsrcname;
+	/* Kept from the central directory for LA_SHARED_DATA. */
+	struct archive_string	name;
 	time_t			mtime;
 	time_t			atime;
 	time_t			ctime;
@@ -126,6 +128,7 @@ struct trad_enc_ctx {
 /* Bits used in flags. */
 #define LA_USED_ZIP64	(1 << 0)
 #define LA_FROM_CENTRAL_DIRECTORY (1 << 1)
+#define LA_SHARED_DATA	(1 << 2) /* Data is that of the previous entry. */
 
 /*
  * See "WinZip - AES Encryption Information"
@@ -138,6 +141,12 @@ struct trad_enc_ctx {
 /**/
 #define MAX_DERIVED_KEY_BUF_SIZE	(AES_MAX_KEY_SIZE * 2 + 2)
 
+struct zip_entry_ref {
+	int64_t			 offset;
+	size_t			 seq;	/* Order of insertion. */
+	struct zip_entry	*entry;
+};
+
 struct zip {
 	/* Structural information about the archive. */
 	struct archive_string	format_name;
@@ -149,8 +158,18 @@ struct zip {
 
 	/* List of entries (seekable Zip only) */
 	struct zip_entry	*zip_entries;
-	struct archive_rb_tree	tree;
-	struct archive_rb_tree	tree_rsrc;
+	/* Entries to expose, sorted by local header offset. */
+	struct zip_entry_ref	*entries_by_offset;
+	size_t			 entries_by_offset_count;
+	size_t			 entries_by_offset_size;
+	size_t			 entries_by_offset_next;
+	/* Mac resource forks, keyed by rsrcname. */
+	struct archive_hmap	 rsrc_map;
+	/* Link target for entries with LA_SHARED_DATA. */
+	struct archive_string	 shared_pathname;
+
+	/* Local time offsets for MS-DOS timestamps. */
+	struct archive_tz_cache	 tz_cache;
 
 	/* Bytes read but not yet consumed via __archive_read_consume() */
 	size_t			unconsumed;
@@ -459,7 +478,7 @@ compression_name(const int compression)
 
 /* Convert an MSDOS-style date/time into Unix-style time. */
 static time_t
-zip_time(const char *p)
+zip_time(struct zip *zip, const char *p)
 {
 	int msTime, msDate;
 	struct tm ts;
@@ -474,8 +493,7 @@ zip_time(const char *p)
 	ts.tm_hour = (msTime >> 11) & 0x1f;
 	ts.tm_min = (msTime >> 5) & 0x3f;
 	ts.tm_sec = (msTime << 1) & 0x3e;
-	ts.tm_isdst = -1;
-	return mktime(&ts);
+	return __archive_mktime(&zip->tz_cache, &ts);
 }
 
 /*
@@ -970,7 +988,7 @@ zip_read_local_file_header(struct archive_read *a, struct archive_entry *entry,
 	}
 	zip->init_decryption = (zip_entry->zip_flags & ZIP_ENCRYPTED);
 	zip_entry->compression = (char)archive_le16dec(p + 8);
-	zip_entry->mtime = zip_time(p + 10);
+	zip_entry->mtime = zip_time(zip, p + 10);
 	zip_entry->crc32 = archive_le32dec(p + 14);
 	if (zip_entry->zip_flags & ZIP_LENGTH_AT_END)
 		zip_entry->decdat = p[11];
@@ -2953,11 +2971,14 @@ archive_read_format_zip_cleanup(struct archive_read *a)
 	if (zip->ppmd8_valid)
 		__archive_ppmd8_functions.Ppmd8_Free(&zip->ppmd8);
 
+	free(zip->entries_by_offset);
+	__archive_hmap_free(&zip->rsrc_map);
 	if (zip->zip_entries) {
 		zip_entry = zip->zip_entries;
 		while (zip_entry != NULL) {
 			next_zip_entry = zip_entry->next;
 			archive_string_free(&zip_entry->rsrcname);
+			archive_string_free(&zip_entry->name);
 			free(zip_entry);
 			zip_entry = next_zip_entry;
 		}
@@ -2971,6 +2992,7 @@ archive_read_format_zip_cleanup(struct archive_read *a)
 	free(zip->erd);
 	free(zip->v_data);
 	archive_string_free(&zip->format_name);
+	archive_string_free(&zip->shared_pathname);
 	free(zip);
 	(a->format->data) = NULL;
 	return (ARCHIVE_OK);
@@ -3492,38 +3514,103 @@ archive_read_format_zip_seekable_bid(struct archive_read *a, int best_bid)
 	return 0;
 }
 
-/* The red-black trees are only used in seeking mode to manage
- * the in-memory copy of the central directory. */
+/* These are only used in seeking mode to manage the in-memory copy
+ * of the central directory. */
 
 static int
-cmp_node(const struct archive_rb_node *n1, const struct archive_rb_node *n2)
+add_entry_by_offset(struct zip *zip, struct zip_entry *zip_entry)
 {
-	const struct zip_entry *e1 = (const struct zip_entry *)n1;
-	const struct zip_entry *e2 = (const struct zip_entry *)n2;
-
-	if (e1->local_header_offset > e2->local_header_offset)
-		return -1;
-	if (e1->local_header_offset < e2->local_header_offset)
-		return 1;
-	return 0;
+	struct zip_entry_ref *ref;
+
+	if (zip->entries_by_offset_count >= zip->entries_by_offset_size) {
+		size_t new_size = zip->entries_by_offset_size * 2;
+
+		if (new_size < 64)
+			new_size = 64;
+		ref = realloc(zip->entries_by_offset,
+		    new_size * sizeof(*ref));
+		if (ref == NULL)
+			return (-1);
+		zip->entries_by_offset = ref;
+		zip->entries_by_offset_size = new_size;
+	}
+	ref = &zip->entries_by_offset[zip->entries_by_offset_count];
+	ref->offset = zip_entry->local_header_offset;
+	ref->seq = zip->entries_by_offset_count++;
+	ref->entry = zip_entry;
+	return (0);
 }
 
 static int
-cmp_key(const struct archive_rb_node *n, const void *key)
+cmp_entry_ref(const void *p1, const void *p2)
+{
+	const struct zip_entry_ref *r1 = (const struct zip_entry_ref *)p1;
+	const struct zip_entry_ref *r2 = (const struct zip_entry_ref *)p2;
+
+	if (r1->offset != r2->offset)
+		return (r1->offset < r2->offset ? -1 : 1);
+	if (r1->seq != r2->seq)
+		return (r1->seq < r2->seq ? -1 : 1);
+	return (0);
+}
+
+/*
+ * Sort the entries by local header offset.  Where several entries
+ * share an offset, the first registered is read as usual.  If it is
+ * a regular file, later regular files there are exposed as hard links
+ * to it; anything else at that offset is dropped.
+ */
+static void
+sort_entries_by_offset(struct zip *zip)
 {
-	/* This function won't be called */
-	(void)n; /* UNUSED */
-	(void)key; /* UNUSED */
-	return 1;
+	struct zip_entry_ref *refs = zip->entries_by_offset;
+	struct zip_entry *lead = NULL;
+	size_t i, n = 0;
+
+	if (zip->entries_by_offset_count == 0)
+		return;
+	qsort(refs, zip->entries_by_offset_count, sizeof(*refs),
+	    cmp_entry_ref);
+	for (i = 0; i < zip->entries_by_offset_count; i++) {
+		if (n > 0 && refs[n - 1].offset == refs[i].offset) {
+			if ((lead->mode & AE_IFMT) == AE_IFREG
+			    && (refs[i].entry->mode & AE_IFMT) == AE_IFREG
+			    && archive_strlen(&refs[i].entry->name) > 0) {
+				refs[i].entry->flags |= LA_SHARED_DATA;
+				refs[n++] = refs[i];
+			}
+			continue;
+		}
+		lead = refs[i].entry;
+		refs[n++] = refs[i];
+	}
+	zip->entries_by_offset_count = n;
 }
 
-static const struct archive_rb_tree_ops rb_ops = {
-	&cmp_node, &cmp_key
-};
+static struct zip_entry *
+next_entry_by_offset(struct zip *zip)
+{
+	if (zip->entries_by_offset_next >= zip->entries_by_offset_count)
+		return (NULL);
+	return (zip->entries_by_offset[zip->entries_by_offset_next++].entry);
+}
+
+static uint64_t
+rsrc_hash_key(const void *key)
+{
+	return (__archive_hmap_hash_string((const char *)key));
+}
+
+static uint64_t
+rsrc_hash_node(const void *n)
+{
+	const struct zip_entry *e = (const struct zip_entry *)n;
+
+	return (__archive_hmap_hash_string(e->rsrcname.s));
+}
 
 static int
-rsrc_cmp_node(const struct archive_rb_node *n1,
-    const struct archive_rb_node *n2)
+rsrc_cmp_node(const void *n1, const void *n2)
 {
 	const struct zip_entry *e1 = (const struct zip_entry *)n1;
 	const struct zip_entry *e2 = (const struct zip_entry *)n2;
@@ -3532,14 +3619,14 @@ rsrc_cmp_node(const struct archive_rb_node *n1,
 }
 
 static int
-rsrc_cmp_key(const struct archive_rb_node *n, const void *key)
+rsrc_cmp_key(const void *n, const void *key)
 {
 	const struct zip_entry *e = (const struct zip_entry *)n;
 	return (strcmp((const char *)key, e->rsrcname.s));
 }
 
-static const struct archive_rb_tree_ops rb_rsrc_ops = {
-	&rsrc_cmp_node, &rsrc_cmp_key
+static const struct archive_hmap_ops rsrc_hmap_ops = {
+	&rsrc_hash_key, &rsrc_hash_node, &rsrc_cmp_key, &rsrc_cmp_node
 };
 
 static const char *
@@ -3557,7 +3644,7 @@ rsrc_basename(const char *name, size_t name_length)
 	return (r);
 }
 
-static void
+static int
 expose_parent_dirs(struct zip *zip, const char *name, size_t name_length)
 {
 	struct archive_string str;
@@ -3571,17 +3658,20 @@ expose_parent_dirs(struct zip *zip, const char *name, size_t name_length)
 		if (s == NULL)
 			break;
 		*s = '\0';
-		/* Transfer the parent directory from zip->tree_rsrc RB
-		 * tree to zip->tree RB tree to expose. */
+		/* Transfer the parent directory from zip->rsrc_map
+		 * to zip->entries_by_offset to expose. */
 		dir = (struct zip_entry *)
-		    __archive_rb_tree_find_node(&zip->tree_rsrc, str.s);
+		    __archive_hmap_remove(&zip->rsrc_map, str.s);
 		if (dir == NULL)
 			break;
-		__archive_rb_tree_remove_node(&zip->tree_rsrc, &dir->node);
 		archive_string_free(&dir->rsrcname);
-		__archive_rb_tree_insert_node(&zip->tree, &dir->node);
+		if (add_entry_by_offset(zip, dir) < 0) {
+			archive_string_free(&str);
+			return (-1);
+		}
 	}
 	archive_string_free(&str);
+	return (0);
 }
 
 static int
@@ -3592,6 +3682,7 @@ slurp_central_directory(struct archive_read *a, struct archive_entry* entry,
 	unsigned found;
 	int64_t correction;
 	ssize_t bytes_avail;
+	int64_t max_offset = -1;
 	const char *p;
 
 	/*
@@ -3643,8 +3734,7 @@ slurp_central_directory(struct archive_read *a, struct archive_entry* entry,
 	correction = archive_filter_bytes(&a->archive, 0)
 			- zip->central_directory_offset;
 
-	__archive_rb_tree_init(&zip->tree, &rb_ops);
-	__archive_rb_tree_init(&zip->tree_rsrc, &rb_rsrc_ops);
+	__archive_hmap_init(&zip->rsrc_map, &rsrc_hmap_ops);
 
 	zip->central_directory_entries_total = 0;
 	while (1) {
@@ -3652,6 +3742,7 @@ slurp_central_directory(struct archive_read *a, struct archive_entry* entry,
 		size_t filename_length, extra_length, comment_length;
 		uint32_t external_attributes;
 		const char *name, *r;
+		int ret = 0;
 
 		if ((p = __archive_read_ahead(a, 4, NULL)) == NULL)
 			return ARCHIVE_FATAL;
@@ -3686,7 +3777,7 @@ slurp_central_directory(struct archive_read *a, struct archive_entry* entry,
 			zip->has_encrypted_entries = 1;
 		}
 		zip_entry->compression = (char)archive_le16dec(p + 10);
-		zip_entry->mtime = zip_time(p + 12);
+		zip_entry->mtime = zip_time(zip, p + 12);
 		zip_entry->crc32 = archive_le32dec(p + 16);
 		if (zip_entry->zip_flags & ZIP_LENGTH_AT_END)
 			zip_entry->decdat = p[13];
@@ -3741,6 +3832,13 @@ slurp_central_directory(struct archive_read *a, struct archive_entry* entry,
 			return ARCHIVE_FATAL;
 		}
 
+		/* An entry that does not start past all earlier ones may
+		 * share data with one of them; keep its name in case. */
+		if (zip_entry->local_header_offset <= max_offset)
+			archive_strncpy(&zip_entry->name, p, filename_length);
+		else
+			max_offset = zip_entry->local_header_offset;
+
 		/*
 		 * Mac resource fork files are stored under the
 		 * "__MACOSX/" directory, so we should check if
@@ -3748,8 +3846,7 @@ slurp_central_directory(struct archive_read *a, struct archive_entry* entry,
 		 */
 		if (!zip->process_mac_extensions) {
 			/* Treat every entry as a regular entry. */
-			__archive_rb_tree_insert_node(&zip->tree,
-			    &zip_entry->node);
+			ret = add_entry_by_offset(zip, zip_entry);
 		} else {
 			name = p;
 			r = rsrc_basename(name, filename_length);
@@ -3761,22 +3858,24 @@ slurp_central_directory(struct archive_read *a, struct archive_entry* entry,
 				if (name[filename_length-1] != '/' &&
 				    (r - name < 3 || r[0] != '.' ||
 				     r[1] != '_')) {
-					__archive_rb_tree_insert_node(
-					    &zip->tree, &zip_entry->node);
+					ret = add_entry_by_offset(zip,
+					    zip_entry);
 					/* Expose its parent directories. */
-					expose_parent_dirs(zip, name,
-					    filename_length);
+					if (ret == 0)
+						ret = expose_parent_dirs(zip,
+						    name, filename_length);
 				} else {
 					/* This file is a resource fork file or
 					 * a directory. */
 					archive_strncpy(&(zip_entry->rsrcname),
 					     name, filename_length);
-					__archive_rb_tree_insert_node(
-					    &zip->tree_rsrc, &zip_entry->node);
+					if (__archive_hmap_insert(
+					    &zip->rsrc_map, zip_entry) < 0)
+						ret = -1;
 				}
 			} else {
 				/* Generate resource fork name to find its
-				 * resource file at zip->tree_rsrc. */
+				 * resource file at zip->rsrc_map. */
 				archive_strcpy(&(zip_entry->rsrcname),
 				    "__MACOSX/");
 				archive_strncat(&(zip_entry->rsrcname),
@@ -3785,18 +3884,23 @@ slurp_central_directory(struct archive_read *a, struct archive_entry* entry,
 				archive_strncat(&(zip_entry->rsrcname),
 				    name + (r - name),
 				    filename_length - (r - name));
-				/* Register an entry to RB tree to sort it by
+				/* Register an entry to sort it by
 				 * file offset. */
-				__archive_rb_tree_insert_node(&zip->tree,
-				    &zip_entry->node);
+				ret = add_entry_by_offset(zip, zip_entry);
 			}
 		}
+		if (ret < 0) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate zip entry");
+			return ARCHIVE_FATAL;
+		}
 
 		/* Skip the comment too ... */
 		__archive_read_consume(a,
 		    filename_length + extra_length + comment_length);
 	}
 
+	sort_entries_by_offset(zip);
 	return ARCHIVE_OK;
 }
 
@@ -3974,6 +4078,69 @@ exit_mac_metadata:
 	return (ret);
 }
 
+/*
+ * An entry whose central directory record points at the local header
+ * of the entry before it, as written by the zip writer's "dedup"
+ * option.  It is exposed as a hard link to that entry.
+ */
+static int
+zip_read_shared_entry(struct archive_read *a, struct archive_entry *entry,
+    struct zip *zip)
+{
+	struct zip_entry *zip_entry = zip->entry;
+	struct archive_string_conv *sconv;
+	int ret = ARCHIVE_OK;
+
+	zip->end_of_entry = 1;
+	zip->init_decryption = 0;
+	zip->entry_bytes_remaining = 0;
+	zip->entry_uncompressed_bytes_read = 0;
+	zip->entry_compressed_bytes_read = 0;
+	zip->unconsumed = 0;
+
+	if (zip_entry->zip_flags & ZIP_UTF8_NAME) {
+		if (zip->sconv_utf8 == NULL) {
+			zip->sconv_utf8 =
+			    archive_string_conversion_from_charset(
+				&a->archive, "UTF-8", 1);
+			if (zip->sconv_utf8 == NULL)
+				return (ARCHIVE_FATAL);
+		}
+		sconv = zip->sconv_utf8;
+	} else if (zip->sconv != NULL)
+		sconv = zip->sconv;
+	else
+		sconv = zip->sconv_default;
+	if (archive_entry_copy_pathname_l(entry, zip_entry->name.s,
+	    archive_strlen(&zip_entry->name), sconv) != 0) {
+		if (errno == ENOMEM) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate memory for Pathname");
+			return (ARCHIVE_FATAL);
+		}
+		archive_set_error(&a->archive,
+		    ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Pathname cannot be converted "
+		    "from %s to current locale.",
+		    archive_string_conversion_charset_name(sconv));
+		ret = ARCHIVE_WARN;
+	}
+	if (archive_strlen(&zip->shared_pathname) == 0) {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Entry shares data with an entry that has no name");
+		return (ARCHIVE_FAILED);
+	}
+	archive_entry_copy_hardlink(entry, zip->shared_pathname.s);
+	archive_entry_set_mode(entry, zip_entry->mode);
+	archive_entry_set_uid(entry, zip_entry->uid);
+	archive_entry_set_gid(entry, zip_entry->gid);
+	archive_entry_set_mtime(entry, zip_entry->mtime, 0);
+	archive_entry_set_ctime(entry, zip_entry->ctime, 0);
+	archive_entry_set_atime(entry, zip_entry->atime, 0);
+	archive_entry_set_size(entry, 0);
+	return (ret);
+}
+
 static int
 archive_read_format_zip_seekable_read_header(struct archive_read *a,
 	struct archive_entry *entry)
@@ -4002,22 +4169,21 @@ archive_read_format_zip_seekable_read_header(struct archive_read *a,
 		r = slurp_central_directory(a, entry, zip);
 		if (r != ARCHIVE_OK)
 			return r;
-		/* Get first entry whose local header offset is lower than
-		 * other entries in the archive file. */
-		zip->entry =
-		    (struct zip_entry *)ARCHIVE_RB_TREE_MIN(&zip->tree);
+		/* Start with the entry whose local header offset is lower
+		 * than other entries in the archive file. */
+		zip->entries_by_offset_next = 0;
+		zip->entry = next_entry_by_offset(zip);
 	} else if (zip->entry != NULL) {
 		/* Get next entry in local header offset order. */
-		zip->entry = (struct zip_entry *)__archive_rb_tree_iterate(
-		    &zip->tree, &zip->entry->node, ARCHIVE_RB_DIR_RIGHT);
+		zip->entry = next_entry_by_offset(zip);
 	}
 
 	if (zip->entry == NULL)
 		return ARCHIVE_EOF;
 
 	if (zip->entry->rsrcname.s)
-		rsrc = (struct zip_entry *)__archive_rb_tree_find_node(
-		    &zip->tree_rsrc, zip->entry->rsrcname.s);
+		rsrc = (struct zip_entry *)__archive_hmap_find(
+		    &zip->rsrc_map, zip->entry->rsrcname.s);
 	else
 		rsrc = NULL;
 
@@ -4028,6 +4194,9 @@ archive_read_format_zip_seekable_read_header(struct archive_read *a,
 	zip->tctx_valid = zip->cctx_valid = zip->hctx_valid = 0;
 	__archive_read_reset_passphrase(a);
 
+	if (zip->entry->flags & LA_SHARED_DATA)
+		return (zip_read_shared_entry(a, entry, zip));
+
 	/* File entries are sorted by the header offset, we should mostly
 	 * use __archive_read_consume to advance a read point to avoid
 	 * redundant data reading.  */
@@ -4040,7 +4209,19 @@ archive_read_format_zip_seekable_read_header(struct archive_read *a,
 		    SEEK_SET);
 	}
 	zip->unconsumed = 0;
+	archive_string_empty(&zip->shared_pathname);
 	r = zip_read_local_file_header(a, entry, zip);
+	/* Entries that share this one's data link to it, even if it
+	 * only warned. */
+	if (r >= ARCHIVE_WARN
+	    && zip->entries_by_offset_next < zip->entries_by_offset_count
+	    && (zip->entries_by_offset[zip->entries_by_offset_next].entry->flags
+		& LA_SHARED_DATA)) {
+		const char *name = archive_entry_pathname(entry);
+
+		if (name != NULL)
+			archive_strcat(&zip->shared_pathname, name);
+	}
 	if (r != ARCHIVE_OK)
 		return r;
 	if (rsrc) {
@@ -0,0 +1,277 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <time.h>
+
+#include "archive_time_private.h"
+
+/*
+ * The conversions between days and civil dates follow Howard
+ * Hinnant's "chrono-Compatible Low-Level Date Algorithms": the year
+ * is shifted to start in March so that the leap day is the last day
+ * of the year, and is then split into 400-year eras of 146097 days.
+ */
+
+static int64_t
+floor_div(int64_t a, int64_t b)
+{
+	int64_t q = a / b;
+
+	if ((a % b) != 0 && ((a < 0) != (b < 0)))
+		q--;
+	return (q);
+}
+
+int64_t
+__archive_days_from_civil(int64_t year, int64_t mon, int64_t mday)
+{
+	int64_t era, yoe, doy, doe;
+
+	/* Carry out of range months into the year. */
+	mon -= 1;
+	year += floor_div(mon, 12);
+	mon -= floor_div(mon, 12) * 12;
+	mon += 1;
+
+	if (mon <= 2)
+		year--;
+	era = floor_div(year, 400);
+	yoe = year - era * 400;				/* [0, 399] */
+	doy = (153 * (mon > 2 ? mon - 3 : mon + 9) + 2) / 5;	/* [0, 365] */
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;	/* [0, 146096] */
+	/* Days beyond the end of the month simply carry over. */
+	return (era * 146097 + doe + mday - 1 - 719468);
+}
+
+void
+__archive_civil_from_days(int64_t days, int64_t *year, int *mon, int *mday)
+{
+	int64_t era, doe, yoe, doy, mp;
+
+	days += 719468;
+	era = floor_div(days, 146097);
+	doe = days - era * 146097;			/* [0, 146096] */
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);	/* [0, 365] */
+	mp = (5 * doy + 2) / 153;			/* [0, 11] */
+	*mday = (int)(doy - (153 * mp + 2) / 5 + 1);
+	*mon = (int)(mp < 10 ? mp + 3 : mp - 9);
+	*year = yoe + era * 400 + (*mon <= 2);
+}
+
+int64_t
+__archive_timegm(const struct tm *tm)
+{
+	int64_t days;
+
+	days = __archive_days_from_civil((int64_t)tm->tm_year + 1900,
+	    (int64_t)tm->tm_mon + 1, tm->tm_mday);
+	return (days * 86400 + (int64_t)tm->tm_hour * 3600
+	    + (int64_t)tm->tm_min * 60 + tm->tm_sec);
+}
+
+struct tm *
+__archive_gmtime(int64_t t, struct tm *tm)
+{
+	int64_t days, secs, year;
+	int mon, mday;
+
+	days = floor_div(t, 86400);
+	secs = t - days * 86400;
+	__archive_civil_from_days(days, &year, &mon, &mday);
+	if (year - 1900 > INT_MAX || year - 1900 < INT_MIN)
+		return (NULL);
+	memset(tm, 0, sizeof(*tm));
+	tm->tm_year = (int)(year - 1900);
+	tm->tm_mon = mon - 1;
+	tm->tm_mday = mday;
+	tm->tm_hour = (int)(secs / 3600);
+	tm->tm_min = (int)(secs / 60 % 60);
+	tm->tm_sec = (int)(secs % 60);
+	/* 1970-01-01 was a Thursday. */
+	tm->tm_wday = (int)(days - floor_div(days + 4, 7) * 7 + 4);
+	tm->tm_yday = (int)(days - __archive_days_from_civil(year, 1, 1));
+	return (tm);
+}
+
+/*
+ * Local time.
+ */
+
+static int
+libc_localtime(time_t t, struct tm *tm)
+{
+#if defined(HAVE_LOCALTIME_R)
+#if defined(HAVE_TZSET)
+	/* localtime_r() need not notice a change of TZ. */
+	tzset();
+#endif
+	return (localtime_r(&t, tm) != NULL ? 0 : -1);
+#elif defined(HAVE__LOCALTIME64_S)
+	__time64_t tmptime = t;
+
+	return (_localtime64_s(tm, &tmptime) == 0 ? 0 : -1);
+#else
+	struct tm *p = localtime(&t);
+
+	if (p == NULL)
+		return (-1);
+	memcpy(tm, p, sizeof(*tm));
+	return (0);
+#endif
+}
+
+/* UTC offset in effect at time 't'. */
+static int
+libc_utc_offset(int64_t t, int64_t *offset, int *isdst)
+{
+	struct tm tm;
+
+	if ((time_t)t != t || libc_localtime((time_t)t, &tm) != 0)
+		return (-1);
+	*offset = __archive_timegm(&tm) - t;
+	*isdst = tm.tm_isdst > 0;
+	return (0);
+}
+
+/* UTC offset mktime() applies to the wall clock time 'local'. */
+static int
+libc_local_offset(int64_t local, int64_t *offset, int *isdst)
+{
+	struct tm tm;
+	time_t t;
+
+	if (__archive_gmtime(local, &tm) == NULL)
+		return (-1);
+	tm.tm_isdst = -1;
+	t = mktime(&tm);
+	if (t == (time_t)-1)
+		return (-1);
+	*offset = local - t;
+	*isdst = 0;
+	return (0);
+}
+
+/*
+ * Find the span holding 'x' whose offset is known to be constant.
+ * This assumes that no time zone has two transitions less than 16
+ * days apart.
+ */
+static const struct archive_tz_span *
+tz_lookup(struct archive_tz_spans *cache, int64_t x,
+    int (*probe)(int64_t, int64_t *, int *))
+{
+	static const int64_t span_size[2] = { 32 * 86400, 86400 };
+	struct archive_tz_span *e;
+	int64_t key, start, off[3];
+	int level, dst[3];
+
+	for (level = 0; level < 2; level++) {
+		key = floor_div(x, span_size[level]);
+		if (level == 0)
+			e = &cache->blocks[(uint64_t)key % ARCHIVE_TZ_BLOCKS];
+		else
+			e = &cache->days[(uint64_t)key % ARCHIVE_TZ_DAYS];
+		if (e->state != 0 && e->key == key) {
+			if (e->state > 0)
+				return (e);
+			continue;
+		}
+		start = key * span_size[level];
+		if (probe(start, &off[0], &dst[0]) != 0 ||
+		    probe(start + span_size[level] / 2, &off[1], &dst[1]) != 0 ||
+		    probe(start + span_size[level] - 1, &off[2], &dst[2]) != 0)
+			return (NULL);
+		e->key = key;
+		if (off[0] != off[1] || off[0] != off[2] ||
+		    dst[0] != dst[1] || dst[0] != dst[2] ||
+		    off[0] <= -86400 || off[0] >= 86400) {
+			e->state = -1;
+			continue;
+		}
+		e->offset = (int32_t)off[0];
+		e->isdst = (signed char)dst[0];
+		e->state = 1;
+		return (e);
+	}
+	return (NULL);
+}
+
+time_t
+__archive_mktime(struct archive_tz_cache *cache, const struct tm *tm)
+{
+	const struct archive_tz_span *e;
+	struct tm tmp;
+	int64_t local, t;
+
+	local = __archive_timegm(tm);
+	e = tz_lookup(&cache->from_local, local, libc_local_offset);
+	if (e == NULL) {
+		/* Near a transition; let libc sort it out. */
+		memcpy(&tmp, tm, sizeof(tmp));
+		tmp.tm_isdst = -1;
+		return (mktime(&tmp));
+	}
+	t = local - e->offset;
+	if ((time_t)t != t)
+		return ((time_t)-1);
+	return ((time_t)t);
+}
+
+struct tm *
+__archive_localtime(struct archive_tz_cache *cache, time_t t,
+    struct tm *tm, long *gmtoff)
+{
+	const struct archive_tz_span *e;
+
+	e = tz_lookup(&cache->to_local, t, libc_utc_offset);
+	if (e == NULL) {
+		/* Near a transition; let libc sort it out. */
+		if (libc_localtime(t, tm) != 0)
+			return (NULL);
+		if (gmtoff != NULL)
+			*gmtoff = (long)(__archive_timegm(tm) - t);
+		return (tm);
+	}
+	if (__archive_gmtime((int64_t)t + e->offset, tm) == NULL)
+		return (NULL);
+	tm->tm_isdst = e->isdst;
+#if defined(HAVE_STRUCT_TM_TM_GMTOFF)
+	tm->tm_gmtoff = e->offset;
+#elif defined(HAVE_STRUCT_TM___TM_GMTOFF)
+	tm->__tm_gmtoff = e->offset;
+#endif
+	if (gmtoff != NULL)
+		*gmtoff = e->offset;
+	return (tm);
+}
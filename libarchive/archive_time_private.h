@@ -0,0 +1,89 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_TIME_PRIVATE_H_INCLUDED
+#define	ARCHIVE_TIME_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#ifndef __LIBARCHIVE_TEST
+#error This header is only to be used internally to libarchive.
+#endif
+#endif
+
+#include <time.h>
+
+/*
+ * Calendar arithmetic for the proleptic Gregorian calendar, so that
+ * readers and writers don't have to go through timegm(), gmtime(),
+ * mktime() and localtime() for every entry.
+ */
+
+/* Days since 1970-01-01.  'mon' is 1-based; out of range months and
+ * days are carried into the year and month like timegm() does. */
+int64_t	__archive_days_from_civil(int64_t year, int64_t mon, int64_t mday);
+void	__archive_civil_from_days(int64_t days, int64_t *year, int *mon,
+	    int *mday);
+
+/* Like timegm(), but *tm is not modified and tm_isdst is ignored. */
+int64_t	__archive_timegm(const struct tm *);
+/* Like gmtime_r().  Returns NULL if the year doesn't fit in tm_year. */
+struct tm *__archive_gmtime(int64_t, struct tm *);
+
+/*
+ * Local time conversions.  The UTC offset is looked up from libc for
+ * a 32-day block, or failing that a single day, and reused for every
+ * time in it as long as libc gives the same offset at the start, the
+ * middle and the end of that span.  Spans with a time zone transition
+ * always go to libc.  The cache must be zero-filled before first use
+ * and belongs to a single archive object.
+ */
+#define	ARCHIVE_TZ_BLOCKS	256	/* About 22 years. */
+#define	ARCHIVE_TZ_DAYS		64
+
+struct archive_tz_span {
+	int64_t		 key;
+	int32_t		 offset;	/* Seconds east of UTC. */
+	signed char	 isdst;
+	signed char	 state;		/* 0 unused, 1 stable, -1 not. */
+};
+
+struct archive_tz_spans {
+	struct archive_tz_span	 blocks[ARCHIVE_TZ_BLOCKS];
+	struct archive_tz_span	 days[ARCHIVE_TZ_DAYS];
+};
+
+struct archive_tz_cache {
+	struct archive_tz_spans	 to_local;
+	struct archive_tz_spans	 from_local;
+};
+
+/* Like mktime() with tm_isdst == -1, but *tm is not modified. */
+time_t	__archive_mktime(struct archive_tz_cache *, const struct tm *);
+/* Like localtime_r().  If 'gmtoff' isn't NULL it is set to the UTC
+ * offset in seconds east of UTC. */
+struct tm *__archive_localtime(struct archive_tz_cache *, time_t,
+	    struct tm *, long *gmtoff);
+
+#endif	/* ARCHIVE_TIME_PRIVATE_H_INCLUDED */
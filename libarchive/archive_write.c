@@ -185,6 +185,20 @@ archive_write_get_bytes_in_last_block(struct archive *_a)
 	return (a->bytes_in_last_block);
 }
 
+int
+archive_write_get_auto_compression_stats(struct archive *_a,
+    la_int64_t *compressed, la_int64_t *stored)
+{
+	struct archive_write *a = (struct archive_write *)_a;
+	archive_check_magic(&a->archive, ARCHIVE_WRITE_MAGIC,
+	    ARCHIVE_STATE_ANY, "archive_write_get_auto_compression_stats");
+	if (compressed != NULL)
+		*compressed = a->auto_entries_compressed;
+	if (stored != NULL)
+		*stored = a->auto_entries_stored;
+	return (ARCHIVE_OK);
+}
+
 /*
  * dev/ino of a file to be rejected.  Used to prevent adding
  * an archive to itself recursively.
@@ -60,7 +60,8 @@ static int archive_filter_b64encode_write(struct archive_write_filter *,
     const void *, size_t);
 static int archive_filter_b64encode_close(struct archive_write_filter *);
 static int archive_filter_b64encode_free(struct archive_write_filter *);
-static void la_b64_encode(struct archive_string *, const unsigned char *, size_t);
+static int la_b64_encode_line(struct archive_write_filter *,
+    const unsigned char *, size_t);
 static int64_t atol8(const char *, size_t);
 
 static const char base64[] = {
@@ -174,38 +175,59 @@ archive_filter_b64encode_open(struct archive_write_filter *f)
 	return (0);
 }
 
-static void
-la_b64_encode(struct archive_string *as, const unsigned char *p, size_t len)
+/*
+ * Encode one line of input, at most LBYTES bytes, and pass every full
+ * block of encoded data to the next filter.  Flushing after each line
+ * keeps encoded_buff small no matter how much data a single write
+ * call delivers.
+ */
+static int
+la_b64_encode_line(struct archive_write_filter *f, const unsigned char *p,
+    size_t len)
 {
-	int c;
+	struct private_b64encode *state = (struct private_b64encode *)f->data;
+	struct archive_string *as = &state->encoded_buff;
+	char *out;
+	int ret;
+
+	/* Four characters per three bytes, plus padding and a newline. */
+	if (archive_string_ensure(as, as->length + (LBYTES / 3) * 4 + 5)
+	    == NULL) {
+		archive_set_error(f->archive, ENOMEM,
+		    "Can't allocate data for b64encode buffer");
+		return (ARCHIVE_FATAL);
+	}
+	out = as->s + as->length;
 
 	for (; len >= 3; p += 3, len -= 3) {
-		c = p[0] >> 2;
-		archive_strappend_char(as, base64[c]);
-		c = ((p[0] & 0x03) << 4) | ((p[1] & 0xf0) >> 4);
-		archive_strappend_char(as, base64[c]);
-		c = ((p[1] & 0x0f) << 2) | ((p[2] & 0xc0) >> 6);
-		archive_strappend_char(as, base64[c]);
-		c = p[2] & 0x3f;
-		archive_strappend_char(as, base64[c]);
+		out[0] = base64[p[0] >> 2];
+		out[1] = base64[((p[0] & 0x03) << 4) | (p[1] >> 4)];
+		out[2] = base64[((p[1] & 0x0f) << 2) | (p[2] >> 6)];
+		out[3] = base64[p[2] & 0x3f];
+		out += 4;
 	}
 	if (len > 0) {
-		c = p[0] >> 2;
-		archive_strappend_char(as, base64[c]);
-		c = (p[0] & 0x03) << 4;
+		*out++ = base64[p[0] >> 2];
 		if (len == 1) {
-			archive_strappend_char(as, base64[c]);
-			archive_strappend_char(as, '=');
-			archive_strappend_char(as, '=');
+			*out++ = base64[(p[0] & 0x03) << 4];
+			*out++ = '=';
 		} else {
-			c |= (p[1] & 0xf0) >> 4;
-			archive_strappend_char(as, base64[c]);
-			c = (p[1] & 0x0f) << 2;
-			archive_strappend_char(as, base64[c]);
-			archive_strappend_char(as, '=');
+			*out++ = base64[((p[0] & 0x03) << 4) | (p[1] >> 4)];
+			*out++ = base64[(p[1] & 0x0f) << 2];
 		}
+		*out++ = '=';
 	}
-	archive_strappend_char(as, '\n');
+	*out++ = '\n';
+	as->length = out - as->s;
+
+	while (archive_strlen(as) >= state->bs) {
+		ret = __archive_write_filter(f->next_filter, as->s, state->bs);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+		memmove(as->s, as->s + state->bs, as->length - state->bs);
+		as->length -= state->bs;
+	}
+	return (ARCHIVE_OK);
 }
 
 /*
@@ -229,26 +251,23 @@ archive_filter_b64encode_write(struct archive_write_filter *f, const void *buff,
 		}
 		if (state->hold_len < LBYTES)
 			return (ret);
-		la_b64_encode(&state->encoded_buff, state->hold, LBYTES);
+		ret = la_b64_encode_line(f, state->hold, LBYTES);
+		if (ret != ARCHIVE_OK)
+			return (ret);
 		state->hold_len = 0;
 	}
 
-	for (; length >= LBYTES; length -= LBYTES, p += LBYTES)
-		la_b64_encode(&state->encoded_buff, p, LBYTES);
+	for (; length >= LBYTES; length -= LBYTES, p += LBYTES) {
+		ret = la_b64_encode_line(f, p, LBYTES);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
 
 	/* Save remaining bytes. */
 	if (length > 0) {
 		memcpy(state->hold, p, length);
 		state->hold_len = length;
 	}
-	while (archive_strlen(&state->encoded_buff) >= state->bs) {
-		ret = __archive_write_filter(f->next_filter,
-		    state->encoded_buff.s, state->bs);
-		memmove(state->encoded_buff.s,
-		    state->encoded_buff.s + state->bs,
-		    state->encoded_buff.length - state->bs);
-		state->encoded_buff.length -= state->bs;
-	}
 
 	return (ret);
 }
@@ -261,10 +280,14 @@ static int
 archive_filter_b64encode_close(struct archive_write_filter *f)
 {
 	struct private_b64encode *state = (struct private_b64encode *)f->data;
+	int ret;
 
 	/* Flush remaining bytes. */
-	if (state->hold_len != 0)
-		la_b64_encode(&state->encoded_buff, state->hold, state->hold_len);
+	if (state->hold_len != 0) {
+		ret = la_b64_encode_line(f, state->hold, state->hold_len);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
 	archive_string_sprintf(&state->encoded_buff, "====\n");
 	/* Write the last block */
 	archive_write_set_bytes_in_last_block(f->archive, 1);
@@ -100,8 +100,9 @@ struct private_data {
 
 	int cur_code, cur_fcode;
 
-	int bit_offset;
-	unsigned char bit_buf;
+	int bit_offset;			/* Bit position in the code group. */
+	int bit_count;			/* Bits waiting in bit_buf. */
+	uint64_t bit_buf;
 
 	unsigned char	*compressed;
 	size_t		 compressed_buffer_size;
@@ -186,6 +187,7 @@ archive_compressor_compress_open(struct archive_write_filter *f)
 	state->in_count = 0;		/* Length of input. */
 	state->bit_buf = 0;
 	state->bit_offset = 0;
+	state->bit_count = 0;
 	state->out_count = 3;		/* Includes 3-byte header mojo. */
 	state->compress_ratio = 0;
 	state->checkpoint = CHECK_GAP;
@@ -215,28 +217,33 @@ archive_compressor_compress_open(struct archive_write_filter *f)
  * Assumptions:
  *	Chars are 8 bits long.
  * Algorithm:
- * 	Maintain a BITS character long buffer (so that 8 codes will
- * fit in it exactly).  Use the VAX insv instruction to insert each
- * code in turn.  When the buffer fills up empty it and start over.
+ * 	Codes are collected in a 64-bit buffer and moved to the output
+ * a few bytes at a time.  Codes are grouped into blocks of n_bits
+ * bytes (so that 8 codes fit in each exactly); when the code size
+ * changes, the current block is padded out, because that is what the
+ * original compress did.
  */
 
-static const unsigned char rmask[9] =
-	{0x00, 0x01, 0x03, 0x07, 0x0f, 0x1f, 0x3f, 0x7f, 0xff};
-
 static int
-output_byte(struct archive_write_filter *f, unsigned char c)
+output_bytes(struct archive_write_filter *f)
 {
 	struct private_data *state = f->data;
+	int ret;
 
-	state->compressed[state->compressed_offset++] = c;
-	++state->out_count;
+	while (state->bit_count >= 8) {
+		state->compressed[state->compressed_offset++] =
+		    (unsigned char)state->bit_buf;
+		state->bit_buf >>= 8;
+		state->bit_count -= 8;
+		++state->out_count;
 
-	if (state->compressed_buffer_size == state->compressed_offset) {
-		int ret = __archive_write_filter(f->next_filter,
-		    state->compressed, state->compressed_buffer_size);
-		if (ret != ARCHIVE_OK)
-			return ARCHIVE_FATAL;
-		state->compressed_offset = 0;
+		if (state->compressed_buffer_size == state->compressed_offset) {
+			ret = __archive_write_filter(f->next_filter,
+			    state->compressed, state->compressed_buffer_size);
+			if (ret != ARCHIVE_OK)
+				return ARCHIVE_FATAL;
+			state->compressed_offset = 0;
+		}
 	}
 
 	return ARCHIVE_OK;
@@ -246,54 +253,46 @@ static int
 output_code(struct archive_write_filter *f, int ocode)
 {
 	struct private_data *state = f->data;
-	int bits, ret, clear_flg, bit_offset;
-
-	clear_flg = ocode == CLEAR;
+	int ret;
 
-	/*
-	 * Since ocode is always >= 8 bits, only need to mask the first
-	 * hunk on the left.
-	 */
-	bit_offset = state->bit_offset % 8;
-	state->bit_buf |= (ocode << bit_offset) & 0xff;
-	output_byte(f, state->bit_buf);
-
-	bits = state->code_len - (8 - bit_offset);
-	ocode >>= 8 - bit_offset;
-	/* Get any 8 bit parts in the middle (<=1 for up to 16 bits). */
-	if (bits >= 8) {
-		output_byte(f, ocode & 0xff);
-		ocode >>= 8;
-		bits -= 8;
-	}
-	/* Last bits. */
+	state->bit_buf |= (uint64_t)ocode << state->bit_count;
+	state->bit_count += state->code_len;
 	state->bit_offset += state->code_len;
-	state->bit_buf = ocode & rmask[bits];
 	if (state->bit_offset == state->code_len * 8)
 		state->bit_offset = 0;
 
+	if (state->bit_count >= 32) {
+		ret = output_bytes(f);
+		if (ret != ARCHIVE_OK)
+			return ret;
+	}
+
 	/*
 	 * If the next entry is going to be too big for the ocode size,
 	 * then increase it, if possible.
 	 */
-	if (clear_flg || state->first_free > state->cur_maxcode) {
+	if (ocode == CLEAR || state->first_free > state->cur_maxcode) {
 	       /*
-		* Write the whole buffer, because the input side won't
+		* Write the whole block, because the input side won't
 		* discover the size increase until after it has read it.
 		*/
+		ret = output_bytes(f);
+		if (ret != ARCHIVE_OK)
+			return ret;
 		if (state->bit_offset > 0) {
-			while (state->bit_offset < state->code_len * 8) {
-				ret = output_byte(f, state->bit_buf);
-				if (ret != ARCHIVE_OK)
-					return ret;
-				state->bit_offset += 8;
-				state->bit_buf = 0;
-			}
+			/* bit_buf is zero above bit_count, so this pads
+			 * with zero bits. */
+			state->bit_count += state->code_len * 8 -
+			    state->bit_offset;
+			ret = output_bytes(f);
+			if (ret != ARCHIVE_OK)
+				return ret;
 		}
 		state->bit_buf = 0;
+		state->bit_count = 0;
 		state->bit_offset = 0;
 
-		if (clear_flg) {
+		if (ocode == CLEAR) {
 			state->code_len = 9;
 			state->cur_maxcode = MAXCODE(state->code_len);
 		} else {
@@ -312,17 +311,10 @@ static int
 output_flush(struct archive_write_filter *f)
 {
 	struct private_data *state = f->data;
-	int ret;
 
 	/* At EOF, write the rest of the buffer. */
-	if (state->bit_offset % 8) {
-		state->code_len = (state->bit_offset % 8 + 7) / 8;
-		ret = output_byte(f, state->bit_buf);
-		if (ret != ARCHIVE_OK)
-			return ret;
-	}
-
-	return (ARCHIVE_OK);
+	state->bit_count = (state->bit_count + 7) & ~7;
+	return output_bytes(f);
 }
 
 /*
@@ -333,6 +325,7 @@ archive_compressor_compress_write(struct archive_write_filter *f,
     const void *buff, size_t length)
 {
 	struct private_data *state = (struct private_data *)f->data;
+	int64_t out_count;
 	int i;
 	int ratio;
 	int c, disp, ret;
@@ -391,9 +384,11 @@ archive_compressor_compress_write(struct archive_write_filter *f,
 
 		state->checkpoint = state->in_count + CHECK_GAP;
 
-		if (state->in_count <= 0x007fffff && state->out_count != 0)
-			ratio = (int)(state->in_count * 256 / state->out_count);
-		else if ((ratio = (int)(state->out_count / 256)) == 0)
+		/* Count the whole bytes still sitting in bit_buf. */
+		out_count = state->out_count + state->bit_count / 8;
+		if (state->in_count <= 0x007fffff && out_count != 0)
+			ratio = (int)(state->in_count * 256 / out_count);
+		else if ((ratio = (int)(out_count / 256)) == 0)
 			ratio = 0x7fffffff;
 		else
 			ratio = (int)(state->in_count / ratio);
@@ -60,7 +60,8 @@ static int archive_filter_uuencode_write(struct archive_write_filter *,
     const void *, size_t);
 static int archive_filter_uuencode_close(struct archive_write_filter *);
 static int archive_filter_uuencode_free(struct archive_write_filter *);
-static void uu_encode(struct archive_string *, const unsigned char *, size_t);
+static int uu_encode_line(struct archive_write_filter *,
+    const unsigned char *, size_t);
 static int64_t atol8(const char *, size_t);
 
 /*
@@ -163,40 +164,73 @@ archive_filter_uuencode_open(struct archive_write_filter *f)
 	return (0);
 }
 
-static void
-uu_encode(struct archive_string *as, const unsigned char *p, size_t len)
+/* Map a 6-bit value to its uuencoded character; zero becomes '`'. */
+#define UUENC(c)	((c) ? (c) + 0x20 : '`')
+
+/*
+ * Encode one line of input, at most LBYTES bytes, and pass every full
+ * block of encoded data to the next filter.  Flushing after each line
+ * keeps encoded_buff small no matter how much data a single write
+ * call delivers.
+ */
+static int
+uu_encode_line(struct archive_write_filter *f, const unsigned char *p,
+    size_t len)
 {
-	int c;
+	struct private_uuencode *state = (struct private_uuencode *)f->data;
+	struct archive_string *as = &state->encoded_buff;
+	char *out;
+	int c, ret;
+
+	/* A length character, four characters per three bytes and
+	 * a newline. */
+	if (archive_string_ensure(as, as->length + (LBYTES / 3) * 4 + 6)
+	    == NULL) {
+		archive_set_error(f->archive, ENOMEM,
+		    "Can't allocate data for uuencode buffer");
+		return (ARCHIVE_FATAL);
+	}
+	out = as->s + as->length;
 
 	c = (int)len;
-	archive_strappend_char(as, c?c + 0x20:'`');
+	*out++ = UUENC(c);
 	for (; len >= 3; p += 3, len -= 3) {
 		c = p[0] >> 2;
-		archive_strappend_char(as, c?c + 0x20:'`');
-		c = ((p[0] & 0x03) << 4) | ((p[1] & 0xf0) >> 4);
-		archive_strappend_char(as, c?c + 0x20:'`');
-		c = ((p[1] & 0x0f) << 2) | ((p[2] & 0xc0) >> 6);
-		archive_strappend_char(as, c?c + 0x20:'`');
+		out[0] = UUENC(c);
+		c = ((p[0] & 0x03) << 4) | (p[1] >> 4);
+		out[1] = UUENC(c);
+		c = ((p[1] & 0x0f) << 2) | (p[2] >> 6);
+		out[2] = UUENC(c);
 		c = p[2] & 0x3f;
-		archive_strappend_char(as, c?c + 0x20:'`');
+		out[3] = UUENC(c);
+		out += 4;
 	}
 	if (len > 0) {
 		c = p[0] >> 2;
-		archive_strappend_char(as, c?c + 0x20:'`');
+		*out++ = UUENC(c);
 		c = (p[0] & 0x03) << 4;
 		if (len == 1) {
-			archive_strappend_char(as, c?c + 0x20:'`');
-			archive_strappend_char(as, '`');
-			archive_strappend_char(as, '`');
+			*out++ = UUENC(c);
+			*out++ = '`';
 		} else {
-			c |= (p[1] & 0xf0) >> 4;
-			archive_strappend_char(as, c?c + 0x20:'`');
+			c |= p[1] >> 4;
+			*out++ = UUENC(c);
 			c = (p[1] & 0x0f) << 2;
-			archive_strappend_char(as, c?c + 0x20:'`');
-			archive_strappend_char(as, '`');
+			*out++ = UUENC(c);
 		}
+		*out++ = '`';
 	}
-	archive_strappend_char(as, '\n');
+	*out++ = '\n';
+	as->length = out - as->s;
+
+	while (archive_strlen(as) >= state->bs) {
+		ret = __archive_write_filter(f->next_filter, as->s, state->bs);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+		memmove(as->s, as->s + state->bs, as->length - state->bs);
+		as->length -= state->bs;
+	}
+	return (ARCHIVE_OK);
 }
 
 /*
@@ -220,26 +254,23 @@ archive_filter_uuencode_write(struct archive_write_filter *f, const void *buff,
 		}
 		if (state->hold_len < LBYTES)
 			return (ret);
-		uu_encode(&state->encoded_buff, state->hold, LBYTES);
+		ret = uu_encode_line(f, state->hold, LBYTES);
+		if (ret != ARCHIVE_OK)
+			return (ret);
 		state->hold_len = 0;
 	}
 
-	for (; length >= LBYTES; length -= LBYTES, p += LBYTES)
-		uu_encode(&state->encoded_buff, p, LBYTES);
+	for (; length >= LBYTES; length -= LBYTES, p += LBYTES) {
+		ret = uu_encode_line(f, p, LBYTES);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
 
 	/* Save remaining bytes. */
 	if (length > 0) {
 		memcpy(state->hold, p, length);
 		state->hold_len = length;
 	}
-	while (archive_strlen(&state->encoded_buff) >= state->bs) {
-		ret = __archive_write_filter(f->next_filter,
-		    state->encoded_buff.s, state->bs);
-		memmove(state->encoded_buff.s,
-		    state->encoded_buff.s + state->bs,
-		    state->encoded_buff.length - state->bs);
-		state->encoded_buff.length -= state->bs;
-	}
 
 	return (ret);
 }
@@ -252,10 +283,14 @@ static int
 archive_filter_uuencode_close(struct archive_write_filter *f)
 {
 	struct private_uuencode *state = (struct private_uuencode *)f->data;
+	int ret;
 
 	/* Flush remaining bytes. */
-	if (state->hold_len != 0)
-		uu_encode(&state->encoded_buff, state->hold, state->hold_len);
+	if (state->hold_len != 0) {
+		ret = uu_encode_line(f, state->hold, state->hold_len);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
 	archive_string_sprintf(&state->encoded_buff, "`\nend\n");
 	/* Write the last block */
 	archive_write_set_bytes_in_last_block(f->archive, 1);
@@ -45,17 +45,23 @@ __FBSDID("$FreeBSD$");
 #include "archive_private.h"
 #include "archive_string.h"
 #include "archive_write_private.h"
+#include "archive_zstd_dict_private.h"
 
 /* Don't compile this if we don't have zstd.h */
 
 struct private_data {
 	int		 compression_level;
+	int		 window_log;	/* 0 = library default. */
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 	ZSTD_CStream	*cstream;
 	int64_t		 total_in;
 	ZSTD_outBuffer	 out;
+#ifdef HAVE_ZSTD_DICT
+	struct archive_zstd_dict *dict;
+#endif
 #else
 	struct archive_write_program_data *pdata;
+	struct archive_string dict_path; /* For "zstd -D". */
 #endif
 };
 
@@ -137,14 +143,61 @@ archive_compressor_zstd_free(struct archive_write_filter *f)
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 	ZSTD_freeCStream(data->cstream);
 	free(data->out.dst);
+#ifdef HAVE_ZSTD_DICT
+	__archive_zstd_dict_release(data->dict);
+#endif
 #else
 	__archive_write_program_free(data->pdata);
+	archive_string_free(&data->dict_path);
 #endif
 	free(data);
 	f->data = NULL;
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Compress with the given dictionary instead of one named by the
+ * "dictionary" option.
+ */
+int
+archive_write_set_zstd_dictionary(struct archive *_a, const void *dict,
+    size_t size)
+{
+	struct archive_write *a = (struct archive_write *)_a;
+	struct archive_write_filter *f;
+
+	archive_check_magic(_a, ARCHIVE_WRITE_MAGIC,
+	    ARCHIVE_STATE_NEW, "archive_write_set_zstd_dictionary");
+
+	for (f = a->filter_first; f != NULL; f = f->next_filter)
+		if (f->code == ARCHIVE_FILTER_ZSTD)
+			break;
+	if (f == NULL) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "No zstd filter has been added");
+		return (ARCHIVE_FATAL);
+	}
+#ifdef HAVE_ZSTD_DICT
+	{
+		struct private_data *data = (struct private_data *)f->data;
+		struct archive_zstd_dict *d;
+
+		d = __archive_zstd_dict_add(_a, dict, size);
+		if (d == NULL)
+			return (ARCHIVE_FATAL);
+		__archive_zstd_dict_release(data->dict);
+		data->dict = d;
+		return (ARCHIVE_OK);
+	}
+#else
+	(void)dict; /* UNUSED */
+	(void)size; /* UNUSED */
+	archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+	    "zstd dictionaries are not supported by this build");
+	return (ARCHIVE_FATAL);
+#endif
+}
+
 static int string_is_numeric (const char* value)
 {
        size_t len = strlen(value);
@@ -204,6 +257,47 @@ archive_compressor_zstd_options(struct archive_write_filter *f, const char *key,
 		}
 		data->compression_level = level;
 		return (ARCHIVE_OK);
+	} else if (strcmp(key, "dictionary") == 0) {
+#ifdef HAVE_ZSTD_DICT
+		struct archive_zstd_dict *d = NULL;
+
+		if (value != NULL) {
+			d = __archive_zstd_dict_load(f->archive, value);
+			if (d == NULL)
+				return (ARCHIVE_FATAL);
+		}
+		__archive_zstd_dict_release(data->dict);
+		data->dict = d;
+		return (ARCHIVE_OK);
+#elif HAVE_ZSTD_H && HAVE_LIBZSTD
+		archive_set_error(f->archive, ARCHIVE_ERRNO_MISC,
+		    "zstd dictionaries need libzstd 1.4.0 or later");
+		return (ARCHIVE_FATAL);
+#else
+		if (value == NULL)
+			archive_string_empty(&data->dict_path);
+		else
+			archive_strcpy(&data->dict_path, value);
+		return (ARCHIVE_OK);
+#endif
+	} else if (strcmp(key, "max-window") == 0) {
+		int log = 0;
+
+		if (value != NULL)
+			log = __archive_zstd_window_log(value);
+		if (log < 0) {
+			archive_set_error(f->archive, ARCHIVE_ERRNO_MISC,
+			    "Invalid zstd window size: %s", value);
+			return (ARCHIVE_FATAL);
+		}
+#if HAVE_ZSTD_H && HAVE_LIBZSTD && !defined(HAVE_ZSTD_DICT)
+		archive_set_error(f->archive, ARCHIVE_ERRNO_MISC,
+		    "Limiting the zstd window needs libzstd 1.4.0 or later");
+		return (ARCHIVE_FATAL);
+#else
+		data->window_log = log;
+		return (ARCHIVE_OK);
+#endif
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -252,6 +346,36 @@ archive_compressor_zstd_open(struct archive_write_filter *f)
 		return (ARCHIVE_FATAL);
 	}
 
+#ifdef HAVE_ZSTD_DICT
+	if (data->window_log > 0) {
+		const size_t ret = ZSTD_CCtx_setParameter(data->cstream,
+		    ZSTD_c_windowLog, data->window_log);
+		if (ZSTD_isError(ret)) {
+			archive_set_error(f->archive, ARCHIVE_ERRNO_MISC,
+			    "Can't limit the zstd window: %s",
+			    ZSTD_getErrorName(ret));
+			return (ARCHIVE_FATAL);
+		}
+	}
+	if (data->dict != NULL) {
+		const ZSTD_CDict *cdict;
+		size_t ret;
+
+		/* Digested once per level and shared between archives. */
+		cdict = __archive_zstd_dict_cdict(f->archive, data->dict,
+		    data->compression_level);
+		if (cdict == NULL)
+			return (ARCHIVE_FATAL);
+		ret = ZSTD_CCtx_refCDict(data->cstream, cdict);
+		if (ZSTD_isError(ret)) {
+			archive_set_error(f->archive, ARCHIVE_ERRNO_MISC,
+			    "Can't use zstd dictionary: %s",
+			    ZSTD_getErrorName(ret));
+			return (ARCHIVE_FATAL);
+		}
+	}
+#endif
+
 	return (ARCHIVE_OK);
 }
 
@@ -366,6 +490,13 @@ archive_compressor_zstd_open(struct archive_write_filter *f)
 		archive_strcat(&as, " --ultra");
 	}
 
+	if (data->window_log > 0)
+		archive_string_sprintf(&as, " --zstd=wlog=%d",
+		    data->window_log);
+	if (archive_strlen(&data->dict_path) > 0)
+		archive_string_sprintf(&as, " -D \"%s\"",
+		    data->dict_path.s);
+
 	f->write = archive_compressor_zstd_write;
 	r = __archive_write_program_open(f, data->pdata, as.s);
 	archive_string_free(&as);
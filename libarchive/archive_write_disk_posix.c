@@ -146,6 +146,7 @@ __FBSDID("$FreeBSD$");
 #include "archive_endian.h"
 #include "archive_entry.h"
 #include "archive_private.h"
+#include "archive_random_private.h"
 #include "archive_write_disk_private.h"
 
 #ifndef O_BINARY
@@ -255,6 +256,14 @@ struct archive_write_disk {
 	struct archive_string	 _name_data; /* backing store for 'name' */
 	char			*tmpname; /* Temporary name * */
 	struct archive_string	 _tmpname_data; /* backing store for 'tmpname' */
+	/* Set if 'fd' is an unnamed O_TMPFILE that still needs a link. */
+	int			 tmpfile_anon;
+	/* One open file per file system to syncfs() at close (_SYNC_BATCH). */
+	int			*sync_fds;
+	dev_t			*sync_devs;
+	size_t			 sync_count;
+	size_t			 sync_size;
+	int			 sync_all;
 	/* Tasks remaining for this object. */
 	int			 todo;
 	/* Tasks deferred until end-of-archive. */
@@ -271,6 +280,11 @@ struct archive_write_disk {
 	int64_t			 total_bytes_written;
 	/* Maximum size of file, -1 if unknown. */
 	int64_t			 filesize;
+	/* Data gathered for one large write (_PREALLOCATE). */
+	char			*write_buf;
+	size_t			 write_buf_len;
+	int64_t			 write_buf_offset;
+	int			 buffer_writes;
 	/* Dir we were in before this restore; only for deep paths. */
 	int			 restore_pwd;
 	/* Mode we should use for this entry; affected by _PERM and umask. */
@@ -310,6 +324,12 @@ struct archive_write_disk {
 #endif
 };
 
+/*
+ * With ARCHIVE_EXTRACT_PREALLOCATE, files at least this big get their
+ * space allocated up front and are written in chunks of this size.
+ */
+#define	PREALLOCATE_CHUNK	(1024 * 1024)
+
 /*
  * Default mode for dirs created automatically (will be modified by umask).
  * Note that POSIX specifies 0777 for implicitly-created dirs, "modified
@@ -376,7 +396,9 @@ static int	create_parent_dir(struct archive_write_disk *, char *);
 static ssize_t	hfs_write_data_block(struct archive_write_disk *,
 		    const char *, size_t);
 static int	fixup_appledouble(struct archive_write_disk *, const char *);
+static int	flush_write_buf(struct archive_write_disk *);
 static int	older(struct stat *, struct archive_entry *);
+static void	preallocate_file(struct archive_write_disk *);
 static int	restore_entry(struct archive_write_disk *);
 static int	set_mac_metadata(struct archive_write_disk *, const char *,
 				 const void *, size_t);
@@ -409,12 +431,207 @@ static ssize_t	_archive_write_disk_data(struct archive *, const void *,
 static ssize_t	_archive_write_disk_data_block(struct archive *, const void *,
 		    size_t, int64_t);
 
+/* Store the directory that holds 'name' in 'dir'. */
+static void
+la_parent_dir(const char *name, struct archive_string *dir)
+{
+	const char *slash;
+
+	archive_string_empty(dir);
+	slash = strrchr(name, '/');
+	if (slash == NULL)
+		archive_strcpy(dir, ".");
+	else if (slash == name)
+		archive_strcpy(dir, "/");
+	else
+		archive_strncpy(dir, name, slash - name);
+}
+
+#if defined(O_TMPFILE) && defined(HAVE_LINKAT)
+/*
+ * Create an unnamed file in the destination directory.  Nothing is
+ * visible in the file system while the data is written, so an
+ * interrupted extraction leaves no partial temporary file behind.
+ */
+static int
+la_open_tmpfile(struct archive_write_disk *a, mode_t mode)
+{
+	int fd;
+
+	la_parent_dir(a->name, &a->_tmpname_data);
+	fd = open(a->_tmpname_data.s,
+	    O_TMPFILE | O_WRONLY | O_BINARY | O_CLOEXEC, mode);
+	if (fd < 0)
+		return (-1);
+	if (fchmod(fd, mode) == -1) {
+		close(fd);
+		return (-1);
+	}
+	a->tmpfile_anon = 1;
+	a->tmpname = NULL;
+	return (fd);
+}
+
+/*
+ * Give the finished file a temporary name next to the destination.
+ * linkat() can't replace an existing file, so this is done just
+ * before the file is renamed over the destination; the name is only
+ * visible between the two calls.
+ */
+static int
+la_link_tmpfile(struct archive_write_disk *a)
+{
+	static const char chars[] =
+	    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	char procpath[64];
+	unsigned char rnd[6];
+	char *p;
+	int i, tries;
+
+	snprintf(procpath, sizeof(procpath), "/proc/self/fd/%d", a->fd);
+	for (tries = 0; tries < 100; tries++) {
+		archive_string_empty(&a->_tmpname_data);
+		archive_string_sprintf(&a->_tmpname_data, "%s.XXXXXX",
+		    a->name);
+		archive_random(rnd, sizeof(rnd));
+		p = a->_tmpname_data.s + a->_tmpname_data.length - 6;
+		for (i = 0; i < 6; i++)
+			p[i] = chars[rnd[i] % (sizeof(chars) - 1)];
+
+		if (linkat(AT_FDCWD, procpath, AT_FDCWD,
+		    a->_tmpname_data.s, AT_SYMLINK_FOLLOW) == 0)
+			break;
+#ifdef AT_EMPTY_PATH
+		/* No /proc; this needs CAP_DAC_READ_SEARCH. */
+		if (errno == ENOENT && linkat(a->fd, "", AT_FDCWD,
+		    a->_tmpname_data.s, AT_EMPTY_PATH) == 0)
+			break;
+#endif
+		if (errno != EEXIST)
+			return (-1);
+	}
+	if (tries == 100)
+		return (-1);
+	a->tmpname = a->_tmpname_data.s;
+	return (0);
+}
+#endif
+
+/*
+ * Start writing back the current file.  With _SYNC_PER_FILE this runs
+ * while the metadata is restored; la_sync_file() then waits for it.
+ */
+static void
+la_start_writeback(struct archive_write_disk *a)
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+	if (a->fd >= 0 && (a->flags &
+	    (ARCHIVE_EXTRACT_SYNC_PER_FILE | ARCHIVE_EXTRACT_SYNC_BATCH)))
+		(void)sync_file_range(a->fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#else
+	(void)a; /* UNUSED */
+#endif
+}
+
+/*
+ * Make the current file's data durable before it is closed (and,
+ * with _SAFE_WRITES, before it is renamed into place), or remember
+ * its file system for the syncfs() at close.
+ */
+static int
+la_sync_file(struct archive_write_disk *a)
+{
+	struct stat st;
+	size_t i;
+	int r;
+
+	if (a->flags & ARCHIVE_EXTRACT_SYNC_PER_FILE) {
+#ifdef HAVE_FDATASYNC
+		r = fdatasync(a->fd);
+#else
+		r = fsync(a->fd);
+#endif
+		if (r == -1) {
+			archive_set_error(&a->archive, errno,
+			    "Failed to sync file");
+			return (ARCHIVE_FAILED);
+		}
+		return (ARCHIVE_OK);
+	}
+
+	if (!(a->flags & ARCHIVE_EXTRACT_SYNC_BATCH) ||
+	    fstat(a->fd, &st) == -1)
+		return (ARCHIVE_OK);
+	for (i = 0; i < a->sync_count; i++) {
+		if (a->sync_devs[i] == st.st_dev)
+			return (ARCHIVE_OK);
+	}
+	if (a->sync_count == a->sync_size) {
+		size_t new_size = a->sync_size ? a->sync_size * 2 : 4;
+		int *fds;
+		dev_t *devs;
+
+		fds = realloc(a->sync_fds, new_size * sizeof(*fds));
+		if (fds == NULL)
+			goto nomem;
+		a->sync_fds = fds;
+		devs = realloc(a->sync_devs, new_size * sizeof(*devs));
+		if (devs == NULL)
+			goto nomem;
+		a->sync_devs = devs;
+		a->sync_size = new_size;
+	}
+	r = dup(a->fd);
+	if (r == -1)
+		goto nomem;
+	__archive_ensure_cloexec_flag(r);
+	a->sync_fds[a->sync_count] = r;
+	a->sync_devs[a->sync_count] = st.st_dev;
+	a->sync_count++;
+	return (ARCHIVE_OK);
+nomem:
+	/* Fall back to syncing everything at close. */
+	a->sync_all = 1;
+	return (ARCHIVE_OK);
+}
+
+/* Make the directory entry for the current file durable. */
+static int
+la_sync_dir(struct archive_write_disk *a)
+{
+	struct archive_string dir;
+	int fd, r = ARCHIVE_OK;
+
+	archive_string_init(&dir);
+	la_parent_dir(a->name, &dir);
+	fd = open(dir.s, O_RDONLY | O_BINARY | O_CLOEXEC);
+	archive_string_free(&dir);
+	if (fd < 0)
+		return (ARCHIVE_OK);
+	/* Some file systems can't sync directories; that's fine. */
+	if (fsync(fd) == -1 && errno != EINVAL) {
+		archive_set_error(&a->archive, errno,
+		    "Failed to sync directory");
+		r = ARCHIVE_FAILED;
+	}
+	close(fd);
+	return (r);
+}
+
 static int
 la_mktemp(struct archive_write_disk *a)
 {
 	int oerrno, fd;
 	mode_t mode;
 
+	a->tmpfile_anon = 0;
+#if defined(O_TMPFILE) && defined(HAVE_LINKAT)
+	/* Fall back to a named file if the file system can't do this. */
+	fd = la_open_tmpfile(a, a->mode & 0777 & ~a->user_umask);
+	if (fd >= 0)
+		return (fd);
+#endif
+
 	archive_string_empty(&a->_tmpname_data);
 	archive_string_sprintf(&a->_tmpname_data, "%s.XXXXXX", a->name);
 	a->tmpname = a->_tmpname_data.s;
@@ -571,6 +788,8 @@ _archive_write_disk_header(struct archive *_a, struct archive_entry *entry)
 	a->fd = -1;
 	a->fd_offset = 0;
 	a->offset = 0;
+	a->write_buf_len = 0;
+	a->buffer_writes = 0;
 	a->restore_pwd = -1;
 	a->uid = a->user_uid;
 	a->mode = archive_entry_mode(a->entry);
@@ -788,6 +1007,9 @@ _archive_write_disk_header(struct archive *_a, struct archive_entry *entry)
 	}
 #endif
 
+	if (a->flags & ARCHIVE_EXTRACT_PREALLOCATE)
+		preallocate_file(a);
+
 	/*
 	 * TODO: There are rumours that some extended attributes must
 	 * be restored before file data is written.  If this is true,
@@ -922,6 +1144,34 @@ archive_write_disk_set_skip_file(struct archive *_a, la_int64_t d, la_int64_t i)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Return non-zero if the 'size' bytes at 'p' are all zero.  Most
+ * of the work is done a word at a time; a block holding data
+ * usually fails on the first word.
+ */
+static int
+is_zero_block(const char *p, size_t size)
+{
+	const char *end = p + size;
+	size_t w[4];
+
+	while (p < end && ((uintptr_t)p & (sizeof(w[0]) - 1)) != 0) {
+		if (*p++ != '\0')
+			return (0);
+	}
+	while ((size_t)(end - p) >= sizeof(w)) {
+		memcpy(w, p, sizeof(w));
+		if ((w[0] | w[1] | w[2] | w[3]) != 0)
+			return (0);
+		p += sizeof(w);
+	}
+	while (p < end) {
+		if (*p++ != '\0')
+			return (0);
+	}
+	return (1);
+}
+
 static ssize_t
 write_data_block(struct archive_write_disk *a, const char *buff, size_t size)
 {
@@ -955,35 +1205,71 @@ write_data_block(struct archive_write_disk *a, const char *buff, size_t size)
 	if (a->filesize >= 0 && (int64_t)(a->offset + size) > a->filesize)
 		start_size = size = (size_t)(a->filesize - a->offset);
 
+	if (a->buffer_writes) {
+		int r;
+
+		/* A gap ends the run being gathered. */
+		if (a->write_buf_len > 0 && a->offset !=
+		    a->write_buf_offset + (int64_t)a->write_buf_len &&
+		    (r = flush_write_buf(a)) != ARCHIVE_OK)
+			return (r);
+		while (size > 0) {
+			if (a->write_buf_len == 0)
+				a->write_buf_offset = a->offset;
+			bytes_to_write = PREALLOCATE_CHUNK - a->write_buf_len;
+			if ((size_t)bytes_to_write > size)
+				bytes_to_write = size;
+			memcpy(a->write_buf + a->write_buf_len, buff,
+			    bytes_to_write);
+			a->write_buf_len += bytes_to_write;
+			a->offset += bytes_to_write;
+			buff += bytes_to_write;
+			size -= bytes_to_write;
+			if (a->write_buf_len == PREALLOCATE_CHUNK &&
+			    (r = flush_write_buf(a)) != ARCHIVE_OK)
+				return (r);
+		}
+		return (start_size);
+	}
+
 	/* Write the data. */
 	while (size > 0) {
 		if (block_size == 0) {
 			bytes_to_write = size;
 		} else {
 			/* We're sparsifying the file. */
-			const char *p, *end;
-			int64_t block_end;
-
-			/* Skip leading zero bytes. */
-			for (p = buff, end = buff + size; p < end; ++p) {
-				if (*p != '\0')
+			size_t n;
+
+			/* Skip blocks that are all zero; the file is new,
+			 * so they are left as holes.  The first block may
+			 * be partial if offset isn't block-aligned. */
+			for (;;) {
+				n = (size_t)(block_size -
+				    a->offset % block_size);
+				if (n > size)
+					n = size;
+				if (!is_zero_block(buff, n))
+					break;
+				buff += n;
+				size -= n;
+				a->offset += n;
+				if (size == 0)
 					break;
 			}
-			a->offset += p - buff;
-			size -= p - buff;
-			buff = p;
 			if (size == 0)
 				break;
 
-			/* Calculate next block boundary after offset. */
-			block_end
-			    = (a->offset / block_size + 1) * block_size;
-
-			/* If the adjusted write would cross block boundary,
-			 * truncate it to the block boundary. */
-			bytes_to_write = size;
-			if (a->offset + bytes_to_write > block_end)
-				bytes_to_write = block_end - a->offset;
+			/* Write this block and all the non-zero blocks
+			 * that follow it at once. */
+			bytes_to_write = n;
+			while ((size_t)bytes_to_write < size) {
+				n = size - bytes_to_write;
+				if (n > (size_t)block_size)
+					n = block_size;
+				if (is_zero_block(buff + bytes_to_write, n))
+					break;
+				bytes_to_write += n;
+			}
 		}
 		/* Seek if necessary to the specified offset. */
 		if (a->offset != a->fd_offset) {
@@ -1008,6 +1294,70 @@ write_data_block(struct archive_write_disk *a, const char *buff, size_t size)
 	return (start_size - size);
 }
 
+/*
+ * Tell the file system how big a new regular file is going to be,
+ * so that it can allocate the space contiguously, and gather its data
+ * into large writes.  Failure to preallocate is not an error; the
+ * file is just written the ordinary way.
+ */
+static void
+preallocate_file(struct archive_write_disk *a)
+{
+	if (a->fd < 0 || a->filesize < PREALLOCATE_CHUNK ||
+	    !S_ISREG(a->mode) || (a->flags & ARCHIVE_EXTRACT_SPARSE))
+		return;
+#if defined(__APPLE__) && defined(UF_COMPRESSED) && defined(HAVE_ZLIB_H)
+	if (a->todo & TODO_HFS_COMPRESSION)
+		return;
+#endif
+	/*
+	 * Linux fallocate() fails where the file system can't do it;
+	 * glibc's posix_fallocate() would write zeros instead, so it
+	 * is only used where fallocate() doesn't exist.
+	 */
+#if defined(HAVE_FALLOCATE)
+	(void)fallocate(a->fd, 0, 0, a->filesize);
+#elif defined(HAVE_POSIX_FALLOCATE)
+	(void)posix_fallocate(a->fd, 0, a->filesize);
+#endif
+	if (a->write_buf == NULL) {
+		a->write_buf = malloc(PREALLOCATE_CHUNK);
+		if (a->write_buf == NULL)
+			return;
+	}
+	a->write_buf_len = 0;
+	a->buffer_writes = 1;
+}
+
+static int
+flush_write_buf(struct archive_write_disk *a)
+{
+	const char *p = a->write_buf;
+	size_t len = a->write_buf_len;
+	ssize_t bytes_written;
+
+	a->write_buf_len = 0;
+	if (a->write_buf_offset != a->fd_offset) {
+		if (lseek(a->fd, a->write_buf_offset, SEEK_SET) < 0) {
+			archive_set_error(&a->archive, errno, "Seek failed");
+			return (ARCHIVE_FATAL);
+		}
+		a->fd_offset = a->write_buf_offset;
+	}
+	while (len > 0) {
+		bytes_written = write(a->fd, p, len);
+		if (bytes_written < 0) {
+			archive_set_error(&a->archive, errno, "Write failed");
+			return (ARCHIVE_WARN);
+		}
+		p += bytes_written;
+		len -= bytes_written;
+		a->total_bytes_written += bytes_written;
+		a->fd_offset += bytes_written;
+	}
+	return (ARCHIVE_OK);
+}
+
 #if defined(__APPLE__) && defined(UF_COMPRESSED) && defined(HAVE_SYS_XATTR_H)\
 	&& defined(HAVE_ZLIB_H)
 
@@ -1674,6 +2024,9 @@ _archive_write_disk_finish_entry(struct archive *_a)
 		return (ARCHIVE_OK);
 	archive_clear_error(&a->archive);
 
+	if (a->write_buf_len > 0 && flush_write_buf(a) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+
 	/* Pad or truncate file to the right size. */
 	if (a->fd < 0) {
 		/* There's no file. */
@@ -1735,6 +2088,8 @@ _archive_write_disk_finish_entry(struct archive *_a)
 		}
 	}
 
+	la_start_writeback(a);
+
 	/* Restore metadata. */
 
 	/*
@@ -1863,6 +2218,18 @@ _archive_write_disk_finish_entry(struct archive *_a)
 finish_metadata:
 	/* If there's an fd, we can close it now. */
 	if (a->fd >= 0) {
+		int r2 = la_sync_file(a);
+		if (r2 < ret) ret = r2;
+#if defined(O_TMPFILE) && defined(HAVE_LINKAT)
+		if (a->tmpfile_anon) {
+			a->tmpfile_anon = 0;
+			if (la_link_tmpfile(a) == -1) {
+				archive_set_error(&a->archive, errno,
+				    "Failed to link temporary file");
+				ret = ARCHIVE_FAILED;
+			}
+		}
+#endif
 		close(a->fd);
 		a->fd = -1;
 		if (a->tmpname) {
@@ -1874,6 +2241,10 @@ finish_metadata:
 			}
 			a->tmpname = NULL;
 		}
+		/* The new name must be durable after the data. */
+		if (ret == ARCHIVE_OK &&
+		    (a->flags & ARCHIVE_EXTRACT_SYNC_PER_FILE))
+			ret = la_sync_dir(a);
 	}
 	/* If there's an entry, we can release it now. */
 	archive_entry_free(a->entry);
@@ -2365,6 +2736,7 @@ create_filesystem_object(struct archive_write_disk *a)
 		/* FALLTHROUGH */
 	case AE_IFREG:
 		a->tmpname = NULL;
+		a->tmpfile_anon = 0;
 		a->fd = open(a->name,
 		    O_WRONLY | O_CREAT | O_EXCL | O_BINARY | O_CLOEXEC, mode);
 		__archive_ensure_cloexec_flag(a->fd);
@@ -2508,6 +2880,25 @@ _archive_write_disk_close(struct archive *_a)
 		p = next;
 	}
 	a->fixup_list = NULL;
+
+	/* Flush everything written to each file system in one go. */
+	while (a->sync_count > 0) {
+		fd = a->sync_fds[--a->sync_count];
+#ifdef HAVE_SYNCFS
+		if (syncfs(fd) == -1) {
+			archive_set_error(&a->archive, errno,
+			    "Failed to sync file system");
+			ret = ARCHIVE_FAILED;
+		}
+#else
+		a->sync_all = 1;
+#endif
+		close(fd);
+	}
+	if (a->sync_all) {
+		sync();
+		a->sync_all = 0;
+	}
 	return (ret);
 }
 
@@ -2535,6 +2926,11 @@ _archive_write_disk_free(struct archive *_a)
 	free(a->resource_fork);
 	free(a->compressed_buffer);
 	free(a->uncompressed_buffer);
+	free(a->write_buf);
+	while (a->sync_count > 0)
+		close(a->sync_fds[--a->sync_count]);
+	free(a->sync_fds);
+	free(a->sync_devs);
 #if defined(__APPLE__) && defined(UF_COMPRESSED) && defined(HAVE_SYS_XATTR_H)\
 	&& defined(HAVE_ZLIB_H)
 	if (a->stream_valid) {
@@ -31,6 +31,8 @@ __FBSDID("$FreeBSD: src/lib/libarchive/archive_write_open_memory.c,v 1.3 2007/01
 #include <string.h>
 
 #include "archive.h"
+#include "archive_private.h"
+#include "archive_write_private.h"
 
 struct write_memory_data {
 	size_t	used;
@@ -113,3 +115,190 @@ memory_write_free(struct archive *a, void *client_data)
 	free(mine);
 	return (ARCHIVE_OK);
 }
+
+/*
+ * Growable variant: the archive goes into a list of fixed-size
+ * chunks, so nothing is ever reallocated or copied a second time.
+ * Every chunk but the last is full.
+ */
+#define	MEMORY_CHUNK_SIZE	(1024 * 1024)
+
+struct write_memory_chunks {
+	size_t			 chunk_size;
+	struct archive_iovec	*chunks;
+	size_t			 count;
+	size_t			 size;	/* Allocated entries in 'chunks'. */
+};
+
+static int	memory_chunks_open(struct archive *, void *);
+static ssize_t	memory_chunks_write(struct archive *, void *,
+		    const void *, size_t);
+static int	memory_chunks_free(struct archive *, void *);
+
+int
+archive_write_open_memory_chunks(struct archive *a, size_t chunk_size)
+{
+	struct write_memory_chunks *mine;
+
+	mine = (struct write_memory_chunks *)calloc(1, sizeof(*mine));
+	if (mine == NULL) {
+		archive_set_error(a, ENOMEM, "No memory");
+		return (ARCHIVE_FATAL);
+	}
+	mine->chunk_size = chunk_size ? chunk_size : MEMORY_CHUNK_SIZE;
+	return (archive_write_open2(a, mine, memory_chunks_open,
+		    memory_chunks_write, NULL, memory_chunks_free));
+}
+
+static int
+memory_chunks_open(struct archive *a, void *client_data)
+{
+	(void)client_data; /* UNUSED */
+	/* Disable padding if it hasn't been set explicitly. */
+	if (-1 == archive_write_get_bytes_in_last_block(a))
+		archive_write_set_bytes_in_last_block(a, 1);
+	return (ARCHIVE_OK);
+}
+
+static ssize_t
+memory_chunks_write(struct archive *a, void *client_data,
+    const void *buff, size_t length)
+{
+	struct write_memory_chunks *mine = client_data;
+	const unsigned char *p = buff;
+	struct archive_iovec *last;
+	size_t remaining = length, n;
+
+	while (remaining > 0) {
+		last = mine->count ? &mine->chunks[mine->count - 1] : NULL;
+		if (last == NULL || last->iov_len == mine->chunk_size) {
+			if (mine->count == mine->size) {
+				size_t new_size =
+				    mine->size ? mine->size * 2 : 16;
+				struct archive_iovec *chunks;
+
+				chunks = realloc(mine->chunks,
+				    new_size * sizeof(*chunks));
+				if (chunks == NULL)
+					goto nomem;
+				mine->chunks = chunks;
+				mine->size = new_size;
+			}
+			last = &mine->chunks[mine->count];
+			last->iov_base = malloc(mine->chunk_size);
+			if (last->iov_base == NULL)
+				goto nomem;
+			last->iov_len = 0;
+			mine->count++;
+		}
+		n = mine->chunk_size - last->iov_len;
+		if (n > remaining)
+			n = remaining;
+		memcpy((unsigned char *)last->iov_base + last->iov_len, p, n);
+		last->iov_len += n;
+		p += n;
+		remaining -= n;
+	}
+	return (length);
+nomem:
+	archive_set_error(a, ENOMEM, "No memory");
+	return (ARCHIVE_FATAL);
+}
+
+static void
+memory_chunks_release(struct write_memory_chunks *mine)
+{
+	archive_write_free_memory_chunks(mine->chunks, mine->count);
+	mine->chunks = NULL;
+	mine->count = mine->size = 0;
+}
+
+static int
+memory_chunks_free(struct archive *a, void *client_data)
+{
+	struct write_memory_chunks *mine;
+	(void)a; /* UNUSED */
+	mine = client_data;
+	if (mine == NULL)
+		return (ARCHIVE_OK);
+	memory_chunks_release(mine);
+	free(mine);
+	return (ARCHIVE_OK);
+}
+
+static struct write_memory_chunks *
+get_memory_chunks(struct archive *_a, const char *fn)
+{
+	struct archive_write *a = (struct archive_write *)_a;
+
+	if (__archive_check_magic(_a, ARCHIVE_WRITE_MAGIC,
+	    ARCHIVE_STATE_HEADER | ARCHIVE_STATE_DATA | ARCHIVE_STATE_CLOSED,
+	    fn) == ARCHIVE_FATAL)
+		return (NULL);
+	if (a->client_writer != memory_chunks_write ||
+	    a->client_data == NULL) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "Archive was not opened with "
+		    "archive_write_open_memory_chunks()");
+		return (NULL);
+	}
+	return (a->client_data);
+}
+
+/*
+ * Returns the chunks written so far.  The array is only valid until
+ * the next write; call this after archive_write_close() to see the
+ * complete archive.
+ */
+int
+archive_write_get_memory_chunks(struct archive *_a,
+    const struct archive_iovec **chunks, size_t *count)
+{
+	struct write_memory_chunks *mine;
+
+	mine = get_memory_chunks(_a, "archive_write_get_memory_chunks");
+	if (mine == NULL)
+		return (ARCHIVE_FATAL);
+	*chunks = mine->chunks;
+	*count = mine->count;
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Hands the chunks written so far to the caller, which must release
+ * them with archive_write_free_memory_chunks().  Later writes start a
+ * new list, so this can also be used to drain a large archive as it
+ * is built.
+ */
+int
+archive_write_take_memory_chunks(struct archive *_a,
+    struct archive_iovec **chunks, size_t *count)
+{
+	struct write_memory_chunks *mine;
+
+	mine = get_memory_chunks(_a, "archive_write_take_memory_chunks");
+	if (mine == NULL)
+		return (ARCHIVE_FATAL);
+	*chunks = mine->chunks;
+	*count = mine->count;
+	mine->chunks = NULL;
+	mine->count = mine->size = 0;
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Frees chunks returned by archive_write_take_memory_chunks().  They
+ * were allocated by the library, so they must also be freed by it: on
+ * Windows the caller may be using a different C runtime.
+ */
+void
+archive_write_free_memory_chunks(struct archive_iovec *chunks, size_t count)
+{
+	size_t i;
+
+	if (chunks == NULL)
+		return;
+	for (i = 0; i < count; i++)
+		free(chunks[i].iov_base);
+	free(chunks);
+}
@@ -124,6 +124,10 @@ struct archive_write {
 	int	(*format_close)(struct archive_write *);
 	int	(*format_free)(struct archive_write *);
 
+	/* Decisions made by the "compression=auto" format option. */
+	int64_t		  auto_entries_compressed;
+	int64_t		  auto_entries_stored;
+
 
 	/*
 	 * Encryption passphrase.
@@ -33,8 +33,12 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_write_set_format.c 201168 2009-1
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
 
 #include "archive.h"
+#include "archive_endian.h"
 #include "archive_private.h"
 #include "archive_write_set_format_private.h"
 
@@ -123,3 +127,198 @@ __archive_write_entry_filetype_unsupported(struct archive *a,
 		    (unsigned long)archive_entry_mode(entry));
 	}
 }
+
+/*
+ * Extensions that "compression=auto" stores without looking at the data.
+ */
+static const char store_extensions_default[] =
+    "7z\0apk\0avif\0br\0bz2\0cab\0deb\0docx\0epub\0flac\0gif\0gz\0"
+    "heic\0jar\0jpeg\0jpg\0lz\0lz4\0lzma\0m4a\0mkv\0mov\0mp3\0mp4\0"
+    "odp\0ods\0odt\0ogg\0opus\0png\0pptx\0rar\0rpm\0tbz2\0tgz\0txz\0"
+    "webm\0webp\0whl\0xlsx\0xz\0zip\0zst\0";
+
+static int
+ascii_tolower(int c)
+{
+	return ((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+}
+
+void
+__archive_store_extensions_init(struct archive_store_extensions *ext)
+{
+	archive_string_init(&ext->names);
+	if (archive_array_append(&ext->names, store_extensions_default,
+	    sizeof(store_extensions_default) - 1) == NULL)
+		__archive_errx(1, "Out of memory");
+}
+
+void
+__archive_store_extensions_free(struct archive_store_extensions *ext)
+{
+	archive_string_free(&ext->names);
+}
+
+int
+__archive_store_extensions_option(struct archive *a,
+    struct archive_store_extensions *ext, const char *format,
+    const char *value)
+{
+	const char *p;
+
+	if (value == NULL) {
+		archive_string_empty(&ext->names);
+		return (ARCHIVE_OK);
+	}
+	if (value[0] == '.')
+		value++;
+	if (value[0] == '\0' || strchr(value, '.') != NULL ||
+	    strchr(value, '/') != NULL) {
+		archive_set_error(a, ARCHIVE_ERRNO_MISC,
+		    "%s: store-extension option needs a filename extension",
+		    format);
+		return (ARCHIVE_FAILED);
+	}
+	for (p = value; *p != '\0'; p++)
+		archive_strappend_char(&ext->names, ascii_tolower(*p));
+	archive_strappend_char(&ext->names, '\0');
+	return (ARCHIVE_OK);
+}
+
+int
+__archive_store_extensions_match(const struct archive_store_extensions *ext,
+    const char *pathname)
+{
+	const char *name, *end, *suffix;
+	size_t len, i;
+
+	if (pathname == NULL)
+		return (0);
+	if ((suffix = strrchr(pathname, '/')) != NULL)
+		pathname = suffix + 1;
+	suffix = strrchr(pathname, '.');
+	if (suffix == NULL || suffix == pathname)
+		return (0);
+	suffix++;
+	len = strlen(suffix);
+
+	name = ext->names.s;
+	end = name + archive_strlen(&ext->names);
+	while (name < end) {
+		size_t l = strlen(name);
+
+		if (l == len) {
+			for (i = 0; i < len; i++) {
+				if (name[i] != ascii_tolower(suffix[i]))
+					break;
+			}
+			if (i == len)
+				return (1);
+		}
+		name += l + 1;
+	}
+	return (0);
+}
+
+/* log2(x) for x >= 1, in 1/256ths. */
+static uint64_t
+log2_q8(uint32_t x)
+{
+	uint64_t y;
+	unsigned r;
+	int i, k;
+
+	for (k = 0; (x >> k) > 1; k++)
+		;
+	/* x / 2^k in 16.16 fixed point, which is in [1, 2). */
+	y = ((uint64_t)x << 16) >> k;
+	r = k << 8;
+	for (i = 7; i >= 0; i--) {
+		y = (y * y) >> 16;
+		if (y >= (2 << 16)) {
+			y >>= 1;
+			r |= 1 << i;
+		}
+	}
+	return (r);
+}
+
+#define SAMPLE_HASH_BITS	12
+#define SAMPLE_MATCH_MAX	258
+#define SAMPLE_MATCH_BITS	24
+
+/*
+ * Estimate what an LZ77 + Huffman coder such as deflate would make of
+ * the sample: one greedy pass finds repeated 4-byte strings through a
+ * small hash table, and the bytes not covered by a match are costed at
+ * their order-0 entropy.  Data that would shrink by less than 1/32 is
+ * not worth compressing.  This is much cheaper than compressing the
+ * sample and good enough to tell media files and compressed archives
+ * from text, executables and other compressible data.
+ */
+int
+__archive_write_sample_compressible(const void *buff, size_t size)
+{
+	const unsigned char *p = (const unsigned char *)buff;
+	uint32_t hash[1 << SAMPLE_HASH_BITS];
+	uint32_t counts[256];
+	uint64_t literals, matches, clogc, cost;
+	unsigned symbols;
+	size_t i, len;
+	int c;
+
+	/* Too little to judge, and cheap to compress anyway. */
+	if (size < 512)
+		return (1);
+	if (size > ARCHIVE_AUTO_SAMPLE_SIZE)
+		size = ARCHIVE_AUTO_SAMPLE_SIZE;
+
+	memset(hash, 0, sizeof(hash));
+	memset(counts, 0, sizeof(counts));
+	matches = 0;
+	i = 0;
+	while (i + 4 <= size) {
+		uint32_t v = archive_le32dec(p + i);
+		uint32_t h = (v * 2654435761U) >> (32 - SAMPLE_HASH_BITS);
+		uint32_t cand = hash[h];
+
+		hash[h] = (uint32_t)i + 1;
+		if (cand != 0 && archive_le32dec(p + cand - 1) == v) {
+			const unsigned char *m = p + cand - 1;
+
+			for (len = 4; i + len < size &&
+			    len < SAMPLE_MATCH_MAX && m[len] == p[i + len];
+			    len++)
+				;
+			matches++;
+			i += len;
+			continue;
+		}
+		counts[p[i++]]++;
+	}
+	while (i < size)
+		counts[p[i++]]++;
+
+	/* The entropy of the literals is L log L - sum(c log c) bits. */
+	literals = 0;
+	symbols = 0;
+	clogc = 0;
+	for (c = 0; c < 256; c++) {
+		if (counts[c] == 0)
+			continue;
+		literals += counts[c];
+		symbols++;
+		clogc += counts[c] * log2_q8(counts[c]);
+	}
+	cost = 0;
+	if (literals > 0) {
+		cost = literals * log2_q8((uint32_t)literals);
+		cost = (cost > clogc) ? cost - clogc : 0;
+		/* Miller-Madow correction: a small sample understates
+		 * the entropy by about (symbols - 1) / (2 ln 2) bits. */
+		cost += (symbols - 1) * 185;
+	}
+	cost += matches * (SAMPLE_MATCH_BITS << 8);
+
+	/* cost < size * 8 bits * 31/32, with cost in 1/256ths of a bit. */
+	return (cost * 32 < (uint64_t)size * (8 << 8) * 31);
+}
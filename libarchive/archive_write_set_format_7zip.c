@@ -49,7 +49,7 @@ __FBSDID("$FreeBSD$");
 #include "archive_entry_locale.h"
 #include "archive_ppmd7_private.h"
 #include "archive_private.h"
-#include "archive_rb.h"
+#include "archive_hmap.h"
 #include "archive_string.h"
 #include "archive_write_private.h"
 #include "archive_write_set_format_private.h"
@@ -64,6 +64,16 @@ __FBSDID("$FreeBSD$");
 #define _7Z_BZIP2	0x040202
 #define _7Z_PPMD	0x030401
 
+#if HAVE_LZMA_H
+#define _7Z_DEFAULT	_7Z_LZMA1
+#elif defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
+#define _7Z_DEFAULT	_7Z_BZIP2
+#elif defined(HAVE_ZLIB_H)
+#define _7Z_DEFAULT	_7Z_DEFLATE
+#else
+#define _7Z_DEFAULT	_7Z_COPY
+#endif
+
 /*
  * 7-Zip header property IDs.
  */
@@ -141,8 +151,6 @@ struct coder {
 };
 
 struct file {
-	struct archive_rb_node	 rbnode;
-
 	struct file		*next;
 	unsigned		 name_len;
 	uint8_t			*utf16name;/* UTF16-LE name. */
@@ -183,6 +191,8 @@ struct _7zip {
 	uint64_t		 total_bytes_uncompressed;
 	uint64_t		 entry_bytes_remaining;
 	uint32_t		 entry_crc32;
+	int			 entry_sampling;
+	int			 entry_stored;
 	uint32_t		 precode_crc32;
 	uint32_t		 encoded_crc32;
 	int			 crc32flg;
@@ -191,6 +201,8 @@ struct _7zip {
 
 	unsigned		 opt_compression;
 	int			 opt_compression_level;
+	int			 opt_auto;
+	struct archive_store_extensions store_extensions;
 
 	struct la_zstream	 stream;
 	struct coder		 coder;
@@ -203,6 +215,20 @@ struct _7zip {
 	unsigned char		 wbuff[512 * 20 * 6];
 	size_t			 wbuff_remaining;
 
+	/*
+	 * "compression=auto" gives each file it decides to store a
+	 * COPY folder of its own after the solid folder.  Their data
+	 * is kept in a second temporary file until the archive is
+	 * closed, and the start of each file's data is collected in
+	 * sample[] before that decision is made.
+	 */
+	int			 stored_fd;
+	uint64_t		 stored_offset;
+	size_t			 total_number_stored_entry;
+	unsigned char		*sample;
+	size_t			 sample_bytes;
+	size_t			 sample_wanted;
+
 	/*
 	 * The list of the file entries which has its contents is used to
 	 * manage struct file objects.
@@ -211,8 +237,8 @@ struct _7zip {
 	struct {
 		struct file	*first;
 		struct file	**last;
-	}			 file_list, empty_list;
-	struct archive_rb_tree	 rbtree;/* for empty files */
+	}			 file_list, empty_list, stored_list;
+	struct archive_hmap	 empty_dirs;/* for empty files */
 };
 
 static int	_7z_options(struct archive_write *,
@@ -222,11 +248,12 @@ static int	_7z_write_header(struct archive_write *,
 static ssize_t	_7z_write_data(struct archive_write *,
 		    const void *, size_t);
 static int	_7z_finish_entry(struct archive_write *);
+static int	add_file(struct archive_write *, int);
 static int	_7z_close(struct archive_write *);
 static int	_7z_free(struct archive_write *);
-static int	file_cmp_node(const struct archive_rb_node *,
-		    const struct archive_rb_node *);
-static int	file_cmp_key(const struct archive_rb_node *, const void *);
+static uint64_t	file_hash_node(const void *);
+static int	file_cmp_node(const void *, const void *);
+static int	file_cmp_sort(const void *, const void *);
 static int	file_new(struct archive_write *a, struct archive_entry *,
 		    struct file **);
 static void	file_free(struct file *);
@@ -234,6 +261,8 @@ static void	file_register(struct _7zip *, struct file *);
 static void	file_register_empty(struct _7zip *, struct file *);
 static void	file_init_register(struct _7zip *);
 static void	file_init_register_empty(struct _7zip *);
+static void	file_register_stored(struct _7zip *, struct file *);
+static void	file_init_register_stored(struct _7zip *);
 static void	file_free_register(struct _7zip *);
 static ssize_t	compress_out(struct archive_write *, const void *, size_t ,
 		    enum la_zaction);
@@ -285,8 +314,8 @@ static int	make_streamsInfo(struct archive_write *, uint64_t, uint64_t,
 int
 archive_write_set_format_7zip(struct archive *_a)
 {
-	static const struct archive_rb_tree_ops rb_ops = {
-		file_cmp_node, file_cmp_key
+	static const struct archive_hmap_ops hmap_ops = {
+		file_hash_node, file_hash_node, file_cmp_node, file_cmp_node
 	};
 	struct archive_write *a = (struct archive_write *)_a;
 	struct _7zip *zip;
@@ -305,21 +334,16 @@ archive_write_set_format_7zip(struct archive *_a)
 		return (ARCHIVE_FATAL);
 	}
 	zip->temp_fd = -1;
-	__archive_rb_tree_init(&(zip->rbtree), &rb_ops);
+	zip->stored_fd = -1;
+	__archive_hmap_init(&(zip->empty_dirs), &hmap_ops);
 	file_init_register(zip);
 	file_init_register_empty(zip);
+	file_init_register_stored(zip);
 
 	/* Set default compression type and its level. */
-#if HAVE_LZMA_H
-	zip->opt_compression = _7Z_LZMA1;
-#elif defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
-	zip->opt_compression = _7Z_BZIP2;
-#elif defined(HAVE_ZLIB_H)
-	zip->opt_compression = _7Z_DEFLATE;
-#else
-	zip->opt_compression = _7Z_COPY;
-#endif
+	zip->opt_compression = _7Z_DEFAULT;
 	zip->opt_compression_level = 6;
+	__archive_store_extensions_init(&zip->store_extensions);
 
 	a->format_data = zip;
 
@@ -346,7 +370,13 @@ _7z_options(struct archive_write *a, const char *key, const char *value)
 	if (strcmp(key, "compression") == 0) {
 		const char *name = NULL;
 
-		if (value == NULL || strcmp(value, "copy") == 0 ||
+		zip->opt_auto = 0;
+		if (value != NULL && strcmp(value, "auto") == 0) {
+			/* The default coder, but store what won't
+			 * compress. */
+			zip->opt_compression = _7Z_DEFAULT;
+			zip->opt_auto = 1;
+		} else if (value == NULL || strcmp(value, "copy") == 0 ||
 		    strcmp(value, "COPY") == 0 ||
 		    strcmp(value, "store") == 0 ||
 		    strcmp(value, "STORE") == 0)
@@ -413,6 +443,9 @@ _7z_options(struct archive_write *a, const char *key, const char *value)
 		zip->opt_compression_level = value[0] - '0';
 		return (ARCHIVE_OK);
 	}
+	if (strcmp(key, "store-extension") == 0)
+		return (__archive_store_extensions_option(&a->archive,
+		    &zip->store_extensions, a->format_name, value));
 
 	/* Note: The "warn" return is just to inform the options
 	 * supervisor that we didn't handle it.  It will generate
@@ -445,8 +478,14 @@ _7z_write_header(struct archive_write *a, struct archive_entry *entry)
 		return (r);
 	}
 	if (file->size == 0 && file->dir) {
-		if (!__archive_rb_tree_insert_node(&(zip->rbtree),
-		    (struct archive_rb_node *)file)) {
+		r = __archive_hmap_insert(&(zip->empty_dirs), file);
+		if (r < 0) {
+			file_free(file);
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate memory");
+			return (ARCHIVE_FATAL);
+		}
+		if (r == 0) {
 			/* We have already had the same file. */
 			file_free(file);
 			return (ARCHIVE_OK);
@@ -472,21 +511,6 @@ _7z_write_header(struct archive_write *a, struct archive_entry *entry)
 		return (r);
 	}
 
-	/*
-	 * Init compression.
-	 */
-	if ((zip->total_number_entry - zip->total_number_empty_entry) == 1) {
-		r = _7z_compression_init_encoder(a, zip->opt_compression,
-			zip->opt_compression_level);
-		if (r < 0) {
-			file_free(file);
-			return (ARCHIVE_FATAL);
-		}
-	}
-
-	/* Register a non-empty file. */
-	file_register(zip, file);
-
 	/*
 	 * Set the current file to cur_file to read its contents.
 	 */
@@ -496,6 +520,28 @@ _7z_write_header(struct archive_write *a, struct archive_entry *entry)
 	/* Save a offset of current file in temporary file. */
 	zip->entry_bytes_remaining = file->size;
 	zip->entry_crc32 = 0;
+	zip->entry_sampling = 0;
+	zip->entry_stored = 0;
+
+	if (zip->opt_auto && zip->opt_compression != _7Z_COPY &&
+	    archive_entry_filetype(entry) == AE_IFREG) {
+		if (__archive_store_extensions_match(&zip->store_extensions,
+		    archive_entry_pathname(entry))) {
+			if (add_file(a, 1) < 0)
+				return (ARCHIVE_FATAL);
+			return (r);
+		}
+		/* Choose the folder once the data has started. */
+		zip->entry_sampling = 1;
+		zip->sample_bytes = 0;
+		zip->sample_wanted = ARCHIVE_AUTO_SAMPLE_SIZE;
+		if (zip->sample_wanted > file->size)
+			zip->sample_wanted = (size_t)file->size;
+		return (r);
+	}
+
+	if (add_file(a, 0) < 0)
+		return (ARCHIVE_FATAL);
 
 	/*
 	 * Store a symbolic link name as file contents.
@@ -513,25 +559,65 @@ _7z_write_header(struct archive_write *a, struct archive_entry *entry)
 	return (r);
 }
 
+/*
+ * Register the current file, in the solid folder or, if it is to be
+ * stored, in a folder of its own.
+ */
+static int
+add_file(struct archive_write *a, int stored)
+{
+	struct _7zip *zip = (struct _7zip *)a->format_data;
+	struct file *file = zip->cur_file;
+	int r;
+
+	if (zip->opt_auto && (file->mode & AE_IFMT) == AE_IFREG) {
+		if (stored || zip->opt_compression == _7Z_COPY)
+			a->auto_entries_stored++;
+		else
+			a->auto_entries_compressed++;
+	}
+	if (stored) {
+		file_register_stored(zip, file);
+		zip->total_number_stored_entry++;
+		zip->entry_stored = 1;
+		return (ARCHIVE_OK);
+	}
+
+	/*
+	 * Init compression.
+	 */
+	if (zip->file_list.first == NULL) {
+		r = _7z_compression_init_encoder(a, zip->opt_compression,
+			zip->opt_compression_level);
+		if (r < 0) {
+			zip->cur_file = NULL;
+			file_free(file);
+			return (ARCHIVE_FATAL);
+		}
+	}
+
+	/* Register a non-empty file. */
+	file_register(zip, file);
+	return (ARCHIVE_OK);
+}
+
 /*
  * Write data to a temporary file.
  */
 static int
-write_to_temp(struct archive_write *a, const void *buff, size_t s)
+write_to_temp(struct archive_write *a, int *fd, uint64_t *offset,
+    const void *buff, size_t s)
 {
-	struct _7zip *zip;
 	const unsigned char *p;
 	ssize_t ws;
 
-	zip = (struct _7zip *)a->format_data;
-
 	/*
 	 * Open a temporary file.
 	 */
-	if (zip->temp_fd == -1) {
-		zip->temp_offset = 0;
-		zip->temp_fd = __archive_mktemp(NULL);
-		if (zip->temp_fd < 0) {
+	if (*fd == -1) {
+		*offset = 0;
+		*fd = __archive_mktemp(NULL);
+		if (*fd < 0) {
 			archive_set_error(&a->archive, errno,
 			    "Couldn't create temporary file");
 			return (ARCHIVE_FATAL);
@@ -540,7 +626,7 @@ write_to_temp(struct archive_write *a, const void *buff, size_t s)
 
 	p = (const unsigned char *)buff;
 	while (s) {
-		ws = write(zip->temp_fd, p, s);
+		ws = write(*fd, p, s);
 		if (ws < 0) {
 			archive_set_error(&(a->archive), errno,
 			    "fwrite function failed");
@@ -548,7 +634,7 @@ write_to_temp(struct archive_write *a, const void *buff, size_t s)
 		}
 		s -= ws;
 		p += ws;
-		zip->temp_offset += ws;
+		*offset += ws;
 	}
 	return (ARCHIVE_OK);
 }
@@ -574,8 +660,8 @@ compress_out(struct archive_write *a, const void *buff, size_t s,
 		if (r != ARCHIVE_OK && r != ARCHIVE_EOF)
 			return (ARCHIVE_FATAL);
 		if (zip->stream.avail_out == 0) {
-			if (write_to_temp(a, zip->wbuff, sizeof(zip->wbuff))
-			    != ARCHIVE_OK)
+			if (write_to_temp(a, &zip->temp_fd, &zip->temp_offset,
+			    zip->wbuff, sizeof(zip->wbuff)) != ARCHIVE_OK)
 				return (ARCHIVE_FATAL);
 			zip->stream.next_out = zip->wbuff;
 			zip->stream.avail_out = sizeof(zip->wbuff);
@@ -590,7 +676,8 @@ compress_out(struct archive_write *a, const void *buff, size_t s,
 	}
 	if (run == ARCHIVE_Z_FINISH) {
 		uint64_t bytes = sizeof(zip->wbuff) - zip->stream.avail_out;
-		if (write_to_temp(a, zip->wbuff, (size_t)bytes) != ARCHIVE_OK)
+		if (write_to_temp(a, &zip->temp_fd, &zip->temp_offset,
+		    zip->wbuff, (size_t)bytes) != ARCHIVE_OK)
 			return (ARCHIVE_FATAL);
 		if ((zip->crc32flg & ENCODED_CRC32) && bytes)
 			zip->encoded_crc32 = crc32(zip->encoded_crc32,
@@ -600,6 +687,59 @@ compress_out(struct archive_write *a, const void *buff, size_t s,
 	return (s);
 }
 
+/*
+ * "compression=auto": decide from the data sampled so far whether the
+ * current file is worth compressing, then write out the sample.
+ */
+static int
+end_sample(struct archive_write *a)
+{
+	struct _7zip *zip = (struct _7zip *)a->format_data;
+	ssize_t bytes;
+
+	zip->entry_sampling = 0;
+	if (add_file(a, !__archive_write_sample_compressible(zip->sample,
+	    zip->sample_bytes)) < 0)
+		return (ARCHIVE_FATAL);
+	if (zip->sample_bytes == 0)
+		return (ARCHIVE_OK);
+	bytes = _7z_write_data(a, zip->sample, zip->sample_bytes);
+	if (bytes < 0)
+		return ((int)bytes);
+	return (ARCHIVE_OK);
+}
+
+static ssize_t
+write_sample(struct archive_write *a, const void *buff, size_t s)
+{
+	struct _7zip *zip = (struct _7zip *)a->format_data;
+	size_t n = zip->sample_wanted - zip->sample_bytes;
+	ssize_t bytes;
+
+	if (zip->sample == NULL) {
+		zip->sample = malloc(ARCHIVE_AUTO_SAMPLE_SIZE);
+		if (zip->sample == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate memory");
+			return (ARCHIVE_FATAL);
+		}
+	}
+	if (n > s)
+		n = s;
+	memcpy(zip->sample + zip->sample_bytes, buff, n);
+	zip->sample_bytes += n;
+	if (zip->sample_bytes < zip->sample_wanted)
+		return (n);
+	if (end_sample(a) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+	if (n == s)
+		return (n);
+	bytes = _7z_write_data(a, (const unsigned char *)buff + n, s - n);
+	if (bytes < 0)
+		return (bytes);
+	return (n + bytes);
+}
+
 static ssize_t
 _7z_write_data(struct archive_write *a, const void *buff, size_t s)
 {
@@ -612,9 +752,18 @@ _7z_write_data(struct archive_write *a, const void *buff, size_t s)
 		s = (size_t)zip->entry_bytes_remaining;
 	if (s == 0 || zip->cur_file == NULL)
 		return (0);
-	bytes = compress_out(a, buff, s, ARCHIVE_Z_RUN);
-	if (bytes < 0)
-		return (bytes);
+	if (zip->entry_sampling)
+		return (write_sample(a, buff, s));
+	if (zip->entry_stored) {
+		if (write_to_temp(a, &zip->stored_fd, &zip->stored_offset,
+		    buff, s) != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
+		bytes = s;
+	} else {
+		bytes = compress_out(a, buff, s, ARCHIVE_Z_RUN);
+		if (bytes < 0)
+			return (bytes);
+	}
 	zip->entry_crc32 = crc32(zip->entry_crc32, buff, (unsigned)bytes);
 	zip->entry_bytes_remaining -= bytes;
 	return (bytes);
@@ -631,6 +780,13 @@ _7z_finish_entry(struct archive_write *a)
 	if (zip->cur_file == NULL)
 		return (ARCHIVE_OK);
 
+	if (zip->entry_sampling) {
+		r = end_sample(a);
+		if (r < 0)
+			return ((int)r);
+		if (zip->cur_file == NULL)
+			return (ARCHIVE_FATAL);
+	}
 	while (zip->entry_bytes_remaining > 0) {
 		s = (size_t)zip->entry_bytes_remaining;
 		if (s > a->null_length)
@@ -664,14 +820,13 @@ flush_wbuff(struct archive_write *a)
 }
 
 static int
-copy_out(struct archive_write *a, uint64_t offset, uint64_t length)
+copy_out(struct archive_write *a, int fd, uint64_t offset, uint64_t length)
 {
 	struct _7zip *zip;
 	int r;
 
 	zip = (struct _7zip *)a->format_data;
-	if (zip->temp_offset > 0 &&
-	    lseek(zip->temp_fd, offset, SEEK_SET) < 0) {
+	if (length > 0 && lseek(fd, offset, SEEK_SET) < 0) {
 		archive_set_error(&(a->archive), errno, "lseek failed");
 		return (ARCHIVE_FATAL);
 	}
@@ -685,7 +840,7 @@ copy_out(struct archive_write *a, uint64_t offset, uint64_t length)
 		else
 			rsize = (size_t)length;
 		wb = zip->wbuff + (sizeof(zip->wbuff) - zip->wbuff_remaining);
-		rs = read(zip->temp_fd, wb, rsize);
+		rs = read(fd, wb, rsize);
 		if (rs < 0) {
 			archive_set_error(&(a->archive), errno,
 			    "Can't read temporary file(%jd)",
@@ -714,15 +869,17 @@ _7z_close(struct archive_write *a)
 	struct _7zip *zip;
 	unsigned char *wb;
 	uint64_t header_offset, header_size, header_unpacksize;
-	uint64_t length;
+	uint64_t data_size, length;
 	uint32_t header_crc32;
 	int r;
 
 	zip = (struct _7zip *)a->format_data;
 
+	data_size = 0;
 	if (zip->total_number_entry > 0) {
-		struct archive_rb_node *n;
-		uint64_t data_offset, data_size, data_unpacksize;
+		struct file **dirs;
+		size_t i, ndirs;
+		uint64_t data_offset, data_unpacksize;
 		unsigned header_compression;
 
 		r = (int)compress_out(a, NULL, 0, ARCHIVE_Z_FINISH);
@@ -739,15 +896,29 @@ _7z_close(struct archive_write *a)
 		zip->total_number_nonempty_entry =
 		    zip->total_number_entry - zip->total_number_empty_entry;
 
+		/* Stored files follow the files in the solid folder. */
+		if (zip->stored_list.first != NULL) {
+			*zip->file_list.last = zip->stored_list.first;
+			zip->file_list.last = zip->stored_list.last;
+			file_init_register_stored(zip);
+		}
 		/* Connect an empty file list. */
 		if (zip->empty_list.first != NULL) {
 			*zip->file_list.last = zip->empty_list.first;
 			zip->file_list.last = zip->empty_list.last;
 		}
 		/* Connect a directory file list. */
-		ARCHIVE_RB_TREE_FOREACH(n, &(zip->rbtree)) {
-			file_register(zip, (struct file *)n);
+		dirs = (struct file **)__archive_hmap_sorted(&(zip->empty_dirs),
+		    &ndirs, file_cmp_sort);
+		if (dirs == NULL && zip->empty_dirs.count > 0) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate memory");
+			return (ARCHIVE_FATAL);
 		}
+		for (i = 0; i < ndirs; i++)
+			file_register(zip, dirs[i]);
+		free(dirs);
+		__archive_hmap_free(&(zip->empty_dirs));
 
 		/*
 		 * NOTE: 7z command supports just LZMA1, LZMA2 and COPY for
@@ -779,7 +950,7 @@ _7z_close(struct archive_write *a)
 		r = (int)compress_out(a, NULL, 0, ARCHIVE_Z_FINISH);
 		if (r < 0)
 			return (r);
-		header_offset = data_offset + data_size;
+		header_offset = data_offset + data_size + zip->stored_offset;
 		header_size = zip->stream.total_out;
 		header_crc32 = zip->precode_crc32;
 		header_unpacksize = zip->stream.total_in;
@@ -844,9 +1015,15 @@ _7z_close(struct archive_write *a)
 
 	/*
 	 * Read all file contents and an encoded header from the temporary
-	 * file and write out it.
+	 * files and write out it.
 	 */
-	r = copy_out(a, 0, length);
+	r = copy_out(a, zip->temp_fd, 0, data_size);
+	if (r != ARCHIVE_OK)
+		return (r);
+	r = copy_out(a, zip->stored_fd, 0, zip->stored_offset);
+	if (r != ARCHIVE_OK)
+		return (r);
+	r = copy_out(a, zip->temp_fd, data_size, length - data_size);
 	if (r != ARCHIVE_OK)
 		return (r);
 	r = flush_wbuff(a);
@@ -882,6 +1059,7 @@ make_substreamsInfo(struct archive_write *a, struct coder *coders)
 {
 	struct _7zip *zip = (struct _7zip *)a->format_data;
 	struct file *file;
+	size_t i, nsolid;
 	int r;
 
 	/*
@@ -891,7 +1069,9 @@ make_substreamsInfo(struct archive_write *a, struct coder *coders)
 	if (r < 0)
 		return (r);
 
-	if (zip->total_number_nonempty_entry > 1 && coders->codec != _7Z_COPY) {
+	nsolid = zip->total_number_nonempty_entry -
+	    zip->total_number_stored_entry;
+	if (nsolid > 1 && coders->codec != _7Z_COPY) {
 		/*
 		 * Make NumUnPackStream.
 		 */
@@ -900,9 +1080,15 @@ make_substreamsInfo(struct archive_write *a, struct coder *coders)
 			return (r);
 
 		/* Write numUnpackStreams */
-		r = enc_uint64(a, zip->total_number_nonempty_entry);
+		r = enc_uint64(a, nsolid);
 		if (r < 0)
 			return (r);
+		/* Each stored file is alone in its folder. */
+		for (i = 0; i < zip->total_number_stored_entry; i++) {
+			r = enc_uint64(a, 1);
+			if (r < 0)
+				return (r);
+		}
 
 		/*
 		 * Make kSize.
@@ -911,10 +1097,7 @@ make_substreamsInfo(struct archive_write *a, struct coder *coders)
 		if (r < 0)
 			return (r);
 		file = zip->file_list.first;
-		for (;file != NULL; file = file->next) {
-			if (file->next == NULL ||
-			    file->next->size == 0)
-				break;
+		for (i = 1; i < nsolid; i++, file = file->next) {
 			r = enc_uint64(a, file->size);
 			if (r < 0)
 				return (r);
@@ -957,15 +1140,37 @@ make_streamsInfo(struct archive_write *a, uint64_t offset, uint64_t pack_size,
     uint32_t header_crc)
 {
 	struct _7zip *zip = (struct _7zip *)a->format_data;
+	struct coder copy_coder = { _7Z_COPY, 0, NULL };
+	struct file *stored_files = NULL, *file;
 	uint8_t codec_buff[8];
-	int numFolders, fi;
+	int numFolders, fi, solid, stored;
 	int codec_size;
 	int i, r;
 
-	if (coders->codec == _7Z_COPY)
-		numFolders = (int)zip->total_number_nonempty_entry;
-	else
-		numFolders = 1;
+	/*
+	 * The data is in one solid folder, apart from the files that
+	 * have COPY folders of their own.  That is every file if the
+	 * coder is COPY, else those "compression=auto" chose to store.
+	 */
+	if (!substrm) {
+		solid = 1;
+		stored = 0;
+	} else if (coders->codec == _7Z_COPY) {
+		solid = 0;
+		stored = (int)zip->total_number_nonempty_entry;
+	} else {
+		stored = (int)zip->total_number_stored_entry;
+		solid = zip->total_number_nonempty_entry > (size_t)stored;
+	}
+	numFolders = solid + stored;
+	if (stored > 0) {
+		stored_files = zip->file_list.first;
+		if (solid) {
+			size_t n = zip->total_number_nonempty_entry - stored;
+			while (n-- > 0)
+				stored_files = stored_files->next;
+		}
+	}
 
 	/*
 	 * Make PackInfo.
@@ -989,21 +1194,18 @@ make_streamsInfo(struct archive_write *a, uint64_t offset, uint64_t pack_size,
 	if (r < 0)
 		return (r);
 
-	if (numFolders > 1) {
-		struct file *file = zip->file_list.first;
-		for (;file != NULL; file = file->next) {
-			if (file->size == 0)
-				break;
-			r = enc_uint64(a, file->size);
-			if (r < 0)
-				return (r);
-		}
-	} else {
+	if (solid) {
 		/* Write size. */
 		r = enc_uint64(a, pack_size);
 		if (r < 0)
 			return (r);
 	}
+	file = stored_files;
+	for (fi = 0; fi < stored; fi++, file = file->next) {
+		r = enc_uint64(a, file->size);
+		if (r < 0)
+			return (r);
+	}
 
 	r = enc_uint64(a, kEnd);
 	if (r < 0)
@@ -1034,13 +1236,21 @@ make_streamsInfo(struct archive_write *a, uint64_t offset, uint64_t pack_size,
 		return (r);
 
 	for (fi = 0; fi < numFolders; fi++) {
+		struct coder *c = coders;
+		int nc = num_coder;
+
+		if (fi >= solid) {
+			c = &copy_coder;
+			nc = 1;
+		}
+
 		/* Write NumCoders. */
-		r = enc_uint64(a, num_coder);
+		r = enc_uint64(a, nc);
 		if (r < 0)
 			return (r);
 
-		for (i = 0; i < num_coder; i++) {
-			unsigned codec_id = coders[i].codec;
+		for (i = 0; i < nc; i++) {
+			unsigned codec_id = c[i].codec;
 
 			/* Write Codec flag. */
 			archive_be64enc(codec_buff, codec_id);
@@ -1050,7 +1260,7 @@ make_streamsInfo(struct archive_write *a, uint64_t offset, uint64_t pack_size,
 			}
 			if (codec_size == 0)
 				codec_size = 1;
-			if (coders[i].prop_size)
+			if (c[i].prop_size)
 				r = enc_uint64(a, codec_size | 0x20);
 			else
 				r = enc_uint64(a, codec_size);
@@ -1064,15 +1274,15 @@ make_streamsInfo(struct archive_write *a, uint64_t offset, uint64_t pack_size,
 			if (r < 0)
 				return (r);
 
-			if (coders[i].prop_size) {
+			if (c[i].prop_size) {
 				/* Write Codec property size. */
-				r = enc_uint64(a, coders[i].prop_size);
+				r = enc_uint64(a, c[i].prop_size);
 				if (r < 0)
 					return (r);
 
 				/* Write Codec properties. */
-				r = (int)compress_out(a, coders[i].props,
-					coders[i].prop_size, ARCHIVE_Z_RUN);
+				r = (int)compress_out(a, c[i].props,
+					c[i].prop_size, ARCHIVE_Z_RUN);
 				if (r < 0)
 					return (r);
 			}
@@ -1086,22 +1296,18 @@ make_streamsInfo(struct archive_write *a, uint64_t offset, uint64_t pack_size,
 	if (r < 0)
 		return (r);
 
-	if (numFolders > 1) {
-		struct file *file = zip->file_list.first;
-		for (;file != NULL; file = file->next) {
-			if (file->size == 0)
-				break;
-			r = enc_uint64(a, file->size);
-			if (r < 0)
-				return (r);
-		}
-
-	} else {
+	if (solid) {
 		/* Write UnPackSize. */
 		r = enc_uint64(a, unpack_size);
 		if (r < 0)
 			return (r);
 	}
+	file = stored_files;
+	for (fi = 0; fi < stored; fi++, file = file->next) {
+		r = enc_uint64(a, file->size);
+		if (r < 0)
+			return (r);
+	}
 
 	if (!substrm) {
 		uint8_t crc[4];
@@ -1457,21 +1663,36 @@ _7z_free(struct archive_write *a)
 {
 	struct _7zip *zip = (struct _7zip *)a->format_data;
 
-	/* Close the temporary file. */
+	/* Close the temporary files. */
 	if (zip->temp_fd >= 0)
 		close(zip->temp_fd);
+	if (zip->stored_fd >= 0)
+		close(zip->stored_fd);
 
+	/* A file whose data was still being sampled is on no list. */
+	if (zip->entry_sampling && zip->cur_file != NULL)
+		file_free(zip->cur_file);
 	file_free_register(zip);
+	__archive_hmap_free(&(zip->empty_dirs));
 	compression_end(&(a->archive), &(zip->stream));
 	free(zip->coder.props);
+	free(zip->sample);
+	__archive_store_extensions_free(&zip->store_extensions);
 	free(zip);
 
 	return (ARCHIVE_OK);
 }
 
+static uint64_t
+file_hash_node(const void *n)
+{
+	const struct file *f = (const struct file *)n;
+
+	return (__archive_hmap_hash_bytes(f->utf16name, f->name_len));
+}
+
 static int
-file_cmp_node(const struct archive_rb_node *n1,
-    const struct archive_rb_node *n2)
+file_cmp_node(const void *n1, const void *n2)
 {
 	const struct file *f1 = (const struct file *)n1;
 	const struct file *f2 = (const struct file *)n2;
@@ -1480,13 +1701,16 @@ file_cmp_node(const struct archive_rb_node *n1,
 		return (memcmp(f1->utf16name, f2->utf16name, f1->name_len));
 	return (f1->name_len > f2->name_len)?1:-1;
 }
-        
+
+/*
+ * qsort() callback for the empty directories, which are written
+ * longest name first.
+ */
 static int
-file_cmp_key(const struct archive_rb_node *n, const void *key)
+file_cmp_sort(const void *p1, const void *p2)
 {
-	const struct file *f = (const struct file *)n;
-
-	return (f->name_len - *(const char *)key);
+	return (file_cmp_node(*(const struct file * const *)p2,
+	    *(const struct file * const *)p1));
 }
 
 static int
@@ -1594,6 +1818,12 @@ file_free_register(struct _7zip *zip)
 		file_free(file);
 		file = file_next;
 	}
+	file = zip->stored_list.first;
+	while (file != NULL) {
+		file_next = file->next;
+		file_free(file);
+		file = file_next;
+	}
 }
 
 static void
@@ -1611,6 +1841,21 @@ file_init_register_empty(struct _7zip *zip)
 	zip->empty_list.last = &(zip->empty_list.first);
 }
 
+static void
+file_register_stored(struct _7zip *zip, struct file *file)
+{
+	file->next = NULL;
+	*zip->stored_list.last = file;
+	zip->stored_list.last = &(file->next);
+}
+
+static void
+file_init_register_stored(struct _7zip *zip)
+{
+	zip->stored_list.first = NULL;
+	zip->stored_list.last = &(zip->stored_list.first);
+}
+
 #if !defined(HAVE_ZLIB_H) || !defined(HAVE_BZLIB_H) ||\
 	 !defined(BZ_CONFIG_ERROR) || !defined(HAVE_LZMA_H)
 static int
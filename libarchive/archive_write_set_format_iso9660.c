@@ -56,6 +56,7 @@
 #include "archive_entry_locale.h"
 #include "archive_private.h"
 #include "archive_rb.h"
+#include "archive_time_private.h"
 #include "archive_write_private.h"
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
@@ -679,6 +680,8 @@ struct iso_option {
 struct iso9660 {
 	/* The creation time of ISO image. */
 	time_t			 birth_time;
+	/* Local time offsets for the recorded dates. */
+	struct archive_tz_cache	 tz_cache;
 	/* A file stream of a temporary file, which file contents
 	 * save to until ISO image can be created. */
 	int			 temp_fd;
@@ -2494,42 +2497,17 @@ set_digit(unsigned char *p, size_t s, int value)
 	}
 }
 
-#if defined(HAVE_STRUCT_TM_TM_GMTOFF)
-#define get_gmoffset(tm)	((tm)->tm_gmtoff)
-#elif defined(HAVE_STRUCT_TM___TM_GMTOFF)
-#define get_gmoffset(tm)	((tm)->__tm_gmtoff)
-#else
+/* Returns the offset from UTC in seconds. */
 static long
-get_gmoffset(struct tm *tm)
+get_tmfromtime(struct iso9660 *iso9660, struct tm *tm, time_t t)
 {
-	long offset;
-
-#if defined(HAVE__GET_TIMEZONE)
-	_get_timezone(&offset);
-#elif defined(__CYGWIN__) || defined(__MINGW32__) || defined(__BORLANDC__)
-	offset = _timezone;
-#else
-	offset = timezone;
-#endif
-	offset *= -1;
-	if (tm->tm_isdst)
-		offset += 3600;
-	return (offset);
-}
-#endif
+	long gmoff;
 
-static void
-get_tmfromtime(struct tm *tm, time_t *t)
-{
-#if HAVE_LOCALTIME_R
-	tzset();
-	localtime_r(t, tm);
-#elif HAVE__LOCALTIME64_S
-	__time64_t tmp_t = (__time64_t) *t; //time_t may be shorter than 64 bits
-	_localtime64_s(tm, &tmp_t);
-#else
-	memcpy(tm, localtime(t), sizeof(*tm));
-#endif
+	if (__archive_localtime(&iso9660->tz_cache, t, tm, &gmoff) == NULL) {
+		memset(tm, 0, sizeof(*tm));
+		gmoff = 0;
+	}
+	return (gmoff);
 }
 
 /*
@@ -2537,11 +2515,12 @@ get_tmfromtime(struct tm *tm, time_t *t)
  * ISO9660 Standard 8.4.26.1
  */
 static void
-set_date_time(unsigned char *p, time_t t)
+set_date_time(unsigned char *p, time_t t, struct iso9660 *iso9660)
 {
 	struct tm tm;
+	long gmoff;
 
-	get_tmfromtime(&tm, &t);
+	gmoff = get_tmfromtime(iso9660, &tm, t);
 	set_digit(p, 4, tm.tm_year + 1900);
 	set_digit(p+4, 2, tm.tm_mon + 1);
 	set_digit(p+6, 2, tm.tm_mday);
@@ -2549,7 +2528,7 @@ set_date_time(unsigned char *p, time_t t)
 	set_digit(p+10, 2, tm.tm_min);
 	set_digit(p+12, 2, tm.tm_sec);
 	set_digit(p+14, 2, 0);
-	set_num_712(p+16, (char)(get_gmoffset(&tm)/(60*15)));
+	set_num_712(p+16, (char)(gmoff/(60*15)));
 }
 
 static void
@@ -2560,18 +2539,19 @@ set_date_time_null(unsigned char *p)
 }
 
 static void
-set_time_915(unsigned char *p, time_t t)
+set_time_915(unsigned char *p, time_t t, struct iso9660 *iso9660)
 {
 	struct tm tm;
+	long gmoff;
 
-	get_tmfromtime(&tm, &t);
+	gmoff = get_tmfromtime(iso9660, &tm, t);
 	set_num_711(p+0, tm.tm_year);
 	set_num_711(p+1, tm.tm_mon+1);
 	set_num_711(p+2, tm.tm_mday);
 	set_num_711(p+3, tm.tm_hour);
 	set_num_711(p+4, tm.tm_min);
 	set_num_711(p+5, tm.tm_sec);
-	set_num_712(p+6, (char)(get_gmoffset(&tm)/(60*15)));
+	set_num_712(p+6, (char)(gmoff/(60*15)));
 }
 
 
@@ -3248,25 +3228,25 @@ set_directory_record_rr(unsigned char *bp, int dr_len,
 			/* Creation time */
 			if (tf_flags & TF_CREATION) {
 				set_time_915(bp+1,
-				    archive_entry_birthtime(file->entry));
+				    archive_entry_birthtime(file->entry), iso9660);
 				bp += 7;
 			}
 			/* Modification time */
 			if (tf_flags & TF_MODIFY) {
 				set_time_915(bp+1,
-				    archive_entry_mtime(file->entry));
+				    archive_entry_mtime(file->entry), iso9660);
 				bp += 7;
 			}
 			/* Last Access time */
 			if (tf_flags & TF_ACCESS) {
 				set_time_915(bp+1,
-				    archive_entry_atime(file->entry));
+				    archive_entry_atime(file->entry), iso9660);
 				bp += 7;
 			}
 			/* Last Attribute Change time */
 			if (tf_flags & TF_ATTRIBUTES) {
 				set_time_915(bp+1,
-				    archive_entry_ctime(file->entry));
+				    archive_entry_ctime(file->entry), iso9660);
 				bp += 7;
 			}
 		}
@@ -3513,7 +3493,7 @@ set_directory_record(unsigned char *p, size_t n, struct isoent *isoent,
 		 *  seems mkisofs uses stat to get.
 		 */
 		set_time_915(bp+19,
-		    archive_entry_mtime(xisoent->file->entry));
+		    archive_entry_mtime(xisoent->file->entry), iso9660);
 		/* File Flags */
 		bp[26] = flag;
 		/* File Unit Size */
@@ -3956,13 +3936,13 @@ write_VD(struct archive_write *a, struct vdd *vdd)
 	if (r != ARCHIVE_OK)
 		return (r);
 	/* Volume Creation Date and Time */
-	set_date_time(bp+814, iso9660->birth_time);
+	set_date_time(bp+814, iso9660->birth_time, iso9660);
 	/* Volume Modification Date and Time */
-	set_date_time(bp+831, iso9660->birth_time);
+	set_date_time(bp+831, iso9660->birth_time, iso9660);
 	/* Volume Expiration Date and Time(obsolete) */
 	set_date_time_null(bp+848);
 	/* Volume Effective Date and Time */
-	set_date_time(bp+865, iso9660->birth_time);
+	set_date_time(bp+865, iso9660->birth_time, iso9660);
 	/* File Structure Version */
 	bp[882] = fst_ver;
 	/* Reserved */
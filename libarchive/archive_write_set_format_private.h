@@ -36,7 +36,32 @@
 
 #include "archive.h"
 #include "archive_entry.h"
+#include "archive_string.h"
 
 void __archive_write_entry_filetype_unsupported(struct archive *a,
     struct archive_entry *entry, const char *format);
+
+/*
+ * Support for the "compression=auto" option of the zip and 7zip
+ * writers, which stores an entry instead of compressing it if its
+ * name or the first ARCHIVE_AUTO_SAMPLE_SIZE bytes of its data say
+ * that compression won't pay.
+ */
+#define ARCHIVE_AUTO_SAMPLE_SIZE	(64 * 1024)
+
+/* Filename extensions of formats that are compressed already. */
+struct archive_store_extensions {
+	struct archive_string	 names;	/* Lower case, NUL-terminated. */
+};
+
+void	__archive_store_extensions_init(struct archive_store_extensions *);
+void	__archive_store_extensions_free(struct archive_store_extensions *);
+/* Handles the "store-extension" option; a NULL value clears the list. */
+int	__archive_store_extensions_option(struct archive *,
+	    struct archive_store_extensions *, const char *format,
+	    const char *value);
+int	__archive_store_extensions_match(
+	    const struct archive_store_extensions *, const char *pathname);
+/* Returns non-zero if the sample looks like it will compress. */
+int	__archive_write_sample_compressible(const void *, size_t);
 #endif
@@ -54,6 +54,7 @@ __FBSDID("$FreeBSD$");
 #include "archive_private.h"
 #include "archive_rb.h"
 #include "archive_string.h"
+#include "archive_time_private.h"
 #include "archive_write_private.h"
 
 /*
@@ -906,18 +907,9 @@ xmlwrite_time(struct archive_write *a, xmlTextWriterPtr writer,
 {
 	char timestr[100];
 	struct tm tm;
-#if defined(HAVE__GMTIME64_S)
-	__time64_t tmptime;
-#endif
 
-#if defined(HAVE_GMTIME_R)
-	gmtime_r(&t, &tm);
-#elif defined(HAVE__GMTIME64_S)
-	tmptime = t;
-	_gmtime64_s(&tm, &tmptime);
-#else
-	memcpy(&tm, gmtime(&t), sizeof(tm));
-#endif
+	if (__archive_gmtime(t, &tm) == NULL)
+		memset(&tm, 0, sizeof(tm));
 	memset(&timestr, 0, sizeof(timestr));
 	/* Do not use %F and %T for portability. */
 	strftime(timestr, sizeof(timestr), "%Y-%m-%dT%H:%M:%S", &tm);
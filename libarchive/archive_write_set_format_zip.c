@@ -44,18 +44,24 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_write_set_format_zip.c 201168 20
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #ifdef HAVE_ZLIB_H
 #include <zlib.h>
 #endif
 
 #include "archive.h"
 #include "archive_cryptor_private.h"
+#include "archive_digest_private.h"
 #include "archive_endian.h"
 #include "archive_entry.h"
 #include "archive_entry_locale.h"
 #include "archive_hmac_private.h"
+#include "archive_hmap.h"
 #include "archive_private.h"
 #include "archive_random_private.h"
+#include "archive_time_private.h"
 #include "archive_write_private.h"
 #include "archive_write_set_format_private.h"
 
@@ -71,6 +77,7 @@ __FBSDID("$FreeBSD: head/lib/libarchive/archive_write_set_format_zip.c 201168 20
 #define ZIP_4GB_MAX_UNCOMPRESSED ARCHIVE_LITERAL_LL(0xff000000)
 
 enum compression {
+	COMPRESSION_AUTO = -2,
 	COMPRESSION_UNSPECIFIED = -1,
 	COMPRESSION_STORE = 0,
 	COMPRESSION_DEFLATE = 8
@@ -119,6 +126,32 @@ struct trad_enc_ctx {
 	uint32_t keys[3];
 };
 
+/*
+ * A regular file already in the archive, for the "dedup" option.
+ * Files are looked up by size and a CRC of their first
+ * DEDUP_HEAD_SIZE bytes; the SHA-256 of the whole content decides.
+ */
+#define DEDUP_HEAD_SIZE	(64 * 1024)
+
+struct zip_dedup {
+	struct zip_dedup *next;		/* Same size and head CRC. */
+	struct zip_dedup *older;	/* All files, for freeing. */
+	int64_t size;
+	uint32_t head_crc;
+	unsigned char sha256[32];
+	int64_t offset;			/* Of the local file header. */
+	int64_t compressed_size;
+	uint32_t crc32;
+	enum compression compression;
+};
+
+enum dedup_state {
+	DEDUP_OFF = 0,
+	DEDUP_HEAD,	/* Collecting the first DEDUP_HEAD_SIZE bytes. */
+	DEDUP_SPOOL,	/* Might be a duplicate; holding all the data. */
+	DEDUP_HASH	/* Not a duplicate; hashing to register it. */
+};
+
 struct zip {
 
 	int64_t entry_offset;
@@ -133,6 +166,7 @@ struct zip {
 	enum encryption  entry_encryption;
 	int entry_flags;
 	int entry_uses_zip64;
+	int entry_header_pending;
 	int experiments;
 	struct trad_enc_ctx tctx;
 	char tctx_valid;
@@ -158,6 +192,7 @@ struct zip {
 	struct archive_string_conv *sconv_default;
 	enum compression requested_compression;
 	int deflate_compression_level;
+	struct archive_store_extensions store_extensions;
 	int init_default_conversion;
 	enum encryption  encryption_type;
 
@@ -171,6 +206,32 @@ struct zip {
 #endif
 	size_t len_buf;
 	unsigned char *buf;
+
+	/* The start of an entry's data, for "compression=auto". */
+	unsigned char *sample;
+	size_t sample_bytes;
+	size_t sample_wanted;
+
+	/* Whole-file deduplication, for "dedup". */
+	int dedup;
+	enum dedup_state entry_dedup;
+	struct zip_dedup *entry_duplicate;
+	int64_t dedup_size;		/* Bytes taken for this entry. */
+	int64_t dedup_limit;
+	uint32_t dedup_head_crc;
+	unsigned char *dedup_head;
+	size_t dedup_head_bytes;
+	size_t dedup_head_wanted;
+	int dedup_fd;			/* Spool for the rest of the data. */
+	int64_t dedup_spool_bytes;
+	archive_sha256_ctx dedup_sha256ctx;
+	int dedup_sha256_valid;
+	unsigned char dedup_sha256[32];
+	struct archive_hmap dedup_map;
+	struct zip_dedup *dedup_list;
+
+	/* Local time offsets for MS-DOS timestamps. */
+	struct archive_tz_cache tz_cache;
 };
 
 /* Don't call this min or MIN, since those are already defined
@@ -186,7 +247,18 @@ static int archive_write_zip_header(struct archive_write *,
 	      struct archive_entry *);
 static int archive_write_zip_options(struct archive_write *,
 	      const char *, const char *);
-static unsigned int dos_time(const time_t);
+static int write_entry_header(struct archive_write *);
+static int write_local_header(struct archive_write *);
+static int write_sample(struct archive_write *);
+static ssize_t zip_write_data(struct archive_write *, const void *, size_t);
+static int finish_central_directory_entry(struct archive_write *);
+static ssize_t dedup_data(struct archive_write *, const void *, size_t);
+static int dedup_resolve(struct archive_write *);
+static int dedup_register(struct archive_write *);
+static int dedup_replay(struct archive_write *);
+static void dedup_digest(struct zip *);
+static void dedup_free(struct zip *);
+static unsigned int dos_time(struct zip *, const time_t);
 static size_t path_length(struct archive_entry *);
 static int write_path(struct archive_entry *, struct archive_write *);
 static void copy_path(struct archive_entry *, unsigned char *);
@@ -234,6 +306,61 @@ cd_alloc(struct zip *zip, size_t length)
 	return (p);
 }
 
+struct zip_dedup_key {
+	int64_t size;
+	uint32_t head_crc;
+};
+
+static uint64_t
+dedup_hash(int64_t size, uint32_t head_crc)
+{
+	unsigned char k[12];
+
+	archive_le64enc(k, (uint64_t)size);
+	archive_le32enc(k + 8, head_crc);
+	return (__archive_hmap_hash_bytes(k, sizeof(k)));
+}
+
+static uint64_t
+dedup_hash_key(const void *key)
+{
+	const struct zip_dedup_key *k = (const struct zip_dedup_key *)key;
+
+	return (dedup_hash(k->size, k->head_crc));
+}
+
+static uint64_t
+dedup_hash_node(const void *n)
+{
+	const struct zip_dedup *d = (const struct zip_dedup *)n;
+
+	return (dedup_hash(d->size, d->head_crc));
+}
+
+static int
+dedup_cmp_key(const void *n, const void *key)
+{
+	const struct zip_dedup *d = (const struct zip_dedup *)n;
+	const struct zip_dedup_key *k = (const struct zip_dedup_key *)key;
+
+	return (d->size != k->size || d->head_crc != k->head_crc);
+}
+
+static int
+dedup_cmp_nodes(const void *n1, const void *n2)
+{
+	const struct zip_dedup *d2 = (const struct zip_dedup *)n2;
+	struct zip_dedup_key k;
+
+	k.size = d2->size;
+	k.head_crc = d2->head_crc;
+	return (dedup_cmp_key(n1, &k));
+}
+
+static const struct archive_hmap_ops dedup_map_ops = {
+	&dedup_hash_key, &dedup_hash_node, &dedup_cmp_key, &dedup_cmp_nodes
+};
+
 static unsigned long
 real_crc32(unsigned long crc, const void *buff, size_t len)
 {
@@ -265,6 +392,14 @@ archive_write_zip_options(struct archive_write *a, const char *key,
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 			    "%s: compression option needs a compression name",
 			    a->format_name);
+		} else if (strcmp(val, "auto") == 0) {
+#ifdef HAVE_ZLIB_H
+			zip->requested_compression = COMPRESSION_AUTO;
+			ret = ARCHIVE_OK;
+#else
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "deflate compression not supported");
+#endif
 		} else if (strcmp(val, "deflate") == 0) {
 #ifdef HAVE_ZLIB_H
 			zip->requested_compression = COMPRESSION_DEFLATE;
@@ -288,7 +423,10 @@ archive_write_zip_options(struct archive_write *a, const char *key,
 			return ARCHIVE_OK;
 		} else {
 #ifdef HAVE_ZLIB_H
-			zip->requested_compression = COMPRESSION_DEFLATE;
+			/* "auto" still decides between this and store. */
+			if (zip->requested_compression != COMPRESSION_AUTO)
+				zip->requested_compression =
+				    COMPRESSION_DEFLATE;
 			zip->deflate_compression_level = val[0] - '0';
 			return ARCHIVE_OK;
 #else
@@ -296,6 +434,23 @@ archive_write_zip_options(struct archive_write *a, const char *key,
 			    "deflate compression not supported");
 #endif
 		}
+	} else if (strcmp(key, "dedup") == 0) {
+		/*
+		 * Store the data of identical regular files once and
+		 * point their central directory entries at it.
+		 */
+		if (val == NULL || val[0] == 0) {
+			zip->dedup = 0;
+			return (ARCHIVE_OK);
+		}
+#ifdef ARCHIVE_HAS_SHA256
+		zip->dedup = 1;
+		return (ARCHIVE_OK);
+#else
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+		    "%s: dedup needs SHA-256 support", a->format_name);
+		return (ARCHIVE_FAILED);
+#endif
 	} else if (strcmp(key, "encryption") == 0) {
 		if (val == NULL) {
 			zip->encryption_type = ENCRYPTION_NONE;
@@ -372,6 +527,9 @@ archive_write_zip_options(struct archive_write *a, const char *key,
 				ret = ARCHIVE_FATAL;
 		}
 		return (ret);
+	} else if (strcmp(key, "store-extension") == 0) {
+		return (__archive_store_extensions_option(&a->archive,
+		    &zip->store_extensions, a->format_name, val));
 	} else if (strcmp(key, "zip64") == 0) {
 		/*
 		 * Bias decisions about Zip64: force them to be
@@ -471,11 +629,15 @@ archive_write_set_format_zip(struct archive *_a)
 	zip->deflate_compression_level = Z_DEFAULT_COMPRESSION;
 #endif
 	zip->crc32func = real_crc32;
+	__archive_store_extensions_init(&zip->store_extensions);
+	__archive_hmap_init(&zip->dedup_map, &dedup_map_ops);
+	zip->dedup_fd = -1;
 
 	/* A buffer used for both compression and encryption. */
 	zip->len_buf = 65536;
 	zip->buf = malloc(zip->len_buf);
 	if (zip->buf == NULL) {
+		__archive_store_extensions_free(&zip->store_extensions);
 		free(zip);
 		archive_set_error(&a->archive, ENOMEM,
 		    "Can't allocate compression buffer");
@@ -511,18 +673,10 @@ is_all_ascii(const char *p)
 static int
 archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 {
-	unsigned char local_header[32];
-	unsigned char local_extra[144];
 	struct zip *zip = a->format_data;
-	unsigned char *e;
-	unsigned char *cd_extra;
-	size_t filename_length;
-	const char *slink = NULL;
-	size_t slink_size = 0;
 	struct archive_string_conv *sconv = get_sconv(a, zip);
 	int ret, ret2 = ARCHIVE_OK;
 	mode_t type;
-	int version_needed = 10;
 
 	/* Ignore types of entries that we don't support. */
 	type = archive_entry_filetype(entry);
@@ -563,6 +717,11 @@ archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 	zip->entry_uncompressed_written = 0;
 	zip->entry_flags = 0;
 	zip->entry_uses_zip64 = 0;
+	zip->entry_header_pending = 0;
+	dedup_digest(zip);	/* In case the last entry was abandoned. */
+	zip->entry_dedup = DEDUP_OFF;
+	zip->entry_duplicate = NULL;
+	zip->entry_compression = COMPRESSION_UNSPECIFIED;
 	zip->entry_crc32 = zip->crc32func(0, NULL, 0);
 	zip->entry_encryption = 0;
 	archive_entry_free(zip->entry);
@@ -657,6 +816,90 @@ archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 #endif
 		}
 	}
+
+	if (zip->dedup && type == AE_IFREG
+	    && (zip->entry_flags & ZIP_ENTRY_FLAG_ENCRYPTED) == 0
+	    && archive_entry_size_is_set(zip->entry)
+	    && archive_entry_size(zip->entry) > 0) {
+		/* Nothing is written until dedup_data() knows whether
+		 * this file's data is already in the archive. */
+		if (archive_sha256_init(&zip->dedup_sha256ctx)
+		    != ARCHIVE_OK) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "Can't initialize SHA-256");
+			return (ARCHIVE_FATAL);
+		}
+		zip->dedup_sha256_valid = 1;
+		zip->entry_dedup = DEDUP_HEAD;
+		zip->dedup_size = 0;
+		zip->dedup_limit = archive_entry_size(zip->entry);
+		zip->dedup_head_bytes = 0;
+		zip->dedup_head_wanted = (size_t)zipmin(zip->dedup_limit,
+		    DEDUP_HEAD_SIZE);
+		zip->dedup_spool_bytes = 0;
+		return (ret2);
+	}
+
+	ret = write_entry_header(a);
+	if (ret != ARCHIVE_OK)
+		return (ret);
+	return (ret2);
+}
+
+/*
+ * Write the local file header for zip->entry, unless
+ * "compression=auto" has to see the start of the data first.
+ */
+static int
+write_entry_header(struct archive_write *a)
+{
+	struct zip *zip = a->format_data;
+	struct archive_entry *entry = zip->entry;
+
+	if (archive_entry_filetype(entry) == AE_IFREG
+	    && zip->requested_compression == COMPRESSION_AUTO
+	    && archive_entry_size_is_set(entry)
+	    && archive_entry_size(entry) > 0) {
+		if (__archive_store_extensions_match(&zip->store_extensions,
+		    archive_entry_pathname(entry))) {
+			zip->entry_compression = COMPRESSION_STORE;
+		} else {
+			/* The header records the compression method, so
+			 * it has to wait until write_sample() has seen
+			 * the start of the data. */
+			zip->entry_header_pending = 1;
+			zip->sample_bytes = 0;
+			zip->sample_wanted = (size_t)zipmin(
+			    archive_entry_size(entry),
+			    ARCHIVE_AUTO_SAMPLE_SIZE);
+			return (ARCHIVE_OK);
+		}
+	}
+	return (write_local_header(a));
+}
+
+/*
+ * Write the local file header for zip->entry and start the central
+ * directory header.  The compression method is chosen here unless
+ * "compression=auto" has already picked one.  A duplicate found by
+ * "dedup" gets only the central directory header.
+ */
+static int
+write_local_header(struct archive_write *a)
+{
+	unsigned char local_header[32];
+	unsigned char local_extra[144];
+	struct zip *zip = a->format_data;
+	struct archive_entry *entry = zip->entry;
+	unsigned char *e;
+	unsigned char *cd_extra;
+	size_t filename_length;
+	const char *slink = NULL;
+	size_t slink_size = 0;
+	int ret;
+	mode_t type = archive_entry_filetype(entry);
+	int version_needed = 10;
+
 	filename_length = path_length(zip->entry);
 
 	/* Determine appropriate compression and size for this entry. */
@@ -682,8 +925,10 @@ archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 		int64_t additional_size = 0;
 
 		zip->entry_uncompressed_limit = size;
-		zip->entry_compression = zip->requested_compression;
-		if (zip->entry_compression == COMPRESSION_UNSPECIFIED) {
+		if (zip->entry_compression == COMPRESSION_UNSPECIFIED)
+			zip->entry_compression = zip->requested_compression;
+		if (zip->entry_compression == COMPRESSION_UNSPECIFIED
+		    || zip->entry_compression == COMPRESSION_AUTO) {
 			zip->entry_compression = COMPRESSION_DEFAULT;
 		}
 		if (zip->entry_compression == COMPRESSION_STORE) {
@@ -771,6 +1016,16 @@ archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 		}
 	}
 
+	if (type == AE_IFREG && zip->requested_compression == COMPRESSION_AUTO
+	    && zip->entry_duplicate == NULL
+	    && (!archive_entry_size_is_set(entry)
+		|| archive_entry_size(entry) > 0)) {
+		if (zip->entry_compression == COMPRESSION_STORE)
+			a->auto_entries_stored++;
+		else
+			a->auto_entries_compressed++;
+	}
+
 	/* Format the local header. */
 	memset(local_header, 0, sizeof(local_header));
 	memcpy(local_header, "PK\003\004", 4);
@@ -782,7 +1037,7 @@ archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 	else
 		archive_le16enc(local_header + 8, zip->entry_compression);
 	archive_le32enc(local_header + 10,
-		dos_time(archive_entry_mtime(zip->entry)));
+		dos_time(zip, archive_entry_mtime(zip->entry)));
 	archive_le32enc(local_header + 14, zip->entry_crc32);
 	if (zip->entry_uses_zip64) {
 		/* Zip64 data in the local header "must" include both
@@ -821,7 +1076,7 @@ archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 	else
 		archive_le16enc(zip->file_header + 10, zip->entry_compression);
 	archive_le32enc(zip->file_header + 12,
-		dos_time(archive_entry_mtime(zip->entry)));
+		dos_time(zip, archive_entry_mtime(zip->entry)));
 	archive_le16enc(zip->file_header + 28, (uint16_t)filename_length);
 	/* Following Info-Zip, store mode in the "external attributes" field. */
 	archive_le32enc(zip->file_header + 38,
@@ -956,6 +1211,11 @@ archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 	/* Update local header with size of extra data and write it all out: */
 	archive_le16enc(local_header + 28, (uint16_t)(e - local_extra));
 
+	/* A duplicate shares the local header and data of an
+	 * earlier file. */
+	if (zip->entry_duplicate != NULL)
+		return (ARCHIVE_OK);
+
 	ret = __archive_write_output(a, local_header, 30);
 	if (ret != ARCHIVE_OK)
 		return (ARCHIVE_FATAL);
@@ -997,15 +1257,82 @@ archive_write_zip_header(struct archive_write *a, struct archive_entry *entry)
 	}
 #endif
 
-	return (ret2);
+	return (ARCHIVE_OK);
+}
+
+/*
+ * "compression=auto": choose the compression method for the entry from
+ * the data collected so far, then write the header and the sample.
+ */
+static int
+write_sample(struct archive_write *a)
+{
+	struct zip *zip = a->format_data;
+	ssize_t bytes;
+	int ret;
+
+	zip->entry_header_pending = 0;
+	if (__archive_write_sample_compressible(zip->sample,
+	    zip->sample_bytes))
+		zip->entry_compression = COMPRESSION_DEFLATE;
+	else
+		zip->entry_compression = COMPRESSION_STORE;
+	ret = write_local_header(a);
+	if (ret != ARCHIVE_OK)
+		return (ret);
+	if (zip->sample_bytes == 0)
+		return (ARCHIVE_OK);
+	bytes = zip_write_data(a, zip->sample, zip->sample_bytes);
+	if (bytes < 0)
+		return ((int)bytes);
+	return (ARCHIVE_OK);
 }
 
 static ssize_t
 archive_write_zip_data(struct archive_write *a, const void *buff, size_t s)
+{
+	struct zip *zip = a->format_data;
+
+	if (zip->entry_dedup != DEDUP_OFF)
+		return (dedup_data(a, buff, s));
+	return (zip_write_data(a, buff, s));
+}
+
+static ssize_t
+zip_write_data(struct archive_write *a, const void *buff, size_t s)
 {
 	int ret;
 	struct zip *zip = a->format_data;
 
+	if (zip->entry_header_pending) {
+		size_t n = zip->sample_wanted - zip->sample_bytes;
+		ssize_t bytes;
+
+		if (zip->sample == NULL) {
+			zip->sample = malloc(ARCHIVE_AUTO_SAMPLE_SIZE);
+			if (zip->sample == NULL) {
+				archive_set_error(&a->archive, ENOMEM,
+				    "Can't allocate zip data");
+				return (ARCHIVE_FATAL);
+			}
+		}
+		if (n > s)
+			n = s;
+		memcpy(zip->sample + zip->sample_bytes, buff, n);
+		zip->sample_bytes += n;
+		if (zip->sample_bytes < zip->sample_wanted)
+			return (n);
+		ret = write_sample(a);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+		if (n == s)
+			return (n);
+		bytes = zip_write_data(a, (const char *)buff + n, s - n);
+		if (bytes < 0)
+			return (bytes);
+		return (n + bytes);
+	}
+
 	if ((int64_t)s > zip->entry_uncompressed_limit)
 		s = (size_t)zip->entry_uncompressed_limit;
 	zip->entry_uncompressed_written += s;
@@ -1142,6 +1469,21 @@ archive_write_zip_finish_entry(struct archive_write *a)
 	struct zip *zip = a->format_data;
 	int ret;
 
+	if (zip->entry_dedup == DEDUP_HEAD
+	    || zip->entry_dedup == DEDUP_SPOOL) {
+		ret = dedup_resolve(a);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+		if (zip->entry_duplicate != NULL)
+			return (finish_central_directory_entry(a));
+	}
+
+	if (zip->entry_header_pending) {
+		ret = write_sample(a);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
+
 #if HAVE_ZLIB_H
 	if (zip->entry_compression == COMPRESSION_DEFLATE) {
 		for (;;) {
@@ -1220,6 +1562,21 @@ archive_write_zip_finish_entry(struct archive_write *a)
 			return (ARCHIVE_FATAL);
 	}
 
+	ret = finish_central_directory_entry(a);
+	if (ret == ARCHIVE_OK && zip->entry_dedup == DEDUP_HASH)
+		ret = dedup_register(a);
+	return (ret);
+}
+
+/*
+ * Fill in the sizes, CRC and offset of the central directory header
+ * started by write_local_header().
+ */
+static int
+finish_central_directory_entry(struct archive_write *a)
+{
+	struct zip *zip = a->format_data;
+
 	/* Append Zip64 extra data to central directory information. */
 	if (zip->entry_compressed_written > ZIP_4GB_MAX
 	    || zip->entry_uncompressed_written > ZIP_4GB_MAX
@@ -1360,6 +1717,9 @@ archive_write_zip_free(struct archive_write *a)
 		free(segment);
 	}
 	free(zip->buf);
+	free(zip->sample);
+	dedup_free(zip);
+	__archive_store_extensions_free(&zip->store_extensions);
 	archive_entry_free(zip->entry);
 	if (zip->cctx_valid)
 		archive_encrypto_aes_ctr_release(&zip->cctx);
@@ -1372,37 +1732,268 @@ archive_write_zip_free(struct archive_write *a)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * "dedup": take data for a regular file whose header is on hold.
+ * The first DEDUP_HEAD_SIZE bytes are kept in memory.  If no earlier
+ * file has the same size and starts the same way, the header and the
+ * data go out as usual; otherwise the rest of the data is spooled to
+ * a temporary file until dedup_resolve() can compare digests.
+ */
+static ssize_t
+dedup_data(struct archive_write *a, const void *buff, size_t s)
+{
+	struct zip *zip = a->format_data;
+	const unsigned char *p = buff;
+	struct zip_dedup_key key;
+	size_t n, ss;
+	ssize_t ws;
+
+	if ((int64_t)s > zip->dedup_limit - zip->dedup_size)
+		s = (size_t)(zip->dedup_limit - zip->dedup_size);
+	if (s == 0)
+		return (0);
+	archive_sha256_update(&zip->dedup_sha256ctx, buff, s);
+	zip->dedup_size += s;
+
+	if (zip->entry_dedup == DEDUP_HASH)
+		return (zip_write_data(a, buff, s));
+
+	ss = s;
+	if (zip->entry_dedup == DEDUP_HEAD) {
+		if (zip->dedup_head == NULL) {
+			zip->dedup_head = malloc(DEDUP_HEAD_SIZE);
+			if (zip->dedup_head == NULL) {
+				archive_set_error(&a->archive, ENOMEM,
+				    "Can't allocate zip data");
+				return (ARCHIVE_FATAL);
+			}
+		}
+		n = zip->dedup_head_wanted - zip->dedup_head_bytes;
+		if (n > ss)
+			n = ss;
+		memcpy(zip->dedup_head + zip->dedup_head_bytes, p, n);
+		zip->dedup_head_bytes += n;
+		p += n;
+		ss -= n;
+		/* A file that fits in the head is decided at the end. */
+		if (zip->dedup_head_bytes < zip->dedup_head_wanted
+		    || zip->dedup_limit == (int64_t)zip->dedup_head_bytes)
+			return (s);
+
+		zip->dedup_head_crc = (uint32_t)real_crc32(0,
+		    zip->dedup_head, zip->dedup_head_bytes);
+		key.size = zip->dedup_limit;
+		key.head_crc = zip->dedup_head_crc;
+		if (__archive_hmap_find(&zip->dedup_map, &key) == NULL) {
+			int ret;
+
+			zip->entry_dedup = DEDUP_HASH;
+			ret = dedup_replay(a);
+			if (ret != ARCHIVE_OK)
+				return (ret);
+			if (ss > 0) {
+				ws = zip_write_data(a, p, ss);
+				if (ws < 0)
+					return (ws);
+			}
+			return (s);
+		}
+		zip->entry_dedup = DEDUP_SPOOL;
+	}
+
+	if (ss == 0)
+		return (s);
+	if (zip->dedup_fd < 0) {
+		zip->dedup_fd = __archive_mktemp(NULL);
+		if (zip->dedup_fd < 0) {
+			archive_set_error(&a->archive, errno,
+			    "Couldn't create temporary file");
+			return (ARCHIVE_FATAL);
+		}
+	} else if (zip->dedup_spool_bytes == 0
+	    && lseek(zip->dedup_fd, 0, SEEK_SET) < 0) {
+		archive_set_error(&a->archive, errno, "lseek failed");
+		return (ARCHIVE_FATAL);
+	}
+	while (ss > 0) {
+		ws = write(zip->dedup_fd, p, ss);
+		if (ws < 0) {
+			archive_set_error(&a->archive, errno,
+			    "Can't write temporary file");
+			return (ARCHIVE_FATAL);
+		}
+		p += ws;
+		ss -= ws;
+		zip->dedup_spool_bytes += ws;
+	}
+	return (s);
+}
+
+/*
+ * Write the header for a file held back by dedup_data() and pass it
+ * everything collected so far.
+ */
+static int
+dedup_replay(struct archive_write *a)
+{
+	struct zip *zip = a->format_data;
+	int64_t remaining;
+	ssize_t bytes;
+	int ret;
+
+	ret = write_entry_header(a);
+	if (ret != ARCHIVE_OK)
+		return (ret);
+	if (zip->dedup_head_bytes > 0) {
+		bytes = zip_write_data(a, zip->dedup_head,
+		    zip->dedup_head_bytes);
+		if (bytes < 0)
+			return ((int)bytes);
+	}
+	remaining = zip->dedup_spool_bytes;
+	zip->dedup_spool_bytes = 0;
+	if (remaining > 0 && lseek(zip->dedup_fd, 0, SEEK_SET) < 0) {
+		archive_set_error(&a->archive, errno, "lseek failed");
+		return (ARCHIVE_FATAL);
+	}
+	while (remaining > 0) {
+		/* The head has been written; reuse its buffer. */
+		bytes = read(zip->dedup_fd, zip->dedup_head,
+		    (size_t)zipmin(remaining, DEDUP_HEAD_SIZE));
+		if (bytes < 0) {
+			archive_set_error(&a->archive, errno,
+			    "Can't read temporary file");
+			return (ARCHIVE_FATAL);
+		}
+		if (bytes == 0) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "Truncated temporary file");
+			return (ARCHIVE_FATAL);
+		}
+		remaining -= bytes;
+		bytes = zip_write_data(a, zip->dedup_head, bytes);
+		if (bytes < 0)
+			return ((int)bytes);
+	}
+	return (ARCHIVE_OK);
+}
+
+static void
+dedup_digest(struct zip *zip)
+{
+	if (zip->dedup_sha256_valid) {
+		archive_sha256_final(&zip->dedup_sha256ctx,
+		    zip->dedup_sha256);
+		zip->dedup_sha256_valid = 0;
+	}
+}
+
+/*
+ * All of the file's data has been seen.  Either point the central
+ * directory at an earlier copy or write the file out now.
+ */
+static int
+dedup_resolve(struct archive_write *a)
+{
+	struct zip *zip = a->format_data;
+	struct zip_dedup_key key;
+	struct zip_dedup *d;
+
+	dedup_digest(zip);
+	if (zip->entry_dedup == DEDUP_HEAD)
+		zip->dedup_head_crc = (uint32_t)real_crc32(0,
+		    zip->dedup_head, zip->dedup_head_bytes);
+	key.size = zip->dedup_size;
+	key.head_crc = zip->dedup_head_crc;
+	d = __archive_hmap_find(&zip->dedup_map, &key);
+	while (d != NULL
+	    && memcmp(d->sha256, zip->dedup_sha256, sizeof(d->sha256)) != 0)
+		d = d->next;
+	if (d != NULL) {
+		zip->entry_duplicate = d;
+		zip->entry_dedup = DEDUP_OFF;
+		zip->entry_offset = d->offset;
+		zip->entry_compression = d->compression;
+		zip->entry_crc32 = d->crc32;
+		zip->entry_compressed_written = d->compressed_size;
+		zip->entry_uncompressed_written = d->size;
+		zip->dedup_spool_bytes = 0;
+		return (write_local_header(a));
+	}
+	zip->entry_dedup = DEDUP_HASH;
+	return (dedup_replay(a));
+}
+
+/* Remember a file that has been written, for later duplicates. */
+static int
+dedup_register(struct archive_write *a)
+{
+	struct zip *zip = a->format_data;
+	struct zip_dedup_key key;
+	struct zip_dedup *d, *first;
+
+	dedup_digest(zip);
+	d = calloc(1, sizeof(*d));
+	if (d == NULL) {
+		archive_set_error(&a->archive, ENOMEM,
+		    "Can't allocate zip data");
+		return (ARCHIVE_FATAL);
+	}
+	d->size = zip->entry_uncompressed_written;
+	d->head_crc = zip->dedup_head_crc;
+	memcpy(d->sha256, zip->dedup_sha256, sizeof(d->sha256));
+	d->offset = zip->entry_offset;
+	d->compressed_size = zip->entry_compressed_written;
+	d->crc32 = zip->entry_crc32;
+	d->compression = zip->entry_compression;
+	d->older = zip->dedup_list;
+	zip->dedup_list = d;
+
+	key.size = d->size;
+	key.head_crc = d->head_crc;
+	first = __archive_hmap_find(&zip->dedup_map, &key);
+	if (first != NULL) {
+		d->next = first->next;
+		first->next = d;
+	} else if (__archive_hmap_insert(&zip->dedup_map, d) < 0) {
+		archive_set_error(&a->archive, ENOMEM,
+		    "Can't allocate zip data");
+		return (ARCHIVE_FATAL);
+	}
+	return (ARCHIVE_OK);
+}
+
+static void
+dedup_free(struct zip *zip)
+{
+	struct zip_dedup *d;
+
+	dedup_digest(zip);
+	while (zip->dedup_list != NULL) {
+		d = zip->dedup_list;
+		zip->dedup_list = d->older;
+		free(d);
+	}
+	__archive_hmap_free(&zip->dedup_map);
+	free(zip->dedup_head);
+	if (zip->dedup_fd >= 0)
+		close(zip->dedup_fd);
+}
+
 /* Convert into MSDOS-style date/time. */
 static unsigned int
-dos_time(const time_t unix_time)
+dos_time(struct zip *zip, const time_t unix_time)
 {
 	struct tm *t;
 	unsigned int dt;
-#if defined(HAVE_LOCALTIME_R) || defined(HAVE__LOCALTIME64_S)
 	struct tm tmbuf;
-#endif
-#if defined(HAVE__LOCALTIME64_S)
-	errno_t terr;
-	__time64_t tmptime;
-#endif
 
 	/* This will not preserve time when creating/extracting the archive
 	 * on two systems with different time zones. */
-#if defined(HAVE_LOCALTIME_R)
-	t = localtime_r(&unix_time, &tmbuf);
-#elif defined(HAVE__LOCALTIME64_S)
-	tmptime = unix_time;
-	terr = _localtime64_s(&tmbuf, &tmptime);
-	if (terr)
-		t = NULL;
-	else
-		t = &tmbuf;
-#else
-	t = localtime(&unix_time);
-#endif
+	t = __archive_localtime(&zip->tz_cache, unix_time, &tmbuf, NULL);
 
 	/* MSDOS-style date/time is only between 1980-01-01 and 2107-12-31 */
-	if (t->tm_year < 1980 - 1900)
+	if (t == NULL || t->tm_year < 1980 - 1900)
 		/* Set minimum date/time '1980-01-01 00:00:00'. */
 		dt = 0x00210000U;
 	else if (t->tm_year > 2107 - 1900)
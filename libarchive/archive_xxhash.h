@@ -41,6 +41,12 @@ struct archive_xxhash {
 	XXH_errorcode (*XXH32_update)(void* state, const void* input,
 			unsigned int len);
 	unsigned int  (*XXH32_digest)(void* state);
+	uint64_t      (*XXH64)(const void* input, size_t len,
+			uint64_t seed);
+	void*         (*XXH64_init)(uint64_t seed);
+	XXH_errorcode (*XXH64_update)(void* state, const void* input,
+			size_t len);
+	uint64_t      (*XXH64_digest)(void* state);
 };
 
 extern const struct archive_xxhash __archive_xxhash;
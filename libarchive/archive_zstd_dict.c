@@ -0,0 +1,343 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(HAVE_PTHREAD_H) && HAVE_ZSTD_H && HAVE_LIBZSTD
+#include <pthread.h>
+#endif
+
+#include "archive.h"
+#include "archive_private.h"
+#include "archive_zstd_dict_private.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#ifndef O_CLOEXEC
+#define O_CLOEXEC	0
+#endif
+
+int
+__archive_zstd_window_log(const char *value)
+{
+	char *end;
+	unsigned long long size;
+	int log;
+
+	if (value == NULL || *value < '0' || *value > '9')
+		return (-1);
+	errno = 0;
+	size = strtoull(value, &end, 10);
+	if (errno != 0 || size > ((unsigned long long)1 << 31))
+		return (-1);
+	switch (*end) {
+	case 'g': case 'G':
+		size <<= 10;
+		/* FALLTHROUGH */
+	case 'm': case 'M':
+		size <<= 10;
+		/* FALLTHROUGH */
+	case 'k': case 'K':
+		size <<= 10;
+		/* Also allow "KiB" and "KB". */
+		if (strcmp(end + 1, "iB") == 0 || strcmp(end + 1, "B") == 0)
+			end += strlen(end) - 1;
+		end++;
+		break;
+	}
+	if (*end != '\0' || size > ((unsigned long long)1 << 31))
+		return (-1);
+	for (log = 10; ((unsigned long long)1 << log) < size; log++)
+		continue;
+	return (log);
+}
+
+#ifdef HAVE_ZSTD_DICT
+
+/* Unreferenced dictionaries kept for the next archive object. */
+#define IDLE_MAX	8
+
+struct zstd_cdict {
+	struct zstd_cdict	*next;
+	int			 level;
+	ZSTD_CDict		*cdict;
+};
+
+struct archive_zstd_dict {
+	struct archive_zstd_dict *next;
+	unsigned		 id;
+	unsigned		 refs;
+	void			*data;
+	size_t			 size;
+	ZSTD_DDict		*ddict;
+	struct zstd_cdict	*cdicts;
+};
+
+/* Most recently used first. */
+static struct archive_zstd_dict	*dicts;
+static unsigned			 idle;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t	dicts_mtx = PTHREAD_MUTEX_INITIALIZER;
+#define	DICTS_LOCK()	pthread_mutex_lock(&dicts_mtx)
+#define	DICTS_UNLOCK()	pthread_mutex_unlock(&dicts_mtx)
+#else
+#define	DICTS_LOCK()
+#define	DICTS_UNLOCK()
+#endif
+
+static void
+dict_free(struct archive_zstd_dict *d)
+{
+	struct zstd_cdict *c;
+
+	while ((c = d->cdicts) != NULL) {
+		d->cdicts = c->next;
+		ZSTD_freeCDict(c->cdict);
+		free(c);
+	}
+	ZSTD_freeDDict(d->ddict);
+	free(d->data);
+	free(d);
+}
+
+/*
+ * Find a dictionary with this content, move it to the front and take
+ * a reference.  Called with the lock held.
+ */
+static struct archive_zstd_dict *
+dict_lookup(unsigned id, const void *data, size_t size)
+{
+	struct archive_zstd_dict *d, **pp;
+
+	for (pp = &dicts; (d = *pp) != NULL; pp = &d->next) {
+		if (d->id == id && d->size == size &&
+		    memcmp(d->data, data, size) == 0) {
+			*pp = d->next;
+			d->next = dicts;
+			dicts = d;
+			if (d->refs++ == 0)
+				idle--;
+			return (d);
+		}
+	}
+	return (NULL);
+}
+
+struct archive_zstd_dict *
+__archive_zstd_dict_add(struct archive *a, const void *data, size_t size)
+{
+	struct archive_zstd_dict *d, *found;
+	unsigned id;
+
+	id = ZSTD_getDictID_fromDict(data, size);
+	if (id == 0) {
+		archive_set_error(a, ARCHIVE_ERRNO_MISC,
+		    "Not a zstd dictionary with a dictionary ID");
+		return (NULL);
+	}
+
+	DICTS_LOCK();
+	d = dict_lookup(id, data, size);
+	DICTS_UNLOCK();
+	if (d != NULL)
+		return (d);
+
+	d = (struct archive_zstd_dict *)calloc(1, sizeof(*d));
+	if (d != NULL && (d->data = malloc(size)) == NULL) {
+		free(d);
+		d = NULL;
+	}
+	if (d == NULL) {
+		archive_set_error(a, ENOMEM,
+		    "Can't allocate zstd dictionary");
+		return (NULL);
+	}
+	memcpy(d->data, data, size);
+	d->size = size;
+	d->id = id;
+	d->refs = 1;
+
+	DICTS_LOCK();
+	/* Another thread may have added it while we were unlocked. */
+	found = dict_lookup(id, data, size);
+	if (found == NULL) {
+		d->next = dicts;
+		dicts = d;
+	}
+	DICTS_UNLOCK();
+	if (found != NULL) {
+		dict_free(d);
+		return (found);
+	}
+	return (d);
+}
+
+struct archive_zstd_dict *
+__archive_zstd_dict_load(struct archive *a, const char *path)
+{
+	struct archive_zstd_dict *d;
+	char *data, *p;
+	size_t size, alloc;
+	ssize_t bytes;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_BINARY | O_CLOEXEC);
+	if (fd < 0) {
+		archive_set_error(a, errno,
+		    "Can't open zstd dictionary %s", path);
+		return (NULL);
+	}
+	__archive_ensure_cloexec_flag(fd);
+
+	data = NULL;
+	size = alloc = 0;
+	for (;;) {
+		if (size == alloc) {
+			alloc = alloc == 0 ? 64 * 1024 : alloc * 2;
+			p = (char *)realloc(data, alloc);
+			if (p == NULL) {
+				archive_set_error(a, ENOMEM,
+				    "Can't allocate zstd dictionary");
+				break;
+			}
+			data = p;
+		}
+		bytes = read(fd, data + size, alloc - size);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			archive_set_error(a, errno,
+			    "Can't read zstd dictionary %s", path);
+			break;
+		}
+		if (bytes == 0) {
+			close(fd);
+			d = __archive_zstd_dict_add(a, data, size);
+			free(data);
+			return (d);
+		}
+		size += bytes;
+	}
+	close(fd);
+	free(data);
+	return (NULL);
+}
+
+void
+__archive_zstd_dict_release(struct archive_zstd_dict *d)
+{
+	struct archive_zstd_dict *p, **pp, **oldest;
+
+	if (d == NULL)
+		return;
+	DICTS_LOCK();
+	if (--d->refs == 0) {
+		idle++;
+		while (idle > IDLE_MAX) {
+			/* Drop the least recently used idle dictionary. */
+			oldest = NULL;
+			for (pp = &dicts; (p = *pp) != NULL; pp = &p->next)
+				if (p->refs == 0)
+					oldest = pp;
+			p = *oldest;
+			*oldest = p->next;
+			idle--;
+			dict_free(p);
+		}
+	}
+	DICTS_UNLOCK();
+}
+
+unsigned
+__archive_zstd_dict_id(const struct archive_zstd_dict *d)
+{
+	return (d->id);
+}
+
+const ZSTD_DDict *
+__archive_zstd_dict_ddict(struct archive *a, struct archive_zstd_dict *d)
+{
+	const ZSTD_DDict *ddict;
+
+	DICTS_LOCK();
+	if (d->ddict == NULL)
+		d->ddict = ZSTD_createDDict(d->data, d->size);
+	ddict = d->ddict;
+	DICTS_UNLOCK();
+	if (ddict == NULL)
+		archive_set_error(a, ENOMEM,
+		    "Can't allocate zstd dictionary");
+	return (ddict);
+}
+
+const ZSTD_CDict *
+__archive_zstd_dict_cdict(struct archive *a, struct archive_zstd_dict *d,
+    int level)
+{
+	struct zstd_cdict *c;
+	const ZSTD_CDict *cdict = NULL;
+
+	DICTS_LOCK();
+	for (c = d->cdicts; c != NULL; c = c->next)
+		if (c->level == level)
+			break;
+	if (c == NULL && (c = calloc(1, sizeof(*c))) != NULL) {
+		c->level = level;
+		c->cdict = ZSTD_createCDict(d->data, d->size, level);
+		if (c->cdict == NULL) {
+			free(c);
+			c = NULL;
+		} else {
+			c->next = d->cdicts;
+			d->cdicts = c;
+		}
+	}
+	if (c != NULL)
+		cdict = c->cdict;
+	DICTS_UNLOCK();
+	if (cdict == NULL)
+		archive_set_error(a, ENOMEM,
+		    "Can't allocate zstd dictionary");
+	return (cdict);
+}
+
+#endif /* HAVE_ZSTD_DICT */
@@ -0,0 +1,74 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_ZSTD_DICT_PRIVATE_H_INCLUDED
+#define	ARCHIVE_ZSTD_DICT_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+#if HAVE_ZSTD_H && HAVE_LIBZSTD
+#include <zstd.h>
+
+/* Referencing digested dictionaries from a stream needs zstd 1.4.0. */
+#if ZSTD_VERSION_NUMBER >= 10400
+#define HAVE_ZSTD_DICT 1
+
+/*
+ * zstd dictionaries shared by every archive object in the process.
+ * A dictionary is digested at most once for decompression and once
+ * per compression level, and a few unused ones are kept around so
+ * that opening many small archives with the same dictionary stays
+ * cheap.  Only dictionaries with a dictionary ID are accepted, since
+ * readers use the ID in the frame header to pick one.
+ */
+struct archive_zstd_dict;
+
+/* Both return a new reference, or NULL with an error set on a. */
+struct archive_zstd_dict *__archive_zstd_dict_add(struct archive *a,
+	    const void *, size_t);
+struct archive_zstd_dict *__archive_zstd_dict_load(struct archive *a,
+	    const char *path);
+void	__archive_zstd_dict_release(struct archive_zstd_dict *);
+
+unsigned __archive_zstd_dict_id(const struct archive_zstd_dict *);
+/* The digested forms stay valid as long as the reference is held. */
+const ZSTD_DDict *__archive_zstd_dict_ddict(struct archive *a,
+	    struct archive_zstd_dict *);
+const ZSTD_CDict *__archive_zstd_dict_cdict(struct archive *a,
+	    struct archive_zstd_dict *, int level);
+
+#endif
+#endif
+
+/*
+ * Parse a window size such as "8M" into a window log: the smallest
+ * log whose window covers the size.  Returns -1 if the value isn't
+ * a size from 1KiB to 2GiB.
+ */
+int	__archive_zstd_window_log(const char *);
+
+#endif
@@ -110,6 +110,7 @@
 #define HAVE_FCHOWN 1
 #define HAVE_FCNTL 1
 #define HAVE_FCNTL_H 1
+#define HAVE_FDATASYNC 1
 #define HAVE_FDOPENDIR 1
 #define HAVE_FORK 1
 #define HAVE_FSEEKO 1
@@ -138,6 +139,7 @@
 #define HAVE_LIBZ 1
 #define HAVE_LIMITS_H 1
 #define HAVE_LINK 1
+#define HAVE_LINKAT 1
 #define HAVE_LOCALE_H 1
 #define HAVE_LOCALTIME_R 1
 #define HAVE_LONG_LONG_INT 1
@@ -157,6 +159,8 @@
 #define HAVE_PIPE 1
 #define HAVE_POLL 1
 #define HAVE_POLL_H 1
+#define HAVE_POSIX_FADVISE 1
+#define HAVE_POSIX_FALLOCATE 1
 #define HAVE_POSIX_SPAWNP 1
 #define HAVE_PTHREAD_H 1
 #define HAVE_PWD_H 1
@@ -0,0 +1,179 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+#define __LIBARCHIVE_TEST
+#include "archive_hmap.h"
+
+/*
+ * Exercise the hash map used by the hot lookup tables against a plain
+ * array that records which keys should be present.
+ */
+
+#define	NKEYS	100000
+
+struct hnode {
+	char	 name[16];
+	int	 id;
+};
+
+static uint64_t
+hnode_hash_key(const void *key)
+{
+	return (__archive_hmap_hash_string((const char *)key));
+}
+
+static uint64_t
+hnode_hash_node(const void *n)
+{
+	return (__archive_hmap_hash_string(((const struct hnode *)n)->name));
+}
+
+static int
+hnode_cmp_key(const void *n, const void *key)
+{
+	return (strcmp(((const struct hnode *)n)->name, (const char *)key));
+}
+
+static int
+hnode_cmp_nodes(const void *n1, const void *n2)
+{
+	return (strcmp(((const struct hnode *)n1)->name,
+	    ((const struct hnode *)n2)->name));
+}
+
+static int
+hnode_cmp_sort(const void *p1, const void *p2)
+{
+	const struct hnode *n1 = *(const struct hnode * const *)p1;
+	const struct hnode *n2 = *(const struct hnode * const *)p2;
+
+	return (n1->id - n2->id);
+}
+
+static const struct archive_hmap_ops hnode_ops = {
+	hnode_hash_key, hnode_hash_node, hnode_cmp_key, hnode_cmp_nodes
+};
+
+DEFINE_TEST(test_archive_hmap)
+{
+	struct archive_hmap m;
+	struct hnode *nodes, dup;
+	char *present;
+	void **sorted;
+	char key[16];
+	size_t count, i, n;
+	int failed;
+
+	nodes = calloc(NKEYS, sizeof(*nodes));
+	present = calloc(NKEYS, 1);
+	assert(nodes != NULL && present != NULL);
+	if (nodes == NULL || present == NULL) {
+		free(nodes);
+		free(present);
+		return;
+	}
+	for (i = 0; i < NKEYS; i++) {
+		snprintf(nodes[i].name, sizeof(nodes[i].name), "f%d", (int)i);
+		nodes[i].id = (int)i;
+	}
+
+	__archive_hmap_init(&m, &hnode_ops);
+	assert(__archive_hmap_find(&m, "f0") == NULL);
+	assert(__archive_hmap_remove(&m, "f0") == NULL);
+	sorted = __archive_hmap_sorted(&m, &count, hnode_cmp_sort);
+	assert(sorted == NULL);
+	assertEqualInt(0, count);
+
+	/* Insert everything; a second node with the same key is refused. */
+	failed = 0;
+	for (i = 0; i < NKEYS; i++) {
+		if (__archive_hmap_insert(&m, &nodes[i]) != 1)
+			failed++;
+		present[i] = 1;
+	}
+	assertEqualInt(0, failed);
+	assertEqualInt(NKEYS, m.count);
+	strcpy(dup.name, "f1234");
+	dup.id = -1;
+	assertEqualInt(0, __archive_hmap_insert(&m, &dup));
+	assertEqualInt(NKEYS, m.count);
+	assert(__archive_hmap_find(&m, "f1234") == &nodes[1234]);
+
+	/* Remove every third key, which moves entries within clusters. */
+	failed = 0;
+	for (i = 0; i < NKEYS; i += 3) {
+		snprintf(key, sizeof(key), "f%d", (int)i);
+		if (__archive_hmap_remove(&m, key) != &nodes[i])
+			failed++;
+		present[i] = 0;
+	}
+	assertEqualInt(0, failed);
+	assert(__archive_hmap_remove(&m, "f0") == NULL);
+
+	/* Put some of them back and look up every key. */
+	failed = 0;
+	for (i = 0; i < NKEYS; i += 6) {
+		if (__archive_hmap_insert(&m, &nodes[i]) != 1)
+			failed++;
+		present[i] = 1;
+	}
+	assertEqualInt(0, failed);
+	failed = 0;
+	n = 0;
+	for (i = 0; i < NKEYS; i++) {
+		void *found;
+
+		snprintf(key, sizeof(key), "f%d", (int)i);
+		found = __archive_hmap_find(&m, key);
+		if (found != (present[i] ? &nodes[i] : NULL))
+			failed++;
+		if (present[i])
+			n++;
+	}
+	assertEqualInt(0, failed);
+	assertEqualInt(n, m.count);
+	assert(__archive_hmap_find(&m, "g1") == NULL);
+
+	/* The sorted view holds exactly the present nodes. */
+	sorted = __archive_hmap_sorted(&m, &count, hnode_cmp_sort);
+	assert(sorted != NULL);
+	assertEqualInt(n, count);
+	failed = 0;
+	for (i = 0, n = 0; sorted != NULL && i < NKEYS; i++) {
+		if (!present[i])
+			continue;
+		if (sorted[n++] != &nodes[i])
+			failed++;
+	}
+	assertEqualInt(0, failed);
+	free(sorted);
+
+	__archive_hmap_free(&m);
+	assertEqualInt(0, m.count);
+	assert(__archive_hmap_find(&m, "f1") == NULL);
+	free(present);
+	free(nodes);
+}
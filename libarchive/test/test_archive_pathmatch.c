@@ -287,3 +287,89 @@ DEFINE_TEST(test_archive_pathmatch)
 	assertEqualInt(1,
 	    archive_pathmatch("b/c/d$", "a/b/c/d", PATHMATCH_NO_ANCHOR_START | PATHMATCH_NO_ANCHOR_END));
 }
+
+/*
+ * Compiled patterns must give exactly the interpreter's answer.
+ * Compare both on random patterns and paths drawn from the characters
+ * that mean something to the matcher.
+ */
+static unsigned int
+pm_random(unsigned int *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return ((*seed >> 16) & 0x7fff);
+}
+
+static void
+pm_random_string(unsigned int *seed, char *buff, size_t max,
+    const char *chars)
+{
+	size_t i, len, n = strlen(chars);
+
+	len = pm_random(seed) % max;
+	for (i = 0; i < len; i++)
+		buff[i] = chars[pm_random(seed) % n];
+	buff[len] = '\0';
+}
+
+/* A path that has a fair chance of matching 'pattern'. */
+static void
+pm_random_path(unsigned int *seed, char *buff, size_t max,
+    const char *pattern, const char *chars)
+{
+	size_t len = 0, n = strlen(chars);
+	int k;
+
+	for (; *pattern != '\0' && len + 3 < max; pattern++) {
+		switch (*pattern) {
+		case '*':
+			for (k = pm_random(seed) % 3; k > 0; k--)
+				buff[len++] = chars[pm_random(seed) % n];
+			break;
+		case '?': case '[': case ']': case '\\':
+			if (pm_random(seed) & 1)
+				buff[len++] = chars[pm_random(seed) % n];
+			break;
+		default:
+			buff[len++] = *pattern;
+			break;
+		}
+	}
+	buff[len] = '\0';
+}
+
+DEFINE_TEST(test_archive_pathmatch_compiled)
+{
+	struct archive_pathmatch_compiled *c;
+	char pattern[16], path[24];
+	unsigned int seed = 12345;
+	int i, j, flags, failures = 0;
+
+	for (i = 0; i < 20000 && failures < 10; i++) {
+		pm_random_string(&seed, pattern, sizeof(pattern),
+		    "ab./*?[]!^-\\$");
+		for (flags = 0; flags < 4; flags++) {
+			c = __archive_pathmatch_compile(pattern, flags);
+			if (!assert(c != NULL))
+				return;
+			for (j = 0; j < 20; j++) {
+				if (j & 1)
+					pm_random_path(&seed, path,
+					    sizeof(path), pattern,
+					    "ab./-$^\\[]");
+				else
+					pm_random_string(&seed, path,
+					    sizeof(path), "ab./-$^\\[]");
+				failure("pattern \"%s\" path \"%s\" flags %d",
+				    pattern, path, flags);
+				if (!assertEqualInt(
+				    archive_pathmatch(pattern, path, flags),
+				    __archive_pathmatch_exec(c, path)))
+					failures++;
+			}
+			assertEqualInt(archive_pathmatch(pattern, NULL, flags),
+			    __archive_pathmatch_exec(c, NULL));
+			__archive_pathmatch_compiled_free(c);
+		}
+	}
+}
@@ -0,0 +1,243 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+#define __LIBARCHIVE_TEST
+#include "archive_time_private.h"
+
+/*
+ * Check the calendar arithmetic against the C library.
+ */
+
+static int
+tm_equal(const struct tm *a, const struct tm *b)
+{
+	return (a->tm_year == b->tm_year && a->tm_mon == b->tm_mon &&
+	    a->tm_mday == b->tm_mday && a->tm_hour == b->tm_hour &&
+	    a->tm_min == b->tm_min && a->tm_sec == b->tm_sec &&
+	    a->tm_wday == b->tm_wday && a->tm_yday == b->tm_yday);
+}
+
+static int
+libc_gmtime(time_t t, struct tm *tm)
+{
+#if defined(HAVE_GMTIME_R)
+	return (gmtime_r(&t, tm) != NULL);
+#elif defined(HAVE__GMTIME64_S)
+	__time64_t tmptime = t;
+
+	return (_gmtime64_s(tm, &tmptime) == 0);
+#else
+	struct tm *p = gmtime(&t);
+
+	if (p != NULL)
+		memcpy(tm, p, sizeof(*tm));
+	return (p != NULL);
+#endif
+}
+
+static int
+libc_localtime(time_t t, struct tm *tm)
+{
+#if defined(HAVE_LOCALTIME_R)
+	return (localtime_r(&t, tm) != NULL);
+#elif defined(HAVE__LOCALTIME64_S)
+	__time64_t tmptime = t;
+
+	return (_localtime64_s(tm, &tmptime) == 0);
+#else
+	struct tm *p = localtime(&t);
+
+	if (p != NULL)
+		memcpy(tm, p, sizeof(*tm));
+	return (p != NULL);
+#endif
+}
+
+DEFINE_TEST(test_archive_time_civil)
+{
+	int64_t day, year, first, last;
+	int mon, mday, failed;
+	struct tm tm, ref;
+
+	/* Some fixed points. */
+	assertEqualInt(0, __archive_days_from_civil(1970, 1, 1));
+	assertEqualInt(-719468, __archive_days_from_civil(0, 3, 1));
+	assertEqualInt(11016, __archive_days_from_civil(2000, 2, 29));
+	assertEqualInt(11017, __archive_days_from_civil(2000, 3, 1));
+	assertEqualInt(-25508, __archive_days_from_civil(1900, 3, 1));
+	/* Out of range months and days carry like timegm() does. */
+	assertEqualInt(__archive_days_from_civil(1980, 1, 1),
+	    __archive_days_from_civil(1979, 13, 1));
+	assertEqualInt(__archive_days_from_civil(1979, 12, 31),
+	    __archive_days_from_civil(1980, 1, 0));
+	assertEqualInt(__archive_days_from_civil(1979, 11, 1),
+	    __archive_days_from_civil(1980, -1, 1));
+	assertEqualInt(__archive_days_from_civil(2001, 3, 1),
+	    __archive_days_from_civil(2001, 2, 29));
+
+	/* Every day from year -10000 to 10000 round-trips. */
+	first = __archive_days_from_civil(-10000, 1, 1);
+	last = __archive_days_from_civil(10000, 12, 31);
+	failed = 0;
+	for (day = first; day <= last; day++) {
+		__archive_civil_from_days(day, &year, &mon, &mday);
+		if (__archive_days_from_civil(year, mon, mday) != day ||
+		    mon < 1 || mon > 12 || mday < 1 || mday > 31)
+			failed++;
+	}
+	assertEqualInt(0, failed);
+
+	/* Every day from 1 to 9999 agrees with gmtime() and timegm(). */
+	if (sizeof(time_t) < 8) {
+		skipping("64-bit time_t is required");
+		return;
+	}
+	failed = 0;
+	for (day = __archive_days_from_civil(1, 1, 1);
+	    day <= __archive_days_from_civil(9999, 12, 31); day++) {
+		/* Vary the time of day as well. */
+		int64_t t = day * 86400 + (day * 7919) % 86400;
+
+		if (!libc_gmtime((time_t)t, &ref))
+			continue;
+		if (__archive_gmtime(t, &tm) == NULL || !tm_equal(&tm, &ref) ||
+		    __archive_timegm(&ref) != t)
+			failed++;
+	}
+	assertEqualInt(0, failed);
+
+#if defined(HAVE_TIMEGM)
+	/* Unnormalized fields are carried like timegm() does. */
+	failed = 0;
+	for (day = 0; day < 200000; day++) {
+		memset(&ref, 0, sizeof(ref));
+		ref.tm_year = (int)(day % 300) - 100;
+		ref.tm_mon = (int)(day % 17) - 1;
+		ref.tm_mday = (int)(day % 33) - 1;
+		ref.tm_hour = (int)(day % 33) - 1;
+		ref.tm_min = (int)(day % 65) - 1;
+		ref.tm_sec = (int)(day % 63) - 1;
+		memcpy(&tm, &ref, sizeof(tm));
+		if (__archive_timegm(&tm) != (int64_t)timegm(&ref))
+			failed++;
+	}
+	assertEqualInt(0, failed);
+#endif
+}
+
+#if defined(HAVE_SETENV) && defined(HAVE_TZSET) && \
+    (!defined(_WIN32) || defined(__CYGWIN__))
+#define	CAN_SET_TZ
+#endif
+
+#ifdef CAN_SET_TZ
+/*
+ * Compare the cached local time conversions with libc across the
+ * range of MS-DOS timestamps in a few time zones.
+ */
+static void
+verify_local_time(const char *zone)
+{
+	struct archive_tz_cache *cache;
+	struct tm tm, ref, dos, before, after;
+	time_t t, r;
+	long gmoff;
+	int failed;
+
+	if (zone != NULL) {
+		setenv("TZ", zone, 1);
+		tzset();
+	}
+	cache = calloc(1, sizeof(*cache));
+	assert(cache != NULL);
+	if (cache == NULL)
+		return;
+
+	/* Every 2h17m from 1980 to 2040: localtime(). */
+	failed = 0;
+	for (t = 315532800; t < 2208988800LL; t += 8221) {
+		if (!libc_localtime(t, &ref))
+			continue;
+		if (__archive_localtime(cache, t, &tm, &gmoff) == NULL ||
+		    !tm_equal(&tm, &ref) ||
+		    (tm.tm_isdst > 0) != (ref.tm_isdst > 0) ||
+		    __archive_timegm(&ref) - t != gmoff)
+			failed++;
+	}
+	failure("TZ=%s", zone == NULL ? "(default)" : zone);
+	assertEqualInt(0, failed);
+
+	/* The same wall clock times, as MS-DOS times do: mktime(). */
+	failed = 0;
+	for (t = 315532800; t < 2208988800LL; t += 8221) {
+		if (__archive_gmtime(t, &dos) == NULL)
+			continue;
+		memcpy(&ref, &dos, sizeof(ref));
+		ref.tm_isdst = -1;
+		r = mktime(&ref);
+		/* Skip times near a transition; they may happen twice or
+		 * never, and libc is free to pick either answer. */
+		if (!libc_localtime(r - 86400, &before) ||
+		    !libc_localtime(r + 86400, &after) ||
+		    __archive_timegm(&before) - (r - 86400) !=
+		    __archive_timegm(&after) - (r + 86400))
+			continue;
+		if (__archive_mktime(cache, &dos) != r)
+			failed++;
+	}
+	failure("TZ=%s", zone == NULL ? "(default)" : zone);
+	assertEqualInt(0, failed);
+	free(cache);
+}
+#endif
+
+DEFINE_TEST(test_archive_time_local)
+{
+#ifdef CAN_SET_TZ
+	const char *zones[] = {
+		"UTC0", "EST5EDT,M3.2.0,M11.1.0", "Europe/London",
+		"America/Sao_Paulo", "Australia/Lord_Howe", "Asia/Kathmandu",
+		"Pacific/Chatham", "Asia/Gaza", NULL
+	};
+	char *saved;
+	const char *tz;
+	int i;
+
+	tz = getenv("TZ");
+	saved = tz != NULL ? strdup(tz) : NULL;
+	verify_local_time(NULL);
+	for (i = 0; zones[i] != NULL; i++)
+		verify_local_time(zones[i]);
+	if (saved != NULL) {
+		setenv("TZ", saved, 1);
+		free(saved);
+	} else
+		unsetenv("TZ");
+	tzset();
+#else
+	skipping("Changing the time zone is not supported on this platform");
+#endif
+}
@@ -0,0 +1,109 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/* Sanity test of internal xxHash functionality */
+
+#define __LIBARCHIVE_BUILD 1
+#include "archive_xxhash.h"
+
+static const char spam[] = "Nobody inspects the spammish repetition";
+
+static void
+fill_pattern(unsigned char *buf, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (unsigned char)(i * 7 + 3);
+}
+
+DEFINE_TEST(test_archive_xxhash32)
+{
+	unsigned char buf[1000];
+	void *state;
+	size_t i, chunk;
+
+	fill_pattern(buf, sizeof(buf));
+
+	assertEqualInt(0x02cc5d05, __archive_xxhash.XXH32("", 0, 0));
+	assertEqualInt(0xe2293b2f,
+	    __archive_xxhash.XXH32(spam, sizeof(spam) - 1, 0));
+	assertEqualInt(0xc85a5152,
+	    __archive_xxhash.XXH32(buf, sizeof(buf), 0));
+
+	/* Feeding the same data in odd-sized pieces must not matter. */
+	for (chunk = 1; chunk < 40; chunk += 3) {
+		state = __archive_xxhash.XXH32_init(0);
+		assert(state != NULL);
+		for (i = 0; i < sizeof(buf); i += chunk) {
+			size_t len = sizeof(buf) - i;
+			if (len > chunk)
+				len = chunk;
+			assertEqualInt(XXH_OK, __archive_xxhash.XXH32_update(
+			    state, buf + i, (unsigned int)len));
+		}
+		assertEqualInt(0xc85a5152,
+		    __archive_xxhash.XXH32_digest(state));
+	}
+}
+
+DEFINE_TEST(test_archive_xxhash64)
+{
+	unsigned char buf[1000], copy[1001];
+	void *state;
+	size_t i, chunk;
+
+	fill_pattern(buf, sizeof(buf));
+
+	assert(__archive_xxhash.XXH64("", 0, 0) == 0xef46db3751d8e999ULL);
+	assert(__archive_xxhash.XXH64("abc", 3, 0) == 0x44bc2cf5ad770999ULL);
+	assert(__archive_xxhash.XXH64(spam, sizeof(spam) - 1, 0) ==
+	    0xfbcea83c8a378bf1ULL);
+	assert(__archive_xxhash.XXH64(buf, sizeof(buf), 0) ==
+	    0x5f235fa033f1a3fbULL);
+	assert(__archive_xxhash.XXH64(buf, sizeof(buf),
+	    0x9e3779b97f4a7c15ULL) ==
+	    0x442acd0a822e86f6ULL);
+
+	/* Unaligned input must hash the same as aligned input. */
+	memcpy(copy + 1, buf, sizeof(buf));
+	assert(__archive_xxhash.XXH64(copy + 1, sizeof(buf), 0) ==
+	    0x5f235fa033f1a3fbULL);
+
+	for (chunk = 1; chunk < 80; chunk += 5) {
+		state = __archive_xxhash.XXH64_init(0);
+		assert(state != NULL);
+		for (i = 0; i < sizeof(buf); i += chunk) {
+			size_t len = sizeof(buf) - i;
+			if (len > chunk)
+				len = chunk;
+			assertEqualInt(XXH_OK, __archive_xxhash.XXH64_update(
+			    state, buf + i, len));
+		}
+		assert(__archive_xxhash.XXH64_digest(state) ==
+		    0x5f235fa033f1a3fbULL);
+	}
+}
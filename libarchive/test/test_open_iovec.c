@@ -0,0 +1,145 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Build an archive in memory, cut it into blocks of varying size
+ * (including empty ones), and read it back through
+ * archive_read_open_iovec().
+ */
+static size_t
+build_archive(int zip, char *buff, size_t buffsize, const char *data,
+    size_t datasize)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char name[16];
+	size_t used;
+	int i;
+
+	assert((a = archive_write_new()) != NULL);
+	if (zip)
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	else
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i < 3; i++) {
+		assert((ae = archive_entry_new()) != NULL);
+		snprintf(name, sizeof(name), "file%d", i);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, datasize);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt(datasize, archive_write_data(a, data, datasize));
+		archive_entry_free(ae);
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	return (used);
+}
+
+static void
+read_blocks(int zip, struct archive_iovec *iov, size_t count,
+    const char *data, size_t datasize, int read_data)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char *out;
+	int i;
+
+	out = malloc(datasize);
+	if (!assert(out != NULL))
+		return;
+	assert((a = archive_read_new()) != NULL);
+	if (zip)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_zip_seekable(a));
+	else
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_iovec(a, iov, count));
+	for (i = 0; i < 3; i++) {
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+		assertEqualInt(datasize, archive_entry_size(ae));
+		if (!read_data)
+			continue;
+		assertEqualInt(datasize, archive_read_data(a, out, datasize));
+		assertEqualMem(out, data, datasize);
+	}
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(out);
+}
+
+static void
+test_format(int zip)
+{
+	static const size_t sizes[] = { 1, 0, 7, 511, 0, 513, 4096, 3 };
+	struct archive_iovec iov[256];
+	const size_t datasize = 20000, buffsize = 100000;
+	char *data, *buff;
+	size_t used, off, count, n;
+
+	data = malloc(datasize);
+	buff = malloc(buffsize);
+	if (!assert(data != NULL && buff != NULL)) {
+		free(data);
+		free(buff);
+		return;
+	}
+	for (n = 0; n < datasize; n++)
+		data[n] = (char)(n * 13 + n / 100);
+	used = build_archive(zip, buff, buffsize, data, datasize);
+
+	for (off = 0, count = 0; off < used; count++) {
+		n = sizes[count % (sizeof(sizes) / sizeof(sizes[0]))];
+		if (n > used - off)
+			n = used - off;
+		assert(count < sizeof(iov) / sizeof(iov[0]));
+		iov[count].iov_base = buff + off;
+		iov[count].iov_len = n;
+		off += n;
+	}
+	/* Read everything, then skip across blocks. */
+	read_blocks(zip, iov, count, data, datasize, 1);
+	read_blocks(zip, iov, count, data, datasize, 0);
+
+	/* A single block behaves like archive_read_open_memory(). */
+	iov[0].iov_base = buff;
+	iov[0].iov_len = used;
+	read_blocks(zip, iov, 1, data, datasize, 1);
+
+	free(data);
+	free(buff);
+}
+
+DEFINE_TEST(test_open_iovec)
+{
+	test_format(0);
+	test_format(1);
+}
@@ -0,0 +1,226 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * test_read_filter_gzip_bgzf.tar.gz is a ustar archive split into
+ * 65280-byte BGZF members (as written by bgzip), followed by the
+ * empty BGZF end-of-file member.  It holds "file1", 150000 bytes of
+ * the pattern below, and "file2", ten copies of "bgzf\n".
+ */
+static const char refname[] = "test_read_filter_gzip_bgzf.tar.gz";
+
+static unsigned char
+pattern(size_t i)
+{
+	return (unsigned char)((i * 7 + (i >> 9)) % 251);
+}
+
+static size_t
+member_size(const char *p)
+{
+	return (((unsigned char)p[16] | ((unsigned char)p[17] << 8)) + 1);
+}
+
+/* Read every entry; return the first error or ARCHIVE_OK. */
+static int
+read_all(struct archive *a)
+{
+	struct archive_entry *ae;
+	char buff[4096];
+	la_ssize_t bytes;
+	int r;
+
+	while ((r = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+		while ((bytes = archive_read_data(a, buff, sizeof(buff))) > 0)
+			continue;
+		if (bytes < 0)
+			return ((int)bytes);
+	}
+	return (r == ARCHIVE_EOF ? ARCHIVE_OK : r);
+}
+
+static void
+verify_bgzf(const char *data, size_t size, const char *options)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char *buff;
+	size_t i;
+	int mismatches;
+
+	assert((buff = malloc(150000)) != NULL);
+	if (buff == NULL)
+		return;
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, data, size));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file1", archive_entry_pathname(ae));
+	assertEqualInt(150000, archive_entry_size(ae));
+	assertEqualInt(150000, archive_read_data(a, buff, 150000));
+	mismatches = 0;
+	for (i = 0; i < 150000; i++)
+		if ((unsigned char)buff[i] != pattern(i))
+			mismatches++;
+	assertEqualInt(0, mismatches);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file2", archive_entry_pathname(ae));
+	assertEqualInt(50, archive_read_data(a, buff, 150000));
+	assertEqualMem(buff, "bgzf\nbgzf\nbgzf\nbgzf\nbgzf\n", 25);
+
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_FILTER_GZIP, archive_filter_code(a, 0));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+}
+
+static void
+verify_corrupt(const char *data, size_t size, const char *options,
+    const char *error)
+{
+	struct archive *a;
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, data, size));
+	assertEqualIntA(a, ARCHIVE_FATAL, read_all(a));
+	failure("options: %s", options == NULL ? "(none)" : options);
+	assertEqualString(error, archive_error_string(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
+DEFINE_TEST(test_read_filter_gzip_bgzf)
+{
+	char *p;
+	size_t size, second;
+
+	if (archive_zlib_version() == NULL) {
+		skipping("gzip reading requires zlib");
+		return;
+	}
+	extract_reference_file(refname);
+	p = slurpfile(&size, "%s", refname);
+	if (!assert(p != NULL))
+		return;
+
+	/* Members are read one at a time or on worker threads. */
+	verify_bgzf(p, size, NULL);
+	verify_bgzf(p, size, "gzip:threads=1");
+	verify_bgzf(p, size, "gzip:threads=4");
+	verify_bgzf(p, size, "threads=0");
+
+	/* Each member's CRC is checked; BSIZE is at offset 16. */
+	second = member_size(p);
+	second += member_size(p + second);
+	p[second - 8] ^= 1;
+	verify_corrupt(p, size, NULL, "gzip data CRC mismatch");
+	verify_corrupt(p, size, "gzip:threads=4", "gzip data CRC mismatch");
+	p[second - 8] ^= 1;
+	p[second - 4] ^= 1;
+	verify_corrupt(p, size, "gzip:threads=4",
+	    "gzip data length mismatch");
+	p[second - 4] ^= 1;
+
+	free(p);
+}
+
+/*
+ * Ordinary gzip members are streamed, and their trailers are
+ * checked as well.
+ */
+DEFINE_TEST(test_read_filter_gzip_trailer)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char *buff, *data;
+	size_t buffsize = 64 * 1024, datasize = 100000, used;
+	size_t i;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	assert((data = malloc(datasize)) != NULL);
+	if (buff == NULL || data == NULL) {
+		free(buff);
+		free(data);
+		return;
+	}
+	for (i = 0; i < datasize; i++)
+		data[i] = (char)pattern(i);
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	if (archive_write_add_filter_gzip(a) != ARCHIVE_OK) {
+		skipping("Can't write gzip");
+		archive_write_free(a);
+		free(buff);
+		free(data);
+		return;
+	}
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, datasize);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualInt(datasize, archive_write_data(a, data, datasize));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* The intact stream reads back. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, read_all(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* The trailer is the last 8 bytes: CRC, then length. */
+	buff[used - 8] ^= 1;
+	verify_corrupt(buff, used, NULL, "gzip data CRC mismatch");
+	verify_corrupt(buff, used, "gzip:threads=2", "gzip data CRC mismatch");
+	buff[used - 8] ^= 1;
+	buff[used - 1] ^= 1;
+	verify_corrupt(buff, used, NULL, "gzip data length mismatch");
+	buff[used - 1] ^= 1;
+
+	free(data);
+	free(buff);
+}
@@ -0,0 +1,212 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * archive_read_data() with large buffers lets the gzip, xz and zstd
+ * filters decompress tar entry data straight into the caller's
+ * buffer.  Mix buffer sizes so that reads switch between that path
+ * and the filter's own buffer, and check the data and the
+ * decompressed byte count against a read that never uses it.
+ */
+
+static const size_t sizes[] = { 300000, 100, 70001, 0 };
+
+/* Poorly compressible, so half the output cuts into file0. */
+static unsigned char
+pattern(size_t i)
+{
+	uint32_t x = (uint32_t)i;
+
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return (unsigned char)x;
+}
+
+static size_t
+make_archive(int (*add_filter)(struct archive *), char *buff,
+    size_t buffsize)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char name[16];
+	char *data;
+	size_t used, i, n;
+	int r;
+
+	assert((data = malloc(sizes[0])) != NULL);
+	if (data == NULL)
+		return (0);
+	for (i = 0; i < sizes[0]; i++)
+		data[i] = pattern(i);
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	r = add_filter(a);
+	if (r != ARCHIVE_OK) {
+		assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+		free(data);
+		return (0);
+	}
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (n = 0; sizes[n] != 0; n++) {
+		snprintf(name, sizeof(name), "file%d", (int)n);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, sizes[n]);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		archive_entry_free(ae);
+		assertEqualIntA(a, (int)sizes[n],
+		    (int)archive_write_data(a, data, sizes[n]));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	free(data);
+	return (used);
+}
+
+/*
+ * Read every entry using buffers that cycle through the given sizes;
+ * returns the decompressed byte count.
+ */
+static int64_t
+verify_read(const char *buff, size_t used, const size_t *chunks)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char *data;
+	size_t n, offset, c, i;
+	la_ssize_t bytes;
+	int64_t total;
+	int mismatches;
+
+	assert((data = malloc(1024 * 1024)) != NULL);
+	if (data == NULL)
+		return (-1);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used));
+	c = 0;
+	for (n = 0; sizes[n] != 0; n++) {
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_next_header(a, &ae));
+		assertEqualInt(sizes[n], archive_entry_size(ae));
+		offset = 0;
+		mismatches = 0;
+		for (;;) {
+			bytes = archive_read_data(a, data, chunks[c]);
+			if (chunks[++c] == 0)
+				c = 0;
+			if (bytes <= 0)
+				break;
+			for (i = 0; i < (size_t)bytes; i++) {
+				if ((unsigned char)data[i] !=
+				    pattern(offset + i))
+					mismatches++;
+			}
+			offset += bytes;
+		}
+		assertEqualInt(0, bytes);
+		assertEqualInt(sizes[n], offset);
+		assertEqualInt(0, mismatches);
+	}
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	total = archive_filter_bytes(a, 0);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(data);
+	return (total);
+}
+
+static void
+verify_truncated(const char *buff, size_t used)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char *data;
+	la_ssize_t bytes;
+
+	assert((data = malloc(1024 * 1024)) != NULL);
+	if (data == NULL)
+		return;
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used / 2));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	while ((bytes = archive_read_data(a, data, 1024 * 1024)) > 0)
+		continue;
+	assert(bytes < 0);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(data);
+}
+
+static void
+test_filter(const char *name, int (*add_filter)(struct archive *))
+{
+	static const size_t small[] = { 1, 511, 4000, 0 };
+	static const size_t large[] = { 1024 * 1024, 0 };
+	static const size_t mixed[] = { 65536, 10, 100000, 8192, 3, 0 };
+	char *buff;
+	size_t buffsize = 2 * 1024 * 1024, used;
+	int64_t expect;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	if (buff == NULL)
+		return;
+	used = make_archive(add_filter, buff, buffsize);
+	if (used == 0) {
+		skipping("%s writing is not supported on this platform",
+		    name);
+		free(buff);
+		return;
+	}
+	failure("%s", name);
+	expect = verify_read(buff, used, small);
+	failure("%s", name);
+	assertEqualInt(expect, verify_read(buff, used, large));
+	failure("%s", name);
+	assertEqualInt(expect, verify_read(buff, used, mixed));
+	verify_truncated(buff, used);
+	free(buff);
+}
+
+DEFINE_TEST(test_read_filter_read_into)
+{
+	if (archive_zlib_version() != NULL)
+		test_filter("gzip", archive_write_add_filter_gzip);
+	if (archive_liblzma_version() != NULL)
+		test_filter("xz", archive_write_add_filter_xz);
+	if (archive_libzstd_version() != NULL)
+		test_filter("zstd", archive_write_add_filter_zstd);
+}
@@ -43,6 +43,22 @@ static const char archive64[] = {
 "====\n"
 };
 
+/* The same data with white space added by a text-only channel. */
+static const char archive64_spaces[] = {
+"begin-base64 644 test_read_uu.Z\n"
+"H52QLgAIHEiwoMGDCBMqXMiwIUIYEG/UqAECAMQYEmFUvJhxI8SPIDXGgDFjBg0YNDDOsAECxsga \n"
+"NmIAAFHDoc2bOHPqBFBnDp0wcizCoJOmzc6ERI0e PRhSo1CQFZdKnUq1qtWrWLNq3cq1q9evYMOK\t\n"
+"HUu2rNmzaNOqXcu2rdu3ZwE=  \n"
+"====\n"
+};
+
+/* The second line is shorter than its length character says. */
+static const char archive_short_line[] = {
+"begin 644 x\n"
+"#86)C\n"
+"&86)C9&\n"
+};
+
 static const char extradata[] = {
 "From uudecode@libarchive Mon Jun  2 03:03:31 2008\n"
 "Return-Path: <uudecode@libarchive>\n"
@@ -168,6 +184,28 @@ DEFINE_TEST(test_read_filter_uudecode)
 	test_read_uu_sub(archive, sizeof(archive)-1, 1);
 }
 
+DEFINE_TEST(test_read_filter_uudecode_short_line)
+{
+	struct archive *a;
+	char *buff;
+	size_t size = sizeof(archive_short_line) - 1;
+
+	/* Copy the data so that reading past its end gets noticed. */
+	assert(NULL != (buff = malloc(size)));
+	if (buff == NULL)
+		return;
+	memcpy(buff, archive_short_line, size);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_FATAL,
+	    archive_read_open_memory(a, buff, size));
+	assertEqualString("Insufficient compressed data",
+	    archive_error_string(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+}
+
 DEFINE_TEST(test_read_filter_uudecode_base64)
 {
 	/* Read the Base64 uuencoded data. */
@@ -175,4 +213,6 @@ DEFINE_TEST(test_read_filter_uudecode_base64)
 	/* Read the Base64 uuencoded data with very long line extra data
 	 * in front of it. */
 	test_read_uu_sub(archive64, sizeof(archive64)-1, 1);
+	/* Read the Base64 uuencoded data with white space in its lines. */
+	test_read_uu_sub(archive64_spaces, sizeof(archive64_spaces)-1, 0);
 }
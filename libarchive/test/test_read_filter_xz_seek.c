@@ -0,0 +1,152 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * test_read_filter_xz_seek.txz is a ustar archive of five files, f0
+ * to f4.  Line n of file i is printf("%d:%06d\n", i, n), 5000 lines
+ * each.  It was compressed as two xz Streams with 16KiB Blocks and
+ * four bytes of Stream Padding between them:
+ *
+ *   head -c 110000 t.tar | xz --block-size=16KiB > t.txz
+ *   printf '\0\0\0\0' >> t.txz
+ *   tail -c +110001 t.tar | xz --block-size=16KiB --check=crc32 >> t.txz
+ */
+
+#define LINE_SIZE	9
+#define FILE_SIZE	(5000 * LINE_SIZE)
+
+static const char reffile[] = "test_read_filter_xz_seek.txz";
+
+/* Fill buff with size bytes of file i from offset. */
+static void
+expected(char *buff, int i, int64_t offset, size_t size)
+{
+	char line[LINE_SIZE + 1];
+	size_t n;
+
+	for (n = 0; n < size; n++, offset++) {
+		snprintf(line, sizeof(line), "%d:%06d\n", i,
+		    (int)(offset / LINE_SIZE));
+		buff[n] = line[offset % LINE_SIZE];
+	}
+}
+
+static void
+verify_read(struct archive *a, int i, int64_t offset, size_t size)
+{
+	char buff[256], exp[256];
+
+	assert(size <= sizeof(buff));
+	expected(exp, i, offset, size);
+	assertEqualIntA(a, (int)size, (int)archive_read_data(a, buff, size));
+	assertEqualMem(buff, exp, size);
+}
+
+static void
+verify_seeks(struct archive *a)
+{
+	struct archive_entry *ae;
+	char buff[16];
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+		assertEqualInt(FILE_SIZE, archive_entry_size(ae));
+		if (i == 0 || i == 3)
+			continue;	/* Skipped unread. */
+
+		/* Jump well into the entry, then back, then near
+		 * the end. */
+		assertEqualInt(30000, archive_seek_data(a, 30000, SEEK_SET));
+		verify_read(a, i, 30000, 200);
+		assertEqualInt(10, archive_seek_data(a, 10, SEEK_SET));
+		verify_read(a, i, 10, 100);
+		assertEqualInt(210, archive_seek_data(a, 100, SEEK_CUR));
+		verify_read(a, i, 210, 50);
+		assertEqualInt(FILE_SIZE - 5,
+		    archive_seek_data(a, -5, SEEK_END));
+		verify_read(a, i, FILE_SIZE - 5, 5);
+		assertEqualIntA(a, 0, archive_read_data(a, buff, sizeof(buff)));
+		if (i == 1) {
+			/* Back again after reaching the end. */
+			assertEqualInt(44000, archive_seek_data(a, 44000,
+			    SEEK_SET));
+			verify_read(a, i, 44000, 100);
+		}
+	}
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+}
+
+DEFINE_TEST(test_read_filter_xz_seek)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char *p;
+	size_t s;
+	int i;
+
+	/* Seekable file. */
+	assert((a = archive_read_new()) != NULL);
+	if (archive_read_support_filter_xz(a) != ARCHIVE_OK) {
+		skipping("xz reading not fully supported on this platform");
+		assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+		return;
+	}
+	extract_reference_file(reffile);
+	p = slurpfile(&s, "%s", reffile);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, reffile, 10240));
+	verify_seeks(a);
+	assertEqualInt(ARCHIVE_FILTER_XZ, archive_filter_code(a, 0));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Seekable memory, read in small pieces. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_xz(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, read_open_memory_seek(a, p, s, 7));
+	verify_seeks(a);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Without a seek callback the archive reads as a stream and
+	 * archive_seek_data() fails without harming the entry. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_xz(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, read_open_memory(a, p, s, 1024));
+	for (i = 0; i < 5; i++) {
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+		verify_read(a, i, 0, 100);
+		assertEqualIntA(a, ARCHIVE_FAILED,
+		    archive_seek_data(a, 30000, SEEK_SET));
+		verify_read(a, i, 100, 100);
+	}
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	free(p);
+}
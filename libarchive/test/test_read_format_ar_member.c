@@ -0,0 +1,171 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+#define BIGSIZE	(1024 * 1024)
+
+static void
+add_member(struct archive *a, const char *name, const void *p, size_t size)
+{
+	struct archive_entry *ae;
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, name);
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	assertEqualIntA(a, (int)size, (int)archive_write_data(a, p, size));
+	archive_entry_free(ae);
+}
+
+/*
+ * Write a .deb-like archive with a large member in the middle and a
+ * damaged header at the end.
+ */
+static void
+make_archive(const char *name, int bsd)
+{
+	struct archive *a;
+	char *big;
+	FILE *f;
+
+	assert((big = malloc(BIGSIZE)) != NULL);
+	memset(big, 'x', BIGSIZE);
+	assert((a = archive_write_new()) != NULL);
+	if (bsd)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_format_ar_bsd(a));
+	else
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_format_ar_svr4(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_open_filename(a, name));
+	add_member(a, "debian-binary", "2.0\n", 4);
+	add_member(a, "big.o", big, BIGSIZE);
+	add_member(a, "control.tar.gz", "control", 7);
+	add_member(a, bsd ? "a-rather-long-member-name.o" : "data.tar.xz",
+	    "data", 4);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	free(big);
+
+	/* 60 bytes without the "`\n" header trailer. */
+	assert((f = fopen(name, "ab")) != NULL);
+	fputs("this is not an ar member header, "
+	    "though it is just as long.\n", f);
+	fclose(f);
+}
+
+static struct archive *
+open_archive(const char *name, const char *options)
+{
+	struct archive *a;
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_ar(a));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, name, 10240));
+	return (a);
+}
+
+static void
+verify_member(struct archive *a, const char *name, const char *data)
+{
+	struct archive_entry *ae;
+	char buff[64];
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(name, archive_entry_pathname(ae));
+	assertEqualInt(strlen(data), archive_entry_size(ae));
+	assertEqualIntA(a, (int)strlen(data),
+	    (int)archive_read_data(a, buff, sizeof(buff)));
+	assertEqualMem(buff, data, strlen(data));
+}
+
+static void
+test_member(const char *name, int bsd)
+{
+	const char *last = bsd ? "a-rather-long-member-name.o" : "data.tar.xz";
+	char options[80];
+	struct archive_entry *ae;
+	struct archive *a;
+
+	make_archive(name, bsd);
+
+	/* Without the option the whole archive is read. */
+	a = open_archive(name, NULL);
+	verify_member(a, "debian-binary", "2.0\n");
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("big.o", archive_entry_pathname(ae));
+	verify_member(a, "control.tar.gz", "control");
+	verify_member(a, last, "data");
+	assertEqualIntA(a, ARCHIVE_FATAL, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Only the requested member comes back, and reading stops
+	 * before the damaged header. */
+	a = open_archive(name, "ar:member=control.tar.gz");
+	verify_member(a, "control.tar.gz", "control");
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Members come back in archive order. */
+	snprintf(options, sizeof(options),
+	    "ar:member=%s,ar:member=debian-binary", last);
+	a = open_archive(name, options);
+	verify_member(a, "debian-binary", "2.0\n");
+	verify_member(a, last, "data");
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* "!member" forgets earlier names. */
+	a = open_archive(name,
+	    "ar:member=debian-binary,ar:!member,ar:member=control.tar.gz");
+	verify_member(a, "control.tar.gz", "control");
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* A name that isn't there reads to the end of the archive. */
+	a = open_archive(name, "ar:member=missing.o");
+	assertEqualIntA(a, ARCHIVE_FATAL, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
+DEFINE_TEST(test_read_format_ar_member)
+{
+	struct archive *a;
+
+	test_member("test.deb", 0);
+	test_member("test_bsd.a", 1);
+
+	/* An empty name is rejected. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_ar(a));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_options(a, "ar:member="));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
@@ -0,0 +1,162 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * test_read_format_cab_threads.cab has five folders:
+ *   MSZIP: a (100000 bytes), b (50 bytes)
+ *   none:  c (9000 bytes)
+ *   MSZIP: d (70000 bytes), e (0 bytes)
+ *   LZX:   f (33000 bytes)
+ *   MSZIP: g (3000 bytes)
+ * Byte i of the n-th file is (i % 251) ^ n, except that f is all zeros.
+ * It was made with a small script, since makecab.exe does not make
+ * folders this small.  The LZX folder is the one from
+ * test_read_format_cab_3.cab, where f is called "zero".
+ */
+static const struct {
+	const char	*name;
+	size_t		 size;
+} files[] = {
+	{ "a", 100000 },
+	{ "b", 50 },
+	{ "c", 9000 },
+	{ "d", 70000 },
+	{ "e", 0 },
+	{ "f", 33000 },
+	{ "g", 3000 },
+};
+#define LZX_FILE	5
+#define NFILES	(sizeof(files) / sizeof(files[0]))
+
+static int
+check_contents(const char *buff, size_t size, int n)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (n == LZX_FILE) {
+			if (buff[i] != 0)
+				return (0);
+		} else if ((unsigned char)buff[i] != (((i % 251) ^ n) & 0xff))
+			return (0);
+	}
+	return (1);
+}
+
+/* Read the entries whose bit is set in "mask" and skip the others. */
+static void
+read_cab(const void *data, size_t size, const char *options, int mask)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char *buff;
+	size_t n;
+
+	buff = malloc(100000);
+	assert(buff != NULL);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    read_open_memory(a, data, size, 1024));
+	for (n = 0; n < NFILES; n++) {
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_next_header(a, &ae));
+		assertEqualString(files[n].name, archive_entry_pathname(ae));
+		assertEqualInt(files[n].size, archive_entry_size(ae));
+		if ((mask & (1 << n)) == 0)
+			continue;
+		failure("%s with %s", files[n].name, options);
+		assertEqualInt(files[n].size,
+		    archive_read_data(a, buff, 100000));
+		failure("%s with %s", files[n].name, options);
+		assert(check_contents(buff, files[n].size, (int)n));
+		assertEqualInt(0, archive_read_data(a, buff, 100000));
+	}
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+}
+
+DEFINE_TEST(test_read_format_cab_threads)
+{
+	const char *refname = "test_read_format_cab_threads.cab";
+	const char *options[] = { "cab:threads=1", "cab:threads=2",
+	    "cab:threads=4" };
+	static const int masks[] = { 0x7f, 0x00, 0x01, 0x08, 0x20,
+	    0x56, 0x40 };
+	struct archive_entry *ae;
+	struct archive *a;
+	char *data;
+	char buff[64];
+	size_t size, i, m;
+
+	extract_reference_file(refname);
+	data = slurpfile(&size, "%s", refname);
+	assert(data != NULL);
+	if (data == NULL)
+		return;
+
+	/* Every mix of read and skipped entries gives the same data
+	 * with and without worker threads. */
+	for (i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+		for (m = 0; m < sizeof(masks) / sizeof(masks[0]); m++)
+			read_cab(data, size, options[i], masks[m]);
+	}
+
+	/* A bad number of threads is rejected. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_cab(a));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_options(a, "cab:threads=-1"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	/* Damage the last folder: its checksum must still be checked,
+	 * and the folders before it must still be readable. */
+	data[size - 100] ^= 1;
+	for (i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+		assert((a = archive_read_new()) != NULL);
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_cab(a));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options[i]));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    read_open_memory(a, data, size, 1024));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_next_header(a, &ae));
+		assertEqualInt(sizeof(buff),
+		    archive_read_data(a, buff, sizeof(buff)));
+		assert(check_contents(buff, sizeof(buff), 0));
+		for (m = 1; m < NFILES; m++)
+			assertEqualIntA(a, ARCHIVE_OK,
+			    archive_read_next_header(a, &ae));
+		assertEqualString("g", archive_entry_pathname(ae));
+		assert(archive_read_data(a, buff, sizeof(buff)) < 0);
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+	}
+	free(data);
+}
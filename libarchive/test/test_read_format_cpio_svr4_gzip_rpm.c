@@ -127,3 +127,122 @@ DEFINE_TEST(test_read_format_cpio_svr4_gzip_rpm)
 	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
 }
 
+
+DEFINE_TEST(test_read_format_cpio_svr4_gzip_rpm_index)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	const char *name = "test_read_format_cpio_svr4_gzip_rpm.rpm";
+	const void *buff;
+	size_t size;
+	int64_t offset;
+	int r;
+
+	assert((a = archive_read_new()) != NULL);
+	r = archive_read_support_filter_gzip(a);
+	if (r == ARCHIVE_WARN) {
+		skipping("gzip reading not fully supported on this platform");
+		assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+		return;
+	}
+	assertEqualIntA(a, ARCHIVE_OK, r);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_filter_rpm(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_options(a, "cpio:rpm-index"));
+	extract_reference_file(name);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_filename(a, name, 2));
+
+	/* Entries come from the rpm header. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("./etc/file1", archive_entry_pathname(ae));
+	assertEqualInt(AE_IFREG | 0644, archive_entry_mode(ae));
+	assertEqualInt(6, archive_entry_size(ae));
+	assertEqualInt(86401, archive_entry_mtime(ae));
+	assertEqualString("root", archive_entry_uname(ae));
+	assertEqualString("root", archive_entry_gname(ae));
+	/* Their data isn't. */
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_data_block(a, &buff, &size, &offset));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("./etc/file2", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("./etc/file3", archive_entry_pathname(ae));
+	assertEqualInt(6, archive_entry_size(ae));
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(archive_format(a), ARCHIVE_FORMAT_CPIO);
+
+	assertEqualInt(ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
+#define __LIBARCHIVE_BUILD 1
+#include "archive_digest_private.h"
+
+DEFINE_TEST(test_read_format_cpio_svr4_gzip_rpm_digest)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	const char *name = "test_read_format_cpio_svr4_gzip_rpm.rpm";
+	archive_md5_ctx ctx;
+	unsigned char md[16];
+	char *p, *rpm;
+	char buff[16];
+	size_t size;
+	int r;
+
+	/* The rpm header in this sample carries MD5 file digests. */
+	if (ARCHIVE_OK != archive_md5_init(&ctx)) {
+		skipping("This platform does not support MD5");
+		return;
+	}
+	archive_md5_final(&ctx, md);
+
+	extract_reference_file(name);
+	rpm = slurpfile(&size, "%s", name);
+	if (!assert(rpm != NULL))
+		return;
+	/* Damage the digest of file2 (md5 of "hello\n") in the header. */
+	for (p = rpm; p < rpm + size - 32; p++)
+		if (memcmp(p, "b1946ac92492d2347c6235b4d2611184", 32) == 0)
+			break;
+	assert(p < rpm + size - 32);
+	p += 33;
+	assertEqualMem(p, "b1946ac9", 8);
+	p[0] = '0';
+
+	assert((a = archive_read_new()) != NULL);
+	r = archive_read_support_filter_gzip(a);
+	if (r == ARCHIVE_WARN) {
+		skipping("gzip reading not fully supported on this platform");
+		assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+		free(rpm);
+		return;
+	}
+	assertEqualIntA(a, ARCHIVE_OK, r);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_filter_rpm(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, rpm, size));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("./etc/file1", archive_entry_pathname(ae));
+	assertEqualInt(6, archive_read_data(a, buff, sizeof(buff)));
+	assertEqualMem(buff, "hello\n", 6);
+	assertEqualInt(0, archive_read_data(a, buff, sizeof(buff)));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("./etc/file2", archive_entry_pathname(ae));
+	assertEqualInt(6, archive_read_data(a, buff, 6));
+	assertEqualInt(ARCHIVE_WARN, archive_read_data(a, buff, sizeof(buff)));
+
+	/* Skipped data isn't checked. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("./etc/file3", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+
+	assertEqualInt(ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(rpm);
+}
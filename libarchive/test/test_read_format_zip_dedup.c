@@ -0,0 +1,113 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * test_read_format_zip_dedup.zip was made with
+ *   bsdtar --format zip --options zip:dedup,zip:compression=store \
+ *       -cf test_read_format_zip_dedup.zip a b c d e
+ * where a and b hold the same 4096 bytes, c differs from them in its
+ * last byte, and d and e hold the first 100 of those bytes.  The
+ * central directory entries of b and e point at the local headers of
+ * a and d.
+ */
+
+static void
+verify_entry(struct archive *a, const char *name, const char *target,
+    const char *data, size_t size)
+{
+	struct archive_entry *ae;
+	char buff[4097];
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(name, archive_entry_pathname(ae));
+	assertEqualString(target, archive_entry_hardlink(ae));
+	assertEqualInt(AE_IFREG, archive_entry_filetype(ae));
+	assertEqualInt(size, archive_entry_size(ae));
+	assertEqualIntA(a, (int)size,
+	    (int)archive_read_data(a, buff, sizeof(buff)));
+	if (size > 0)
+		assertEqualMem(buff, data, size);
+}
+
+DEFINE_TEST(test_read_format_zip_dedup)
+{
+	const char *refname = "test_read_format_zip_dedup.zip";
+	struct archive_entry *ae;
+	struct archive *a;
+	char data[4096], other[4096];
+	char *p;
+	size_t i, s;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (char)(i * 7 + i / 251);
+	memcpy(other, data, sizeof(other));
+	other[sizeof(other) - 1] ^= 1;
+	extract_reference_file(refname);
+	p = slurpfile(&s, "%s", refname);
+
+	/* The seekable reader turns shared data into hard links. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_format_zip_seekable(a));
+	assertEqualIntA(a, ARCHIVE_OK, read_open_memory_seek(a, p, s, 7));
+	verify_entry(a, "a", NULL, data, 4096);
+	verify_entry(a, "b", "a", NULL, 0);
+	verify_entry(a, "c", NULL, other, 4096);
+	verify_entry(a, "d", NULL, data, 100);
+	verify_entry(a, "e", "d", NULL, 0);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	/* The streaming reader sees only the local headers. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_format_zip_streamable(a));
+	assertEqualIntA(a, ARCHIVE_OK, read_open_memory(a, p, s, 7));
+	verify_entry(a, "a", NULL, data, 4096);
+	verify_entry(a, "c", NULL, other, 4096);
+	verify_entry(a, "d", NULL, data, 100);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	/* A warning from the first copy doesn't lose the link to it:
+	 * damage the CRC-32 in the local header of d. */
+	assertEqualMem(p + 8350, "PK\003\004", 4);
+	memcpy(p + 8350 + 14, "\xef\xbe\xad\xde", 4);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_format_zip_seekable(a));
+	assertEqualIntA(a, ARCHIVE_OK, read_open_memory_seek(a, p, s, 7));
+	verify_entry(a, "a", NULL, data, 4096);
+	verify_entry(a, "b", "a", NULL, 0);
+	verify_entry(a, "c", NULL, other, 4096);
+	assertEqualIntA(a, ARCHIVE_WARN, archive_read_next_header(a, &ae));
+	assertEqualString("d", archive_entry_pathname(ae));
+	verify_entry(a, "e", "d", NULL, 0);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	free(p);
+}
@@ -0,0 +1,115 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Write large files with ARCHIVE_EXTRACT_PREALLOCATE using small,
+ * out-of-order and short writes and verify what lands on disk.
+ */
+static void
+check_file(const char *name, const unsigned char *expect, size_t size)
+{
+	unsigned char *buff;
+	size_t read_size;
+
+	buff = (unsigned char *)slurpfile(&read_size, "%s", name);
+	if (!assert(buff != NULL))
+		return;
+	assertEqualInt(size, read_size);
+	if (read_size == size)
+		assertEqualMem(buff, expect, size);
+	free(buff);
+}
+
+DEFINE_TEST(test_write_disk_preallocate)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	const size_t size = 3 * 1024 * 1024 + 1234;
+	unsigned char *data, *expect;
+	size_t i, n;
+
+	data = malloc(size);
+	expect = malloc(size);
+	if (!assert(data != NULL && expect != NULL)) {
+		free(data);
+		free(expect);
+		return;
+	}
+	for (i = 0; i < size; i++)
+		data[i] = (unsigned char)(i * 7 + i / 4096);
+
+	assert((a = archive_write_disk_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_disk_set_options(a, ARCHIVE_EXTRACT_PREALLOCATE));
+
+	/* Sequential data in odd-sized pieces. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file1");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	for (i = 0; i < size; i += n) {
+		n = 10240 + 17;
+		if (n > size - i)
+			n = size - i;
+		assertEqualInt(n, archive_write_data(a, data + i, n));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+	archive_entry_free(ae);
+	check_file("file1", data, size);
+
+	/* Blocks with gaps between them and data missing at the end. */
+	memset(expect, 0, size);
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file2");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_data_block(a, data, 100000, 0));
+	memcpy(expect, data, 100000);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_data_block(a, data + 500000, 2000000, 500000));
+	memcpy(expect + 500000, data + 500000, 2000000);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+	archive_entry_free(ae);
+	check_file("file2", expect, size);
+
+	/* Small files aren't affected. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file3");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, 5000);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	assertEqualInt(5000, archive_write_data(a, data, 5000));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+	archive_entry_free(ae);
+	check_file("file3", data, 5000);
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_free(a));
+	free(data);
+	free(expect);
+}
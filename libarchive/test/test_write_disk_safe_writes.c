@@ -0,0 +1,117 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+#if !defined(_WIN32) || defined(__CYGWIN__)
+/* Count directory entries other than "." and "..". */
+static int
+count_entries(const char *dirname)
+{
+	DIR *d;
+	struct dirent *de;
+	int n = 0;
+
+	d = opendir(dirname);
+	if (d == NULL)
+		return (-1);
+	while ((de = readdir(d)) != NULL) {
+		if (strcmp(de->d_name, ".") != 0 &&
+		    strcmp(de->d_name, "..") != 0)
+			n++;
+	}
+	closedir(d);
+	return (n);
+}
+#endif
+
+/*
+ * ARCHIVE_EXTRACT_SAFE_WRITES must leave the old file in place until
+ * the new one is complete, then replace it in one step without
+ * leaving temporary files behind.
+ */
+DEFINE_TEST(test_write_disk_safe_writes)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+	skipping("SAFE_WRITES is not supported on Windows");
+#else
+	struct archive *a;
+	struct archive_entry *ae;
+	struct stat st;
+#if defined(O_TMPFILE) && defined(HAVE_LINKAT)
+	int fd;
+#endif
+
+	assertUmask(022);
+	assertMakeDir("out", 0755);
+	assertMakeFile("out/f", 0644, "old");
+	assertMakeHardlink("old", "out/f");
+
+	assert((a = archive_write_disk_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_disk_set_options(a, ARCHIVE_EXTRACT_SAFE_WRITES |
+	    ARCHIVE_EXTRACT_PERM));
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "out/f");
+	archive_entry_set_mode(ae, AE_IFREG | 0640);
+	archive_entry_set_size(ae, 3);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	assertEqualInt(3, archive_write_data(a, "new", 3));
+	/* Not replaced yet. */
+	assertTextFileContents("old", "out/f");
+#if defined(O_TMPFILE) && defined(HAVE_LINKAT)
+	/* Where the file system can do it, the new data has no name. */
+	fd = open("out", O_TMPFILE | O_WRONLY, 0600);
+	if (fd >= 0) {
+		close(fd);
+		assertEqualInt(1, count_entries("out"));
+	} else {
+		skipping("O_TMPFILE is not supported here");
+	}
+#endif
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+	archive_entry_free(ae);
+
+	/* A file with nothing in the way is written in place. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "out/g");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, 1);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	assertEqualInt(1, archive_write_data(a, "g", 1));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+	archive_entry_free(ae);
+
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	assertTextFileContents("new", "out/f");
+	assertFileMode("out/f", 0640);
+	assertTextFileContents("g", "out/g");
+	/* The hard link still points at the replaced file. */
+	assertEqualInt(0, stat("old", &st));
+	assertEqualInt(1, st.st_nlink);
+	assertEqualInt(2, count_entries("out"));
+#endif
+}
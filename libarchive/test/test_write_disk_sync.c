@@ -0,0 +1,79 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * The sync policies must not change what gets extracted; they only
+ * decide when it reaches stable storage.
+ */
+static void
+extract_files(int flags, const char *dir)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	char name[64];
+	int i;
+
+	assert((a = archive_write_disk_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_disk_set_options(a, flags));
+	for (i = 0; i < 3; i++) {
+		assert((ae = archive_entry_new()) != NULL);
+		snprintf(name, sizeof(name), "%s/file%d", dir, i);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, 5);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt(5, archive_write_data(a, "12345", 5));
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+		archive_entry_free(ae);
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	for (i = 0; i < 3; i++) {
+		snprintf(name, sizeof(name), "%s/file%d", dir, i);
+		assertTextFileContents("12345", name);
+	}
+}
+
+DEFINE_TEST(test_write_disk_sync)
+{
+	assertMakeDir("per_file", 0755);
+	extract_files(ARCHIVE_EXTRACT_SYNC_PER_FILE, "per_file");
+	assertMakeDir("batch", 0755);
+	extract_files(ARCHIVE_EXTRACT_SYNC_BATCH, "batch");
+	assertMakeDir("both", 0755);
+	extract_files(ARCHIVE_EXTRACT_SYNC_PER_FILE |
+	    ARCHIVE_EXTRACT_SYNC_BATCH, "both");
+
+	/* Replace existing files through SAFE_WRITES. */
+	assertMakeFile("batch/file0", 0644, "old");
+	assertMakeFile("per_file/file1", 0644, "old");
+	extract_files(ARCHIVE_EXTRACT_SYNC_PER_FILE |
+	    ARCHIVE_EXTRACT_SAFE_WRITES, "per_file");
+	extract_files(ARCHIVE_EXTRACT_SYNC_BATCH |
+	    ARCHIVE_EXTRACT_SAFE_WRITES, "batch");
+}
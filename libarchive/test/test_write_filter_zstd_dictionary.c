@@ -0,0 +1,253 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * test_write_filter_zstd_dictionary.dict was trained by zstd on
+ * records like the ones record() writes.
+ */
+static const char refname[] = "test_write_filter_zstd_dictionary.dict";
+
+#define	NRECORDS	2
+#define	BIGSIZE		(3 * 1024 * 1024)
+
+static int
+record(char *buff, unsigned n)
+{
+	return (sprintf(buff, "{\"host\":\"node%03u\",\"metric\":\"cpu.load\","
+	    "\"value\":%u.%02u,\"tags\":[\"rack%u\",\"zone-%c\"],\"ts\":%u}\n",
+	    n % 173, n % 7, n % 100, n % 11, 'a' + n % 5,
+	    1700000000U + n * 37));
+}
+
+static unsigned char
+big_pattern(size_t i)
+{
+	uint32_t x = (uint32_t)i;
+
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	return (unsigned char)x;
+}
+
+/*
+ * Write NRECORDS small entries, or one BIGSIZE entry, through the
+ * zstd filter with the given dictionary bytes and options.
+ */
+static size_t
+write_archive(const void *dict, size_t dictsize, const char *options,
+    int big, char *buff, size_t buffsize)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char name[16], data[256], *bigdata = NULL;
+	size_t used, i;
+	int n, size;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_zstd(a));
+	if (dict != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_zstd_dictionary(a, dict, dictsize));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	if (big) {
+		assert((bigdata = malloc(BIGSIZE)) != NULL);
+		for (i = 0; bigdata != NULL && i < BIGSIZE; i++)
+			bigdata[i] = big_pattern(i);
+	}
+	for (n = 0; n < (big ? 1 : NRECORDS); n++) {
+		size = big ? BIGSIZE : record(data, n * 7919);
+		snprintf(name, sizeof(name), "rec%02d", n);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, size);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		archive_entry_free(ae);
+		assertEqualIntA(a, size, (int)archive_write_data(a,
+		    big ? bigdata : data, size));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	free(bigdata);
+	return (used);
+}
+
+/*
+ * Read the archive back and check every entry.  Returns ARCHIVE_OK,
+ * or the first error with its message copied to errmsg.
+ */
+static int
+read_archive(const char *buff, size_t used, const void *dict,
+    size_t dictsize, const char *options, int big, char *errmsg,
+    size_t errsize)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char data[256], *readbuf;
+	la_ssize_t bytes;
+	size_t i;
+	int n, r, size, mismatches = 0;
+
+	assert((readbuf = malloc(BIGSIZE)) != NULL);
+	if (readbuf == NULL)
+		return (ARCHIVE_FATAL);
+	errmsg[0] = '\0';
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_zstd(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	if (dict != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_add_zstd_dictionary(a, dict, dictsize));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options));
+	r = archive_read_open_memory(a, buff, used);
+	for (n = 0; r == ARCHIVE_OK && n < (big ? 1 : NRECORDS); n++) {
+		r = archive_read_next_header(a, &ae);
+		if (r != ARCHIVE_OK)
+			break;
+		size = big ? BIGSIZE : record(data, n * 7919);
+		bytes = archive_read_data(a, readbuf, BIGSIZE);
+		if (bytes < 0) {
+			r = (int)bytes;
+			break;
+		}
+		assertEqualInt(size, bytes);
+		for (i = 0; big && i < BIGSIZE; i++)
+			if (readbuf[i] != (char)big_pattern(i))
+				mismatches++;
+		if (!big)
+			assertEqualMem(data, readbuf, size);
+	}
+	if (r == ARCHIVE_OK)
+		r = archive_read_next_header(a, &ae) == ARCHIVE_EOF ?
+		    ARCHIVE_OK : ARCHIVE_FATAL;
+	if (r != ARCHIVE_OK && archive_error_string(a) != NULL)
+		snprintf(errmsg, errsize, "%s", archive_error_string(a));
+	assertEqualInt(0, mismatches);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(readbuf);
+	return (r);
+}
+
+DEFINE_TEST(test_write_filter_zstd_dictionary)
+{
+	struct archive *a;
+	char *buff, *dict, errmsg[256], options[512], expect[64];
+	size_t buffsize = BIGSIZE + 256 * 1024, dictsize;
+	size_t used_plain, used_dict, used_option;
+	unsigned id;
+	int r;
+
+	if (archive_libzstd_version() == NULL) {
+		skipping("zstd dictionaries need libzstd");
+		return;
+	}
+	/* Older libzstd can't use digested dictionaries. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_zstd(a));
+	r = archive_write_set_zstd_dictionary(a, "not a dictionary", 16);
+	assertEqualInt(ARCHIVE_FATAL, r);
+	if (strstr(archive_error_string(a), "not supported") != NULL) {
+		assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+		skipping("zstd dictionaries are not supported by this build");
+		return;
+	}
+	assertEqualString("Not a zstd dictionary with a dictionary ID",
+	    archive_error_string(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	extract_reference_file(refname);
+	dict = slurpfile(&dictsize, "%s", refname);
+	assert((buff = malloc(buffsize)) != NULL);
+	if (dict == NULL || buff == NULL) {
+		free(dict);
+		free(buff);
+		return;
+	}
+	/* The dictionary ID follows the 4-byte magic number. */
+	id = (unsigned char)dict[4] | ((unsigned char)dict[5] << 8) |
+	    ((unsigned char)dict[6] << 16) |
+	    ((unsigned)(unsigned char)dict[7] << 24);
+	snprintf(expect, sizeof(expect), "zstd data needs dictionary %u", id);
+
+	/* The dictionary makes these small records smaller. */
+	used_plain = write_archive(NULL, 0, NULL, 0, buff, buffsize);
+	used_dict = write_archive(dict, dictsize, NULL, 0, buff, buffsize);
+	failure("plain %d bytes, with dictionary %d bytes",
+	    (int)used_plain, (int)used_dict);
+	assert(used_dict < used_plain);
+
+	/* Reading needs the dictionary, given as bytes or as a path. */
+	assertEqualInt(ARCHIVE_FATAL, read_archive(buff, used_dict,
+	    NULL, 0, NULL, 0, errmsg, sizeof(errmsg)));
+	assertEqualString(expect, errmsg);
+	assertEqualInt(ARCHIVE_OK, read_archive(buff, used_dict,
+	    dict, dictsize, NULL, 0, errmsg, sizeof(errmsg)));
+	snprintf(options, sizeof(options), "zstd:dictionary=%s", refname);
+	assertEqualInt(ARCHIVE_OK, read_archive(buff, used_dict,
+	    NULL, 0, options, 0, errmsg, sizeof(errmsg)));
+
+	/* The path option gives the same output as the bytes. */
+	used_option = write_archive(NULL, 0, options, 0, buff, buffsize);
+	assertEqualInt(used_dict, used_option);
+	assertEqualInt(ARCHIVE_OK, read_archive(buff, used_option,
+	    dict, dictsize, NULL, 0, errmsg, sizeof(errmsg)));
+
+	/* The default window is larger than 1MiB... */
+	used_plain = write_archive(NULL, 0, NULL, 1, buff, buffsize);
+	assertEqualInt(ARCHIVE_OK, read_archive(buff, used_plain,
+	    NULL, 0, NULL, 1, errmsg, sizeof(errmsg)));
+	assert(ARCHIVE_OK != read_archive(buff, used_plain,
+	    NULL, 0, "zstd:max-window=1M", 1, errmsg, sizeof(errmsg)));
+	/* ...but the writer can be limited to one. */
+	used_plain = write_archive(NULL, 0, "zstd:max-window=1MiB", 1,
+	    buff, buffsize);
+	assertEqualInt(ARCHIVE_OK, read_archive(buff, used_plain,
+	    NULL, 0, "zstd:max-window=1048576", 1, errmsg, sizeof(errmsg)));
+	assert(ARCHIVE_OK != read_archive(buff, used_plain,
+	    NULL, 0, "zstd:max-window=512k", 1, errmsg, sizeof(errmsg)));
+
+	/* Bad option values. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_zstd(a));
+	assertEqualIntA(a, ARCHIVE_FATAL,
+	    archive_read_set_options(a, "zstd:max-window=12x"));
+	assertEqualIntA(a, ARCHIVE_FATAL,
+	    archive_read_set_options(a, "zstd:max-window=4G"));
+	assertEqualIntA(a, ARCHIVE_FATAL,
+	    archive_read_set_options(a, "zstd:dictionary=nonexistent.dict"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	free(dict);
+	free(buff);
+}
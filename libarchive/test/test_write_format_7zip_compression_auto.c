@@ -0,0 +1,177 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Exercise "compression=auto": files that won't compress get COPY
+ * folders of their own after the solid folder.
+ */
+
+#define BUFFSIZE	(2 * 1024 * 1024)
+
+static void
+fill_random(unsigned char *p, size_t size, uint32_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		p[i] = (unsigned char)(seed >> 24);
+	}
+}
+
+static void
+add_entry(struct archive *a, const char *name, int type, const void *data,
+    size_t size, size_t written, size_t chunk)
+{
+	struct archive_entry *ae;
+	size_t off;
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, name);
+	archive_entry_set_mode(ae, type | 0644);
+	if (type == AE_IFLNK)
+		archive_entry_copy_symlink(ae, (const char *)data);
+	else
+		archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	for (off = 0; off < written; off += chunk) {
+		size_t n = written - off < chunk ? written - off : chunk;
+		assertEqualIntA(a, (int)n, (int)archive_write_data(a,
+		    (const char *)data + off, n));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+}
+
+static void
+verify_entry(struct archive *a, const char *name, const void *data,
+    size_t size, size_t nonzero)
+{
+	struct archive_entry *ae;
+	char *p = malloc(size + 1);
+	size_t i;
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(name, archive_entry_pathname(ae));
+	assertEqualIntA(a, (int)size, (int)archive_read_data(a, p, size + 1));
+	assertEqualMem(data, p, nonzero);
+	for (i = nonzero; i < size && p[i] == 0; i++)
+		;
+	assertEqualInt(size, i);
+	free(p);
+}
+
+DEFINE_TEST(test_write_format_7zip_compression_auto)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	unsigned char *buff, *random, *text;
+	la_int64_t compressed, stored;
+	size_t used, i;
+
+	buff = malloc(BUFFSIZE);
+	random = malloc(200000);
+	text = malloc(200000);
+	fill_random(random, 200000, 4321);
+	for (i = 0; i < 200000; i++)
+		text[i] = "All work and no play makes Jack a dull boy.\n"[i % 44];
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_7zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a, "7zip:compression=auto"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, BUFFSIZE, &used));
+	add_entry(a, "random", AE_IFREG, random, 200000, 200000, 1000);
+	add_entry(a, "text", AE_IFREG, text, 200000, 200000, 65536);
+	add_entry(a, "empty", AE_IFREG, NULL, 0, 0, 1);
+	add_entry(a, "photo.jpg", AE_IFREG, text, 5000, 5000, 5000);
+	/* Judged by what was written before finish_entry() pads it
+	 * with zeros. */
+	add_entry(a, "short", AE_IFREG, random, 100000, 1000, 1000);
+	add_entry(a, "link", AE_IFLNK, "text", 0, 0, 1);
+	add_entry(a, "dir", AE_IFDIR, NULL, 0, 0, 1);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_get_auto_compression_stats(a, &compressed, &stored));
+	assertEqualInt(4, compressed + stored);
+	if (compressed != 0) {
+		/* Only the text is compressed. */
+		assertEqualInt(1, compressed);
+		assert(used > 305000);
+		assert(used < 330000);
+	}
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used));
+	/* The solid folder comes first, then stored files, then the
+	 * files without data. */
+	if (compressed != 0) {
+		verify_entry(a, "text", text, 200000, 200000);
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_next_header(a, &ae));
+		assertEqualString("link", archive_entry_pathname(ae));
+		assertEqualString("text", archive_entry_symlink(ae));
+		verify_entry(a, "random", random, 200000, 200000);
+		verify_entry(a, "photo.jpg", text, 5000, 5000);
+		verify_entry(a, "short", random, 100000, 1000);
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	/* An archive where every file is stored. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_7zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a, "7zip:compression=auto"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, BUFFSIZE, &used));
+	add_entry(a, "r1", AE_IFREG, random, 100000, 100000, 100000);
+	add_entry(a, "r2", AE_IFREG, random + 100000, 100000, 100000, 4096);
+	add_entry(a, "empty", AE_IFREG, NULL, 0, 0, 1);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used));
+	verify_entry(a, "r1", random, 100000, 100000);
+	verify_entry(a, "r2", random + 100000, 100000, 100000);
+	verify_entry(a, "empty", NULL, 0, 0);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	free(text);
+	free(random);
+	free(buff);
+}
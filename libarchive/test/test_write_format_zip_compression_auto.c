@@ -0,0 +1,204 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Exercise "compression=auto": each regular file of known size is
+ * deflated or stored according to its name and the start of its data.
+ */
+
+#define BUFFSIZE	(2 * 1024 * 1024)
+
+static void
+fill_random(unsigned char *p, size_t size, uint32_t seed)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		p[i] = (unsigned char)(seed >> 24);
+	}
+}
+
+static void
+fill_text(unsigned char *p, size_t size)
+{
+	size_t i;
+	int n = 0;
+
+	for (i = 0; i < size; i++) {
+		if (i % 32 == 0)
+			n = (int)(i / 32);
+		p[i] = (i % 32 == 31) ? '\n' : "line 0123456789"[(n + i) % 15];
+	}
+}
+
+static void
+add_file(struct archive *a, const char *name, const void *data,
+    size_t size, int size_known, size_t chunk)
+{
+	struct archive_entry *ae;
+	size_t off;
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, name);
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	if (size_known)
+		archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	for (off = 0; off < size; off += chunk) {
+		size_t n = size - off < chunk ? size - off : chunk;
+		assertEqualIntA(a, (int)n, (int)archive_write_data(a,
+		    (const char *)data + off, n));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+}
+
+static unsigned i2(const unsigned char *p) { return ((p[0] & 0xff) | ((p[1] & 0xff) << 8)); }
+static unsigned i4(const unsigned char *p) { return (i2(p) | (i2(p + 2) << 16)); }
+
+/* Return the compression method the central directory gives a file. */
+static int
+cd_method(const unsigned char *buff, size_t used, const char *name)
+{
+	const unsigned char *eocd = buff + used - 22;
+	const unsigned char *p = buff + i4(eocd + 16);
+	int entries = i2(eocd + 10);
+
+	while (entries-- > 0) {
+		size_t n = i2(p + 28);
+
+		if (n == strlen(name) && memcmp(p + 46, name, n) == 0)
+			return (i2(p + 10));
+		p += 46 + n + i2(p + 30) +
+		    i2(p + 32);
+	}
+	return (-1);
+}
+
+static void
+verify_file(struct archive *a, const char *name, const void *data,
+    size_t size)
+{
+	struct archive_entry *ae;
+	char *p;
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(name, archive_entry_pathname(ae));
+	p = malloc(size + 1);
+	if (!assert(p != NULL))
+		return;
+	assertEqualIntA(a, (int)size, (int)archive_read_data(a, p, size + 1));
+	assertEqualMem(data, p, size);
+	free(p);
+}
+
+DEFINE_TEST(test_write_format_zip_compression_auto)
+{
+#ifndef HAVE_ZLIB_H
+	skipping("deflate compression is not supported on this platform");
+#else
+	struct archive *a;
+	unsigned char *buff, *random, *text;
+	la_int64_t compressed, stored;
+	size_t used;
+
+	buff = malloc(BUFFSIZE);
+	random = malloc(200000);
+	text = malloc(200000);
+	fill_random(random, 200000, 12345);
+	fill_text(text, 200000);
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a, "zip:compression=auto"));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_write_set_options(a, "zip:store-extension=a/b"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, BUFFSIZE, &used));
+
+	/* The sample is collected over several writes. */
+	add_file(a, "random.bin", random, 200000, 1, 1000);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_get_auto_compression_stats(a, &compressed, &stored));
+	assertEqualInt(0, compressed);
+	assertEqualInt(1, stored);
+	add_file(a, "text.txt", text, 200000, 1, 200000);
+	/* Stored because of its name. */
+	add_file(a, "photo.JPG", text, 5000, 1, 5000);
+	/* Files of unknown size are always deflated. */
+	add_file(a, "stream.bin", random, 5000, 0, 5000);
+	/* The whole of a small file is the sample. */
+	add_file(a, "small.bin", random + 1000, 3000, 1, 1000);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_get_auto_compression_stats(a, &compressed, &stored));
+	assertEqualInt(2, compressed);
+	assertEqualInt(3, stored);
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	assertEqualInt(0, cd_method(buff, used, "random.bin"));
+	assertEqualInt(8, cd_method(buff, used, "text.txt"));
+	assertEqualInt(0, cd_method(buff, used, "photo.JPG"));
+	assertEqualInt(8, cd_method(buff, used, "stream.bin"));
+	assertEqualInt(0, cd_method(buff, used, "small.bin"));
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used));
+	verify_file(a, "random.bin", random, 200000);
+	verify_file(a, "text.txt", text, 200000);
+	verify_file(a, "photo.JPG", text, 5000);
+	verify_file(a, "stream.bin", random, 5000);
+	verify_file(a, "small.bin", random + 1000, 3000);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	/* Replace the list of extensions that are stored by name. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_options(a,
+	    "zip:compression=auto,zip:!store-extension,"
+	    "zip:store-extension=.TXT"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, BUFFSIZE, &used));
+	add_file(a, "text.txt", text, 200000, 1, 65536);
+	add_file(a, "photo.jpg", text, 5000, 1, 5000);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	assertEqualInt(0, cd_method(buff, used, "text.txt"));
+	assertEqualInt(8, cd_method(buff, used, "photo.jpg"));
+
+	free(text);
+	free(random);
+	free(buff);
+#endif
+}
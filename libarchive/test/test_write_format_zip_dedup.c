@@ -0,0 +1,203 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Exercise "dedup": a regular file whose data is already in the
+ * archive gets a central directory entry pointing at the earlier
+ * copy, and reads back as a hard link to it.
+ */
+
+
+#define BUFFSIZE	(2 * 1024 * 1024)
+#define DATASIZE	200000
+
+/* Write a file in 'chunk'-byte pieces. */
+static void
+write_file(struct archive *a, const char *name, const unsigned char *data,
+    size_t size, int size_known, size_t chunk)
+{
+	struct archive_entry *ae;
+	size_t off, n;
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, name);
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	if (size_known)
+		archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	for (off = 0; off < size; off += n) {
+		n = size - off < chunk ? size - off : chunk;
+		assertEqualIntA(a, (int)n,
+		    (int)archive_write_data(a, data + off, n));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_finish_entry(a));
+}
+
+static unsigned i2(const unsigned char *p) { return ((p[0] & 0xff) | ((p[1] & 0xff) << 8)); }
+static unsigned i4(const unsigned char *p) { return (i2(p) | (i2(p + 2) << 16)); }
+
+/* Return the local header offset the central directory gives a file. */
+static long
+cd_offset(const unsigned char *buff, size_t used, const char *name)
+{
+	const unsigned char *eocd = buff + used - 22;
+	const unsigned char *p = buff + i4(eocd + 16);
+	int entries = i2(eocd + 10);
+
+	while (entries-- > 0) {
+		size_t n = i2(p + 28);
+
+		if (n == strlen(name) && memcmp(p + 46, name, n) == 0)
+			return ((long)i4(p + 42));
+		p += 46 + n + i2(p + 30) + i2(p + 32);
+	}
+	return (-1);
+}
+
+/* Read the next entry back; 'target' is the hard link it should be. */
+static void
+verify_entry(struct archive *a, const char *name, const char *target,
+    const unsigned char *data, size_t size)
+{
+	struct archive_entry *ae;
+	char *p;
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(name, archive_entry_pathname(ae));
+	assertEqualString(target, archive_entry_hardlink(ae));
+	p = malloc(size + 1);
+	if (!assert(p != NULL))
+		return;
+	assertEqualIntA(a, (int)size, (int)archive_read_data(a, p, size + 1));
+	if (size > 0)
+		assertEqualMem(p, data, size);
+	free(p);
+}
+
+DEFINE_TEST(test_write_format_zip_dedup)
+{
+	struct archive *a;
+	struct archive_entry *ae;
+	unsigned char *buff, *data, *other;
+	size_t used, i;
+	int r;
+
+	buff = malloc(BUFFSIZE);
+	data = malloc(DATASIZE);
+	other = malloc(DATASIZE);
+	if (!assert(buff != NULL && data != NULL && other != NULL)) {
+		free(other);
+		free(data);
+		free(buff);
+		return;
+	}
+	for (i = 0; i < DATASIZE; i++)
+		data[i] = (unsigned char)(i * 7 + i / 251);
+	memcpy(other, data, DATASIZE);
+	other[DATASIZE - 1] ^= 1;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	r = archive_write_set_options(a, "zip:dedup");
+	if (r == ARCHIVE_FAILED) {
+		/* The reader side is covered by test_read_format_zip_dedup. */
+		assertEqualString("zip: dedup needs SHA-256 support",
+		    archive_error_string(a));
+		skipping("dedup needs SHA-256 support");
+		assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+		free(other);
+		free(data);
+		free(buff);
+		return;
+	}
+	assertEqualIntA(a, ARCHIVE_OK, r);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a, "zip:compression=store"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, BUFFSIZE, &used));
+	write_file(a, "a", data, DATASIZE, 1, 7000);
+	write_file(a, "b", data, DATASIZE, 1, DATASIZE);
+	/* Same size and start as "a", so it is held back to the end. */
+	write_file(a, "c", other, DATASIZE, 1, 65536);
+	/* Small files fit in the head. */
+	write_file(a, "d", data, 5000, 1, 5000);
+	write_file(a, "e", data, 5000, 1, 100);
+	write_file(a, "f", data, 4999, 1, 4999);
+	/* Files of unknown size are not deduplicated. */
+	write_file(a, "g", data, DATASIZE, 0, 65536);
+	write_file(a, "h", data, DATASIZE, 1, 65536);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	assertEqualInt(0, cd_offset(buff, used, "a"));
+	assertEqualInt(0, cd_offset(buff, used, "b"));
+	assertEqualInt(0, cd_offset(buff, used, "h"));
+	assert(cd_offset(buff, used, "c") > 0);
+	assert(cd_offset(buff, used, "d") > cd_offset(buff, used, "c"));
+	assertEqualInt(cd_offset(buff, used, "d"), cd_offset(buff, used, "e"));
+	assert(cd_offset(buff, used, "f") > cd_offset(buff, used, "d"));
+	assert(cd_offset(buff, used, "g") > cd_offset(buff, used, "f"));
+	/* Only "a", "c", "d", "f" and "g" have data of their own. */
+	assert(used < 3 * DATASIZE + 10000 + 5000);
+
+	/* The duplicates read back as hard links, in the order of
+	 * the data they share. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, used));
+	verify_entry(a, "a", NULL, data, DATASIZE);
+	verify_entry(a, "b", "a", NULL, 0);
+	verify_entry(a, "h", "a", NULL, 0);
+	verify_entry(a, "c", NULL, other, DATASIZE);
+	verify_entry(a, "d", NULL, data, 5000);
+	verify_entry(a, "e", "d", NULL, 0);
+	verify_entry(a, "f", NULL, data, 4999);
+	verify_entry(a, "g", NULL, data, DATASIZE);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	/* Without the option, every file has its own data. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a, "zip:dedup,zip:!dedup"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, BUFFSIZE, &used));
+	write_file(a, "a", data, 5000, 1, 5000);
+	write_file(a, "b", data, 5000, 1, 5000);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	assertEqualInt(0, cd_offset(buff, used, "a"));
+	assert(cd_offset(buff, used, "b") > 0);
+
+	free(other);
+	free(data);
+	free(buff);
+}
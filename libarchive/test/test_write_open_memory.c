@@ -82,3 +82,107 @@ DEFINE_TEST(test_write_open_memory)
 	}
 	archive_entry_free(ae);
 }
+
+static void
+write_test_archive(struct archive *a, const char *data, size_t size)
+{
+	struct archive_entry *ae;
+
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_set_pathname(ae, "file");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, size);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	assertEqualInt(size, archive_write_data(a, data, size));
+	archive_entry_free(ae);
+}
+
+DEFINE_TEST(test_write_open_memory_chunks)
+{
+	struct archive *a;
+	const struct archive_iovec *chunks;
+	struct archive_iovec *taken;
+	size_t count, ntaken, i, used, total;
+	const size_t datasize = 100000;
+	char *data, *expect;
+
+	data = malloc(datasize);
+	expect = malloc(datasize + 4096);
+	if (!assert(data != NULL && expect != NULL)) {
+		free(data);
+		free(expect);
+		return;
+	}
+	for (i = 0; i < datasize; i++)
+		data[i] = (char)(i * 31 + i / 256);
+
+	/* The reference archive, written into one buffer. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, expect, datasize + 4096, &used));
+	write_test_archive(a, data, datasize);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* The same archive in chunks that don't line up with blocks. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory_chunks(a, 3000));
+	write_test_archive(a, data, datasize);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_get_memory_chunks(a, &chunks, &count));
+	assertEqualInt(count, (used + 2999) / 3000);
+	total = 0;
+	for (i = 0; i < count; i++) {
+		if (i + 1 < count)
+			assertEqualInt(3000, chunks[i].iov_len);
+		assertEqualMem(chunks[i].iov_base, expect + total,
+		    chunks[i].iov_len);
+		total += chunks[i].iov_len;
+	}
+	assertEqualInt(used, total);
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* Take the chunks while the archive is being written. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory_chunks(a, 0));
+	write_test_archive(a, data, datasize);
+	total = 0;
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_take_memory_chunks(a, &taken, &ntaken));
+	for (i = 0; i < ntaken; i++) {
+		assertEqualMem(taken[i].iov_base, expect + total,
+		    taken[i].iov_len);
+		total += taken[i].iov_len;
+	}
+	archive_write_free_memory_chunks(taken, ntaken);
+	assert(total > 0);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_take_memory_chunks(a, &taken, &ntaken));
+	for (i = 0; i < ntaken; i++) {
+		assertEqualMem(taken[i].iov_base, expect + total,
+		    taken[i].iov_len);
+		total += taken[i].iov_len;
+	}
+	archive_write_free_memory_chunks(taken, ntaken);
+	assertEqualInt(used, total);
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* Only archives opened for chunks have any. */
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, expect, datasize + 4096, &used));
+	assertEqualIntA(a, ARCHIVE_FATAL,
+	    archive_write_get_memory_chunks(a, &chunks, &count));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	free(data);
+	free(expect);
+}
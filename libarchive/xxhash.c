@@ -36,8 +36,6 @@ You can contact the author at :
 
 #include "archive_xxhash.h"
 
-#ifdef HAVE_LIBLZ4
-
 /***************************************
 ** Tuning parameters
 ****************************************/
@@ -103,6 +101,12 @@ static XXH_errorcode	  XXH32_resetState(void*, unsigned int);
 typedef struct { long long ll[(XXH32_SIZEOFSTATE+(sizeof(long long)-1))/sizeof(long long)]; } XXH32_stateSpace_t;
 static unsigned int	  XXH32_intermediateDigest (void*);
 
+static uint64_t	  XXH64 (const void*, size_t, uint64_t);
+static void*		  XXH64_init   (uint64_t);
+static XXH_errorcode	  XXH64_update (void*, const void*, size_t);
+static uint64_t	  XXH64_digest (void*);
+static XXH_errorcode	  XXH64_resetState(void*, uint64_t);
+
 /***************************************
 ** Basic Types
 ****************************************/
@@ -136,6 +140,7 @@ static unsigned int	  XXH32_intermediateDigest (void*);
 #endif
 
 typedef struct _U32_S { U32 v; } _PACKED U32_S;
+typedef struct _U64_S { U64 v; } _PACKED U64_S;
 
 #if !defined(XXH_USE_UNALIGNED_ACCESS) && !defined(__GNUC__)
 #  pragma pack(pop)
@@ -159,23 +164,48 @@ static inline U32 A32(const void* x)
     return (((const U32_S *)(x))->v);
 }
 
+#if GCC_VERSION >= 409
+__attribute__((__no_sanitize_undefined__))
+#endif
+#if defined(_MSC_VER)
+static __inline U64 A64(const void * x)
+#else
+static inline U64 A64(const void* x)
+#endif
+{
+    return (((const U64_S *)(x))->v);
+}
+
 /* Note : although _rotl exists for minGW (GCC under windows), performance seems poor */
 #if defined(_MSC_VER)
 #  define XXH_rotl32(x,r) _rotl(x,r)
+#  define XXH_rotl64(x,r) _rotl64(x,r)
 #else
 #  define XXH_rotl32(x,r) ((x << r) | (x >> (32 - r)))
+#  define XXH_rotl64(x,r) ((x << r) | (x >> (64 - r)))
 #endif
 
 #if defined(_MSC_VER)     /* Visual Studio */
 #  define XXH_swap32 _byteswap_ulong
+#  define XXH_swap64 _byteswap_uint64
 #elif GCC_VERSION >= 403
 #  define XXH_swap32 __builtin_bswap32
+#  define XXH_swap64 __builtin_bswap64
 #else
 static inline U32 XXH_swap32 (U32 x) {
     return  ((x << 24) & 0xff000000 ) |
 			((x <<  8) & 0x00ff0000 ) |
 			((x >>  8) & 0x0000ff00 ) |
 			((x >> 24) & 0x000000ff );}
+static inline U64 XXH_swap64 (U64 x) {
+    return  ((x << 56) & 0xff00000000000000ULL) |
+			((x << 40) & 0x00ff000000000000ULL) |
+			((x << 24) & 0x0000ff0000000000ULL) |
+			((x <<  8) & 0x000000ff00000000ULL) |
+			((x >>  8) & 0x00000000ff000000ULL) |
+			((x >> 24) & 0x0000000000ff0000ULL) |
+			((x >> 40) & 0x000000000000ff00ULL) |
+			((x >> 56) & 0x00000000000000ffULL);}
 #endif
 
 
@@ -188,6 +218,12 @@ static inline U32 XXH_swap32 (U32 x) {
 #define PRIME32_4    668265263U
 #define PRIME32_5    374761393U
 
+#define PRIME64_1 11400714785074694791ULL
+#define PRIME64_2 14029467366897019727ULL
+#define PRIME64_3  1609587929392839161ULL
+#define PRIME64_4  9650029242287828579ULL
+#define PRIME64_5  2870177450012600261ULL
+
 
 /***************************************
 ** Architecture Macros
@@ -222,6 +258,18 @@ FORCE_INLINE U32 XXH_readLE32_align(const U32* ptr, XXH_endianess endian, XXH_al
 static
 FORCE_INLINE U32 XXH_readLE32(const U32* ptr, XXH_endianess endian) { return XXH_readLE32_align(ptr, endian, XXH_unaligned); }
 
+static
+FORCE_INLINE U64 XXH_readLE64_align(const U64* ptr, XXH_endianess endian, XXH_alignment align)
+{
+    if (align==XXH_unaligned)
+        return endian==XXH_littleEndian ? A64(ptr) : XXH_swap64(A64(ptr));
+    else
+        return endian==XXH_littleEndian ? *ptr : XXH_swap64(*ptr);
+}
+
+static
+FORCE_INLINE U64 XXH_readLE64(const U64* ptr, XXH_endianess endian) { return XXH_readLE64_align(ptr, endian, XXH_unaligned); }
+
 
 /*****************************
 ** Simple Hash Functions
@@ -502,24 +550,292 @@ U32 XXH32_digest (void* state_in)
     return h32;
 }
 
+
+/*****************************
+** 64-bit Hash Functions
+******************************/
+
+static
+FORCE_INLINE U64 XXH64_round(U64 acc, U64 input)
+{
+    acc += input * PRIME64_2;
+    acc  = XXH_rotl64(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+static
+FORCE_INLINE U64 XXH64_mergeRound(U64 acc, U64 val)
+{
+    val  = XXH64_round(0, val);
+    acc ^= val;
+    acc  = acc * PRIME64_1 + PRIME64_4;
+    return acc;
+}
+
+static
+FORCE_INLINE U64 XXH64_finalize(U64 h64, const BYTE* p, const BYTE* bEnd, XXH_endianess endian, XXH_alignment align)
+{
+#define XXH_get64bits(p) XXH_readLE64_align((const U64*)p, endian, align)
+    while (p+8<=bEnd)
+    {
+        U64 const k1 = XXH64_round(0, XXH_get64bits(p));
+        h64 ^= k1;
+        h64  = XXH_rotl64(h64, 27) * PRIME64_1 + PRIME64_4;
+        p+=8;
+    }
+
+    if (p+4<=bEnd)
+    {
+        h64 ^= (U64)(XXH_get32bits(p)) * PRIME64_1;
+        h64  = XXH_rotl64(h64, 23) * PRIME64_2 + PRIME64_3;
+        p+=4;
+    }
+
+    while (p<bEnd)
+    {
+        h64 ^= (*p) * PRIME64_5;
+        h64  = XXH_rotl64(h64, 11) * PRIME64_1;
+        p++;
+    }
+
+    h64 ^= h64 >> 33;
+    h64 *= PRIME64_2;
+    h64 ^= h64 >> 29;
+    h64 *= PRIME64_3;
+    h64 ^= h64 >> 32;
+
+    return h64;
+}
+
+static
+FORCE_INLINE U64 XXH64_endian_align(const void* input, size_t len, U64 seed, XXH_endianess endian, XXH_alignment align)
+{
+    const BYTE* p = (const BYTE*)input;
+    const BYTE* bEnd = p + len;
+    U64 h64;
+
+#ifdef XXH_ACCEPT_NULL_INPUT_POINTER
+    if (p==NULL) { len=0; bEnd=p=(const BYTE*)(size_t)32; }
+#endif
+
+    if (len>=32)
+    {
+        const BYTE* const limit = bEnd - 32;
+        U64 v1 = seed + PRIME64_1 + PRIME64_2;
+        U64 v2 = seed + PRIME64_2;
+        U64 v3 = seed + 0;
+        U64 v4 = seed - PRIME64_1;
+
+        do
+        {
+            v1 = XXH64_round(v1, XXH_get64bits(p)); p+=8;
+            v2 = XXH64_round(v2, XXH_get64bits(p)); p+=8;
+            v3 = XXH64_round(v3, XXH_get64bits(p)); p+=8;
+            v4 = XXH64_round(v4, XXH_get64bits(p)); p+=8;
+        } while (p<=limit);
+
+        h64 = XXH_rotl64(v1, 1) + XXH_rotl64(v2, 7) + XXH_rotl64(v3, 12) + XXH_rotl64(v4, 18);
+        h64 = XXH64_mergeRound(h64, v1);
+        h64 = XXH64_mergeRound(h64, v2);
+        h64 = XXH64_mergeRound(h64, v3);
+        h64 = XXH64_mergeRound(h64, v4);
+    }
+    else
+    {
+        h64  = seed + PRIME64_5;
+    }
+
+    h64 += (U64) len;
+
+    return XXH64_finalize(h64, p, bEnd, endian, align);
+}
+
+static
+U64 XXH64(const void* input, size_t len, U64 seed)
+{
+    XXH_endianess endian_detected = (XXH_endianess)XXH_CPU_LITTLE_ENDIAN;
+
+#  if !defined(XXH_USE_UNALIGNED_ACCESS)
+    if ((((size_t)input) & 7) == 0)   /* Input is aligned, let's leverage the speed advantage */
+    {
+        if ((endian_detected==XXH_littleEndian) || XXH_FORCE_NATIVE_FORMAT)
+            return XXH64_endian_align(input, len, seed, XXH_littleEndian, XXH_aligned);
+        else
+            return XXH64_endian_align(input, len, seed, XXH_bigEndian, XXH_aligned);
+    }
+#  endif
+
+    if ((endian_detected==XXH_littleEndian) || XXH_FORCE_NATIVE_FORMAT)
+        return XXH64_endian_align(input, len, seed, XXH_littleEndian, XXH_unaligned);
+    else
+        return XXH64_endian_align(input, len, seed, XXH_bigEndian, XXH_unaligned);
+}
+
+struct XXH_state64_t
+{
+    U64 total_len;
+    U64 seed;
+    U64 v1;
+    U64 v2;
+    U64 v3;
+    U64 v4;
+    U64 memory[4];
+    int memsize;
+};
+
+static
+XXH_errorcode XXH64_resetState(void* state_in, U64 seed)
+{
+    struct XXH_state64_t * state = (struct XXH_state64_t *) state_in;
+    state->seed = seed;
+    state->v1 = seed + PRIME64_1 + PRIME64_2;
+    state->v2 = seed + PRIME64_2;
+    state->v3 = seed + 0;
+    state->v4 = seed - PRIME64_1;
+    state->total_len = 0;
+    state->memsize = 0;
+    return XXH_OK;
+}
+
+static
+void* XXH64_init (U64 seed)
+{
+    void* state = XXH_malloc (sizeof(struct XXH_state64_t));
+    if (state != NULL)
+        XXH64_resetState(state, seed);
+    return state;
+}
+
+static
+FORCE_INLINE XXH_errorcode XXH64_update_endian (void* state_in, const void* input, size_t len, XXH_endianess endian)
+{
+    struct XXH_state64_t * state = (struct XXH_state64_t *) state_in;
+    const BYTE* p = (const BYTE*)input;
+    const BYTE* const bEnd = p + len;
+
+#ifdef XXH_ACCEPT_NULL_INPUT_POINTER
+    if (input==NULL) return XXH_ERROR;
+#endif
+
+    state->total_len += len;
+
+    if (state->memsize + len < 32)   /* fill in tmp buffer */
+    {
+        XXH_memcpy(((BYTE*)state->memory) + state->memsize, input, len);
+        state->memsize += (int)len;
+        return XXH_OK;
+    }
+
+    if (state->memsize)   /* some data left from previous update */
+    {
+        XXH_memcpy(((BYTE*)state->memory) + state->memsize, input, 32-state->memsize);
+        state->v1 = XXH64_round(state->v1, XXH_readLE64(state->memory+0, endian));
+        state->v2 = XXH64_round(state->v2, XXH_readLE64(state->memory+1, endian));
+        state->v3 = XXH64_round(state->v3, XXH_readLE64(state->memory+2, endian));
+        state->v4 = XXH64_round(state->v4, XXH_readLE64(state->memory+3, endian));
+        p += 32-state->memsize;
+        state->memsize = 0;
+    }
+
+    if (p+32 <= bEnd)
+    {
+        const BYTE* const limit = bEnd - 32;
+        U64 v1 = state->v1;
+        U64 v2 = state->v2;
+        U64 v3 = state->v3;
+        U64 v4 = state->v4;
+
+        do
+        {
+            v1 = XXH64_round(v1, XXH_readLE64((const U64*)p, endian)); p+=8;
+            v2 = XXH64_round(v2, XXH_readLE64((const U64*)p, endian)); p+=8;
+            v3 = XXH64_round(v3, XXH_readLE64((const U64*)p, endian)); p+=8;
+            v4 = XXH64_round(v4, XXH_readLE64((const U64*)p, endian)); p+=8;
+        } while (p<=limit);
+
+        state->v1 = v1;
+        state->v2 = v2;
+        state->v3 = v3;
+        state->v4 = v4;
+    }
+
+    if (p < bEnd)
+    {
+        XXH_memcpy(state->memory, p, bEnd-p);
+        state->memsize = (int)(bEnd-p);
+    }
+
+    return XXH_OK;
+}
+
+static
+XXH_errorcode XXH64_update (void* state_in, const void* input, size_t len)
+{
+    XXH_endianess endian_detected = (XXH_endianess)XXH_CPU_LITTLE_ENDIAN;
+
+    if ((endian_detected==XXH_littleEndian) || XXH_FORCE_NATIVE_FORMAT)
+        return XXH64_update_endian(state_in, input, len, XXH_littleEndian);
+    else
+        return XXH64_update_endian(state_in, input, len, XXH_bigEndian);
+}
+
+static
+FORCE_INLINE U64 XXH64_intermediateDigest_endian (void* state_in, XXH_endianess endian)
+{
+    struct XXH_state64_t * state = (struct XXH_state64_t *) state_in;
+    const BYTE * p = (const BYTE*)state->memory;
+    const BYTE * const bEnd = p + state->memsize;
+    U64 h64;
+
+    if (state->total_len >= 32)
+    {
+        U64 const v1 = state->v1;
+        U64 const v2 = state->v2;
+        U64 const v3 = state->v3;
+        U64 const v4 = state->v4;
+
+        h64 = XXH_rotl64(v1, 1) + XXH_rotl64(v2, 7) + XXH_rotl64(v3, 12) + XXH_rotl64(v4, 18);
+        h64 = XXH64_mergeRound(h64, v1);
+        h64 = XXH64_mergeRound(h64, v2);
+        h64 = XXH64_mergeRound(h64, v3);
+        h64 = XXH64_mergeRound(h64, v4);
+    }
+    else
+    {
+        h64  = state->seed + PRIME64_5;
+    }
+
+    h64 += (U64) state->total_len;
+
+    /* The tail buffer is always properly aligned. */
+    return XXH64_finalize(h64, p, bEnd, endian, XXH_aligned);
+}
+
+static
+U64 XXH64_digest (void* state_in)
+{
+    XXH_endianess endian_detected = (XXH_endianess)XXH_CPU_LITTLE_ENDIAN;
+    U64 h64;
+
+    if ((endian_detected==XXH_littleEndian) || XXH_FORCE_NATIVE_FORMAT)
+        h64 = XXH64_intermediateDigest_endian(state_in, XXH_littleEndian);
+    else
+        h64 = XXH64_intermediateDigest_endian(state_in, XXH_bigEndian);
+
+    XXH_free(state_in);
+
+    return h64;
+}
+
 const
 struct archive_xxhash __archive_xxhash = {
 	XXH32,
 	XXH32_init,
 	XXH32_update,
-	XXH32_digest
+	XXH32_digest,
+	XXH64,
+	XXH64_init,
+	XXH64_update,
+	XXH64_digest
 };
-#else
-
-/*
- * Define an empty version of the struct if we aren't using the LZ4 library.
- */
-const
-struct archive_xxhash __archive_xxhash = {
-	NULL,
-	NULL,
-	NULL,
-	NULL
-};
-
-#endif /* HAVE_LIBLZ4 */
@@ -334,6 +334,9 @@ main(int argc, char **argv)
 			bsdtar->extract_flags |=
 			    ARCHIVE_EXTRACT_CLEAR_NOCHANGE_FFLAGS;
 			break;
+		case 'd': /* GNU tar */
+			set_mode(bsdtar, opt);
+			break;
 		case OPTION_EXCLUDE: /* GNU tar */
 			if (archive_match_exclude_pattern(
 			    bsdtar->matching, bsdtar->argument) != ARCHIVE_OK)
@@ -643,6 +646,9 @@ main(int argc, char **argv)
 		case OPTION_POSIX: /* GNU tar */
 			cset_set_format(bsdtar->cset, "pax");
 			break;
+		case OPTION_PREALLOCATE:
+			bsdtar->extract_flags |= ARCHIVE_EXTRACT_PREALLOCATE;
+			break;
 		case 'q': /* FreeBSD GNU tar --fast-read, NetBSD -q */
 			bsdtar->flags |= OPTFLAG_FAST_READ;
 			break;
@@ -793,7 +799,7 @@ main(int argc, char **argv)
 	/* Otherwise, a mode is required. */
 	if (bsdtar->mode == '\0')
 		lafe_errc(1, 0,
-		    "Must specify one of -c, -r, -t, -u, -x");
+		    "Must specify one of -c, -d, -r, -t, -u, -x");
 
 	/* Check boolean options only permitted in certain modes. */
 	if (bsdtar->flags & OPTFLAG_AUTO_COMPRESS)
@@ -801,7 +807,7 @@ main(int argc, char **argv)
 	if (bsdtar->readdisk_flags & ARCHIVE_READDISK_NO_TRAVERSE_MOUNTS)
 		only_mode(bsdtar, "--one-file-system", "cru");
 	if (bsdtar->flags & OPTFLAG_FAST_READ)
-		only_mode(bsdtar, "--fast-read", "xt");
+		only_mode(bsdtar, "--fast-read", "dxt");
 	if (bsdtar->extract_flags & ARCHIVE_EXTRACT_HFS_COMPRESSION_FORCED)
 		only_mode(bsdtar, "--hfsCompression", "x");
 	if (bsdtar->extract_flags & ARCHIVE_EXTRACT_NO_HFS_COMPRESSION)
@@ -860,7 +866,7 @@ main(int argc, char **argv)
 	}
 	/* Check other parameters only permitted in certain modes. */
 	if (compress_program != NULL) {
-		only_mode(bsdtar, "--use-compress-program", "cxt");
+		only_mode(bsdtar, "--use-compress-program", "cdxt");
 		cset_add_filter_program(bsdtar->cset, compress_program);
 		/* Ignore specified compressions. */
 		compression = '\0';
@@ -877,13 +883,13 @@ main(int argc, char **argv)
 			strcat(buff, compression_name);
 			break;
 		}
-		only_mode(bsdtar, buff, "cxt");
+		only_mode(bsdtar, buff, "cdxt");
 		cset_add_filter(bsdtar->cset, compression_name);
 	}
 	if (compression2 != '\0') {
 		strcpy(buff, "--");
 		strcat(buff, compression2_name);
-		only_mode(bsdtar, buff, "cxt");
+		only_mode(bsdtar, buff, "cdxt");
 		cset_add_filter(bsdtar->cset, compression2_name);
 	}
 	if (cset_get_format(bsdtar->cset) != NULL)
@@ -912,6 +918,9 @@ main(int argc, char **argv)
 	case 'c':
 		tar_mode_c(bsdtar);
 		break;
+	case 'd':
+		tar_mode_d(bsdtar);
+		break;
 	case 'r':
 		tar_mode_r(bsdtar);
 		break;
@@ -972,6 +981,7 @@ usage(void)
 	fprintf(stderr, "  List:    %s -tf <archive-filename>\n", p);
 	fprintf(stderr, "  Extract: %s -xf <archive-filename>\n", p);
 	fprintf(stderr, "  Create:  %s -cf <archive-filename> [filenames...]\n", p);
+	fprintf(stderr, "  Compare: %s -df <archive-filename> [patterns...]\n", p);
 	fprintf(stderr, "  Help:    %s --help\n", p);
 	exit(1);
 }
@@ -987,7 +997,7 @@ version(void)
 
 static const char *long_help_msg =
 	"First option must be a mode specifier:\n"
-	"  -c Create  -r Add/Replace  -t List  -u Update  -x Extract\n"
+	"  -c Create  -d Compare  -r Add/Replace  -t List  -u Update  -x Extract\n"
 	"Common Options:\n"
 	"  -b #  Use # 512-byte records per I/O block\n"
 	"  -f <filename>  Location of archive (default " _PATH_DEFTAPE ")\n"
@@ -1007,7 +1017,9 @@ static const char *long_help_msg =
 	"  -k    Keep (don't overwrite) existing files\n"
 	"  -m    Don't restore modification times\n"
 	"  -O    Write entries to stdout, don't restore to disk\n"
-	"  -p    Restore permissions (including ACLs, owner, file flags)\n";
+	"  -p    Restore permissions (including ACLs, owner, file flags)\n"
+	"Compare: %p -d [options] [<patterns>]\n"
+	"  <patterns>  If specified, compare only entries that match\n";
 
 
 /*
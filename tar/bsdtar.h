@@ -62,7 +62,7 @@ struct bsdtar {
 	int		  uid;  /* --uid */
 	const char	 *uname; /* --uname */
 	const char	 *passphrase; /* --passphrase */
-	char		  mode; /* Program mode: 'c', 't', 'r', 'u', 'x' */
+	char		  mode; /* Program mode: 'c', 'd', 't', 'r', 'u', 'x' */
 	char		  symlink_mode; /* H or L, per BSD conventions */
 	const char	 *option_options; /* --options */
 	char		  day_first; /* show day before month in -tv output */
@@ -90,12 +90,12 @@ struct bsdtar {
 	 * Data for various subsystems.  Full definitions are located in
 	 * the file where they are used.
 	 */
-	struct archive		*diskreader;	/* for write.c */
+	struct archive		*diskreader;	/* for write.c, read.c */
 	struct archive_entry_linkresolver *resolver; /* for write.c */
 	struct archive_dir	*archive_dir;	/* for write.c */
 	struct name_cache	*gname_cache;	/* for write.c */
-	char			*buff;		/* for write.c */
-	size_t			 buff_size;	/* for write.c */
+	char			*buff;		/* for write.c, read.c */
+	size_t			 buff_size;	/* for write.c, read.c */
 	int			 first_fs;	/* for write.c */
 	struct archive		*matching;	/* for matching.c */
 	struct security		*security;	/* for read.c */
@@ -178,6 +178,7 @@ enum {
 	OPTION_OPTIONS,
 	OPTION_PASSPHRASE,
 	OPTION_POSIX,
+	OPTION_PREALLOCATE,
 	OPTION_SAFE_WRITES,
 	OPTION_SAME_OWNER,
 	OPTION_STRIP_COMPONENTS,
@@ -200,6 +201,7 @@ void	safe_fprintf(FILE *, const char *fmt, ...) __LA_PRINTF(2, 3);
 void	set_chdir(struct bsdtar *, const char *newdir);
 const char *tar_i64toa(int64_t);
 void	tar_mode_c(struct bsdtar *bsdtar);
+void	tar_mode_d(struct bsdtar *bsdtar);
 void	tar_mode_r(struct bsdtar *bsdtar);
 void	tar_mode_t(struct bsdtar *bsdtar);
 void	tar_mode_u(struct bsdtar *bsdtar);
@@ -47,7 +47,7 @@ __FBSDID("$FreeBSD$");
  * Short options for tar.  Please keep this sorted.
  */
 static const char *short_options
-	= "aBb:C:cf:HhI:JjkLlmnOoPpqrSs:T:tUuvW:wX:xyZz";
+	= "aBb:C:cdf:HhI:JjkLlmnOoPpqrSs:T:tUuvW:wX:xyZz";
 
 /*
  * Long options for tar.  Please keep this list sorted.
@@ -77,10 +77,12 @@ static const struct bsdtar_option {
 	{ "check-links",          0, OPTION_CHECK_LINKS },
 	{ "chroot",               0, OPTION_CHROOT },
 	{ "clear-nochange-fflags", 0, OPTION_CLEAR_NOCHANGE_FFLAGS },
+	{ "compare",              0, 'd' },
 	{ "compress",             0, 'Z' },
 	{ "confirmation",         0, 'w' },
 	{ "create",               0, 'c' },
 	{ "dereference",	  0, 'L' },
+	{ "diff",                 0, 'd' },
 	{ "directory",            1, 'C' },
 	{ "disable-copyfile",	  0, OPTION_NO_MAC_METADATA },
 	{ "exclude",              1, OPTION_EXCLUDE },
@@ -143,6 +145,7 @@ static const struct bsdtar_option {
 	{ "options",              1, OPTION_OPTIONS },
 	{ "passphrase",		  1, OPTION_PASSPHRASE },
 	{ "posix",		  0, OPTION_POSIX },
+	{ "preallocate",	  0, OPTION_PREALLOCATE },
 	{ "preserve-permissions", 0, 'p' },
 	{ "read-full-blocks",	  0, 'B' },
 	{ "safe-writes",	  0, OPTION_SAFE_WRITES },
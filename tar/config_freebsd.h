@@ -53,6 +53,7 @@
 #define	HAVE_NL_LANGINFO 1
 #endif
 #define	HAVE_PATHS_H 1
+#define	HAVE_POSIX_FADVISE 1
 #define	HAVE_PWD_H 1
 #define	HAVE_READLINK 1
 #define	HAVE_REGEX_H 1
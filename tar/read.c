@@ -78,16 +78,75 @@ __FBSDID("$FreeBSD: src/usr.bin/tar/read.c,v 1.40 2008/08/21 06:41:14 kientzle E
 #include "bsdtar.h"
 #include "err.h"
 
+#ifndef O_BINARY
+#define	O_BINARY 0
+#endif
+
+/*
+ * Files are compared in large, page-aligned chunks so that the disk
+ * side of a verification run is not limited by the (usually much
+ * smaller) blocks the archive reader hands back.
+ *
+ * The comparison runs on the calling thread.  Entries come out of the
+ * archive one at a time, and each block from archive_read_data_block()
+ * is only valid until the next call, so handing blocks to workers
+ * would mean copying them, which costs about as much as the memcmp()
+ * it saves.  Disk reads already overlap with decoding through kernel
+ * readahead (POSIX_FADV_SEQUENTIAL).  What remains is the copy out of
+ * the page cache, which a reader thread could hide, but decoding
+ * dominates for compressed archives.
+ */
+#define	COMPARE_BUFF_SIZE	(1024 * 1024)
+#define	COMPARE_BUFF_ALIGN	4096
+
+struct compare_file {
+	int		 fd;
+	char		*buff;
+	size_t		 buff_size;
+	size_t		 avail;		/* Bytes read into buff. */
+	size_t		 next;		/* First byte not yet compared. */
+};
+
 struct progress_data {
 	struct bsdtar *bsdtar;
 	struct archive *archive;
 	struct archive_entry *entry;
 };
 
+static int	compare_entry(struct bsdtar *, struct archive *,
+		    struct archive_entry *);
 static void	read_archive(struct bsdtar *bsdtar, char mode, struct archive *);
 static int unmatched_inclusions_warn(struct archive *matching, const char *);
 
 
+void
+tar_mode_d(struct bsdtar *bsdtar)
+{
+	bsdtar->diskreader = archive_read_disk_new();
+	if (bsdtar->diskreader == NULL)
+		lafe_errc(1, ENOMEM, "Cannot allocate disk reader object");
+	/* Only the plain stat(2) data is compared. */
+	archive_read_disk_set_symlink_physical(bsdtar->diskreader);
+	archive_read_disk_set_behavior(bsdtar->diskreader,
+	    ARCHIVE_READDISK_NO_ACL | ARCHIVE_READDISK_NO_XATTR |
+	    ARCHIVE_READDISK_NO_FFLAGS);
+
+	bsdtar->buff_size = COMPARE_BUFF_SIZE;
+	bsdtar->buff = malloc(bsdtar->buff_size + COMPARE_BUFF_ALIGN);
+	if (bsdtar->buff == NULL)
+		lafe_errc(1, ENOMEM, "Cannot allocate memory");
+
+	read_archive(bsdtar, 'd', NULL);
+
+	if (unmatched_inclusions_warn(bsdtar->matching,
+	    "Not found in archive") != 0)
+		bsdtar->return_value = 1;
+	free(bsdtar->buff);
+	bsdtar->buff = NULL;
+	archive_read_free(bsdtar->diskreader);
+	bsdtar->diskreader = NULL;
+}
+
 void
 tar_mode_t(struct bsdtar *bsdtar)
 {
@@ -154,7 +213,7 @@ progress_func(void *cookie)
 }
 
 /*
- * Handle 'x' and 't' modes.
+ * Handle 'd', 't' and 'x' modes.
  */
 static void
 read_archive(struct bsdtar *bsdtar, char mode, struct archive *writer)
@@ -341,6 +400,12 @@ read_archive(struct bsdtar *bsdtar, char mode, struct archive *writer)
 				break;
 			}
 			fprintf(out, "\n");
+		} else if (mode == 'd') {
+			if (edit_pathname(bsdtar, entry))
+				continue; /* Excluded by a rewrite failure. */
+			r = compare_entry(bsdtar, a, entry);
+			if (r == ARCHIVE_FATAL)
+				break;
 		} else {
 			/* Note: some rewrite failures prevent extraction. */
 			if (edit_pathname(bsdtar, entry))
@@ -418,3 +483,218 @@ unmatched_inclusions_warn(struct archive *matching, const char *msg)
 
 	return (archive_match_path_unmatched_inclusions(matching));
 }
+
+/*
+ * Print one difference between an archive entry and the disk.
+ * Differences go to stdout so they can be collected separately from
+ * real errors, and they make the final exit status nonzero.
+ */
+static void
+compare_report(struct bsdtar *bsdtar, const char *path, const char *what)
+{
+	safe_fprintf(stdout, "%s: %s", path, what);
+	fprintf(stdout, "\n");
+	bsdtar->return_value = 1;
+}
+
+/*
+ * Compare the next 'len' bytes of the file with 'p', or with zeros if
+ * 'p' is NULL (a hole in a sparse entry).  Returns 0 if they match,
+ * 1 if they differ and -1 on a read error.
+ */
+static int
+compare_file_bytes(struct compare_file *cf, const char *p, int64_t len)
+{
+	const char *q;
+	size_t n;
+	ssize_t bytes_read;
+
+	while (len > 0) {
+		if (cf->next == cf->avail) {
+			bytes_read = read(cf->fd, cf->buff, cf->buff_size);
+			if (bytes_read < 0)
+				return (-1);
+			if (bytes_read == 0)
+				return (1); /* File is shorter than entry. */
+			cf->avail = (size_t)bytes_read;
+			cf->next = 0;
+		}
+		n = cf->avail - cf->next;
+		if ((int64_t)n > len)
+			n = (size_t)len;
+		q = cf->buff + cf->next;
+		if (p != NULL) {
+			if (memcmp(p, q, n) != 0)
+				return (1);
+			p += n;
+		} else if (q[0] != '\0' ||
+		    (n > 1 && memcmp(q, q + 1, n - 1) != 0))
+			return (1);
+		cf->next += n;
+		len -= n;
+	}
+	return (0);
+}
+
+/*
+ * Compare the body of the current entry with the file open on 'fd'.
+ */
+static int
+compare_data(struct bsdtar *bsdtar, struct archive *a,
+    struct archive_entry *entry, int fd)
+{
+	struct compare_file cf;
+	const void *block;
+	size_t size;
+	int64_t offset, pos;
+	int r, same;
+
+	cf.fd = fd;
+	cf.buff = bsdtar->buff + (COMPARE_BUFF_ALIGN -
+	    ((uintptr_t)bsdtar->buff % COMPARE_BUFF_ALIGN)) %
+	    COMPARE_BUFF_ALIGN;
+	cf.buff_size = bsdtar->buff_size;
+	cf.avail = cf.next = 0;
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	pos = 0;
+	same = 0;
+	for (;;) {
+		r = archive_read_data_block(a, &block, &size, &offset);
+		if (r == ARCHIVE_EOF)
+			break;
+		if (r != ARCHIVE_OK) {
+			lafe_warnc(0, "%s: %s", archive_entry_pathname(entry),
+			    archive_error_string(a));
+			bsdtar->return_value = 1;
+			if (r < ARCHIVE_WARN)
+				return (r);
+		}
+		if (offset > pos)
+			same = compare_file_bytes(&cf, NULL, offset - pos);
+		if (same == 0)
+			same = compare_file_bytes(&cf, block, size);
+		if (same != 0)
+			break;
+		pos = offset + size;
+	}
+	/* A sparse entry may end with a hole. */
+	if (same == 0 && pos < archive_entry_size(entry))
+		same = compare_file_bytes(&cf, NULL,
+		    archive_entry_size(entry) - pos);
+	if (same < 0) {
+		lafe_warnc(errno, "%s: Read error",
+		    archive_entry_pathname(entry));
+		bsdtar->return_value = 1;
+	} else if (same > 0)
+		compare_report(bsdtar, archive_entry_pathname(entry),
+		    "Contents differ");
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Compare one archive entry with the file of the same name on disk.
+ * Returns the status of the archive reader; differences and problems
+ * with the disk side only affect the exit status.
+ */
+static int
+compare_entry(struct bsdtar *bsdtar, struct archive *a,
+    struct archive_entry *entry)
+{
+	struct archive *disk = bsdtar->diskreader;
+	struct archive_entry *dentry, *lentry;
+	const char *path, *hardlink, *s1, *s2;
+	int fd, r;
+
+	path = archive_entry_pathname(entry);
+	hardlink = archive_entry_hardlink(entry);
+	if (bsdtar->verbose) {
+		safe_fprintf(stdout, "%s", path);
+		fprintf(stdout, "\n");
+	}
+
+	dentry = archive_entry_new();
+	if (dentry == NULL)
+		lafe_errc(1, ENOMEM, "Cannot allocate memory");
+	archive_entry_copy_pathname(dentry, path);
+	if (archive_read_disk_entry_from_file(disk, dentry, -1, NULL)
+	    < ARCHIVE_WARN) {
+		lafe_warnc(archive_errno(disk), "%s: Cannot stat", path);
+		bsdtar->return_value = 1;
+		archive_entry_free(dentry);
+		return (ARCHIVE_OK);
+	}
+
+	r = ARCHIVE_OK;
+	if (hardlink != NULL) {
+		lentry = archive_entry_new();
+		if (lentry == NULL)
+			lafe_errc(1, ENOMEM, "Cannot allocate memory");
+		archive_entry_copy_pathname(lentry, hardlink);
+		if (archive_read_disk_entry_from_file(disk, lentry, -1, NULL)
+		    < ARCHIVE_WARN ||
+		    archive_entry_dev(lentry) != archive_entry_dev(dentry) ||
+		    archive_entry_ino64(lentry) != archive_entry_ino64(dentry)) {
+			safe_fprintf(stdout, "%s: Not linked to %s",
+			    path, hardlink);
+			fprintf(stdout, "\n");
+			bsdtar->return_value = 1;
+		}
+		archive_entry_free(lentry);
+		/* Only some formats store the data with a link. */
+		if (archive_entry_size(entry) == 0)
+			goto done;
+	}
+
+	if (archive_entry_filetype(entry) != archive_entry_filetype(dentry)) {
+		compare_report(bsdtar, path, "File type differs");
+		goto done;
+	}
+	if (archive_entry_filetype(entry) == AE_IFLNK) {
+		s1 = archive_entry_symlink(entry);
+		s2 = archive_entry_symlink(dentry);
+		if (s1 == NULL || s2 == NULL || strcmp(s1, s2) != 0)
+			compare_report(bsdtar, path, "Symlink differs");
+		goto done;
+	}
+	if (archive_entry_perm(entry) != archive_entry_perm(dentry))
+		compare_report(bsdtar, path, "Mode differs");
+	if (archive_entry_uid(entry) != archive_entry_uid(dentry))
+		compare_report(bsdtar, path, "Uid differs");
+	if (archive_entry_gid(entry) != archive_entry_gid(dentry))
+		compare_report(bsdtar, path, "Gid differs");
+	/* Directory times change whenever their contents do. */
+	if (archive_entry_filetype(entry) != AE_IFDIR &&
+	    archive_entry_mtime_is_set(entry) &&
+	    archive_entry_mtime(entry) != archive_entry_mtime(dentry))
+		compare_report(bsdtar, path, "Mod time differs");
+
+	switch (archive_entry_filetype(entry)) {
+	case AE_IFBLK:
+	case AE_IFCHR:
+		if (archive_entry_rdev(entry) != archive_entry_rdev(dentry))
+			compare_report(bsdtar, path, "Device number differs");
+		break;
+	case AE_IFREG:
+		if (archive_entry_size(entry) != archive_entry_size(dentry)) {
+			compare_report(bsdtar, path, "Size differs");
+			break;
+		}
+		if (archive_entry_size(entry) == 0)
+			break;
+		fd = open(path, O_RDONLY | O_BINARY);
+		if (fd < 0) {
+			lafe_warnc(errno, "%s: Cannot open", path);
+			bsdtar->return_value = 1;
+			break;
+		}
+		r = compare_data(bsdtar, a, entry, fd);
+		close(fd);
+		break;
+	}
+done:
+	archive_entry_free(dentry);
+	return (r);
+}
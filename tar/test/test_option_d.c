@@ -0,0 +1,107 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+DEFINE_TEST(test_option_d)
+{
+	const char *differences[] = {
+		"d/edit: Contents differ",
+		"d/grow: Size differs",
+		"d/perm: Mode differs",
+		NULL
+	};
+	const char *link_differences[] = {
+		"d/link: Symlink differs",
+		NULL
+	};
+
+	assertMakeDir("d", 0755);
+	assertMakeFile("d/same", 0644, "unchanged");
+	assertMakeFile("d/edit", 0644, "original");
+	assertMakeFile("d/grow", 0644, "short");
+	assertMakeFile("d/perm", 0644, "perm");
+	assertMakeFile("d/gone", 0644, "gone");
+	assertUtimes("d/edit", 86400, 0, 86400, 0);
+	assertUtimes("d/grow", 86400, 0, 86400, 0);
+	if (canSymlink())
+		assertMakeSymlink("d/link", "same", 0);
+
+	assertEqualInt(0,
+	    systemf("%s -cf archive.tar d >c.out 2>c.err", testprog));
+	assertEmptyFile("c.out");
+	assertEmptyFile("c.err");
+
+	/* Nothing has changed yet. */
+	assertEqualInt(0,
+	    systemf("%s -df archive.tar >d1.out 2>d1.err", testprog));
+	assertEmptyFile("d1.out");
+	assertEmptyFile("d1.err");
+
+	/* The long names select the same mode. */
+	assertEqualInt(0,
+	    systemf("%s --diff -f archive.tar >d2.out 2>d2.err", testprog));
+	assertEmptyFile("d2.out");
+	assertEmptyFile("d2.err");
+	assertEqualInt(0,
+	    systemf("%s --compare -f archive.tar d/same >d3.out 2>d3.err",
+	    testprog));
+	assertEmptyFile("d3.out");
+	assertEmptyFile("d3.err");
+
+	/* Same size and time, different bytes. */
+	assertMakeFile("d/edit", 0644, "ORIGINAL");
+	assertUtimes("d/edit", 86400, 0, 86400, 0);
+	assertMakeFile("d/grow", 0644, "not so short");
+	assertUtimes("d/grow", 86400, 0, 86400, 0);
+	assertChmod("d/perm", 0600);
+	assertEqualInt(0, systemf("%s -df archive.tar d/same d/edit d/grow "
+	    "d/perm >d4.out 2>d4.err", testprog) == 0);
+	assertFileContainsLinesAnyOrder("d4.out", differences);
+
+	/* -v lists every entry that was compared. */
+	assertEqualInt(0, systemf("%s -dvf archive.tar d/same "
+	    ">d5.out 2>d5.err", testprog));
+	assertTextFileContents("d/same\n", "d5.out");
+	assertEmptyFile("d5.err");
+
+	/* A missing file is an error, not a difference. */
+	assertEqualInt(0, unlink("d/gone"));
+	assertEqualInt(0, systemf("%s -df archive.tar d/gone "
+	    ">d6.out 2>d6.err", testprog) == 0);
+	assertEmptyFile("d6.out");
+	assertNonEmptyFile("d6.err");
+
+	if (canSymlink()) {
+		assertEqualInt(0, unlink("d/link"));
+		assertMakeSymlink("d/link", "edit", 0);
+		assertEqualInt(0, systemf("%s -df archive.tar d/link "
+		    ">d7.out 2>d7.err", testprog) == 0);
+		assertFileContainsLinesAnyOrder("d7.out", link_differences);
+	}
+
+	/* Other modes don't accept -d. */
+	assertEqualInt(0, systemf("%s -d -x -f archive.tar "
+	    ">d8.out 2>d8.err", testprog) == 0);
+}